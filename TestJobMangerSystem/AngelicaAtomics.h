@@ -100,7 +100,7 @@ struct SLockFreeSingleLinkedListHeader
 
 	//! Retrieves a pointer to the first item on a single-linked list.
 	//! \note This does not remove the item from the list, and it's unsafe to inspect anything but the returned address.
-	//friend void* AngelicaRtlFirstEntrySList(SLockFreeSingleLinkedListHeader& list);
+	friend void* AngelicaRtlFirstEntrySList(SLockFreeSingleLinkedListHeader& list);
 
 	//! Pops one element atomically from the front of a single-linked list, and returns a pointer to the item.
 	//! \note If the list was empty, nullptr is returned instead.
@@ -129,6 +129,8 @@ static_assert(std::alignment_of<SLockFreeSingleLinkedListHeader>::value == sizeo
 
 #if _WIN32
 	#include "AngelicaAtomics_win32.h"
+#elif ANGELICA_PLATFORM_POSIX
+	#include "AngelicaAtomics_posix.h"
 #endif
 
 #define WRITE_LOCK_VAL (1 << 16)
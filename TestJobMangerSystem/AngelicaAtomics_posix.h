@@ -3,7 +3,11 @@
 #pragma once
 
 #include <sched.h>
-#include <AngelicaCore/Assert/AngelicaAssert.h>
+#include <unistd.h>
+#include <assert.h>
+#if !ANGELICA_PLATFORM_ANDROID
+	#include <immintrin.h>
+#endif
 
 //////////////////////////////////////////////////////////////////////////
 // Interlocked API
@@ -104,8 +108,8 @@ inline unsigned char AngelicaInterlockedCompareExchange128(volatile long long* p
 	#if ANGELICA_PLATFORM_IOS
 		#error Ensure AngelicaInterlockedCompareExchange128 is working on IOS also
 	#endif
-	ANGELICA_ASSERT_MESSAGE((((long long)pDst) & 15) == 0, "The destination data must be 16-byte aligned to avoid a general protection fault.");
-	#if _WIN64 || ANGELICA_PLATFORM_X86
+	assert((((long long)pDst) & 15) == 0 && "The destination data must be 16-byte aligned to avoid a general protection fault.");
+	#if ANGELICA_PLATFORM_X64
 		bool bEquals;
 		__asm__ __volatile__(
 		"lock cmpxchg16b %1\n\t"
@@ -160,11 +160,19 @@ private:
 namespace AngelicaMT {
 	void AngelicaMemoryBarrier();
 	void AngelicaYieldThread();
+
+	//! Wait-on-address, blocks the calling thread while the 32 bit word at pAddress equals nCompareValue.
+	//! Can return spuriously, callers need to re-check their condition in a loop.
+	void AngelicaWaitOnAddress(volatile void* pAddress, unsigned int nCompareValue);
+	//! Wakes all threads blocked in AngelicaWaitOnAddress on pAddress, the memory itself is not accessed.
+	void AngelicaWakeByAddressAll(volatile void* pAddress);
 } // namespace AngelicaMT
 
 // Include architecture specific code.
 #if _WIN32
 	#include "AngelicaThread_win32.h"
+#elif ANGELICA_PLATFORM_POSIX
+	#include "AngelicaThread_posix.h"
 #endif
 
 
@@ -8,6 +8,8 @@
 #if _WIN32
 	#include "AngelicaAtomics_impl_win32.h"
 	#include "AngelicaThreadImpl_win32.h"
+#elif ANGELICA_PLATFORM_POSIX
+	#include "AngelicaThreadImpl_posix.h"
 #endif
 
 // vim:ts=2
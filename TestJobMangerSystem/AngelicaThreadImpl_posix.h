@@ -0,0 +1,309 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+#pragma once
+
+#include "AngelicaThread_posix.h"
+#include "Linuxspecific.h"
+namespace AngelicaMT
+{
+namespace detail
+{
+
+//////////////////////////////////////////////////////////////////////////
+// AngelicaLock_PthreadMutex
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaLock_PthreadMutex::Lock()
+{
+	pthread_mutex_lock(&m_mutex);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaLock_PthreadMutex::Unlock()
+{
+	pthread_mutex_unlock(&m_mutex);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// AngelicaLock_PthreadMutex_Recursive
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaLock_PthreadMutex_Recursive::Lock()
+{
+	const unsigned long threadId = GetCurrentThreadId();
+
+	if (threadId == m_exclusiveOwningThreadId)
+	{
+		++m_recurseCounter;
+	}
+	else
+	{
+		m_posix_lock_type.Lock();
+		assert(m_recurseCounter == 0);
+		assert(m_exclusiveOwningThreadId == THREADID_NULL);
+		m_exclusiveOwningThreadId = threadId;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaLock_PthreadMutex_Recursive::Unlock()
+{
+	const unsigned long threadId = GetCurrentThreadId();
+	assert(m_exclusiveOwningThreadId == threadId);
+
+	if (m_recurseCounter)
+	{
+		--m_recurseCounter;
+	}
+	else
+	{
+		m_exclusiveOwningThreadId = THREADID_NULL;
+		m_posix_lock_type.Unlock();
+	}
+}
+
+}
+}
+
+//////////////////////////////////////////////////////////////////////////
+AngelicaEvent::AngelicaEvent() :
+	m_nState(0),
+	m_nWaiters(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////
+AngelicaEvent::~AngelicaEvent()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaEvent::Reset()
+{
+	AngelicaInterlockedExchange(alias_cast<volatile LONG*>(&m_nState), 0);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaEvent::Set()
+{
+	AngelicaInterlockedExchange(alias_cast<volatile LONG*>(&m_nState), 1);
+
+	// the exchange is a full barrier, a waiter either sees the state or is counted here
+	if (*const_cast<volatile int*>(&m_nWaiters) > 0)
+		AngelicaMT::detail::FutexWake(&m_nState, 1);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaEvent::Wait() const
+{
+	Wait(INFINITE);
+}
+
+//////////////////////////////////////////////////////////////////////////
+bool AngelicaEvent::Wait(const unsigned int timeoutMillis) const
+{
+	const signed long long nStart = GetRealTicks();
+	do
+	{
+		// auto reset, consume the signal
+		if (AngelicaInterlockedCompareExchange(alias_cast<volatile LONG*>(&m_nState), 0, 1) == 1)
+			return true;
+
+		unsigned int nRemaining = INFINITE;
+		if (timeoutMillis != INFINITE)
+		{
+			const signed long long nElapsed = (GetRealTicks() - nStart) / 1000000LL;
+			if (nElapsed >= (signed long long)timeoutMillis)
+				return false;
+			nRemaining = timeoutMillis - (unsigned int)nElapsed;
+		}
+
+		AngelicaInterlockedIncrement(&m_nWaiters);
+		AngelicaMT::detail::FutexWait(&m_nState, 0, nRemaining);
+		AngelicaInterlockedDecrement(&m_nWaiters);
+	}
+	while (true);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+AngelicaConditionVariable::AngelicaConditionVariable()
+{
+	pthread_cond_init(&m_condVar, NULL);
+}
+
+//////////////////////////////////////////////////////////////////////////
+AngelicaConditionVariable::~AngelicaConditionVariable()
+{
+	pthread_cond_destroy(&m_condVar);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaConditionVariable::NotifySingle()
+{
+	pthread_cond_signal(&m_condVar);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaConditionVariable::Notify()
+{
+	pthread_cond_broadcast(&m_condVar);
+}
+
+//////////////////////////////////////////////////////////////////////////
+AngelicaSemaphore::AngelicaSemaphore(int nMaximumCount, int nInitialCount) :
+	m_nCount(nInitialCount),
+	m_nWaiters(0)
+{
+	(void)nMaximumCount;
+}
+
+//////////////////////////////////////////////////////////////////////////
+AngelicaSemaphore::~AngelicaSemaphore()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaSemaphore::Acquire()
+{
+	do
+	{
+		const int nCount = *const_cast<volatile int*>(&m_nCount);
+		if (nCount > 0)
+		{
+			if (AngelicaInterlockedCompareExchange(alias_cast<volatile LONG*>(&m_nCount), nCount - 1, nCount) == nCount)
+				return;
+			continue;
+		}
+
+		// register as waiter before parking, the kernel re-checks m_nCount == 0 atomically
+		AngelicaInterlockedIncrement(&m_nWaiters);
+		AngelicaMT::detail::FutexWait(&m_nCount, 0);
+		AngelicaInterlockedDecrement(&m_nWaiters);
+	}
+	while (true);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaSemaphore::Release()
+{
+	AngelicaInterlockedIncrement(&m_nCount);
+
+	// only enter the kernel if somebody is parked
+	if (*const_cast<volatile int*>(&m_nWaiters) > 0)
+		AngelicaMT::detail::FutexWake(&m_nCount, 1);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaSemaphore::Release(int nCount)
+{
+	AngelicaInterlockedAdd(alias_cast<volatile LONG*>(&m_nCount), nCount);
+
+	// one kernel call wakes up to nCount parked threads
+	if (*const_cast<volatile int*>(&m_nWaiters) > 0)
+		AngelicaMT::detail::FutexWake(&m_nCount, nCount);
+}
+
+//////////////////////////////////////////////////////////////////////////
+AngelicaFastSemaphore::AngelicaFastSemaphore(int nMaximumCount, int nInitialCount) :
+	m_Semaphore(nMaximumCount),
+	m_nCounter(nInitialCount)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////
+AngelicaFastSemaphore::~AngelicaFastSemaphore()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaFastSemaphore::Acquire()
+{
+	int nCount = ~0;
+	do
+	{
+		nCount = *const_cast<volatile int*>(&m_nCounter);
+	}
+	while (AngelicaInterlockedCompareExchange(alias_cast<volatile LONG*>(&m_nCounter), nCount - 1, nCount) != nCount);
+
+	// if the count would have been 0 or below, park on the futex semaphore
+	if ((nCount - 1) < 0)
+		m_Semaphore.Acquire();
+}
+
+//////////////////////////////////////////////////////////////////////////
+bool AngelicaFastSemaphore::TryAcquire()
+{
+	int nCount = ~0;
+	do
+	{
+		nCount = *const_cast<volatile int*>(&m_nCounter);
+		if (nCount <= 0)
+			return false;
+	}
+	while (AngelicaInterlockedCompareExchange(alias_cast<volatile LONG*>(&m_nCounter), nCount - 1, nCount) != nCount);
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaFastSemaphore::Release()
+{
+	int nCount = ~0;
+	do
+	{
+		nCount = *const_cast<volatile int*>(&m_nCounter);
+	}
+	while (AngelicaInterlockedCompareExchange(alias_cast<volatile LONG*>(&m_nCounter), nCount + 1, nCount) != nCount);
+
+	// wake up futex semaphore if we have waiter
+	if (nCount < 0)
+		m_Semaphore.Release();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaFastSemaphore::Release(int nCount)
+{
+	int nOldCount = ~0;
+	do
+	{
+		nOldCount = *const_cast<volatile int*>(&m_nCounter);
+	}
+	while (AngelicaInterlockedCompareExchange(alias_cast<volatile LONG*>(&m_nCounter), nOldCount + nCount, nOldCount) != nOldCount);
+
+	// only the threads which went below 0 are parked, wake at most nCount of them
+	if (nOldCount < 0)
+		m_Semaphore.Release(-nOldCount < nCount ? -nOldCount : nCount);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+namespace AngelicaMT {
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaMemoryBarrier()
+{
+	MemoryBarrier();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaYieldThread()
+{
+	sched_yield();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaWaitOnAddress(volatile void* pAddress, unsigned int nCompareValue)
+{
+	AngelicaMT::detail::FutexWait(static_cast<volatile int*>(pAddress), (int)nCompareValue);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaWakeByAddressAll(volatile void* pAddress)
+{
+	AngelicaMT::detail::FutexWake(static_cast<volatile int*>(pAddress), INT_MAX);
+}
+} // namespace AngelicaMT
@@ -252,6 +252,12 @@ void AngelicaSemaphore::Release()
 	ReleaseSemaphore((HANDLE)m_Semaphore, 1, NULL);
 }
 
+//////////////////////////////////////////////////////////////////////////
+void AngelicaSemaphore::Release(int nCount)
+{
+	ReleaseSemaphore((HANDLE)m_Semaphore, nCount, NULL);
+}
+
 //////////////////////////////////////////////////////////////////////////
 AngelicaFastSemaphore::AngelicaFastSemaphore(int nMaximumCount, int nInitialCount) :
 	m_Semaphore(nMaximumCount),
@@ -279,6 +285,21 @@ void AngelicaFastSemaphore::Acquire()
 		m_Semaphore.Acquire();
 }
 
+//////////////////////////////////////////////////////////////////////////
+bool AngelicaFastSemaphore::TryAcquire()
+{
+	int nCount = ~0;
+	do
+	{
+		nCount = *const_cast<volatile int*>(&m_nCounter);
+		if (nCount <= 0)
+			return false;
+	}
+	while (AngelicaInterlockedCompareExchange(alias_cast<volatile LONG*>(&m_nCounter), nCount - 1, nCount) != nCount);
+
+	return true;
+}
+
 //////////////////////////////////////////////////////////////////////////
 void AngelicaFastSemaphore::Release()
 {
@@ -294,6 +315,21 @@ void AngelicaFastSemaphore::Release()
 		m_Semaphore.Release();
 }
 
+//////////////////////////////////////////////////////////////////////////
+void AngelicaFastSemaphore::Release(int nCount)
+{
+	int nOldCount = ~0;
+	do
+	{
+		nOldCount = *const_cast<volatile int*>(&m_nCounter);
+	}
+	while (AngelicaInterlockedCompareExchange(alias_cast<volatile LONG*>(&m_nCounter), nOldCount + nCount, nOldCount) != nOldCount);
+
+	// only the threads which went below 0 are sleeping, wake at most nCount of them
+	if (nOldCount < 0)
+		m_Semaphore.Release(-nOldCount < nCount ? -nOldCount : nCount);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 namespace AngelicaMT {
 
@@ -308,4 +344,16 @@ void AngelicaYieldThread()
 {
 	SwitchToThread();
 }
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaWaitOnAddress(volatile void* pAddress, unsigned int nCompareValue)
+{
+	WaitOnAddress(pAddress, &nCompareValue, sizeof(nCompareValue), INFINITE);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaWakeByAddressAll(volatile void* pAddress)
+{
+	WakeByAddressAll(const_cast<void*>(pAddress));
+}
 } // namespace AngelicaMT
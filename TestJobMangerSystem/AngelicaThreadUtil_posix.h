@@ -0,0 +1,265 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+//////////////////////////////////////////////////////////////////////////
+// NOTE: INTERNAL HEADER NOT FOR PUBLIC USE
+// This header should only be include by SystemThreading.cpp only
+// It provides an interface for pthread intrinsics
+// It's only client should be CThreadManager which should manage all thread interaction
+#if !defined(INCLUDED_FROM_SYSTEM_THREADING_CPP)
+	#error "ANGELICATEK INTERNAL HEADER. ONLY INCLUDE FROM SYSTEMTHRADING.CPP."
+#endif
+//////////////////////////////////////////////////////////////////////////
+
+#include <pthread.h>
+#include <sys/resource.h>
+#include <fenv.h>
+#include <string>
+
+#define DEFAULT_THREAD_STACK_SIZE_KB 0
+
+// pthread_setname_np only accepts 16 characters including the terminator
+#define POSIX_THREAD_NAME_LENGTH_MAX 16
+
+// Returns the last posix error, in string format. Returns an empty string if there is no error.
+static std::string GetLastErrorAsString(int nError = errno)
+{
+	if (nError == 0)
+		return "";
+
+	return strerror(nError);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// THREAD CREATION AND MANAGMENT
+//////////////////////////////////////////////////////////////////////////
+namespace AngelicaThreadUtil
+{
+// Define type for platform specific thread handle
+typedef THREAD_HANDLE TThreadHandle;
+
+struct SThreadCreationDesc
+{
+	// Define platform specific thread entry function functor type
+	typedef unsigned int (_stdcall * EntryFunc)(void*);
+
+	const char* szThreadName;
+	EntryFunc   fpEntryFunc;
+	void*       pArgList;
+	unsigned int      nStackSizeInBytes;
+};
+
+namespace detail
+{
+// pthread entry functions have a different signature, forward to the win32 style entry function
+struct SPosixThreadStart
+{
+	SThreadCreationDesc::EntryFunc fpEntryFunc;
+	void*                          pArgList;
+};
+
+static void* PosixThreadEntry(void* pData)
+{
+	SPosixThreadStart threadStart = *static_cast<SPosixThreadStart*>(pData);
+	delete static_cast<SPosixThreadStart*>(pData);
+
+	return (void*)(UINT_PTR)threadStart.fpEntryFunc(threadStart.pArgList);
+}
+}
+
+//////////////////////////////////////////////////////////////////////////
+TThreadHandle AngelicaGetCurrentThreadHandle()
+{
+	return (TThreadHandle)pthread_self();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Note: pthread_t values stay valid for the lifetime of the thread, no duplication needed
+TThreadHandle AngelicaDuplicateThreadHandle(const TThreadHandle& hThreadHandle)
+{
+	return hThreadHandle;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaCloseThreadHandle(TThreadHandle& hThreadHandle)
+{
+	// threads are created detached, nothing to release
+	hThreadHandle = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+unsigned long AngelicaGetCurrentThreadId()
+{
+	return GetCurrentThreadId();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaSetThreadName(unsigned long threadId, const char* sThreadName)
+{
+	// the name can only be set reliably from the thread itself
+	if (threadId != AngelicaGetCurrentThreadId())
+		return;
+
+	char szShortName[POSIX_THREAD_NAME_LENGTH_MAX];
+	strncpy(szShortName, sThreadName, POSIX_THREAD_NAME_LENGTH_MAX - 1);
+	szShortName[POSIX_THREAD_NAME_LENGTH_MAX - 1] = '\0';
+	pthread_setname_np(pthread_self(), szShortName);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaSetThreadAffinityMask(TThreadHandle pThreadHandle, DWORD dwAffinityMask)
+{
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	for (unsigned int i = 0; i < sizeof(DWORD) * 8 && i < CPU_SETSIZE; ++i)
+	{
+		if (dwAffinityMask & ((DWORD)1 << i))
+			CPU_SET(i, &cpuSet);
+	}
+
+	pthread_setaffinity_np((pthread_t)pThreadHandle, sizeof(cpuSet), &cpuSet);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaSetThreadPriority(TThreadHandle pThreadHandle, DWORD dwPriority)
+{
+	// SCHED_OTHER threads only have a nice value, which is per kernel thread
+	// only the calling thread can be adjusted, raising the priority requires CAP_SYS_NICE
+	if ((pthread_t)pThreadHandle != pthread_self())
+		return;
+
+	const int nNice = -(int)dwPriority;
+	if (setpriority(PRIO_PROCESS, (id_t)GetCurrentThreadId(), nNice) != 0)
+	{
+		std::string errMsg = GetLastErrorAsString();
+		//AngelicaWarning(VALIDATOR_MODULE_SYSTEM, VALIDATOR_WARNING, "<ThreadInfo> Unable to set thread priority. System Error Msg: \"%s\"", errMsg.c_str());
+		return;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaSetThreadPriorityBoost(TThreadHandle pThreadHandle, bool bEnabled)
+{
+	// no priority boosting on linux
+	(void)pThreadHandle;
+	(void)bEnabled;
+}
+
+//////////////////////////////////////////////////////////////////////////
+bool AngelicaCreateThread(TThreadHandle* pThreadHandle, const SThreadCreationDesc& threadDesc)
+{
+	const unsigned int nStackSize = threadDesc.nStackSizeInBytes != 0 ? threadDesc.nStackSizeInBytes : DEFAULT_THREAD_STACK_SIZE_KB * 1024;
+
+	pthread_attr_t threadAttr;
+	pthread_attr_init(&threadAttr);
+	pthread_attr_setdetachstate(&threadAttr, PTHREAD_CREATE_DETACHED);
+	if (nStackSize != 0)
+	{
+		const size_t nAlignedStackSize = (nStackSize < PTHREAD_STACK_MIN) ? PTHREAD_STACK_MIN : nStackSize;
+		pthread_attr_setstacksize(&threadAttr, nAlignedStackSize);
+	}
+
+	// Create thread
+	detail::SPosixThreadStart* pThreadStart = new detail::SPosixThreadStart;
+	pThreadStart->fpEntryFunc = threadDesc.fpEntryFunc;
+	pThreadStart->pArgList = threadDesc.pArgList;
+
+	pthread_t threadHandle;
+	const int nError = pthread_create(&threadHandle, &threadAttr, detail::PosixThreadEntry, pThreadStart);
+	pthread_attr_destroy(&threadAttr);
+
+	if (nError != 0)
+	{
+		delete pThreadStart;
+		*pThreadHandle = 0;
+		std::string errMsg = GetLastErrorAsString(nError);
+		//AngelicaWarning(VALIDATOR_MODULE_SYSTEM, VALIDATOR_WARNING, "<ThreadInfo> Unable to create thread \"%s\". System Error Msg: \"%s\"", threadDesc.szThreadName, errMsg.c_str());
+		return false;
+	}
+
+	*pThreadHandle = (TThreadHandle)threadHandle;
+
+	// Print info to log
+	//AngelicaComment("<ThreadInfo>: New thread \"%s\" | StackSize: %u(KB)", threadDesc.szThreadName, threadDesc.nStackSizeInBytes / 1024);
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AngelicaThreadExitCall()
+{
+	// Note: as on win32, return from the thread function instead of calling pthread_exit
+	// so that destructors of objects on the stack are executed.
+}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// FLOATING POINT EXCEPTIONS
+//////////////////////////////////////////////////////////////////////////
+namespace AngelicaThreadUtil
+{
+///////////////////////////////////////////////////////////////////////////
+void EnableFloatExceptions(EFPE_Severity eFPESeverity)
+{
+	// Optimization
+	// Enable DAZ/FZ
+	// Denormals Are Zeros
+	// Flush-to-Zero
+	_mm_setcsr(_mm_getcsr() | _MM_FLUSH_ZERO_ON | 0x0040 /* DAZ */);
+
+#ifndef _RELEASE
+	// Clear pending exceptions and mask all floating exceptions off.
+	feclearexcept(FE_ALL_EXCEPT);
+	fedisableexcept(FE_ALL_EXCEPT);
+
+	if (eFPESeverity == eFPE_Basic)
+	{
+		// Enable:
+		// - FE_DIVBYZERO
+		// - FE_INVALID
+		feenableexcept(FE_DIVBYZERO | FE_INVALID);
+	}
+
+	if (eFPESeverity == eFPE_All)
+	{
+		// Enable:
+		// - FE_DIVBYZERO
+		// - FE_INVALID
+		// - FE_UNDERFLOW
+		// - FE_OVERFLOW
+		feenableexcept(FE_DIVBYZERO | FE_INVALID | FE_UNDERFLOW | FE_OVERFLOW);
+	}
+#endif // _RELEASE
+}
+
+//////////////////////////////////////////////////////////////////////////
+void EnableFloatExceptions(unsigned long nThreadId, EFPE_Severity eFPESeverity)
+{
+	if (eFPESeverity >= eFPE_LastEntry)
+	{
+		//AngelicaWarning(VALIDATOR_MODULE_SYSTEM, VALIDATOR_ERROR, "Floating Point Exception (FPE) severity is out of range. (%i)", eFPESeverity);
+	}
+
+	// Check if the thread ID matches the current thread
+	// Note: the floating point state of another thread can not be modified on linux
+	if (nThreadId == 0 || nThreadId == AngelicaGetCurrentThreadId())
+	{
+		EnableFloatExceptions(eFPESeverity);
+		return;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+unsigned int GetFloatingPointExceptionMask()
+{
+	feclearexcept(FE_ALL_EXCEPT);
+	// report the masked exceptions like _controlfp does
+	return (unsigned int)(~fegetexcept() & FE_ALL_EXCEPT);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void SetFloatingPointExceptionMask(unsigned int nMask)
+{
+	feclearexcept(FE_ALL_EXCEPT);
+	fedisableexcept(FE_ALL_EXCEPT);
+	feenableexcept(~nMask & FE_ALL_EXCEPT);
+}
+}
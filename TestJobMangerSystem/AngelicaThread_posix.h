@@ -0,0 +1,184 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+#pragma once
+
+#include <pthread.h>
+namespace AngelicaMT {
+namespace detail {
+enum eLOCK_TYPE
+{
+	eLockType_CRITICAL_SECTION,
+	eLockType_SRW,
+	eLockType_MUTEX
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Non recursive pthread mutex
+// glibc spins briefly in user space and only enters the kernel (futex) if contended.
+class AngelicaLock_PthreadMutex
+{
+public:
+	static const eLOCK_TYPE s_value = eLockType_MUTEX;
+	friend class AngelicaConditionVariable;
+public:
+	AngelicaLock_PthreadMutex()
+	{
+		pthread_mutex_init(&m_mutex, NULL);
+	}
+	~AngelicaLock_PthreadMutex()
+	{
+		pthread_mutex_destroy(&m_mutex);
+	}
+	void Lock();
+	void Unlock();
+
+private:
+	AngelicaLock_PthreadMutex(const AngelicaLock_PthreadMutex&) = delete;
+	AngelicaLock_PthreadMutex& operator=(const AngelicaLock_PthreadMutex&) = delete;
+
+private:
+	pthread_mutex_t m_mutex;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Recursive lock on top of AngelicaLock_PthreadMutex, same semantics as the win32 SRW recursive lock
+class AngelicaLock_PthreadMutex_Recursive
+{
+public:
+	static const eLOCK_TYPE s_value = eLockType_MUTEX;
+	friend class AngelicaConditionVariable;
+
+public:
+	AngelicaLock_PthreadMutex_Recursive() : m_recurseCounter(0), m_exclusiveOwningThreadId(THREADID_NULL) {}
+
+	void Lock();
+	void Unlock();
+
+	// Deprecated
+#ifndef _RELEASE
+	bool IsLocked()
+	{
+		return m_exclusiveOwningThreadId == GetCurrentThreadId();
+	}
+#endif
+
+private:
+	AngelicaLock_PthreadMutex_Recursive(const AngelicaLock_PthreadMutex_Recursive&) = delete;
+	AngelicaLock_PthreadMutex_Recursive& operator=(const AngelicaLock_PthreadMutex_Recursive&) = delete;
+
+private:
+	AngelicaLock_PthreadMutex m_posix_lock_type;
+	unsigned int              m_recurseCounter;
+
+	// Due to its semantics, this member can be accessed in an unprotected manner,
+	// but only for comparison with the current tid.
+	volatile unsigned long m_exclusiveOwningThreadId;
+};
+
+} // detail
+} // AngelicaMT
+
+  //////////////////////////////////////////////////////////////////////////
+  /////////////////////////    DEFINE LOCKS    /////////////////////////////
+  //////////////////////////////////////////////////////////////////////////
+
+template<> class AngelicaLockT<ANGELICALOCK_RECURSIVE> : public AngelicaMT::detail::AngelicaLock_PthreadMutex_Recursive
+{
+};
+template<> class AngelicaLockT<ANGELICALOCK_FAST> : public AngelicaMT::detail::AngelicaLock_PthreadMutex
+{
+};
+
+typedef AngelicaMT::detail::AngelicaLock_PthreadMutex_Recursive AngelicaMutex;
+typedef AngelicaMT::detail::AngelicaLock_PthreadMutex           AngelicaMutexFast; // Not recursive
+
+//////////////////////////////////////////////////////////////////////////
+//! AngelicaEvent represent a synchronization event (auto reset).
+//! Parks on a futex, Set() only enters the kernel if a thread is waiting.
+class AngelicaEvent
+{
+public:
+	AngelicaEvent();
+	~AngelicaEvent();
+
+	//! Reset the event to the unsignalled state.
+	void Reset();
+
+	//! Set the event to the signalled state.
+	void Set();
+
+	//! Access a HANDLE to wait on.
+	void* GetHandle() const { return (void*)&m_nState; };
+
+	//! Wait indefinitely for the object to become signalled.
+	void Wait() const;
+
+	//! Wait, with a time limit, for the object to become signalled.
+	bool Wait(const unsigned int timeoutMillis) const;
+
+private:
+	AngelicaEvent(const AngelicaEvent&);
+	AngelicaEvent& operator=(const AngelicaEvent&);
+
+private:
+	mutable volatile int m_nState;   // 1 if signalled
+	mutable volatile int m_nWaiters; // number of threads parked on m_nState
+};
+typedef AngelicaEvent AngelicaEventTimed;
+
+//////////////////////////////////////////////////////////////////////////
+class AngelicaConditionVariable
+{
+public:
+	AngelicaConditionVariable();
+	~AngelicaConditionVariable();
+	void NotifySingle();
+	void Notify();
+
+private:
+	AngelicaConditionVariable(const AngelicaConditionVariable&);
+	AngelicaConditionVariable& operator=(const AngelicaConditionVariable&);
+
+private:
+	pthread_cond_t m_condVar;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//! Platform independent wrapper for a counting semaphore.
+//! Implemented on a futex, Release() only enters the kernel if a thread is waiting.
+class AngelicaSemaphore
+{
+public:
+	AngelicaSemaphore(int nMaximumCount, int nInitialCount = 0);
+	~AngelicaSemaphore();
+	void Acquire();
+	void Release();
+	void Release(int nCount);
+
+private:
+	volatile int m_nCount;   // available objects, threads park on this word while it is 0
+	volatile int m_nWaiters; // number of threads parked on m_nCount
+};
+
+//////////////////////////////////////////////////////////////////////////
+//! Platform independent wrapper for a counting semaphore
+//! except that this version uses C-A-S only until a blocking call is needed.
+//! -> No kernel call if there are object in the semaphore.
+class AngelicaFastSemaphore
+{
+public:
+	AngelicaFastSemaphore(int nMaximumCount, int nInitialCount = 0);
+	~AngelicaFastSemaphore();
+	void Acquire();
+
+	//! Takes an object only if one is available without waiting, never goes to the kernel.
+	bool TryAcquire();
+	void Release();
+
+	//! Release nCount objects with a single C-A-S, at most one kernel call for all woken waiters.
+	void Release(int nCount);
+
+private:
+	AngelicaSemaphore m_Semaphore;
+	volatile int      m_nCounter;
+};
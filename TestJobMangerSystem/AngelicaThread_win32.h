@@ -221,6 +221,7 @@ public:
 	~AngelicaSemaphore();
 	void Acquire();
 	void Release();
+	void Release(int nCount);
 
 private:
 	void* m_Semaphore;
@@ -236,8 +237,14 @@ public:
 	AngelicaFastSemaphore(int nMaximumCount, int nInitialCount = 0);
 	~AngelicaFastSemaphore();
 	void Acquire();
+
+	//! Takes an object only if one is available without waiting, never goes to the kernel.
+	bool TryAcquire();
 	void Release();
 
+	//! Release nCount objects with a single C-A-S, at most one kernel call for all woken waiters.
+	void Release(int nCount);
+
 private:
 	AngelicaSemaphore   m_Semaphore;
 	volatile int m_nCounter;
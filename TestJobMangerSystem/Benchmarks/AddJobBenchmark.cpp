@@ -0,0 +1,134 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   AddJobBenchmark.cpp
+//  Version:     v1.00
+//  Description: Cost of submitting one empty job, with running and with parked workers
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+
+#include "../stdafx.h"
+#include "../IJobManager.h"
+#include "../IJobManager_JobDelegator.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <stdio.h>
+
+namespace
+{
+class CBenchWork
+{
+public:
+	void Work() {}
+};
+}
+
+DECLARE_JOB("BenchEmpty", TBenchEmptyJob, CBenchWork::Work);
+
+namespace
+{
+const unsigned int scNumSubmissions = 4096;
+
+// keeps all workers inside a job, so submissions neither wake nor race with a worker
+class CWorkerParking
+{
+public:
+	CWorkerParking() : m_nParked(0), m_bRelease(false) {}
+
+	void Park()
+	{
+		const unsigned int nNumWorkers = GetJobManagerInterface()->GetNumWorkerThreads();
+		m_bRelease = false;
+		m_nParked = 0;
+		for (unsigned int i = 0; i < nNumWorkers; ++i)
+			GetJobManagerInterface()->AddLambdaJob("BenchParking", [this]() { Wait(); }, JobManager::eHighPriority, &m_jobState);
+		while (m_nParked != nNumWorkers)
+			std::this_thread::yield();
+	}
+
+	void Release()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bRelease = true;
+		}
+		m_condition.notify_all();
+		m_jobState.Wait();
+	}
+
+private:
+	void Wait()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		++m_nParked;
+		m_condition.wait(lock, [this]() { return m_bRelease; });
+	}
+
+	std::mutex                m_mutex;
+	std::condition_variable   m_condition;
+	std::atomic<unsigned int> m_nParked;
+	bool                      m_bRelease;
+	JobManager::SJobState     m_jobState;
+};
+
+// best round in nanoseconds per submission, only the submission loop is timed
+template<typename TSubmit>
+double BestNsPerSubmission(bool bParkWorkers, unsigned int nRounds, const TSubmit& submit)
+{
+	CWorkerParking parking;
+	double fBest = 1e30;
+	for (unsigned int nRound = 0; nRound < nRounds; ++nRound)
+	{
+		if (bParkWorkers)
+			parking.Park();
+
+		JobManager::SJobState jobState;
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < scNumSubmissions; ++i)
+			submit(jobState);
+		const double fNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+		if (bParkWorkers)
+			parking.Release();
+		jobState.Wait();
+		fBest = fNs < fBest ? fNs : fBest;
+	}
+	return fBest / scNumSubmissions;
+}
+}
+
+int main()
+{
+	// room for a whole round, so a submission never has to wait for a free slot
+	GetJobManagerInterface()->SetWorkerPoolPolicy(JobManager::eWPP_AllLogicalCores, 0);
+	GetJobManagerInterface()->SetJobQueueCapacity(JobManager::eRegularPriority, 2 * scNumSubmissions);
+	GetJobManagerInterface()->Init(0);
+	printf("workers: %u\n", GetJobManagerInterface()->GetNumWorkerThreads());
+
+	CBenchWork work;
+	const unsigned int nRounds = 50;
+
+	const char* arrModeNames[] = { "workers running:", "workers parked:" };
+	for (unsigned int nMode = 0; nMode < 2; ++nMode)
+	{
+		const bool bParkWorkers = nMode == 1;
+		const double fLambda = BestNsPerSubmission(bParkWorkers, nRounds, [](JobManager::SJobState& rJobState)
+		{
+			GetJobManagerInterface()->AddLambdaJob("BenchEmptyLambda", []() {}, JobManager::eRegularPriority, &rJobState);
+		});
+		const double fDelegator = BestNsPerSubmission(bParkWorkers, nRounds, [&work](JobManager::SJobState& rJobState)
+		{
+			TBenchEmptyJob job;
+			job.SetClassInstance(&work);
+			job.RegisterJobState(&rJobState);
+			job.Run();
+		});
+		printf("%-16s ns per submission: AddLambdaJob %6.1f | AddJob %6.1f\n", arrModeNames[nMode], fLambda, fDelegator);
+	}
+
+	return 0;
+}
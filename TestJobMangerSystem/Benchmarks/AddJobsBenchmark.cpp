@@ -0,0 +1,93 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   AddJobsBenchmark.cpp
+//  Version:     v1.00
+//  Description: Fan out throughput of AddJobs against one AddJob per job
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+
+#include "../stdafx.h"
+#include "../IJobManager.h"
+#include "../IJobManager_JobDelegator.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <stdio.h>
+
+namespace
+{
+std::atomic<unsigned int> g_nExecuted(0);
+
+class CBenchWork
+{
+public:
+	void Work(unsigned int nValue) { g_nExecuted += nValue; }
+};
+}
+
+DECLARE_JOB("BenchFanOut", TBenchFanOutJob, CBenchWork::Work);
+
+int main()
+{
+	GetJobManagerInterface()->SetWorkerPoolPolicy(JobManager::eWPP_AllLogicalCores, 0);
+	GetJobManagerInterface()->Init(0);
+	printf("workers: %u\n", GetJobManagerInterface()->GetNumWorkerThreads());
+
+	const unsigned int nNumJobs = 1000;
+	const unsigned int nNumFanOuts = 200;
+	const unsigned int nRuns = 5;
+
+	// every third job is high priority so AddJobs has to split the batch into runs of equal priority
+	CBenchWork work;
+	std::vector<std::unique_ptr<TBenchFanOutJob>> arrJobs(nNumJobs);
+	std::vector<JobManager::CJobBase*> arrJobPtrs(nNumJobs);
+	for (unsigned int i = 0; i < nNumJobs; ++i)
+	{
+		arrJobs[i].reset(new TBenchFanOutJob(1));
+		arrJobs[i]->SetClassInstance(&work);
+		if (i % 3 == 0)
+			arrJobs[i]->SetPriorityLevel(JobManager::eHighPriority);
+		arrJobPtrs[i] = arrJobs[i].get();
+	}
+
+	const char* arrModeNames[] = { "AddJob loop", "AddJobs" };
+	for (unsigned int nMode = 0; nMode < 2; ++nMode)
+	{
+		double fBest = 1e30;
+		for (unsigned int nRun = 0; nRun < nRuns; ++nRun)
+		{
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (unsigned int nFanOut = 0; nFanOut < nNumFanOuts; ++nFanOut)
+			{
+				JobManager::SJobState jobState;
+				for (unsigned int i = 0; i < nNumJobs; ++i)
+					arrJobs[i]->RegisterJobState(&jobState);
+
+				if (nMode == 0)
+				{
+					for (unsigned int i = 0; i < nNumJobs; ++i)
+						arrJobs[i]->Run();
+				}
+				else
+				{
+					GetJobManagerInterface()->AddJobs(&arrJobPtrs[0], nNumJobs);
+				}
+				jobState.Wait();
+			}
+			const double fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			fBest = fSeconds < fBest ? fSeconds : fBest;
+		}
+		printf("%-12s %5u job fan out: %6.2f M jobs/s\n", arrModeNames[nMode], nNumJobs, nNumJobs * nNumFanOuts / fBest * 1e-6);
+	}
+
+	const unsigned int nExpected = 2 * nRuns * nNumFanOuts * nNumJobs;
+	if (g_nExecuted != nExpected)
+	{
+		printf("error: %u jobs executed, %u expected\n", g_nExecuted.load(), nExpected);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,111 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   CoroutineBenchmark.cpp
+//  Version:     v1.00
+//  Description: Multi step pipelines written as coroutines against a waiting thread
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+
+#include "../stdafx.h"
+#include "../IJobManager.h"
+#include "../JobCoroutine.h"
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+
+#if defined(JOBMANAGER_SUPPORT_COROUTINES)
+
+namespace
+{
+const unsigned int scNumSteps = 3;
+const unsigned int scNumLeafJobs = 8;
+
+std::atomic<unsigned int> g_nLeafJobs(0);
+
+void AddLeafJobs(JobManager::SJobState& rJobState)
+{
+	for (unsigned int i = 0; i < scNumLeafJobs; ++i)
+		GetJobManagerInterface()->AddLambdaJob("BenchLeaf", []() { ++g_nLeafJobs; }, JobManager::eRegularPriority, &rJobState);
+}
+
+// each step fans out leaf jobs and continues once they finished, no thread waits in between
+JobManager::CJobCoroutine CoroutinePipeline()
+{
+	co_await JobManager::Schedule();
+	for (unsigned int nStep = 0; nStep < scNumSteps; ++nStep)
+	{
+		JobManager::SJobState jobState;
+		AddLeafJobs(jobState);
+		co_await jobState;
+	}
+}
+
+// the same steps with the calling thread blocked in Wait after each fan out
+void WaitingPipeline()
+{
+	for (unsigned int nStep = 0; nStep < scNumSteps; ++nStep)
+	{
+		JobManager::SJobState jobState;
+		AddLeafJobs(jobState);
+		jobState.Wait();
+	}
+}
+}
+
+int main()
+{
+	GetJobManagerInterface()->SetWorkerPoolPolicy(JobManager::eWPP_AllLogicalCores, 0);
+	GetJobManagerInterface()->Init(0);
+	printf("workers: %u\n", GetJobManagerInterface()->GetNumWorkerThreads());
+
+	const unsigned int nNumPipelines = 2048;
+	const unsigned int nNumInFlight = 64;
+	const unsigned int nRuns = 5;
+
+	double fBestCoroutine = 1e30;
+	double fBestWaiting = 1e30;
+	for (unsigned int nRun = 0; nRun < nRuns; ++nRun)
+	{
+		// nNumInFlight coroutine pipelines are interleaved on the workers, the main thread only waits for a whole group
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int nGroup = 0; nGroup < nNumPipelines / nNumInFlight; ++nGroup)
+		{
+			JobManager::SJobState groupState;
+			for (unsigned int i = 0; i < nNumInFlight; ++i)
+				CoroutinePipeline().Run(&groupState);
+			groupState.Wait();
+		}
+		double fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		fBestCoroutine = fSeconds < fBestCoroutine ? fSeconds : fBestCoroutine;
+
+		// a waiting thread can only drive one pipeline at a time
+		start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < nNumPipelines; ++i)
+			WaitingPipeline();
+		fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		fBestWaiting = fSeconds < fBestWaiting ? fSeconds : fBestWaiting;
+	}
+
+	printf("%u pipelines of %u steps x %u jobs, us per pipeline: co_await %.2f | Wait %.2f\n",
+	       nNumPipelines, scNumSteps, scNumLeafJobs, fBestCoroutine * 1e6 / nNumPipelines, fBestWaiting * 1e6 / nNumPipelines);
+
+	const unsigned int nExpected = 2 * nRuns * nNumPipelines * scNumSteps * scNumLeafJobs;
+	if (g_nLeafJobs != nExpected)
+	{
+		printf("error: %u leaf jobs executed, %u expected\n", g_nLeafJobs.load(), nExpected);
+		return 1;
+	}
+	return 0;
+}
+
+#else
+
+int main()
+{
+	printf("coroutines are not supported by this compiler\n");
+	return 0;
+}
+
+#endif
@@ -0,0 +1,133 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   InPlaceExecutionBenchmark.cpp
+//  Version:     v1.00
+//  Description: Worker side cost of small node queue jobs, build it with and
+//               without JOBMANAGER_SUPPORT_IN_PLACE_EXECUTION to compare
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+
+#include "../stdafx.h"
+#include "../IJobManager.h"
+#include "../IJobManager_JobDelegator.h"
+#include "../PCBackEnd/ThreadBackEnd.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <stdio.h>
+
+namespace
+{
+volatile unsigned int g_nSink = 0;
+
+class CBenchWork
+{
+public:
+	void Work(unsigned int nValue) { g_nSink = nValue; }
+};
+}
+
+DECLARE_JOB("BenchSmall", TBenchSmallJob, CBenchWork::Work);
+
+namespace
+{
+const unsigned int scNumJobsPerRound = 1000;
+
+// keeps all workers inside a job until the round is queued, so the timed part is only the workers draining it
+class CWorkerParking
+{
+public:
+	CWorkerParking() : m_nParked(0), m_bRelease(false) {}
+
+	void Park()
+	{
+		const unsigned int nNumWorkers = GetJobManagerInterface()->GetNumWorkerThreads();
+		m_bRelease = false;
+		m_nParked = 0;
+		for (unsigned int i = 0; i < nNumWorkers; ++i)
+			GetJobManagerInterface()->AddLambdaJob("BenchParking", [this]() { Wait(); }, JobManager::eHighPriority, &m_jobState);
+		while (m_nParked != nNumWorkers)
+			std::this_thread::yield();
+	}
+
+	void Release()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bRelease = true;
+		}
+		m_condition.notify_all();
+	}
+
+	void WaitReleased()
+	{
+		m_jobState.Wait();
+	}
+
+private:
+	void Wait()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		++m_nParked;
+		m_condition.wait(lock, [this]() { return m_bRelease; });
+	}
+
+	std::mutex                m_mutex;
+	std::condition_variable   m_condition;
+	std::atomic<unsigned int> m_nParked;
+	bool                      m_bRelease;
+	JobManager::SJobState     m_jobState;
+};
+}
+
+int main()
+{
+	GetJobManagerInterface()->SetWorkerPoolPolicy(JobManager::eWPP_AllLogicalCores, 0);
+	GetJobManagerInterface()->SetJobQueueCapacity(JobManager::eRegularPriority, 2 * scNumJobsPerRound);
+	GetJobManagerInterface()->Init(0);
+#if defined(JOBMANAGER_SUPPORT_IN_PLACE_EXECUTION)
+	printf("workers: %u, in place execution on\n", GetJobManagerInterface()->GetNumWorkerThreads());
+#else
+	printf("workers: %u, in place execution off\n", GetJobManagerInterface()->GetNumWorkerThreads());
+#endif
+
+	CBenchWork work;
+	CWorkerParking parking;
+	const unsigned int nRounds = 200;
+	const unsigned int nRuns = 5;
+
+	double fBest = 1e30;
+	for (unsigned int nRun = 0; nRun < nRuns; ++nRun)
+	{
+		double fDrainNs = 0.0;
+		for (unsigned int nRound = 0; nRound < nRounds; ++nRound)
+		{
+			parking.Park();
+
+			// submitted from the main thread, so every job goes through the node queue
+			JobManager::SJobState jobState;
+			for (unsigned int i = 0; i < scNumJobsPerRound; ++i)
+			{
+				TBenchSmallJob job(i);
+				job.SetClassInstance(&work);
+				job.RegisterJobState(&jobState);
+				job.Run();
+			}
+
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			parking.Release();
+			jobState.Wait();
+			fDrainNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+			parking.WaitReleased();
+		}
+		const double fNsPerJob = fDrainNs / (nRounds * scNumJobsPerRound);
+		fBest = fNsPerJob < fBest ? fNsPerJob : fBest;
+	}
+
+	printf("worker side ns per small job: %.1f (best of %u)\n", fBest, nRuns);
+	return 0;
+}
@@ -0,0 +1,100 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   JobQueueSlotBenchmark.cpp
+//  Version:     v1.00
+//  Description: Submit and drain cost of jobs with small and big parameters, build it
+//               with and without JOBMANAGER_SUPPORT_COMPACT_JOB_QUEUE_SLOTS to compare
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+
+#include "../stdafx.h"
+#include "../IJobManager.h"
+#include "../IJobManager_JobDelegator.h"
+#include <chrono>
+#include <stdio.h>
+
+namespace
+{
+volatile unsigned int g_nSink = 0;
+
+template<unsigned int N>
+struct SPayload
+{
+	unsigned char arrData[N];
+};
+
+class CBenchWork
+{
+public:
+	template<unsigned int N>
+	void Work(SPayload<N> payload) { g_nSink = payload.arrData[0] + payload.arrData[N - 1]; }
+
+	void Work16(SPayload<16> payload)   { Work(payload); }
+	void Work48(SPayload<48> payload)   { Work(payload); }
+	void Work112(SPayload<112> payload) { Work(payload); }
+	void Work240(SPayload<240> payload) { Work(payload); }
+	void Work432(SPayload<432> payload) { Work(payload); }
+};
+}
+
+DECLARE_JOB("BenchParams16", TBenchParams16Job, CBenchWork::Work16);
+DECLARE_JOB("BenchParams48", TBenchParams48Job, CBenchWork::Work48);
+DECLARE_JOB("BenchParams112", TBenchParams112Job, CBenchWork::Work112);
+DECLARE_JOB("BenchParams240", TBenchParams240Job, CBenchWork::Work240);
+DECLARE_JOB("BenchParams432", TBenchParams432Job, CBenchWork::Work432);
+
+namespace
+{
+const unsigned int scNumJobsPerRound = 1000;
+const unsigned int scNumRounds = 100;
+const unsigned int scNumRuns = 5;
+
+// time from the first submit until the last job of the round finished, per job, best of all runs
+template<class TJob, unsigned int N>
+double MeasureNsPerJob(CBenchWork& rWork)
+{
+	SPayload<N> payload;
+	for (unsigned int i = 0; i < N; ++i)
+		payload.arrData[i] = (unsigned char)i;
+
+	double fBest = 1e30;
+	for (unsigned int nRun = 0; nRun < scNumRuns; ++nRun)
+	{
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int nRound = 0; nRound < scNumRounds; ++nRound)
+		{
+			JobManager::SJobState jobState;
+			for (unsigned int i = 0; i < scNumJobsPerRound; ++i)
+			{
+				TJob job(payload);
+				job.SetClassInstance(&rWork);
+				job.RegisterJobState(&jobState);
+				job.Run();
+			}
+			jobState.Wait();
+		}
+		const double fNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		const double fNsPerJob = fNs / (scNumRounds * scNumJobsPerRound);
+		fBest = fNsPerJob < fBest ? fNsPerJob : fBest;
+	}
+	return fBest;
+}
+}
+
+int main()
+{
+	GetJobManagerInterface()->SetWorkerPoolPolicy(JobManager::eWPP_AllLogicalCores, 0);
+	GetJobManagerInterface()->SetJobQueueCapacity(JobManager::eRegularPriority, 2 * scNumJobsPerRound);
+	GetJobManagerInterface()->Init(0);
+	printf("workers: %u, job queue slot size: %u\n", GetJobManagerInterface()->GetNumWorkerThreads(), JobManager::SInfoBlock::scSizeOfJobQueueSlot);
+
+	CBenchWork work;
+	printf("ns per job with  16 byte parameters: %.1f (best of %u)\n", MeasureNsPerJob<TBenchParams16Job, 16>(work), scNumRuns);
+	printf("ns per job with  48 byte parameters: %.1f (best of %u)\n", MeasureNsPerJob<TBenchParams48Job, 48>(work), scNumRuns);
+	printf("ns per job with 112 byte parameters: %.1f (best of %u)\n", MeasureNsPerJob<TBenchParams112Job, 112>(work), scNumRuns);
+	printf("ns per job with 240 byte parameters: %.1f (best of %u)\n", MeasureNsPerJob<TBenchParams240Job, 240>(work), scNumRuns);
+	printf("ns per job with 432 byte parameters: %.1f (best of %u)\n", MeasureNsPerJob<TBenchParams432Job, 432>(work), scNumRuns);
+	return 0;
+}
@@ -0,0 +1,112 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   ParallelForBenchmark.cpp
+//  Version:     v1.00
+//  Description: ParallelFor against one job per item and against hand split jobs
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+
+#include "../stdafx.h"
+#include "../IJobManager.h"
+#include "../ParallelFor.h"
+#include <chrono>
+#include <vector>
+#include <stdio.h>
+#include <math.h>
+
+namespace
+{
+// per item work, nCost square roots
+inline float ItemWork(size_t i, unsigned int nCost)
+{
+	float f = (float)i;
+	for (unsigned int k = 0; k < nCost; ++k)
+		f = sqrtf(f + 1.0f);
+	return f;
+}
+
+// best time of nRuns in nanoseconds per item
+template<typename TFunc>
+double BestNsPerItem(size_t nItems, unsigned int nRuns, const TFunc& func)
+{
+	double fBest = 1e30;
+	for (unsigned int nRun = 0; nRun < nRuns; ++nRun)
+	{
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		func();
+		const double fNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		fBest = fNs < fBest ? fNs : fBest;
+	}
+	return fBest / (double)nItems;
+}
+
+// one lambda job per item, all sharing one job state
+void PerItemJobs(std::vector<float>& arrOut, unsigned int nCost)
+{
+	float* pOut = &arrOut[0];
+	JobManager::SJobState jobState;
+	for (size_t i = 0; i < arrOut.size(); ++i)
+		GetJobManagerInterface()->AddLambdaJob("BenchItem", [pOut, i, nCost]() { pOut[i] = ItemWork(i, nCost); }, JobManager::eRegularPriority, &jobState);
+	jobState.Wait();
+}
+
+// the pattern ParallelFor replaces, one job and one job state per worker, the caller only waits
+void HandSplitJobs(std::vector<float>& arrOut, unsigned int nCost)
+{
+	float* pOut = &arrOut[0];
+	const size_t nItems = arrOut.size();
+	const unsigned int nNumJobs = GetJobManagerInterface()->GetNumWorkerThreads();
+	std::vector<JobManager::SJobState> arrJobStates(nNumJobs);
+	for (unsigned int nJob = 0; nJob < nNumJobs; ++nJob)
+	{
+		const size_t nBegin = nItems * nJob / nNumJobs;
+		const size_t nEnd = nItems * (nJob + 1) / nNumJobs;
+		GetJobManagerInterface()->AddLambdaJob("BenchSplit", [pOut, nBegin, nEnd, nCost]()
+		{
+			for (size_t i = nBegin; i < nEnd; ++i)
+				pOut[i] = ItemWork(i, nCost);
+		}, JobManager::eRegularPriority, &arrJobStates[nJob]);
+	}
+	for (unsigned int nJob = 0; nJob < nNumJobs; ++nJob)
+		arrJobStates[nJob].Wait();
+}
+
+void SerialLoop(std::vector<float>& arrOut, unsigned int nCost)
+{
+	for (size_t i = 0; i < arrOut.size(); ++i)
+		arrOut[i] = ItemWork(i, nCost);
+}
+}
+
+int main()
+{
+	GetJobManagerInterface()->SetWorkerPoolPolicy(JobManager::eWPP_AllLogicalCores, 0);
+	GetJobManagerInterface()->Init(0);
+	printf("workers: %u\n", GetJobManagerInterface()->GetNumWorkerThreads());
+
+	struct SCase { size_t nItems; unsigned int nCost; };
+	const SCase arrCases[] = { { 1000000, 1 }, { 100000, 32 }, { 10000, 1000 } };
+	const unsigned int nRuns = 5;
+
+	for (const SCase& rCase : arrCases)
+	{
+		std::vector<float> arrOut(rCase.nItems);
+		const unsigned int nCost = rCase.nCost;
+
+		const double fSerial = BestNsPerItem(rCase.nItems, nRuns, [&]() { SerialLoop(arrOut, nCost); });
+		const double fPerItem = BestNsPerItem(rCase.nItems, nRuns, [&]() { PerItemJobs(arrOut, nCost); });
+		const double fHandSplit = BestNsPerItem(rCase.nItems, nRuns, [&]() { HandSplitJobs(arrOut, nCost); });
+		const double fParallelFor = BestNsPerItem(rCase.nItems, nRuns, [&]()
+		{
+			float* pOut = &arrOut[0];
+			JobManager::ParallelFor(0, rCase.nItems, [pOut, nCost](size_t i) { pOut[i] = ItemWork(i, nCost); });
+		});
+
+		printf("%7u items x %4u sqrt, ns per item: serial %8.1f | job per item %8.1f | hand split %8.1f | ParallelFor %8.1f\n",
+		       (unsigned int)rCase.nItems, nCost, fSerial, fPerItem, fHandSplit, fParallelFor);
+	}
+
+	return 0;
+}
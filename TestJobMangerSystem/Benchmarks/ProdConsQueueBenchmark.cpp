@@ -0,0 +1,122 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   ProdConsQueueBenchmark.cpp
+//  Version:     v1.00
+//  Description: Producer/consumer queue packets against one job per work item
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+
+#include "../stdafx.h"
+#include "../IJobManager.h"
+#include "../IJobManager_JobDelegator.h"
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <stdio.h>
+
+namespace
+{
+// only the drain job of a queue touches it, so it needs no atomic
+unsigned int g_nQueueSum = 0;
+std::atomic<unsigned int> g_nJobSum(0);
+
+class CBenchWork
+{
+public:
+	void QueueWork(unsigned int nValue) { g_nQueueSum += nValue; }
+	void JobWork(unsigned int nValue)   { g_nJobSum += nValue; }
+};
+}
+
+DECLARE_JOB("BenchQueuePacket", TBenchQueueJob, CBenchWork::QueueWork);
+DECLARE_JOB("BenchPlainJob", TBenchPlainJob, CBenchWork::JobWork);
+
+namespace
+{
+typedef PROD_CONS_QUEUE_TYPE(TBenchQueueJob, 256) TBenchQueue;
+
+const unsigned int scNumItems = 1000000;
+const unsigned int scBatchSize = 64;
+
+void AddSinglePackets(CBenchWork& rWork)
+{
+	TBenchQueue queue;
+	for (unsigned int i = 0; i < scNumItems; ++i)
+	{
+		TBenchQueueJob::packet packet(1);
+		packet.SetClassInstance(&rWork);
+		queue.AddPacket(packet);
+	}
+	queue.WaitFinished();
+}
+
+void AddPacketBatches(CBenchWork& rWork)
+{
+	TBenchQueue queue;
+	std::vector<TBenchQueueJob::packet> arrBatch(scBatchSize, TBenchQueueJob::packet(1));
+	for (unsigned int i = 0; i < scBatchSize; ++i)
+		arrBatch[i].SetClassInstance(&rWork);
+	for (unsigned int i = 0; i < scNumItems / scBatchSize; ++i)
+		queue.AddPackets(&arrBatch[0], scBatchSize);
+	queue.WaitFinished();
+}
+
+// one job per item, waiting now and then so the job queue can't run full
+void AddPlainJobs(CBenchWork& rWork)
+{
+	JobManager::SJobState jobState;
+	for (unsigned int i = 0; i < scNumItems; ++i)
+	{
+		TBenchPlainJob job(1);
+		job.SetClassInstance(&rWork);
+		job.RegisterJobState(&jobState);
+		job.Run();
+		if ((i & 16383) == 16383)
+			jobState.Wait();
+	}
+	jobState.Wait();
+}
+
+// best of nRuns in million items per second
+template<typename TFunc>
+double BestMItemsPerSecond(unsigned int nItems, unsigned int nRuns, const TFunc& func)
+{
+	double fBest = 1e30;
+	for (unsigned int nRun = 0; nRun < nRuns; ++nRun)
+	{
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		func();
+		const double fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		fBest = fSeconds < fBest ? fSeconds : fBest;
+	}
+	return nItems / fBest * 1e-6;
+}
+}
+
+int main()
+{
+	GetJobManagerInterface()->SetWorkerPoolPolicy(JobManager::eWPP_AllLogicalCores, 0);
+	GetJobManagerInterface()->Init(0);
+	printf("workers: %u\n", GetJobManagerInterface()->GetNumWorkerThreads());
+
+	CBenchWork work;
+	const unsigned int nRuns = 5;
+	const unsigned int nBatchedItems = scNumItems / scBatchSize * scBatchSize;
+
+	const double fSingle = BestMItemsPerSecond(scNumItems, nRuns, [&]() { AddSinglePackets(work); });
+	const double fBatched = BestMItemsPerSecond(nBatchedItems, nRuns, [&]() { AddPacketBatches(work); });
+	const double fPlain = BestMItemsPerSecond(scNumItems, nRuns, [&]() { AddPlainJobs(work); });
+
+	printf("M items/s: AddPacket %.2f | AddPackets x%u %.2f | AddJob %.2f\n", fSingle, scBatchSize, fBatched, fPlain);
+
+	const unsigned int nExpectedQueueSum = nRuns * (scNumItems + nBatchedItems);
+	const unsigned int nExpectedJobSum = nRuns * scNumItems;
+	if (g_nQueueSum != nExpectedQueueSum || g_nJobSum != nExpectedJobSum)
+	{
+		printf("error: %u queue items and %u jobs executed, %u and %u expected\n", g_nQueueSum, g_nJobSum.load(), nExpectedQueueSum, nExpectedJobSum);
+		return 1;
+	}
+	return 0;
+}
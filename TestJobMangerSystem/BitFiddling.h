@@ -4,6 +4,13 @@
 
 
 
+#if ANGELICA_COMPILER_GCC || ANGELICA_COMPILER_CLANG
+
+	#define countLeadingZeros32(x) ((x) ? __builtin_clz  (x) : 32)
+	#define countLeadingZeros64(x) ((x) ? __builtin_clzll(x) : 64)
+
+#else  // Windows implementation
+
 inline unsigned int countLeadingZeros32(unsigned int x)
 {
 	unsigned long result = 32 ^ 31;
@@ -24,12 +31,14 @@ inline unsigned long long countLeadingZeros64(unsigned long long x)
 	result ^= 63; // needed because the index is from LSB (whereas all other implementations are from MSB)
 #else
 	unsigned long result = (x & 0xFFFFFFFF00000000ULL)
-		? countLeadingZeros32(unsigned int(x >> 32)) +  0
-		: countLeadingZeros32(unsigned int(x >>  0)) + 32;
+		? countLeadingZeros32((unsigned int)(x >> 32)) +  0
+		: countLeadingZeros32((unsigned int)(x >>  0)) + 32;
 #endif
 	return result;
 }
 
+#endif
+
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Count the number of trailing zeros
@@ -66,8 +75,8 @@ inline unsigned long long countTrailingZeros64(unsigned long long x)
 	PREFAST_SUPPRESS_WARNING(6102);
 #else
 	unsigned long result = (x & 0x00000000FFFFFFFFULL)
-		? countTrailingZeros32(unsigned int(x >>  0)) +  0
-		: countTrailingZeros32(unsigned int(x >> 32)) + 32;
+		? countTrailingZeros32((unsigned int)(x >>  0)) +  0
+		: countTrailingZeros32((unsigned int)(x >> 32)) + 32;
 #endif
 	return result;
 }
@@ -165,24 +174,24 @@ struct IsPowerOfTwoCompileTime
 // Result ranges from -1 to 7/15/31/63
 #if ANGELICA_COMPILER_GCC || ANGELICA_COMPILER_CLANG
 
-static inline unsigned char  IntegerLog2(unsigned char  v) { return unsigned char (31U   - __builtin_clz  (v)); }
-static inline unsigned short IntegerLog2(unsigned short v) { return unsigned short(31U   - __builtin_clz  (v)); }
-static inline unsigned int IntegerLog2(unsigned int v) { return unsigned int(31UL  - __builtin_clz  (v)); }
-static inline unsigned long long IntegerLog2(unsigned long long v) { return unsigned long long(63ULL - __builtin_clzll(v)); }
+static inline unsigned char  IntegerLog2(unsigned char  v) { return (unsigned char)(31U   - __builtin_clz  (v)); }
+static inline unsigned short IntegerLog2(unsigned short v) { return (unsigned short)(31U   - __builtin_clz  (v)); }
+static inline unsigned int IntegerLog2(unsigned int v) { return (unsigned int)(31UL  - __builtin_clz  (v)); }
+static inline unsigned long long IntegerLog2(unsigned long long v) { return (unsigned long long)(63ULL - __builtin_clzll(v)); }
 
 #else  // Windows implementation
 
-static inline unsigned char  IntegerLog2(unsigned char  v) { unsigned long result = ~0U; _BitScanReverse  (&result, v); return unsigned char (result); }
-static inline unsigned short IntegerLog2(unsigned short v) { unsigned long result = ~0U; _BitScanReverse  (&result, v); return unsigned short(result); }
-static inline unsigned int IntegerLog2(unsigned int v) { unsigned long result = ~0U; _BitScanReverse  (&result, v); return unsigned int(result); }
+static inline unsigned char  IntegerLog2(unsigned char  v) { unsigned long result = ~0U; _BitScanReverse  (&result, v); return (unsigned char)(result); }
+static inline unsigned short IntegerLog2(unsigned short v) { unsigned long result = ~0U; _BitScanReverse  (&result, v); return (unsigned short)(result); }
+static inline unsigned int IntegerLog2(unsigned int v) { unsigned long result = ~0U; _BitScanReverse  (&result, v); return (unsigned int)(result); }
 #if ANGELICA_PLATFORM_X64
-static inline unsigned long long IntegerLog2(unsigned long long v) { unsigned long result = ~0U; _BitScanReverse64(&result, v); return unsigned long long(result); }
+static inline unsigned long long IntegerLog2(unsigned long long v) { unsigned long result = ~0U; _BitScanReverse64(&result, v); return (unsigned long long)(result); }
 #else
 static inline unsigned long long IntegerLog2(unsigned long long v)
 {
 	unsigned long result = ~0U;
-	if      (v & 0xFFFFFFFF00000000ULL) _BitScanReverse(&result, unsigned int(v >> 32)), result += 32;
-	else if (v & 0x00000000FFFFFFFFULL) _BitScanReverse(&result, unsigned int(v >>  0)), result +=  0;
+	if      (v & 0xFFFFFFFF00000000ULL) _BitScanReverse(&result, (unsigned int)(v >> 32)), result += 32;
+	else if (v & 0x00000000FFFFFFFFULL) _BitScanReverse(&result, (unsigned int)(v >>  0)), result +=  0;
 	return result;
 }
 #endif
@@ -192,10 +201,10 @@ static inline unsigned long long IntegerLog2(unsigned long long v)
 // Calculates the number of bits needed to represent a number.
 // Passing 0 will return the maximum number of bits.
 // Result ranges from 0 to 8/16/32/64
-static inline unsigned char  IntegerLog2_RoundUp(unsigned char  v) { return unsigned char (IntegerLog2(unsigned char (v - 1U  )) + 1U  ); }
-static inline unsigned short IntegerLog2_RoundUp(unsigned short v) { return unsigned short(IntegerLog2(unsigned short(v - 1U  )) + 1U  ); }
-static inline unsigned int IntegerLog2_RoundUp(unsigned int v) { return unsigned int(IntegerLog2(unsigned int(v - 1UL )) + 1UL ); }
-static inline unsigned long long IntegerLog2_RoundUp(unsigned long long v) { return unsigned long long(IntegerLog2(unsigned long long(v - 1ULL)) + 1ULL); }
+static inline unsigned char  IntegerLog2_RoundUp(unsigned char  v) { return (unsigned char)(IntegerLog2((unsigned char)(v - 1U  )) + 1U  ); }
+static inline unsigned short IntegerLog2_RoundUp(unsigned short v) { return (unsigned short)(IntegerLog2((unsigned short)(v - 1U  )) + 1U  ); }
+static inline unsigned int IntegerLog2_RoundUp(unsigned int v) { return (unsigned int)(IntegerLog2((unsigned int)(v - 1UL )) + 1UL ); }
+static inline unsigned long long IntegerLog2_RoundUp(unsigned long long v) { return (unsigned long long)(IntegerLog2((unsigned long long)(v - 1ULL)) + 1ULL); }
 
 // Calculates the power-of-2 upper range of a given number.
 // Passing 0 will return 1 on x86 (shift modulo datatype size is no shift) and 0 on other platforms.
@@ -233,26 +242,26 @@ inline size_t IntegerLog2(size_t x)
 #endif
 
 // Find-first-MSB-set
-static inline unsigned char BitIndex(unsigned char  v) { return unsigned char(IntegerLog2(v)); }
-static inline unsigned char BitIndex(unsigned short v) { return unsigned char(IntegerLog2(v)); }
-static inline unsigned char BitIndex(unsigned int v) { return unsigned char(IntegerLog2(v)); }
-static inline unsigned char BitIndex(unsigned long long v) { return unsigned char(IntegerLog2(v)); }
+static inline unsigned char BitIndex(unsigned char  v) { return (unsigned char)(IntegerLog2(v)); }
+static inline unsigned char BitIndex(unsigned short v) { return (unsigned char)(IntegerLog2(v)); }
+static inline unsigned char BitIndex(unsigned int v) { return (unsigned char)(IntegerLog2(v)); }
+static inline unsigned char BitIndex(unsigned long long v) { return (unsigned char)(IntegerLog2(v)); }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Calculates the number of bits set.
 #if ANGELICA_COMPILER_GCC || ANGELICA_COMPILER_CLANG
 
-static inline unsigned char CountBits(unsigned char  v) { return unsigned char(__builtin_popcount  (v)); }
-static inline unsigned char CountBits(unsigned short v) { return unsigned char(__builtin_popcount  (v)); }
-static inline unsigned char CountBits(unsigned int v) { return unsigned char(__builtin_popcount  (v)); }
-static inline unsigned char CountBits(unsigned long long v) { return unsigned char(__builtin_popcountll(v)); }
+static inline unsigned char CountBits(unsigned char  v) { return (unsigned char)(__builtin_popcount  (v)); }
+static inline unsigned char CountBits(unsigned short v) { return (unsigned char)(__builtin_popcount  (v)); }
+static inline unsigned char CountBits(unsigned int v) { return (unsigned char)(__builtin_popcount  (v)); }
+static inline unsigned char CountBits(unsigned long long v) { return (unsigned char)(__builtin_popcountll(v)); }
 
 #elif ANGELICA_PLATFORM_SSE4
 
-static inline unsigned char CountBits(unsigned char  v) { return unsigned char(__popcnt  (v)); }
-static inline unsigned char CountBits(unsigned short v) { return unsigned char(__popcnt  (v)); }
-static inline unsigned char CountBits(unsigned int v) { return unsigned char(__popcnt  (v)); }
-static inline unsigned char CountBits(unsigned long long v) { return unsigned char(__popcnt64(v)); }
+static inline unsigned char CountBits(unsigned char  v) { return (unsigned char)(__popcnt  (v)); }
+static inline unsigned char CountBits(unsigned short v) { return (unsigned char)(__popcnt  (v)); }
+static inline unsigned char CountBits(unsigned int v) { return (unsigned char)(__popcnt  (v)); }
+static inline unsigned char CountBits(unsigned long long v) { return (unsigned char)(__popcnt64(v)); }
 
 #else
 
@@ -8,13 +8,19 @@
 // -------------------------------------------------------------------------
 //  History:
 ////////////////////////////////////////////////////////////////////////////
-#include "StdAfx.h"
-#include "..\AngelicaPlatformDefines.h"
-#include "../MSVCspecific.h"
-#include "../Win32specific.h"
+#include "stdafx.h"
+#include "../AngelicaPlatformDefines.h"
+#if ANGELICA_PLATFORM_WINDOWS
+	#include "../MSVCspecific.h"
+	#include "../Win32specific.h"
+#else
+	#include "../GCCspecific.h"
+	#include "../Linuxspecific.h"
+#endif
 #include <assert.h>
-#include "..\BitFiddling.h"
+#include "../BitFiddling.h"
 #include "BlockingBackEnd.h"
+#include "../IThreadConfigManager.h"
 #include "../JobManager.h"
 //#include "../../System.h"
 //#include "../../CPUDetect.h"
@@ -37,6 +43,7 @@ JobManager::BlockingBackEnd::CBlockingBackEnd::CBlockingBackEnd(JobManager::SInf
 ///////////////////////////////////////////////////////////////////////////////
 JobManager::BlockingBackEnd::CBlockingBackEnd::~CBlockingBackEnd()
 {
+	m_JobQueue.Shutdown();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -44,6 +51,13 @@ bool JobManager::BlockingBackEnd::CBlockingBackEnd::Init(unsigned int nSysMaxWor
 {
 	m_pWorkerThreads = new CBlockingBackEndWorkerThread*[nSysMaxWorker];
 
+	// blocking workers run small job functions only, spawn them with the backend stack size instead of the platform default
+	IThreadConfigManager* pThreadConfigManager = GetGlobalThreadManager()->GetThreadConfigManager();
+	SThreadConfig workerConfig = *pThreadConfigManager->GetDefaultThreadConfig();
+	workerConfig.szThreadName = "JobSystem_Worker_* (Blocking)";
+	workerConfig.stackSizeBytes = detail::eStackSize;
+	pThreadConfigManager->SetThreadConfig(workerConfig);
+
 	// create single worker thread for blocking backend
 	for (unsigned int i = 0; i < nSysMaxWorker; ++i)
 	{
@@ -144,30 +158,22 @@ void JobManager::BlockingBackEnd::CBlockingBackEnd::AddJob(JobManager::CJobDeleg
 	// copy info block into job queue
 	PREFAST_ASSUME(pFallbackInfoBlock);
 	JobManager::SInfoBlock& RESTRICT_REFERENCE rJobInfoBlock = (cEnqRes == JobManager::detail::eAJR_NeedFallbackJobInfoBlock ?
-	                                                            *pFallbackInfoBlock : m_JobQueue.jobInfoBlocks[nJobPriority][jobSlot]);
+	                                                            *pFallbackInfoBlock : m_JobQueue.GetJobInfoBlock(nJobPriority, jobSlot));
 
-	// since we will use the whole InfoBlock, and it is aligned to 128 bytes, clear the cacheline, this is faster than a cachemiss on write
-#if ANGELICA_PLATFORM_64BIT
-	//STATIC_CHECK( sizeof(JobManager::SInfoBlock) == 512, ERROR_SIZE_OF_SINFOBLOCK_NOT_EQUALS_512 );
-#else
-	//STATIC_CHECK( sizeof(JobManager::SInfoBlock) == 384, ERROR_SIZE_OF_SINFOBLOCK_NOT_EQUALS_384 );
-#endif
-
-	// first cache line needs to be persistent
-	//ResetLine128(&rJobInfoBlock, 128);
-	//ResetLine128(&rJobInfoBlock, 256);
-#if ANGELICA_PLATFORM_64BIT
-	//ResetLine128(&rJobInfoBlock, 384);
-#endif
+	// a job queue slot is only SInfoBlock::scSizeOfJobQueueSlot bytes, the following slots belong to other jobs
+	// so only the header and the parameters in use are written, fallback blocks are full SInfoBlocks
 
 	/////////////////////////////////////////////////////////////////////////////
 	// Initialize the InfoBlock
-	rInfoBlock.AssignMembersTo(&rJobInfoBlock);
+	rInfoBlock.AssignHeaderTo(&rJobInfoBlock);
 
-	// copy job parameter if it is a non-queue job
+	// copy job parameter if it is a non-queue job, compact queue slots only hold small parameters
 	if (crJob.GetQueue() == NULL)
 	{
-		JobManager::CJobManager::CopyJobParameter(crJob.GetParamDataSize(), rJobInfoBlock.GetParamAddress(), crJob.GetJobParamData());
+		if (cEnqRes == JobManager::detail::eAJR_NeedFallbackJobInfoBlock)
+			JobManager::CJobManager::CopyJobParameter(crJob.GetParamDataSize(), rJobInfoBlock.GetParamAddress(), crJob.GetJobParamData());
+		else
+			pJobManager->CopyJobParameterToQueueSlot(crJob.GetParamDataSize(), rJobInfoBlock, crJob.GetJobParamData());
 	}
 
 	assert(rInfoBlock.jobInvoker);
@@ -177,19 +183,12 @@ void JobManager::BlockingBackEnd::CBlockingBackEnd::AddJob(JobManager::CJobDeleg
 
 #if defined(JOBMANAGER_SUPPORT_FRAMEPROFILER)
 	assert(cJobId < JobManager::detail::eJOB_FRAME_STATS_MAX_SUPP_JOBS);
-	m_pBackEndWorkerProfiler->RegisterJob(cJobId, pJobManager->GetJobName(rInfoBlock.jobInvoker));
+	m_pBackEndWorkerProfiler->RegisterJob(cJobId, cJobHandle->cpString);
 	rJobInfoBlock.frameProfIndex = (unsigned char)m_pBackEndWorkerProfiler->GetProfileIndex();
 #endif
 
 	/////////////////////////////////////////////////////////////////////////////
 	// initialization finished, make all visible for worker threads
-	// the producing thread won't need the info block anymore, flush it from the cache
-	//FlushLine128(&rJobInfoBlock, 0);
-	//FlushLine128(&rJobInfoBlock, 128);
-#if ANGELICA_PLATFORM_64BIT
-	//FlushLine128(&rJobInfoBlock, 256);
-	//FlushLine128(&rJobInfoBlock, 384);
-#endif
 
 	IF (cEnqRes == JobManager::detail::eAJR_NeedFallbackJobInfoBlock, 0)
 	{
@@ -199,8 +198,7 @@ void JobManager::BlockingBackEnd::CBlockingBackEnd::AddJob(JobManager::CJobDeleg
 	else
 	{
 		////AngelicaLogAlways("Add Job to Slot 0x%x, priority 0x%x", jobSlot, nJobPriority );
-		MemoryBarrier();
-		m_JobQueue.jobInfoBlockStates[nJobPriority][jobSlot].SetReady();
+		m_JobQueue.PublishJobSlots(jobSlot, 1, nJobPriority);
 
 		// Release semaphore count to signal the workers that work is available
 		m_Semaphore.Release();
@@ -230,10 +228,6 @@ void JobManager::BlockingBackEnd::CBlockingBackEndWorkerThread::ThreadEntry()
 
 			// in case of a fallback job, just get it from the global per thread list
 			pFallbackInfoBlock->AssignMembersTo(&infoBlock);
-			if (!infoBlock.HasQueue())  // copy parameters for non producer/consumer jobs
-			{
-				JobManager::CJobManager::CopyJobParameter(infoBlock.paramSize << 4, infoBlock.GetParamAddress(), pFallbackInfoBlock->GetParamAddress());
-			}
 
 			// free temp info block again
 			delete pFallbackInfoBlock;
@@ -266,10 +260,6 @@ void JobManager::BlockingBackEnd::CBlockingBackEndWorkerThread::ThreadEntry()
 
 					// in case of a fallback job, just get it from the global per thread list
 					pRegularWorkerFallback->AssignMembersTo(&infoBlock);
-					if (!infoBlock.HasQueue())  // copy parameters for non producer/consumer jobs
-					{
-						JobManager::CJobManager::CopyJobParameter(infoBlock.paramSize << 4, infoBlock.GetParamAddress(), pRegularWorkerFallback->GetParamAddress());
-					}
 
 					// free temp info block again
 					delete pRegularWorkerFallback;
@@ -298,7 +288,10 @@ void JobManager::BlockingBackEnd::CBlockingBackEndWorkerThread::ThreadEntry()
 					currentPullIndex = *const_cast<volatile unsigned long long*>(&m_rJobQueue.pull.index);
 					currentPushIndex = *const_cast<volatile unsigned long long*>(&m_rJobQueue.push.index);
 #endif
-					// spin if the updated push ptr didn't reach us yet
+					// only claim jobs which are already completely written
+					currentPushIndex = m_rJobQueue.GetPublishedPushIndex(currentPullIndex, currentPushIndex);
+
+					// spin if the updated push ptr or the published job didn't reach us yet
 					if (currentPushIndex == currentPullIndex)
 						continue;
 
@@ -320,28 +313,11 @@ void JobManager::BlockingBackEnd::CBlockingBackEndWorkerThread::ThreadEntry()
 				unsigned int nJobSlot = nExtractedCurIndex & (nNumWorkerQUeueJobs - 1);
 
 				////AngelicaLogAlways("Got Job From Slot 0x%x nPriorityLevel 0x%x", nJobSlot, nPriorityLevel );
-				// 2. Wait still the produces has finished writing all data to the SInfoBlock
-				JobManager::detail::SJobQueueSlotState* pJobInfoBlockState = &m_rJobQueue.jobInfoBlockStates[nPriorityLevel][nJobSlot];
-				int iter = 0;
-				while (!pJobInfoBlockState->IsReady())
-				{
-					Sleep(iter++ > 10 ? 1 : 0);
-				}
-				;
+				// 2. Get a local copy of the info block, it was published before we claimed it
+				JobManager::SInfoBlock* pCurrentJobSlot = &m_rJobQueue.GetJobInfoBlock(nPriorityLevel, nJobSlot);
+				pJobManager->CopyJobFromQueueSlot(*pCurrentJobSlot, infoBlock);
 
-				// 3. Get a local copy of the info block as asson as it is ready to be used
-				JobManager::SInfoBlock* pCurrentJobSlot = &m_rJobQueue.jobInfoBlocks[nPriorityLevel][nJobSlot];
-				pCurrentJobSlot->AssignMembersTo(&infoBlock);
-				if (!infoBlock.HasQueue())  // copy parameters for non producer/consumer jobs
-				{
-					JobManager::CJobManager::CopyJobParameter(infoBlock.paramSize << 4, infoBlock.GetParamAddress(), pCurrentJobSlot->GetParamAddress());
-				}
-
-				// 4. Remark the job state as suspended
-				MemoryBarrier();
-				pJobInfoBlockState->SetNotReady();
-
-				// 5. Mark the jobslot as free again
+				// 3. Mark the jobslot as free again
 				MemoryBarrier();
 				pCurrentJobSlot->Release((1 << JobManager::SJobQueuePos::eBitsPerPriorityLevel) / m_rJobQueue.GetMaxWorkerQueueJobs(nPriorityLevel));
 			}
@@ -354,6 +330,24 @@ void JobManager::BlockingBackEnd::CBlockingBackEndWorkerThread::ThreadEntry()
 		{
 			DoWorkProducerConsumerQueue(infoBlock);
 		}
+		else IF (infoBlock.IsCancelled(), 0)
+		{
+			// cancelled while queued, only invokers owning their parameters run to release them
+			JobManager::detail::SetCurrentJobCancellationToken(infoBlock.pCancellationToken);
+			if (infoBlock.InvokeOnCancel())
+				(*infoBlock.jobInvoker)(infoBlock.GetParamAddress());
+			JobManager::detail::SetCurrentJobCancellationToken(NULL);
+
+#if defined(JOBMANAGER_SUPPORT_FRAMEPROFILER)
+			m_pBlockingBackend->GetBackEndWorkerProfiler()->RecordCancelledJob(infoBlock.frameProfIndex, static_cast<const unsigned int>(infoBlock.jobId));
+#endif
+
+			IF (infoBlock.GetJobState(), 1)
+			{
+				SJobState* pJobState = infoBlock.GetJobState();
+				pJobState->SetStopped();
+			}
+		}
 		else
 		{
 			// Now we are safe to use the info block
@@ -385,14 +379,9 @@ void JobManager::BlockingBackEnd::CBlockingBackEndWorkerThread::ThreadEntry()
 			//ANGELICAPROFILE_SCOPE_PROFILE_MARKER(pJobManager->GetJobName(infoBlock.jobInvoker));
 			//ANGELICAPROFILE_SCOPE_PLATFORM_MARKER(pJobManager->GetJobName(infoBlock.jobInvoker));
 #endif
-			if (infoBlock.jobLambdaInvoker)
-			{
-				infoBlock.jobLambdaInvoker();
-			}
-			else
-			{
-				(*infoBlock.jobInvoker)(infoBlock.GetParamAddress());
-			}
+			JobManager::detail::SetCurrentJobCancellationToken(infoBlock.pCancellationToken);
+			(*infoBlock.jobInvoker)(infoBlock.GetParamAddress());
+			JobManager::detail::SetCurrentJobCancellationToken(NULL);
 
 #if defined(JOBMANAGER_SUPPORT_FRAMEPROFILER)
 			JobManager::IWorkerBackEndProfiler* workerProfiler = m_pBlockingBackend->GetBackEndWorkerProfiler();
@@ -435,17 +424,6 @@ void JobManager::BlockingBackEnd::CBlockingBackEndWorkerThread::DoWorkProducerCo
 
 	bool bNewJobFound = true;
 
-	// union used to construct 64 bit value for atomic updates
-	union T64BitValue
-	{
-		signed long long doubleWord;
-		struct
-		{
-			unsigned int word0;
-			unsigned int word1;
-		};
-	};
-
 	const unsigned int cParamSize = (rInfoBlock.paramSize << 4);
 
 	Invoker pInvoker = NULL;
@@ -469,7 +447,7 @@ void JobManager::BlockingBackEnd::CBlockingBackEndWorkerThread::DoWorkProducerCo
 		}
 
 		// make sure we don't try to execute an already stopped job
-		assert(pAddPacketData->pJobState && pAddPacketData->pJobState->IsRunning() == true);
+		assert(!pAddPacketData->pJobState || pAddPacketData->pJobState->IsRunning() == true);
 
 		// call delegator function to invoke job entry
 #if !defined(_RELEASE) || defined(PERFORMANCE_BUILD)
@@ -489,138 +467,24 @@ void JobManager::BlockingBackEnd::CBlockingBackEndWorkerThread::DoWorkProducerCo
 		// == update queue state == //
 		IncrQueuePullPointer_Blocking(curPullPtr, queueIncr, queueStart, queueEnd);
 
-		// load cur push once
-		INT_PTR curPushPtr = *pQueuePush;
-
-		// update pull ptr (safe since only change by a single job worker)
+		// update pull ptr (safe since only change by a single job worker), the packet was read completely before
+		ProdConsQueueBase::PacketBarrier();
 		*pQueuePull = curPullPtr;
 
-		// check if we need to wake up the producer from a queue full state
-		IF ((curPushPtr & 1) == 1, 0)
-		{
-			(*pQueuePush) = curPushPtr & ~1;
-			pQueue->m_pQueueFullSemaphore->Release();
-		}
-
-		// clear queue full marker
-		curPushPtr = curPushPtr & ~1;
-
 		// work on next packet if still there
-		IF (curPushPtr != curPullPtr, 1)
+		IF (curPullPtr != *pQueuePush, 1)
 		{
+			ProdConsQueueBase::PacketBarrier();
 			continue;
 		}
 
-		// temp end of queue, try to update the state while checking the push ptr
-		bNewJobFound = false;
-
-		JobManager::SJobSyncVariable runningSyncVar;
-		runningSyncVar.SetRunning();
-		JobManager::SJobSyncVariable stoppedSyncVar;
-
-#if ANGELICA_PLATFORM_64BIT // for 64 bit, we need to atomically swap 128 bit
-		bool bStopLoop = false;
-		bool bUnlockQueueFullstate = false;
-		SJobSyncVariable queueStoppedSemaphore;
-		signed long long resultValue[2] = { *alias_cast<signed long long*>(&runningSyncVar), curPushPtr };
-		signed long long compareValue[2] = { *alias_cast<signed long long*>(&runningSyncVar), curPushPtr };  // use for result comparsion, since the original compareValue is overwritten
-		signed long long exchangeValue[2] = { *alias_cast<signed long long*>(&stoppedSyncVar), curPushPtr };
-		do
-		{
-			resultValue[0] = compareValue[0];
-			resultValue[1] = compareValue[1];
-			unsigned char ret = AngelicaInterlockedCompareExchange128((volatile signed long long*)pQueue, exchangeValue[1], exchangeValue[0], resultValue);
-
-			bNewJobFound = ((resultValue[1] & ~1) != curPushPtr);
-			bStopLoop = bNewJobFound || (resultValue[0] == compareValue[0] && resultValue[1] == compareValue[1]);
-
-			if (bNewJobFound == false && resultValue[0] > 1)
-			{
-				// get a copy of the syncvar for unlock (since we will overwrite it)
-				queueStoppedSemaphore = *alias_cast<SJobSyncVariable*>(&resultValue[0]);
-
-				// update the exchange value to ensure the CAS succeeds
-				compareValue[0] = resultValue[0];
-			}
-
-			if (bNewJobFound == false && ((resultValue[1] & 1) == 1))
-			{
-				// update the exchange value to ensure the CAS succeeds
-				compareValue[1] = resultValue[1];
-				exchangeValue[1] = (resultValue[1] & ~1);
-				bUnlockQueueFullstate = true; // needs to be unset after the loop to ensure a correct state
-			}
-
-		}
-		while (!bStopLoop);
-
-		if (bUnlockQueueFullstate)
-		{
-			assert(bNewJobFound == false);
-			pQueue->m_pQueueFullSemaphore->Release();
-		}
-		if (queueStoppedSemaphore.IsRunning())
-		{
-			assert(bNewJobFound == false);
-			queueStoppedSemaphore.SetStopped();
-		}
-#else
-		bool bStopLoop = false;
-		bool bUnlockQueueFullstate = false;
-		SJobSyncVariable queueStoppedSemaphore;
-		T64BitValue resultValue;
-
-		T64BitValue compareValue;
-		compareValue.word0 = *alias_cast<unsigned int*>(&runningSyncVar);
-		compareValue.word1 = curPushPtr;
-
-		T64BitValue exchangeValue;
-		exchangeValue.word0 = *alias_cast<unsigned int*>(&stoppedSyncVar);
-		exchangeValue.word1 = curPushPtr;
-
-		do
-		{
-
-			resultValue.doubleWord = AngelicaInterlockedCompareExchange64((volatile signed long long*)pQueue, exchangeValue.doubleWord, compareValue.doubleWord);
-
-			bNewJobFound = ((resultValue.word1 & ~1) != curPushPtr);
-			bStopLoop = bNewJobFound || resultValue.doubleWord == compareValue.doubleWord;
-
-			if (bNewJobFound == false && resultValue.word0 > 1)
-			{
-				// get a copy of the syncvar for unlock (since we will overwrite it)
-				queueStoppedSemaphore = *alias_cast<SJobSyncVariable*>(&resultValue.word0);
-
-				// update the exchange value to ensure the CAS succeeds
-				compareValue.word0 = resultValue.word0;
-			}
-
-			if (bNewJobFound == false && ((resultValue.word1 & 1) == 1))
-			{
-				// update the exchange value to ensure the CAS succeeds
-				compareValue.word1 = resultValue.word1;
-				exchangeValue.word1 = (resultValue.word1 & ~1);
-				bUnlockQueueFullstate = true;
-			}
-
-		}
-		while (!bStopLoop);
-
-		if (bUnlockQueueFullstate)
-		{
-			assert(bNewJobFound == false);
-			pQueue->m_pQueueFullSemaphore->Release();
-		}
-		if (queueStoppedSemaphore.IsRunning())
-		{
-			assert(bNewJobFound == false);
-			queueStoppedSemaphore.SetStopped();
-		}
-#endif
-
+		// temp end of queue, leave it unless packets were added in the meantime
+		bNewJobFound = pQueue->ContinueDrain();
 	}
 	while (bNewJobFound);
 
+	// nothing touches the queue after this, the producer may release it once WaitFinished returned
+	pQueue->m_QueueRunningState.SetStopped();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,374 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   CpuTopology.cpp
+//  Version:     v1.00
+//  Description: CPU topology detection and worker pool sizing for the thread backend
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "AngelicaPlatformDefines.h"
+#if ANGELICA_PLATFORM_WINDOWS
+	#include "Win32specific.h"
+	#include "MSVCspecific.h"
+#else
+	#include "Linuxspecific.h"
+	#include "GCCspecific.h"
+#endif
+#include "CpuTopology.h"
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+typedef unsigned long long TCoreMask;
+
+// Per logical core: masks of all logical cores sharing a resource with it
+struct SLogicalCoreInfo
+{
+	TCoreMask siblingMask;    // same physical core
+	TCoreMask packageMask;
+	TCoreMask l2Mask;
+	TCoreMask l3Mask;
+	TCoreMask numaNodeMask;
+	unsigned int nNumaNodeId; // OS node number
+};
+
+#if ANGELICA_PLATFORM_WINDOWS
+///////////////////////////////////////////////////////////////////////////////
+// Note: only reports the processor group of the calling thread, which matches the 64 core limit of SCpuTopology
+bool QueryLogicalCores(SLogicalCoreInfo* arrInfo, unsigned int& rNumLogicalCores)
+{
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo(&systemInfo);
+	rNumLogicalCores = std::min((unsigned int)systemInfo.dwNumberOfProcessors, (unsigned int)JobManager::SCpuTopology::eMaxLogicalCores);
+
+	DWORD nLength = 0;
+	GetLogicalProcessorInformation(NULL, &nLength);
+	if (GetLastError() != ERROR_INSUFFICIENT_BUFFER)
+		return false;
+
+	std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> processorInfo(nLength / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+	if (!GetLogicalProcessorInformation(&processorInfo[0], &nLength))
+		return false;
+
+	for (size_t i = 0; i < processorInfo.size(); ++i)
+	{
+		const SYSTEM_LOGICAL_PROCESSOR_INFORMATION& rInfo = processorInfo[i];
+		const TCoreMask mask = (TCoreMask)rInfo.ProcessorMask;
+
+		for (unsigned int nCore = 0; nCore < rNumLogicalCores; ++nCore)
+		{
+			if ((mask & (1ULL << nCore)) == 0)
+				continue;
+
+			switch (rInfo.Relationship)
+			{
+			case RelationProcessorCore:
+				arrInfo[nCore].siblingMask = mask;
+				break;
+			case RelationProcessorPackage:
+				arrInfo[nCore].packageMask = mask;
+				break;
+			case RelationNumaNode:
+				arrInfo[nCore].numaNodeMask = mask;
+				arrInfo[nCore].nNumaNodeId = rInfo.NumaNode.NodeNumber;
+				break;
+			case RelationCache:
+				if (rInfo.Cache.Type == CacheInstruction)
+					break;
+				if (rInfo.Cache.Level == 2)
+					arrInfo[nCore].l2Mask = mask;
+				else if (rInfo.Cache.Level == 3)
+					arrInfo[nCore].l3Mask = mask;
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+#else
+///////////////////////////////////////////////////////////////////////////////
+// Reads a sysfs cpu list like "0-3,8-11" into a mask
+bool ReadCpuList(const char* szPath, TCoreMask& rMask)
+{
+	FILE* pFile = fopen(szPath, "r");
+	if (!pFile)
+		return false;
+
+	char szBuffer[256];
+	const bool bRead = fgets(szBuffer, sizeof(szBuffer), pFile) != NULL;
+	fclose(pFile);
+	if (!bRead)
+		return false;
+
+	rMask = 0;
+	const char* pCur = szBuffer;
+	while (*pCur >= '0' && *pCur <= '9')
+	{
+		char* pEnd = NULL;
+		const unsigned long nFirst = strtoul(pCur, &pEnd, 10);
+		unsigned long nLast = nFirst;
+		if (*pEnd == '-')
+			nLast = strtoul(pEnd + 1, &pEnd, 10);
+
+		for (unsigned long nCore = nFirst; nCore <= nLast && nCore < JobManager::SCpuTopology::eMaxLogicalCores; ++nCore)
+			rMask |= 1ULL << nCore;
+
+		pCur = (*pEnd == ',') ? pEnd + 1 : pEnd;
+	}
+	return rMask != 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool ReadFirstLine(const char* szPath, char* szBuffer, int nBufferSize)
+{
+	FILE* pFile = fopen(szPath, "r");
+	if (!pFile)
+		return false;
+
+	const bool bRead = fgets(szBuffer, nBufferSize, pFile) != NULL;
+	fclose(pFile);
+	return bRead;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool QueryLogicalCores(SLogicalCoreInfo* arrInfo, unsigned int& rNumLogicalCores)
+{
+	const long nOnlineCores = sysconf(_SC_NPROCESSORS_ONLN);
+	rNumLogicalCores = std::min((unsigned int)std::max(nOnlineCores, 1L), (unsigned int)JobManager::SCpuTopology::eMaxLogicalCores);
+
+	bool bFoundTopology = false;
+	char szPath[128];
+	char szValue[32];
+	for (unsigned int nCore = 0; nCore < rNumLogicalCores; ++nCore)
+	{
+		sprintf_s(szPath, "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list", nCore);
+		bFoundTopology |= ReadCpuList(szPath, arrInfo[nCore].siblingMask);
+
+		sprintf_s(szPath, "/sys/devices/system/cpu/cpu%u/topology/core_siblings_list", nCore);
+		ReadCpuList(szPath, arrInfo[nCore].packageMask);
+
+		for (unsigned int nIndex = 0;; ++nIndex)
+		{
+			sprintf_s(szPath, "/sys/devices/system/cpu/cpu%u/cache/index%u/level", nCore, nIndex);
+			if (!ReadFirstLine(szPath, szValue, sizeof(szValue)))
+				break;
+			const int nLevel = atoi(szValue);
+
+			sprintf_s(szPath, "/sys/devices/system/cpu/cpu%u/cache/index%u/type", nCore, nIndex);
+			if (ReadFirstLine(szPath, szValue, sizeof(szValue)) && strncmp(szValue, "Instruction", 11) == 0)
+				continue;
+
+			sprintf_s(szPath, "/sys/devices/system/cpu/cpu%u/cache/index%u/shared_cpu_list", nCore, nIndex);
+			if (nLevel == 2)
+				ReadCpuList(szPath, arrInfo[nCore].l2Mask);
+			else if (nLevel == 3)
+				ReadCpuList(szPath, arrInfo[nCore].l3Mask);
+		}
+	}
+
+	// node numbers can have gaps, memory only nodes have an empty cpu list
+	for (unsigned int nNode = 0; nNode < JobManager::SCpuTopology::eMaxLogicalCores; ++nNode)
+	{
+		TCoreMask nodeMask = 0;
+		sprintf_s(szPath, "/sys/devices/system/node/node%u/cpulist", nNode);
+		if (!ReadCpuList(szPath, nodeMask))
+			continue;
+
+		for (unsigned int nCore = 0; nCore < rNumLogicalCores; ++nCore)
+		{
+			if (nodeMask & (1ULL << nCore))
+			{
+				arrInfo[nCore].numaNodeMask = nodeMask;
+				arrInfo[nCore].nNumaNodeId = nNode;
+			}
+		}
+	}
+
+	return bFoundTopology;
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Gives every distinct mask a consecutive index, returns the number of distinct masks
+unsigned int AssignDomains(const TCoreMask* arrMasks, unsigned int nNumCores, unsigned char* arrDomain)
+{
+	unsigned int nNumDomains = 0;
+	for (unsigned int i = 0; i < nNumCores; ++i)
+	{
+		unsigned int j = 0;
+		while (j < i && arrMasks[j] != arrMasks[i])
+			++j;
+
+		arrDomain[i] = (j < i) ? arrDomain[j] : (unsigned char)nNumDomains++;
+	}
+	return nNumDomains;
+}
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::detail::DetectCpuTopology(JobManager::SCpuTopology& rTopology)
+{
+	memset(&rTopology, 0, sizeof(rTopology));
+
+	SLogicalCoreInfo arrInfo[SCpuTopology::eMaxLogicalCores];
+	memset(arrInfo, 0, sizeof(arrInfo));
+
+	unsigned int nNumLogicalCores = 1;
+	QueryLogicalCores(arrInfo, nNumLogicalCores);
+	nNumLogicalCores = std::max(nNumLogicalCores, 1u);
+
+	// fill in whatever the OS didn't report: own physical core, one package, L2 per core, L3 per package
+	const TCoreMask validMask = (nNumLogicalCores == SCpuTopology::eMaxLogicalCores) ? ~0ULL : ((1ULL << nNumLogicalCores) - 1);
+	TCoreMask arrSiblingMasks[SCpuTopology::eMaxLogicalCores];
+	TCoreMask arrPackageMasks[SCpuTopology::eMaxLogicalCores];
+	TCoreMask arrL2Masks[SCpuTopology::eMaxLogicalCores];
+	TCoreMask arrL3Masks[SCpuTopology::eMaxLogicalCores];
+	TCoreMask arrNumaNodeMasks[SCpuTopology::eMaxLogicalCores];
+	for (unsigned int i = 0; i < nNumLogicalCores; ++i)
+	{
+		const SLogicalCoreInfo& rInfo = arrInfo[i];
+		arrSiblingMasks[i] = (rInfo.siblingMask & validMask) ? (rInfo.siblingMask & validMask) : (1ULL << i);
+		arrPackageMasks[i] = (rInfo.packageMask & validMask) ? (rInfo.packageMask & validMask) : validMask;
+		arrL2Masks[i] = (rInfo.l2Mask & validMask) ? (rInfo.l2Mask & validMask) : arrSiblingMasks[i];
+		arrL3Masks[i] = (rInfo.l3Mask & validMask) ? (rInfo.l3Mask & validMask) : arrPackageMasks[i];
+		arrNumaNodeMasks[i] = (rInfo.numaNodeMask & validMask) ? (rInfo.numaNodeMask & validMask) : validMask;
+	}
+
+	rTopology.nNumLogicalCores = nNumLogicalCores;
+	rTopology.nNumPhysicalCores = AssignDomains(arrSiblingMasks, nNumLogicalCores, rTopology.arrPhysicalCore);
+	rTopology.nNumPackages = AssignDomains(arrPackageMasks, nNumLogicalCores, rTopology.arrPackage);
+	rTopology.nNumL2Domains = AssignDomains(arrL2Masks, nNumLogicalCores, rTopology.arrL2Domain);
+	rTopology.nNumL3Domains = AssignDomains(arrL3Masks, nNumLogicalCores, rTopology.arrL3Domain);
+	rTopology.nNumNumaNodes = AssignDomains(arrNumaNodeMasks, nNumLogicalCores, rTopology.arrNumaNode);
+	for (unsigned int i = 0; i < nNumLogicalCores; ++i)
+		rTopology.arrNumaNodeId[rTopology.arrNumaNode[i]] = (unsigned char)arrInfo[i].nNumaNodeId;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::detail::BuildWorkerPoolLayout(const JobManager::SCpuTopology& rTopology, unsigned int nSysMaxWorker, JobManager::SWorkerPoolLayout& rLayout)
+{
+	// order the logical cores: the first SMT thread of every physical core, then the second ones, ...
+	unsigned char arrCoreOrder[SCpuTopology::eMaxLogicalCores];
+	unsigned int nNumOrdered = 0;
+	for (unsigned int nSmtIndex = 0; nNumOrdered < rTopology.nNumLogicalCores && nSmtIndex < rTopology.nNumLogicalCores; ++nSmtIndex)
+	{
+		for (unsigned int nPhysicalCore = 0; nPhysicalCore < rTopology.nNumPhysicalCores; ++nPhysicalCore)
+		{
+			unsigned int nSiblingIndex = 0;
+			for (unsigned int nLogicalCore = 0; nLogicalCore < rTopology.nNumLogicalCores; ++nLogicalCore)
+			{
+				if (rTopology.arrPhysicalCore[nLogicalCore] != nPhysicalCore)
+					continue;
+
+				if (nSiblingIndex++ == nSmtIndex)
+				{
+					arrCoreOrder[nNumOrdered++] = (unsigned char)nLogicalCore;
+					break;
+				}
+			}
+		}
+	}
+
+	// the reserved cores are taken from the front, that's where the main thread usually runs
+	unsigned int nNumCandidates = rTopology.nNumLogicalCores;
+	unsigned int nNumReserved = 0;
+	switch (rLayout.policy)
+	{
+	case eWPP_AllLogicalCores:
+		break;
+	case eWPP_OnePerPhysicalCore:
+		nNumCandidates = rTopology.nNumPhysicalCores;
+		nNumReserved = std::min(rLayout.nReservedCores, nNumCandidates - 1);
+		break;
+	case eWPP_LogicalMinusReserved:
+	default:
+		nNumReserved = std::min(rLayout.nReservedCores, nNumCandidates - 1);
+		break;
+	}
+
+	unsigned int nNumWorkers = nNumCandidates - nNumReserved;
+	if (nSysMaxWorker)
+		nNumWorkers = std::min(nNumWorkers, nSysMaxWorker);
+
+	rLayout.nNumWorkers = nNumWorkers;
+	for (unsigned int i = 0; i < nNumWorkers; ++i)
+	{
+		rLayout.arrWorkerLogicalCore[i] = arrCoreOrder[nNumReserved + i];
+		rLayout.arrWorkerNumaNode[i] = rTopology.arrNumaNode[rLayout.arrWorkerLogicalCore[i]];
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+const char* JobManager::detail::GetWorkerPoolPolicyName(JobManager::EWorkerPoolPolicy policy)
+{
+	switch (policy)
+	{
+	case eWPP_AllLogicalCores:
+		return "AllLogicalCores";
+	case eWPP_OnePerPhysicalCore:
+		return "OnePerPhysicalCore";
+	case eWPP_LogicalMinusReserved:
+		return "LogicalMinusReserved";
+	default:
+		return "Unknown";
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+unsigned int JobManager::detail::GetCurrentLogicalCore()
+{
+#if ANGELICA_PLATFORM_WINDOWS
+	// only the processor group of the calling thread, like the topology
+	return (unsigned int)GetCurrentProcessorNumber();
+#else
+	const int nCore = sched_getcpu();
+	return nCore >= 0 ? (unsigned int)nCore : ~0;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void* JobManager::detail::NumaAlignedMalloc(size_t nSize, size_t nAlignment, unsigned int nNumaNodeId)
+{
+	if (nNumaNodeId >= SCpuTopology::eMaxLogicalCores)
+		return _aligned_malloc(nSize, nAlignment);
+
+#if ANGELICA_PLATFORM_WINDOWS
+	// page aligned, which covers every alignment used by the job system
+	void* pMemory = VirtualAllocExNuma(GetCurrentProcess(), NULL, nSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, nNumaNodeId);
+	return pMemory ? pMemory : VirtualAlloc(NULL, nSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+	// whole pages, the policy must not apply to memory next to the allocation
+	enum { ePageSize = 4096, eMPOL_Preferred = 1, eMPOL_MF_Move = 1 << 1 };
+	const size_t nPageSize = ePageSize;
+	const size_t nAllocSize = (nSize + nPageSize - 1) & ~(nPageSize - 1);
+	void* pMemory = _aligned_malloc(nAllocSize, std::max(nAlignment, nPageSize));
+	if (!pMemory)
+		return NULL;
+
+	// no libnuma dependency, the policy is only a preference and nothing changes if the kernel has no NUMA support
+	unsigned long arrNodeMask[SCpuTopology::eMaxLogicalCores / (8 * sizeof(unsigned long))];
+	memset(arrNodeMask, 0, sizeof(arrNodeMask));
+	arrNodeMask[nNumaNodeId / (8 * sizeof(unsigned long))] = 1UL << (nNumaNodeId % (8 * sizeof(unsigned long)));
+	syscall(SYS_mbind, pMemory, nAllocSize, eMPOL_Preferred, arrNodeMask, sizeof(arrNodeMask) * 8 + 1, eMPOL_MF_Move);
+	return pMemory;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::detail::NumaAlignedFree(void* pMemory, unsigned int nNumaNodeId)
+{
+#if ANGELICA_PLATFORM_WINDOWS
+	if (nNumaNodeId < SCpuTopology::eMaxLogicalCores)
+	{
+		VirtualFree(pMemory, 0, MEM_RELEASE);
+		return;
+	}
+#endif
+	_aligned_free(pMemory);
+}
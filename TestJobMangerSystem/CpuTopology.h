@@ -0,0 +1,38 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   CpuTopology.h
+//  Version:     v1.00
+//  Description: CPU topology detection and worker pool sizing for the thread backend
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "IJobManager.h"
+
+namespace JobManager {
+namespace detail {
+
+// Fills rTopology with the logical/physical cores, packages, shared L2/L3 domains and NUMA nodes of the machine.
+// If the OS doesn't provide the information, every logical core is treated as its own physical core on a single node.
+void DetectCpuTopology(JobManager::SCpuTopology& rTopology);
+
+// Computes worker count and placement for rLayout.policy and rLayout.nReservedCores.
+// Workers are spread over physical cores first, SMT siblings are used last. nSysMaxWorker (if not 0) clamps the count.
+void BuildWorkerPoolLayout(const JobManager::SCpuTopology& rTopology, unsigned int nSysMaxWorker, JobManager::SWorkerPoolLayout& rLayout);
+
+// Returns a printable name for a worker pool policy.
+const char* GetWorkerPoolPolicyName(JobManager::EWorkerPoolPolicy policy);
+
+// Returns the logical core the calling thread runs on right now, ~0 if the OS can't tell.
+unsigned int GetCurrentLogicalCore();
+
+// Aligned allocation placed on the NUMA node with the OS node number nNumaNodeId (see SCpuTopology::arrNumaNodeId),
+// ~0 allocates without a preference. The memory has to be released with NumaAlignedFree and the same node number.
+void* NumaAlignedMalloc(size_t nSize, size_t nAlignment, unsigned int nNumaNodeId);
+void  NumaAlignedFree(void* pMemory, unsigned int nNumaNodeId);
+
+} // namespace detail
+} // namespace JobManager
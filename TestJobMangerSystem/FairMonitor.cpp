@@ -35,6 +35,96 @@ MERCHANTABILITY ARE HEREBY DISCLAIMED.
 #include<algorithm>
 #include "FairMonitor.h"
 
+#if !defined(_WIN32)
+///////////////////////////////////////////////////////////////////////
+//
+// Posix versions of the few Win32 primitives the monitor is built on.
+// Critical sections map to recursive pthread mutexes, the per-waiter
+// auto-reset events map to a heap allocated futex word, so a waiting
+// thread parks directly in the kernel without a mutex/condvar pair.
+//
+namespace
+{
+  void InitializeCriticalSection(CRITICAL_SECTION* pCritSec)
+  {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(pCritSec, &attr);
+    pthread_mutexattr_destroy(&attr);
+  }
+
+  void DeleteCriticalSection(CRITICAL_SECTION* pCritSec)
+  {
+    pthread_mutex_destroy(pCritSec);
+  }
+
+  void EnterCriticalSection(CRITICAL_SECTION* pCritSec)
+  {
+    pthread_mutex_lock(pCritSec);
+  }
+
+  void LeaveCriticalSection(CRITICAL_SECTION* pCritSec)
+  {
+    pthread_mutex_unlock(pCritSec);
+  }
+
+  BOOL TryEnterCriticalSection(CRITICAL_SECTION* pCritSec)
+  {
+    return pthread_mutex_trylock(pCritSec) == 0;
+  }
+
+  void SetLastError(DWORD dwError)
+  {
+    errno = (int)dwError;
+  }
+
+  DWORD GetLastError()
+  {
+    return (DWORD)errno;
+  }
+
+  // The event is a single int: 0 = unsignalled, 1 = signalled.
+  HANDLE CreateEvent(void*, BOOL, BOOL, const char*)
+  {
+    return new int(0);
+  }
+
+  BOOL CloseHandle(HANDLE hEvent)
+  {
+    delete static_cast<int*>(hEvent);
+    return TRUE;
+  }
+
+  BOOL SetEvent(HANDLE hEvent)
+  {
+    volatile int* pState = static_cast<volatile int*>(hEvent);
+    __sync_lock_test_and_set(pState, 1);
+    AngelicaMT::detail::FutexWake(pState, 1);
+    return TRUE;
+  }
+
+  DWORD WaitForSingleObject(HANDLE hEvent, DWORD dwMillisecondsTimeout)
+  {
+    volatile int* pState = static_cast<volatile int*>(hEvent);
+    const signed long long nStart = GetRealTicks();
+    while( ! __sync_bool_compare_and_swap(pState, 1, 0) )
+    {
+      unsigned int nRemaining = INFINITE;
+      if( dwMillisecondsTimeout != INFINITE )
+      {
+        const signed long long nElapsed = (GetRealTicks() - nStart) / 1000000LL;
+        if( nElapsed >= (signed long long)dwMillisecondsTimeout )
+          return WAIT_TIMEOUT;
+        nRemaining = (unsigned int)(dwMillisecondsTimeout - nElapsed);
+      }
+      AngelicaMT::detail::FutexWait(pState, 0, nRemaining);
+    }
+    return WAIT_OBJECT_0;
+  }
+}
+#endif
+
 ///////////////////////////////////////////////////////////////////////
 //
 FairMonitor::FairMonitor() :
@@ -37,7 +37,14 @@ MERCHANTABILITY ARE HEREBY DISCLAIMED.
 #ifndef __FAIR_MONITOR_INCLUDED__
 #define __FAIR_MONITOR_INCLUDED__
 
+#if defined(_WIN32)
 #include"windows.h"
+#else
+#include<pthread.h>
+// On posix the critical sections are recursive pthread mutexes and the
+// wait set events are futex words, see FairMonitor.cpp.
+typedef pthread_mutex_t CRITICAL_SECTION;
+#endif
 #include<deque>
 
 ///////////////////////////////////////////////////////////////////////
@@ -8,10 +8,15 @@
 // -------------------------------------------------------------------------
 //  History:
 ////////////////////////////////////////////////////////////////////////////
-#include "StdAfx.h"
-#include "..\AngelicaPlatformDefines.h"
-#include "../MSVCspecific.h"
-#include "../Win32specific.h"
+#include "stdafx.h"
+#include "../AngelicaPlatformDefines.h"
+#if ANGELICA_PLATFORM_WINDOWS
+	#include "../MSVCspecific.h"
+	#include "../Win32specific.h"
+#else
+	#include "../GCCspecific.h"
+	#include "../Linuxspecific.h"
+#endif
 #include "FallBackBackend.h"
 #include "../JobManager.h"
 
@@ -42,29 +47,34 @@ void JobManager::FallBackBackEnd::CFallBackBackEnd::AddJob(JobManager::CJobDeleg
 		INT_PTR queueStart = pQueue->m_RingBufferStart;
 		INT_PTR queueEnd = pQueue->m_RingBufferEnd;
 		INT_PTR curPullPtr = *pQueuePull;
-
-		// == process job packet == //
-		void* pParamMem = (void*)curPullPtr;
 		const unsigned int cParamSize = (rInfoBlock.paramSize << 4);
-		SAddPacketData* const __restrict pAddPacketData = (SAddPacketData*)((unsigned char*)curPullPtr + cParamSize);
 
-		Invoker pInvoker = pJobManager->GetJobInvoker(pAddPacketData->nInvokerIndex);
+		// the job is only started for the first packet of a batch, process all published ones
+		do
+		{
+			// == process job packet == //
+			void* pParamMem = (void*)curPullPtr;
+			SAddPacketData* const __restrict pAddPacketData = (SAddPacketData*)((unsigned char*)curPullPtr + cParamSize);
 
-		// call delegator function to invoke job entry
-		(*pInvoker)(pParamMem);
+			Invoker pInvoker = pJobManager->GetJobInvoker(pAddPacketData->nInvokerIndex);
 
-		// mark job as finished
-		IF (pAddPacketData->pJobState, 1)
-		{
-			pAddPacketData->pJobState->SetStopped();
-		}
+			// call delegator function to invoke job entry
+			(*pInvoker)(pParamMem);
+
+			// mark job as finished
+			IF (pAddPacketData->pJobState, 1)
+			{
+				pAddPacketData->pJobState->SetStopped();
+			}
 
-		// == update queue state == //
-		const INT_PTR cNextPull = curPullPtr + queueIncr;
-		curPullPtr = (cNextPull >= queueEnd) ? queueStart : cNextPull;
+			// == update queue state == //
+			const INT_PTR cNextPull = curPullPtr + queueIncr;
+			curPullPtr = (cNextPull >= queueEnd) ? queueStart : cNextPull;
 
-		// update pull ptr (safe since only change by a single job worker)
-		*pQueuePull = curPullPtr;
+			// update pull ptr (safe since only change by a single job worker)
+			*pQueuePull = curPullPtr;
+		}
+		while (curPullPtr != *pQueuePush || pQueue->ContinueDrain());
 
 		// mark queue as finished(safe since the fallback is not threaded)
 		pQueueState->SetStopped();
@@ -75,14 +85,7 @@ void JobManager::FallBackBackEnd::CFallBackBackEnd::AddJob(JobManager::CJobDeleg
 		const void* pParamMem = crJob.GetJobParamData();
 
 		// execute job function
-		if (crJob.GetLambda())
-		{
-			crJob.GetLambda()();
-		}
-		else
-		{
-			(*delegator)((void*)pParamMem);
-		}
+		(*delegator)((void*)pParamMem);
 
 		IF (rInfoBlock.GetJobState(), 1)
 		{
@@ -0,0 +1,86 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   GCCSpecific.h
+//  Version:     v1.00
+//  Compilers:   gcc, clang
+//  Description: Settings for all builds under GCC compatible compilers
+// -------------------------------------------------------------------------
+//  History:
+//
+////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#if !defined(__GNUC__)
+	#error This file should only be included on GCC compatible compilers
+#endif
+
+//! Compiler version
+#define ANGELICA_COMPILER_GCC     1
+#define ANGELICA_COMPILER_VERSION ((__GNUC__ * 100) + __GNUC_MINOR__)
+
+//! Compiler features
+#if defined(__EXCEPTIONS)
+	#define ANGELICA_COMPILER_EXCEPTIONS 1
+#endif
+#if defined(__GXX_RTTI)
+	#define ANGELICA_COMPILER_RTTI 1
+#endif
+
+//! __FUNC__ is like __func__, but it has the class name
+#define __FUNC__               __PRETTY_FUNCTION__
+#define __FUNCTION__           __func__
+#define ANGELICA_FUNC_HAS_SIGNATURE 1
+
+//! PREfast heleprs
+#define PREFAST_SUPPRESS_WARNING(W)
+#define PREFAST_ASSUME(cond)
+
+//! Deprecation helper
+#define ANGELICA_DEPRECATED(func) func __attribute__((deprecated))
+
+//! Portable alignment helper, can be placed after the struct/class/union keyword, or before the type of a declaration.
+//! Example: struct ANGELICA_ALIGN(16) { ... }; ANGELICA_ALIGN(16) char myAlignedChar;
+#define ANGELICA_ALIGN(bytes) __attribute__((aligned(bytes)))
+
+//! MSVC style declspecs used by the shared headers, only align is supported
+#define _declspec(spec)          ANGELICA_DECLSPEC_ ## spec
+#define __declspec(spec)         ANGELICA_DECLSPEC_ ## spec
+#define ANGELICA_DECLSPEC_align(bytes) ANGELICA_ALIGN(bytes)
+
+//! Calling conventions only exist on 32 bit Windows
+#define __stdcall
+#define _stdcall
+#define __cdecl
+
+//! Restricted reference (similar to restricted pointer), use like: SFoo& RESTRICT_REFERENCE myFoo = ...;
+#define RESTRICT_REFERENCE __restrict__
+
+//! Compiler-supported type-checking helper
+#define PRINTF_PARAMS(...) __attribute__((format(printf, __VA_ARGS__)))
+#define SCANF_PARAMS(...)  __attribute__((format(scanf, __VA_ARGS__)))
+
+//! Barrier to prevent R/W reordering by the compiler.
+//! Note: This does not emit any instruction, and it does not prevent CPU reordering!
+#define MEMORY_RW_REORDERING_BARRIER asm volatile ("" ::: "memory")
+
+//! Static branch-prediction helpers
+#define IF(condition, hint)    if (__builtin_expect(!!(condition), hint))
+#define IF_UNLIKELY(condition) if (__builtin_expect(!!(condition), 0))
+#define IF_LIKELY(condition)   if (__builtin_expect(!!(condition), 1))
+
+//! Inline helpers
+#define NO_INLINE             __attribute__((noinline))
+#define NO_INLINE_WEAK        __attribute__((noinline)) __attribute__((weak))
+#define ANGELICA_FORCE_INLINE __attribute__((always_inline)) inline
+#define __forceinline         __attribute__((always_inline)) inline
+
+//! Packing helper, the preceding declaration will be tightly packed.
+#define __PACKED __attribute__((packed))
+
+// Suppress undefined behavior sanitizer errors on a function.
+#define ANGELICA_FUNCTION_CONTAINS_UNDEFINED_BEHAVIOR __attribute__((no_sanitize("undefined")))
+
+//! Unreachable code marker for helping error handling and optimization
+#define UNREACHABLE() __builtin_unreachable()
@@ -11,10 +11,14 @@
 ////////////////////////////////////////////////////////////////////////////
 
 #pragma once
+#if defined(_WIN32)
 #include<windows.h>
+#endif
 #include "AngelicaThread.h"
-#include "timevalue.h"
+#include "TimeValue.h"
 #include <functional>
+#include <type_traits>
+#include <utility>
 #include "FairMonitor.h"
 
 // Job manager settings
@@ -33,6 +37,10 @@
 	#undef JOBMANAGER_SUPPORT_PROFILING
 #endif
 
+//! Enable to shrink the slots of the fixed size job queues to 128 bytes, bigger parameters are then moved into a pooled block.
+//! Off by default, it showed no gain over full slots (see Benchmarks/JobQueueSlotBenchmark.cpp).
+//#define JOBMANAGER_SUPPORT_COMPACT_JOB_QUEUE_SLOTS
+
 struct ILog;
 
 //! Implementation of mutex/condition variable.
@@ -133,7 +141,7 @@ struct SProdConsQueueBase;
 }
 namespace JobManager {
 namespace detail {
-struct SJobQueueSlotState;
+struct SJobQueueSlotSequence;
 }
 }
 
@@ -173,9 +181,20 @@ struct _declspec(align(128)) SWorkerStats
 //! Type to reprensent a semaphore handle of the jobmanager.
 typedef unsigned short TSemaphoreHandle;
 
+//! Type to represent a delayed or periodic job of the jobmanager, 0 is no timer.
+typedef unsigned int TJobTimerHandle;
+
 //! Magic value to reprensent an invalid job handle.
 enum  : unsigned int { INVALID_JOB_HANDLE = ((unsigned int)-1) };
 
+//! Special targets of a job, see CJobDelegator::SetTargetWorker.
+//! Values below the number of workers of the thread backend name a worker.
+enum ETargetWorker : unsigned int
+{
+	eTW_AnyWorker  = ((unsigned int)-1),     //!< Any worker can take the job, the default.
+	eTW_MainThread = ((unsigned int)-2),     //!< The job waits in the main thread queue until PumpMainThreadJobs runs it.
+};
+
 //! BackEnd Type.
 enum EBackEndType
 {
@@ -184,6 +203,111 @@ enum EBackEndType
 	eBET_Blocking
 };
 
+//! Policy used to size the worker pool of the thread backend from the detected CPU topology.
+enum EWorkerPoolPolicy
+{
+	eWPP_AllLogicalCores,        //!< One worker per logical core, SMT siblings included.
+	eWPP_OnePerPhysicalCore,     //!< One worker per physical core minus the reserved cores, SMT siblings stay free.
+	eWPP_LogicalMinusReserved,   //!< One worker per logical core minus the reserved cores (e.g. for the main thread).
+};
+
+//! CPU topology as detected during IJobManager::Init.
+//! Per logical core the index of its physical core, package and shared cache domains is stored.
+struct SCpuTopology
+{
+	enum { eMaxLogicalCores = 64 };
+
+	unsigned int  nNumLogicalCores;
+	unsigned int  nNumPhysicalCores;
+	unsigned int  nNumPackages;
+	unsigned int  nNumL2Domains;                        //!< Number of distinct groups of cores sharing a L2 cache.
+	unsigned int  nNumL3Domains;                        //!< Number of distinct groups of cores sharing a L3 cache.
+	unsigned int  nNumNumaNodes;                        //!< 1 if the OS doesn't report NUMA nodes.
+	unsigned char arrPhysicalCore[eMaxLogicalCores];
+	unsigned char arrPackage[eMaxLogicalCores];
+	unsigned char arrL2Domain[eMaxLogicalCores];
+	unsigned char arrL3Domain[eMaxLogicalCores];
+	unsigned char arrNumaNode[eMaxLogicalCores];
+	unsigned char arrNumaNodeId[eMaxLogicalCores];      //!< OS node number of each NUMA node index, used for node local allocations.
+};
+
+//! Worker layout chosen by the thread backend during IJobManager::Init.
+struct SWorkerPoolLayout
+{
+	EWorkerPoolPolicy policy;
+	unsigned int      nReservedCores;
+	bool              bPinWorkers;                                       //!< Workers are bound to their logical core (only cores < 32).
+	unsigned int      nNumWorkers;
+	unsigned char     arrWorkerLogicalCore[SCpuTopology::eMaxLogicalCores]; //!< Logical core each worker is placed on.
+	unsigned char     arrWorkerNumaNode[SCpuTopology::eMaxLogicalCores];    //!< NUMA node of the core, the worker uses the job queue of this node.
+};
+
+//! Global job queue usage of the thread backend per priority level.
+struct SJobQueueStats
+{
+	unsigned int nCapacity[eNumPriorityLevel];         //!< Slots of the fixed size queues of all NUMA nodes.
+	unsigned int nPeakOccupancy[eNumPriorityLevel];    //!< Most jobs waiting at once since the last reset, overflow included.
+	unsigned int nOverflowJobs[eNumPriorityLevel];     //!< Jobs which didn't fit into the queue since the last reset.
+	unsigned int nOverflowSegments[eNumPriorityLevel]; //!< Overflow segments allocated so far, they are kept for reuse.
+
+	// time from queuing to a worker taking the job, all job sources of the level since the last reset
+	unsigned int       nDequeuedJobs[eNumPriorityLevel];
+	unsigned int       nAgedJobs[eNumPriorityLevel];   //!< Jobs taken ahead of higher levels because they waited longer than SPrioritySchedulingSettings::nMaxWaitUS.
+	unsigned long long nTotalWaitUS[eNumPriorityLevel];
+	unsigned int       nMaxWaitUS[eNumPriorityLevel];
+
+	// jobs taken from the job queue or a deque of the own NUMA node and of another node, all priority levels since the last reset
+	unsigned int nLocalNodeJobs;
+	unsigned int nRemoteNodeJobs;                      //!< Each one read its SInfoBlock across the interconnect.
+};
+
+//! How the workers of the thread backend choose the priority level of their next job.
+enum EPrioritySchedulingPolicy
+{
+	ePSP_Strict,                 //!< Always the highest level with work, lower levels starve under sustained higher priority load.
+	ePSP_WeightedFairShare,      //!< Levels with work share the jobs each worker takes in proportion to their weights (smooth weighted round-robin).
+};
+
+//! Tuning of the priority level selection, see IJobManager::SetPrioritySchedulingSettings.
+struct SPrioritySchedulingSettings
+{
+	EPrioritySchedulingPolicy policy;
+	unsigned int              arrWeights[eNumPriorityLevel]; //!< Guaranteed share of a level while others have work too, 0 only runs it when no other level has work.
+	unsigned int              nMaxWaitUS;                    //!< Aging for both policies, a lower level whose oldest queued job waited longer is served ahead of higher ones, 0 to disable.
+};
+
+//! How an idle worker of the thread backend waits for new jobs.
+enum EWorkerIdlePolicy
+{
+	eWIP_Park,                   //!< Sleep on the semaphore at once, no idle cpu cost but every wakeup goes through the kernel.
+	eWIP_SpinThenPark,           //!< Spin for a budget learned from the idle times seen so far, then yield, then sleep.
+	eWIP_Spin,                   //!< Spin and yield until work arrives, never sleep. Each idle worker keeps a core busy.
+};
+
+//! Tuning of the worker idle path, see IJobManager::SetWorkerIdleSettings.
+struct SWorkerIdleSettings
+{
+	EWorkerIdlePolicy policy;
+	unsigned int      nMaxSpinUS;                    //!< Upper bound of the learned spin budget, idle times above it go to sleep right away.
+	unsigned int      nYieldUS;                      //!< Time spent yielding the core after the spin budget ran out.
+	unsigned int      nMinJobTimeBeforeWaitUS;       //!< With less job execution time since the last wait, a worker first tries to get work without waiting (Durango only).
+};
+
+//! Idle behaviour of all workers since the last reset.
+struct SWorkerIdleStats
+{
+	enum { eNumWakeLatencyBuckets = 16 };
+
+	unsigned int       nSpinWakeups;                 //!< Work found while spinning.
+	unsigned int       nYieldWakeups;                //!< Work found while yielding.
+	unsigned int       nParkWakeups;                 //!< Work found after sleeping on the semaphore.
+	unsigned long long nSpinTimeUS;                  //!< Cpu time burned spinning and yielding.
+	unsigned long long nParkTimeUS;                  //!< Time spent sleeping.
+	unsigned long long nTotalWakeLatencyUS;          //!< Sum of the times from the job signal to a sleeping worker running, see nParkWakeups.
+	unsigned int       nMaxWakeLatencyUS;
+	unsigned int       arrWakeLatencyHistogram[eNumWakeLatencyBuckets]; //!< Sleeping wakeups by latency, bucket i counts latencies below 2^i us, the last one all above.
+};
+
 namespace Fiber
 {
 //! The alignment of the fibertask stack (currently set to 128 kb).
@@ -192,6 +316,13 @@ enum {FIBERTASK_ALIGNMENT = 128U << 10 };
 //! The number of switches the fibertask records (default: 32).
 enum {FIBERTASK_RECORD_SWITCHES = 32U };
 
+//! Suspend the calling job while *pAddress equals nCompareValue, its worker runs other jobs meanwhile.
+//! Returns false without waiting if the caller doesn't run on a job fiber, see IJobManager::SetFiberMode.
+bool WaitOnAddress(volatile void* pAddress, unsigned int nCompareValue);
+
+//! Make all jobs suspended in WaitOnAddress on pAddress runnable again, the memory itself is not accessed.
+void WakeByAddressAll(volatile void* pAddress);
+
 } // namespace JobManager::Fiber
 
 } // namespace JobManager
@@ -205,6 +336,7 @@ struct SJobStringHandle
 	unsigned int strLen;         //!< String length.
 	int          jobId;          //!< Index (also acts as id) of job.
 	unsigned int       nJobInvokerIdx; //!< Index of the jobInvoker (used to job switching in the prod/con queue).
+	unsigned int nNameHash;      //!< JobNameHash of the string, compared before the string on lookups.
 
 	inline bool operator==(const SJobStringHandle& crOther) const;
 	inline bool operator<(const SJobStringHandle& crOther) const;
@@ -214,6 +346,15 @@ struct SJobStringHandle
 //! Handle retrieved by name for job invocation.
 typedef SJobStringHandle* TJobHandle;
 
+//! FNV-1a hash of a job name, selects the slot of the name in the job handle registry.
+constexpr unsigned int JobNameHash(const char* cpJobName, unsigned int nStrLen)
+{
+	unsigned int nHash = 2166136261u;
+	for (unsigned int i = 0; i < nStrLen; ++i)
+		nHash = (nHash ^ (unsigned char)cpJobName[i]) * 16777619u;
+	return nHash;
+}
+
 bool SJobStringHandle::operator==(const SJobStringHandle& crOther) const
 {
 	return strcmp(cpString, crOther.cpString) == 0;
@@ -257,8 +398,31 @@ struct SJobProfilingDataContainer
 	SJobProfilingData arrJobProfilingData[nCapturedFrames][nCapturedEntriesPerFrame];
 };
 
-//! Special combination of a volatile spinning variable combined with a semaphore.
-//! Used if the running state is not yet set to finish during waiting.
+//! Work to continue once a job state stopped, registered instead of a thread waiting for it.
+struct SJobStateContinuation
+{
+	typedef void (* TResumeFunc)(SJobStateContinuation* pContinuation);
+
+	TResumeFunc            pResume;       //!< Called by the thread which stopped the job state, must not block.
+	SJobStateContinuation* pNext;         //!< Link in the list of continuations waiting on the same address.
+	volatile void*         pWaitAddress;  //!< Sync variable the continuation waits on.
+};
+
+namespace detail
+{
+//! Keep pContinuation until ResumeContinuations is called for pAddress, returns false if *pAddress doesn't equal nCompareValue anymore.
+bool ParkContinuation(volatile void* pAddress, unsigned int nCompareValue, SJobStateContinuation* pContinuation);
+
+//! Call pResume of all continuations parked on pAddress once the job state there stopped.
+//! The continuations stay parked if it was started again meanwhile, the memory is only read if a continuation is parked on it.
+void ResumeContinuations(volatile void* pAddress);
+
+//! Take pContinuation out of its list again, returns false if a ResumeContinuations call already took it and will resume it.
+bool UnparkContinuation(SJobStateContinuation* pContinuation);
+} // namespace detail
+
+//! Running counter of a job state, waiters sleep directly on the address of this word.
+//! No semaphore is needed, SetStopped only wakes if a waiter has registered itself.
 struct SJobSyncVariable
 {
 	SJobSyncVariable();
@@ -270,21 +434,28 @@ struct SJobSyncVariable
 	void SetRunning() volatile;
 	bool SetStopped(struct SJobStateBase* pPostCallback = nullptr) volatile;
 
+	//! Register a continuation instead of waiting, returns false if nothing is running and the caller can continue at once.
+	bool AddContinuation(SJobStateContinuation* pContinuation) volatile;
+
+	//! Sets the waiter flag at pWordValue again if jobs are running, returns false if the job state stopped.
+	//! Parked continuations keep waiting in that case, like a thread looping in Wait.
+	static bool KeepWaiting(volatile void* pWordValue);
+
 private:
 	friend class CJobManager;
 
-	//! Union used to combine the semaphore and the running state in a single word.
+	//! Union used to combine the waiter flag and the running state in a single word.
 	union SyncVar
 	{
 		volatile unsigned int wordValue;
 		struct
 		{
-			unsigned short           nRunningCounter;
-			TSemaphoreHandle semaphoreHandle;
+			unsigned short nRunningCounter;
+			unsigned short nWaiterFlag;       //!< Set by waiters before they go to sleep on wordValue.
 		};
 	};
 
-	SyncVar syncVar;      //!< Sync-variable which contain the running state or the used semaphore.
+	SyncVar syncVar;      //!< Sync-variable which contain the running state and the waiter flag.
 #if ANGELICA_PLATFORM_64BIT
 	char    padding[4];
 #endif
@@ -305,6 +476,12 @@ public:
 	}
 	virtual void AddPostJob() {};
 
+	//! pContinuation->pResume is called once the job state stopped, returns false if it isn't running.
+	inline bool AddContinuation(SJobStateContinuation* pContinuation)
+	{
+		return syncVar.AddContinuation(pContinuation);
+	}
+
 	virtual ~SJobStateBase() {}
 
 private:
@@ -428,6 +605,7 @@ struct _declspec(align(16)) SJobFrameStats
 	const char* cpName;               //!< Job name.
 
 	unsigned int usecLast;            //!< Last but one frames Job time in microseconds (written and accumulated by Thread).
+	unsigned int cancelledCount;      //!< Number of queued jobs skipped this frame because they were cancelled.
 
 	inline SJobFrameStats();
 	inline SJobFrameStats(const char* cpJobName);
@@ -457,12 +635,24 @@ struct _declspec(align(16)) SJobFrameStatsSummary
 	unsigned int nTotalExecutionTime;             //!< Total execution time of all jobs in microseconds.
 	unsigned int nNumJobsExecuted;                //!< Total Number of job executions this frame.
 	unsigned int nNumIndividualJobsExecuted;      //!< Total Number of individual jobs.
+	unsigned int nNumJobsCancelled;               //!< Total Number of queued jobs skipped this frame because they were cancelled.
 };
 
-SJobFrameStats::SJobFrameStats(const char* cpJobName) : usec(0), count(0), cpName(cpJobName), usecLast(0)
+//! Per frame stats of the jobs which were given a deadline, see CJobDelegator::SetDeadline.
+struct SJobDeadlineStats
+{
+	enum { eNumLatenessBuckets = 16 };
+
+	unsigned int nNumJobsWithDeadline;            //!< Jobs with a deadline finished this frame.
+	unsigned int nNumMissedDeadlines;             //!< Jobs which finished after their deadline.
+	unsigned int nMaxLatenessMicroSec;            //!< Worst lateness of a missed deadline.
+	unsigned int arrLatenessHistogram[eNumLatenessBuckets]; //!< Missed deadlines by lateness, bucket i counts latenesses below 2^i us, the last one all above.
+};
+
+SJobFrameStats::SJobFrameStats(const char* cpJobName) : usec(0), count(0), cpName(cpJobName), usecLast(0), cancelledCount(0)
 {}
 
-SJobFrameStats::SJobFrameStats() : cpName("Uninitialized"), usec(0), count(0), usecLast(0)
+SJobFrameStats::SJobFrameStats() : cpName("Uninitialized"), usec(0), count(0), usecLast(0), cancelledCount(0)
 {}
 
 void SJobFrameStats::operator=(const SJobFrameStats& crFrom)
@@ -471,12 +661,13 @@ void SJobFrameStats::operator=(const SJobFrameStats& crFrom)
 	count = crFrom.count;
 	cpName = crFrom.cpName;
 	usecLast = crFrom.usecLast;
+	cancelledCount = crFrom.cancelledCount;
 }
 
 void SJobFrameStats::Reset()
 {
 	usecLast = usec;
-	usec = count = 0;
+	usec = count = cancelledCount = 0;
 }
 
 bool SJobFrameStats::operator<(const SJobFrameStats& crOther) const
@@ -497,6 +688,22 @@ struct _declspec(align(16))SAddPacketData
 //! Takes a pointer to a params structure and does the decomposition of the parameters, then calls the Job entry function.
 typedef void (* Invoker)(void*);
 
+//! Cancellation flag shared by a group of jobs, see CJobDelegator::SetCancellationToken.
+//! Jobs which haven't started when the token is cancelled are skipped and their job state completes,
+//! running jobs can poll JobManager::IsJobCancelled to return early. The token has to outlive its jobs.
+class CJobCancellationToken
+{
+public:
+	CJobCancellationToken() : m_nCancelled(0) {}
+
+	void Cancel()            { AngelicaInterlockedExchange(&m_nCancelled, 1); }
+	void Reset()             { m_nCancelled = 0; }
+	bool IsCancelled() const { return m_nCancelled != 0; }
+
+private:
+	volatile LONG m_nCancelled;
+};
+
 //! Info block transferred first for each job.
 //! We have to transfer the info block, parameter block, input memory needed for execution.
 struct _declspec(align(128)) SInfoBlock
@@ -542,14 +749,14 @@ struct _declspec(align(128)) SInfoBlock
 
 	//! data needed to run the job and it's functionality.
 	volatile SInfoBlockState jobState;             //!< State of the SInfoBlock in job queue, should only be modified by access functions.
-	Invoker jobInvoker;                            //!< Callback function to job invoker (extracts parameters and calls entry function).
-	std::function<void()> jobLambdaInvoker;        //!< Alternative way to invoke job with lambda
+	Invoker jobInvoker;                            //!< Callback function to job invoker (extracts parameters and calls entry function), for lambda jobs the closure thunk.
 	union                                          //!< External job state address /shared with address of prod-cons queue.
 	{
 		JobManager::SJobState*          pJobState;
 		JobManager::SProdConsQueueBase* pQueue;
 	};
 	JobManager::SInfoBlock* pNext;                 //!< Single linked list for fallback jobs in the case the queue is full, and a worker wants to push new work.
+	const CJobCancellationToken* pCancellationToken; //!< Checked when the job is taken from the queue, NULL if the job can't be cancelled.
 
 	// Per-job settings like cache size and so on.
 	unsigned char frameProfIndex;                  //!< Index of SJobFrameStats*.
@@ -561,9 +768,14 @@ struct _declspec(align(128)) SInfoBlock
 #if defined(JOBMANAGER_SUPPORT_PROFILING)
 	unsigned short profilerIndex;                  //!< index for the job system profiler.
 #endif
+	unsigned long long nEnqueueTicks;              //!< GetRealTicks when the job was queued, for the wait time stats and aging of the thread backend.
+	unsigned long long nDeadlineTicks;             //!< GetRealTicks the job should be finished by, 0 if it has no deadline.
 
 	//! Bits used for nflags.
 	static const unsigned int scHasQueue = 0x4;
+	static const unsigned int scInvokeOnCancel = 0x8; //!< Invoker has to run for a cancelled job to release its parameters, it must skip the job function then.
+	static const unsigned int scBoundToWorker = 0x10; //!< Job was targeted at a thread, it runs on the worker stack and not on a fiber which could resume elsewhere.
+	static const unsigned int scParamsPooled = 0x20;  //!< Parameters didn't fit into a job queue slot, paramData holds the pointer to a pooled block.
 
 	//! Size of the SInfoBlock struct and how much memory we have to store parameters.
 #if ANGELICA_PLATFORM_64BIT
@@ -572,31 +784,51 @@ struct _declspec(align(128)) SInfoBlock
 	static const unsigned int scAvailParamSize = scSizeOfSJobQueueEntry - scSizeOfJobQueueEntryHeader;
 #else
 	static const unsigned int scSizeOfSJobQueueEntry = 384;
-	static const unsigned int scSizeOfJobQueueEntryHeader = 32;   //!< Please adjust when adding/removing members, keep as a multiple of 16.
+	static const unsigned int scSizeOfJobQueueEntryHeader = 48;   //!< Please adjust when adding/removing members, keep as a multiple of 16.
 	static const unsigned int scAvailParamSize = scSizeOfSJobQueueEntry - scSizeOfJobQueueEntryHeader;
 #endif
 
+	//! Size of the slots of the fixed size job queues and how much of it can hold parameters.
+#if defined(JOBMANAGER_SUPPORT_COMPACT_JOB_QUEUE_SLOTS)
+	//! Compact slots only hold the header and the parameters of small jobs.
+	//! Bigger parameters are moved into a pooled block, so a dispatch only touches the cache lines in use.
+	static const unsigned int scSizeOfJobQueueSlot = 128;
+#else
+	static const unsigned int scSizeOfJobQueueSlot = scSizeOfSJobQueueEntry;
+#endif
+	static const unsigned int scJobQueueSlotParamSize = scSizeOfJobQueueSlot - scSizeOfJobQueueEntryHeader;
+
 	//! Parameter data are enclosed within to save a cache miss.
 	_declspec(align(16)) unsigned char paramData[scAvailParamSize];    //!< is 16 byte aligned, make sure it is kept aligned.
 
-	inline void AssignMembersTo(SInfoBlock* pDest) const
+	//! Copies the members in front of the parameters.
+	inline void AssignHeaderTo(SInfoBlock* pDest) const
 	{
 		pDest->jobInvoker = jobInvoker;
-		pDest->jobLambdaInvoker = jobLambdaInvoker;
 		pDest->pJobState = pJobState;
 		pDest->pQueue = pQueue;
 		pDest->pNext = pNext;
+		pDest->pCancellationToken = pCancellationToken;
 
 		pDest->frameProfIndex = frameProfIndex;
 		pDest->nflags = nflags;
 		pDest->paramSize = paramSize;
 		pDest->jobId = jobId;
+		pDest->nEnqueueTicks = nEnqueueTicks;
+		pDest->nDeadlineTicks = nDeadlineTicks;
 
 #if defined(JOBMANAGER_SUPPORT_PROFILING)
 		pDest->profilerIndex = profilerIndex;
 #endif
+	}
 
-		memcpy(pDest->paramData, paramData, sizeof(paramData));
+	//! Copies the header and the parameters in use, producer/consumer queue jobs keep their parameters in the queue.
+	inline void AssignMembersTo(SInfoBlock* pDest) const
+	{
+		assert((nflags & (unsigned char)scParamsPooled) == 0);
+		AssignHeaderTo(pDest);
+		if (!HasQueue())
+			memcpy(pDest->paramData, paramData, paramSize << 4);
 	}
 
 	inline bool HasQueue() const
@@ -604,6 +836,21 @@ struct _declspec(align(128)) SInfoBlock
 		return (nflags & (unsigned char)scHasQueue) != 0;
 	}
 
+	inline bool IsCancelled() const
+	{
+		return pCancellationToken && pCancellationToken->IsCancelled();
+	}
+
+	inline bool InvokeOnCancel() const
+	{
+		return (nflags & (unsigned char)scInvokeOnCancel) != 0;
+	}
+
+	inline bool IsBoundToWorker() const
+	{
+		return (nflags & (unsigned char)scBoundToWorker) != 0;
+	}
+
 	inline void SetJobState(JobManager::SJobState* _pJobState)
 	{
 		assert(!HasQueue());
@@ -642,8 +889,14 @@ struct _declspec(align(16)) SJobQueuePos
 	//! Base of job queue per priority level.
 	JobManager::SInfoBlock* jobQueue[JobManager::eNumPriorityLevel];
 
+	//! The slots of a job queue are SInfoBlock::scSizeOfJobQueueSlot bytes apart.
+	inline JobManager::SInfoBlock& GetInfoBlock(unsigned int nPriorityLevel, unsigned int nJobSlot) const
+	{
+		return *reinterpret_cast<JobManager::SInfoBlock*>(reinterpret_cast<unsigned char*>(jobQueue[nPriorityLevel]) + nJobSlot * JobManager::SInfoBlock::scSizeOfJobQueueSlot);
+	}
+
 	//! Base of job queue per priority level.
-	JobManager::detail::SJobQueueSlotState* jobQueueStates[JobManager::eNumPriorityLevel];
+	JobManager::detail::SJobQueueSlotSequence* jobQueueStates[JobManager::eNumPriorityLevel];
 
 	//! Index use for job slot publishing each priority level is encoded in this single value.
 	volatile unsigned long long index;
@@ -673,6 +926,24 @@ struct _declspec(align(16)) SJobQueuePos
 		}
 	}
 
+	//! Bits of the index which belong to the priority level.
+	inline static unsigned long long GetIndexMask(unsigned int nPriorityLevel)
+	{
+		switch (nPriorityLevel)
+		{
+		case eHighPriority:
+			return eMaskHighPriority;
+		case eRegularPriority:
+			return eMaskRegularPriority;
+		case eLowPriority:
+			return eMaskLowPriority;
+		case eStreamPriority:
+			return eMaskStreamPriority;
+		default:
+			return 0;
+		}
+	}
+
 	inline static bool IncreasePullIndex(unsigned long long currentPullIndex, unsigned long long currentPushIndex, unsigned long long& rNewPullIndex, unsigned int& rPriorityLevel,
 	                                    unsigned int nJobQueueSizeHighPriority, unsigned int nJobQueueSizeRegularPriority, unsigned int nJobQueueSizeLowPriority, unsigned int nJobQueueSizeStreamPriority)
 	{
@@ -740,14 +1011,14 @@ struct _declspec(align(16)) SJobQueuePos
 		return true;
 	}
 
-	inline static unsigned long long IncreasePushIndex(unsigned long long currentPushIndex, unsigned int nPriorityLevel)
+	inline static unsigned long long IncreasePushIndex(unsigned long long currentPushIndex, unsigned int nPriorityLevel, unsigned int nCount = 1)
 	{
-		return IncreaseIndex(currentPushIndex, nPriorityLevel);
+		return IncreaseIndex(currentPushIndex, nPriorityLevel, nCount);
 	}
 
-	inline static unsigned long long IncreaseIndex(unsigned long long currentIndex, unsigned int nPriorityLevel)
+	inline static unsigned long long IncreaseIndex(unsigned long long currentIndex, unsigned int nPriorityLevel, unsigned int nCount = 1)
 	{
-		unsigned long long nIncrease = 1ULL;
+		unsigned long long nIncrease = nCount;
 		unsigned long long nMask = 0;
 		switch (nPriorityLevel)
 		{
@@ -774,7 +1045,7 @@ struct _declspec(align(16)) SJobQueuePos
 		// increase counter while preventing overflow
 		unsigned long long nCurrentValue = currentIndex & nMask;                        // extract all bits for this priority only
 		unsigned long long nCurrentValueCleared = currentIndex & ~nMask;                // extract all bits of other priorities (they shouldn't change)
-		nCurrentValue += nIncrease;                                         // increase value by one (already at the right bit position)
+		nCurrentValue += nIncrease;                                         // increase value by nCount (already at the right bit position)
 		nCurrentValue &= nMask;                                             // mask out again to handle overflow
 		unsigned long long nNewCurrentValue = nCurrentValueCleared | nCurrentValue;     // add new value to other priorities
 		return nNewCurrentValue;
@@ -799,6 +1070,14 @@ protected:
 	unsigned short nProfilerIndex;    //!< index handle for Jobmanager Profiling Data.
 };
 
+//! Absolute deadline nMicroSeconds from now, in the GetRealTicks units expected by CJobDelegator::SetDeadline.
+inline unsigned long long GetDeadlineFromNow(unsigned int nMicroSeconds)
+{
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	return (unsigned long long)GetRealTicks() + (unsigned long long)nMicroSeconds * (unsigned long long)freq.QuadPart / 1000000;
+}
+
 //! Delegation class for each job.
 class CJobDelegator : public CCommonDMABase
 {
@@ -838,14 +1117,24 @@ public:
 	void         SetPriorityLevel(unsigned int nPrioritylevel) { m_nPrioritylevel = nPrioritylevel; }
 	void         SetBlocking()                                 { m_bIsBlocking = true; }
 
-	void         SetLambda(const std::function<void()>& lambda)
-	{
-		m_lambda = lambda;
-	}
-	const std::function<void()>& GetLambda() const
-	{
-		return m_lambda;
-	}
+	//! Absolute deadline in GetRealTicks units, 0 if the job has none. See GetDeadlineFromNow.
+	unsigned long long GetDeadline() const                     { return m_nDeadlineTicks; }
+	void               SetDeadline(unsigned long long nDeadlineTicks) { m_nDeadlineTicks = nDeadlineTicks; }
+
+	//! Token to skip the job if it is cancelled before it starts, NULL for none.
+	const CJobCancellationToken* GetCancellationToken() const                              { return m_pCancellationToken; }
+	void                         SetCancellationToken(const CJobCancellationToken* pToken) { m_pCancellationToken = pToken; }
+
+	//! Run the invoker of a cancelled job anyway, for invokers which release the job parameters.
+	bool         IsInvokeOnCancel() const                      { return m_bInvokeOnCancel; }
+	void         SetInvokeOnCancel()                           { m_bInvokeOnCancel = true; }
+
+	//! Worker of the thread backend which has to run the job, eTW_AnyWorker by default.
+	//! Targeted jobs go into the inbox of the worker, which looks at it before the shared queues,
+	//! eTW_MainThread jobs are only run by PumpMainThreadJobs. Blocking jobs and ids of workers which don't exist
+	//! are treated like eTW_AnyWorker. Targeted jobs don't run on a fiber, waits inside them block the worker.
+	unsigned int GetTargetWorker() const                       { return m_nTargetWorker; }
+	void         SetTargetWorker(unsigned int nWorkerId)       { m_nTargetWorker = nWorkerId; }
 
 protected:
 	JobManager::SJobState*                m_pJobState;      //!< Extern job state.
@@ -855,7 +1144,10 @@ protected:
 	unsigned int                          m_ParamDataSize;  //!< Sizeof parameter struct.
 	unsigned long                              m_CurThreadID;    //!< Current thread id.
 	Invoker                               m_pGenericDelecator;
-	std::function<void()>                 m_lambda;
+	unsigned long long                    m_nDeadlineTicks; //!< Absolute deadline in GetRealTicks units, 0 for none.
+	const CJobCancellationToken*          m_pCancellationToken; //!< Token checked when the job is dequeued, NULL for none.
+	bool                                  m_bInvokeOnCancel; //!< If true, the invoker also runs for a cancelled job.
+	unsigned int                          m_nTargetWorker;  //!< Worker id, eTW_AnyWorker or eTW_MainThread.
 };
 
 //! Base class for jobs.
@@ -912,6 +1204,79 @@ protected:
 	}
 
 };
+
+//! Job running a lambda.
+//! Small trivially copyable closures are stored in the parameter block and copied with it into the job slot,
+//! all other closures are moved into a block of the job manager's closure pool which is returned after the call.
+class CJobLambda : public CJobBase
+{
+public:
+	template<typename TLambda>
+	CJobLambda(const char* jobName, TLambda&& lambda);
+
+	void SetPriorityLevel(unsigned int nPriorityLevel)
+	{
+		m_JobDelegator.SetPriorityLevel(nPriorityLevel);
+	}
+	void SetBlocking()
+	{
+		m_JobDelegator.SetBlocking();
+	}
+	void SetDeadline(unsigned long long nDeadlineTicks)
+	{
+		m_JobDelegator.SetDeadline(nDeadlineTicks);
+	}
+	void SetCancellationToken(const CJobCancellationToken* pToken)
+	{
+		m_JobDelegator.SetCancellationToken(pToken);
+	}
+	void SetTargetWorker(unsigned int nWorkerId)
+	{
+		m_JobDelegator.SetTargetWorker(nWorkerId);
+	}
+
+private:
+	//! Handle of the name last used with a closure type. Each lambda expression has its own closure type,
+	//! so this is a per call site cache which only looks up the registry when the call site passes another name.
+	template<typename TClosure>
+	static TJobHandle GetCachedJobHandle(const char* jobName);
+
+	//! Closure types which can be placed in the parameter block, they are copied with memcpy between info blocks.
+	template<typename TClosure>
+	struct SStoreInline
+	{
+		enum
+		{
+			value = sizeof(TClosure) <= SInfoBlock::scAvailParamSize && std::alignment_of<TClosure>::value <= 16 &&
+			        std::is_trivially_copyable<TClosure>::value
+		};
+	};
+
+	template<typename TClosure>
+	static void InvokeInline(void* pParam)
+	{
+		(*static_cast<TClosure*>(pParam))();
+	}
+
+	template<typename TClosure>
+	static void InvokePooled(void* pParam);
+
+	//! Only used to register the job name.
+	static void Invoke(void* p)
+	{
+	}
+
+	template<typename TClosure, typename TLambda>
+	void StoreClosure(TLambda&& lambda, std::true_type);
+	template<typename TClosure, typename TLambda>
+	void StoreClosure(TLambda&& lambda, std::false_type);
+
+public:
+	TJobHandle m_jobHandle;
+
+private:
+	_declspec(align(16)) unsigned char m_closureStorage[SInfoBlock::scAvailParamSize];
+};
 } // namespace JobManager
 
 // Interface of the JobManager.
@@ -960,13 +1325,48 @@ struct IJobManager
 	//! Add a job.
 	virtual void AddJob(JobManager::CJobDelegator& RESTRICT_REFERENCE crJob, const JobManager::TJobHandle cJobHandle) = 0;
 
+	//! Add a batch of jobs.
+	//! Queue slots for consecutive jobs of the same priority are reserved with one atomic operation
+	//! and the workers are woken with a single semaphore release instead of one per job.
+	virtual void AddJobs(JobManager::CJobBase* const* ppJobs, unsigned int nNumJobs) = 0;
+
 	//! Add a job as a lambda callback.
 	virtual void AddLambdaJob(const char* jobName, const std::function<void()>& lambdaCallback, TPriorityLevel priority = JobManager::eRegularPriority, SJobState* pJobState = nullptr) = 0;
 
+	//! Add a job as a lambda callback without wrapping it into a std::function.
+	//! Closures fitting into the job parameter block don't allocate memory.
+	template<typename TLambda>
+	void AddLambdaJob(const char* jobName, TLambda&& lambdaCallback, TPriorityLevel priority = JobManager::eRegularPriority, SJobState* pJobState = nullptr);
+
+	//! Add a lambda job which is submitted once the delay passed.
+	//! The job state is running from this call on, so waiting on it also waits for the delay.
+	virtual JobManager::TJobTimerHandle AddDelayedJob(unsigned int nDelayMilliSec, const char* jobName, const std::function<void()>& lambdaCallback, TPriorityLevel priority = JobManager::eRegularPriority, SJobState* pJobState = nullptr) = 0;
+
+	//! Add a lambda job which is submitted every period until the timer is cancelled.
+	virtual JobManager::TJobTimerHandle AddPeriodicJob(unsigned int nPeriodMilliSec, const char* jobName, const std::function<void()>& lambdaCallback, TPriorityLevel priority = JobManager::eRegularPriority) = 0;
+
+	//! Cancel a delayed or periodic job, returns false if the timer already fired or was cancelled.
+	//! A job submitted before the cancel still runs.
+	virtual bool CancelJobTimer(JobManager::TJobTimerHandle hTimer) = 0;
+
+	//! Allow timer jobs to be submitted up to this late so close expiries share one wakeup, 1 by default.
+	virtual void SetJobTimerSlack(unsigned int nSlackMilliSec) = 0;
+
+	//! Run the jobs queued for the main thread with eTW_MainThread on the calling thread, returns the number of jobs run.
+	//! Jobs added while pumping wait for the next call. With a budget the pump stops once it is used up, after at least one job.
+	virtual unsigned int PumpMainThreadJobs(unsigned int nBudgetMicroSec = 0) = 0;
+
 	//! Wait for a job, preempt the calling thread if the job is not done yet.
 	virtual const bool WaitForJob(JobManager::SJobState& rJobState) const = 0;
 
+	//! Wait until all job states stopped, the calling thread is parked once and woken by the last SetStopped.
+	virtual void WaitForAll(JobManager::SJobState* const* ppJobStates, unsigned int nNumJobStates) const = 0;
+
+	//! Wait until one of the job states stopped and return its index, the calling thread is woken by the first SetStopped.
+	virtual unsigned int WaitForAny(JobManager::SJobState* const* ppJobStates, unsigned int nNumJobStates) const = 0;
+
 	//! Obtain job handle from name.
+	//! Names already registered are found without locking, only the first lookup of a name takes the job manager lock.
 	virtual const JobManager::TJobHandle GetJobHandle(const char* cpJobName, const unsigned int cStrLen, JobManager::Invoker pInvoker) = 0;
 
 	//! Obtain job handle from name.
@@ -980,6 +1380,7 @@ struct IJobManager
 	virtual bool                           InvokeAsJob(const char* cJobHandle) const = 0;
 	virtual bool                           InvokeAsJob(const JobManager::TJobHandle cJobHandle) const = 0;
 
+	//! Comma separated names of jobs which run in the calling thread, the string is matched when set and when a job is registered.
 	virtual void                           SetJobFilter(const char* pFilter) = 0;
 	virtual void                           SetJobSystemEnabled(int nEnable) = 0;
 
@@ -1006,9 +1407,66 @@ struct IJobManager
 	//! Get the actual semaphore object for aquire/release calls.
 	virtual SJobFinishedConditionVariable* GetSemaphore(JobManager::TSemaphoreHandle nSemaphoreHandle, volatile const void* pOwner) = 0;
 
+	//! Get a 16 byte aligned block for a lambda closure which doesn't fit into the job parameter block.
+	virtual void* AllocateLambdaClosure(size_t nSize) = 0;
+
+	//! Return a block allocated with AllocateLambdaClosure to the pool, nSize has to match the allocation.
+	virtual void FreeLambdaClosure(void* pClosure, size_t nSize) = 0;
+
 	virtual void                           DumpJobList() = 0;
 
+	//! Select how the thread backend sizes its worker pool, has to be called before Init.
+	//! nSysMaxWorker passed to Init still clamps the resulting worker count.
+	virtual void                           SetWorkerPoolPolicy(JobManager::EWorkerPoolPolicy policy, unsigned int nReservedCores = 1, bool bPinWorkers = false) = 0;
+
+	//! CPU topology detected during Init.
+	virtual const JobManager::SCpuTopology&      GetCpuTopology() const = 0;
+
+	//! Worker layout the thread backend was created with.
+	virtual const JobManager::SWorkerPoolLayout& GetWorkerPoolLayout() const = 0;
+
+	//! Print the detected topology and the chosen worker layout.
+	virtual void                           DumpWorkerPoolLayout() = 0;
+
+	//! Set the number of slots of the global job queue for one priority level, has to be called before Init.
+	//! The size is rounded up to a power of two, jobs which don't fit go into a growable overflow queue.
+	//! On NUMA machines each node gets a queue of this size.
+	virtual void                           SetJobQueueCapacity(JobManager::TPriorityLevel priority, unsigned int nCapacity) = 0;
+
+	//! Capacity and peak usage of the global job queue.
+	virtual void                           GetJobQueueStats(JobManager::SJobQueueStats& rStats) const = 0;
+
+	//! Restart the peak occupancy, overflow and wait time counters.
+	virtual void                           ResetJobQueueStats() = 0;
+
+	//! Select how workers share their time between the priority levels, takes effect with the next job a worker takes.
+	//! The default is ePSP_Strict without aging, weights of 32/8/2/1 are preset for ePSP_WeightedFairShare.
+	virtual void                           SetPrioritySchedulingSettings(const JobManager::SPrioritySchedulingSettings& rSettings) = 0;
+	virtual const JobManager::SPrioritySchedulingSettings& GetPrioritySchedulingSettings() const = 0;
+
+	//! Select and tune how idle workers wait for new jobs, takes effect the next time a worker runs out of work.
+	//! The default is eWIP_Park, a spin and yield budget of 50us each is preset for eWIP_SpinThenPark.
+	virtual void                           SetWorkerIdleSettings(const JobManager::SWorkerIdleSettings& rSettings) = 0;
+	virtual const JobManager::SWorkerIdleSettings& GetWorkerIdleSettings() const = 0;
+
+	//! Wake latency and idle cpu cost of the workers, to balance latency against idle power.
+	virtual void                           GetWorkerIdleStats(JobManager::SWorkerIdleStats& rStats) const = 0;
+	virtual void                           ResetWorkerIdleStats() = 0;
+
+	//! Run the jobs of the thread backend on pooled fibers, has to be called before Init.
+	//! A job waiting on a job state then suspends its fiber and the worker continues with other jobs.
+	//! nFiberStackSize is the stack size of each fiber, 0 for the default, the stack size of the worker threads (256KB).
+	virtual void                           SetFiberMode(bool bEnable, unsigned int nFiberStackSize = 0) = 0;
+
+	//! Run the jobs of the thread backend which have a deadline earliest deadline first, ahead of the priority levels.
+	//! Blocking jobs and jobs without a deadline are not affected. Missed deadlines are reported by the IWorkerBackEndProfiler.
+	virtual void                           SetDeadlineScheduling(bool bEnable) = 0;
+	virtual bool                           IsDeadlineSchedulingEnabled() const = 0;
+
 	virtual void                           SetFrameStartTime(const CTimeValue& rFrameStartTime) = 0;
+
+	//! Returns true if the job running on the calling thread was cancelled, see CJobCancellationToken.
+	virtual bool                           IsCurrentJobCancelled() const = 0;
 };
 extern "C" JobManager::IJobManager* GetJobManagerInterface();
 //! Utility function to get the worker thread id in a job, returns 0xFFFFFFFF otherwise.
@@ -1018,6 +1476,12 @@ inline unsigned int GetWorkerThreadId()
 	return nWorkerThreadID == ~0 ? ~0 : (nWorkerThreadID & ~0x40000000);
 }
 
+//! Utility function for long running jobs to check if they were cancelled and should return early.
+inline bool IsJobCancelled()
+{
+	return GetJobManagerInterface()->IsCurrentJobCancelled();
+}
+
 //! Utility function to find out if a call comes from the mainthread or from a worker thread.
 inline bool IsWorkerThread()
 {
@@ -1070,6 +1534,81 @@ inline const bool SJobState::Wait()
 	return GetJobManagerInterface()->WaitForJob(*this);
 }
 
+/////////////////////////////////////////////////////////////////////////////
+template<typename TLambda>
+inline CJobLambda::CJobLambda(const char* jobName, TLambda&& lambda)
+{
+	typedef typename std::decay<TLambda>::type TClosure;
+
+	m_jobHandle = GetCachedJobHandle<TClosure>(jobName);
+	StoreClosure<TClosure>(std::forward<TLambda>(lambda), std::integral_constant<bool, SStoreInline<TClosure>::value>());
+	SetJobProgramData(m_jobHandle);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+template<typename TClosure>
+inline TJobHandle CJobLambda::GetCachedJobHandle(const char* jobName)
+{
+	// a handle keeps the name pointer it was registered with, call sites passing a string literal hit the cache
+	static TJobHandle volatile s_cachedJobHandle = NULL;
+	TJobHandle cachedJobHandle = s_cachedJobHandle;
+	if (cachedJobHandle != NULL && cachedJobHandle->cpString == jobName)
+		return cachedJobHandle;
+
+	cachedJobHandle = GetJobManagerInterface()->GetJobHandle(jobName, &Invoke);
+	s_cachedJobHandle = cachedJobHandle;
+	return cachedJobHandle;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+template<typename TClosure, typename TLambda>
+inline void CJobLambda::StoreClosure(TLambda&& lambda, std::true_type)
+{
+	new(m_closureStorage) TClosure(std::forward<TLambda>(lambda));
+	m_JobDelegator.SetJobParamData(m_closureStorage);
+	m_JobDelegator.SetParamDataSize((sizeof(TClosure) + 15) & ~15);
+	m_JobDelegator.SetDelegator(&InvokeInline<TClosure>);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+template<typename TClosure, typename TLambda>
+inline void CJobLambda::StoreClosure(TLambda&& lambda, std::false_type)
+{
+	static_assert(std::alignment_of<TClosure>::value <= 16, "lambda closure needs more than 16 byte alignment");
+
+	// only the pointer to the pooled closure is passed as parameter
+	void* pClosureMemory = GetJobManagerInterface()->AllocateLambdaClosure(sizeof(TClosure));
+	TClosure* pClosure = new(pClosureMemory) TClosure(std::forward<TLambda>(lambda));
+	memcpy(m_closureStorage, &pClosure, sizeof(pClosure));
+	m_JobDelegator.SetJobParamData(m_closureStorage);
+	m_JobDelegator.SetParamDataSize(16);
+	m_JobDelegator.SetDelegator(&InvokePooled<TClosure>);
+	m_JobDelegator.SetInvokeOnCancel();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+template<typename TClosure>
+inline void CJobLambda::InvokePooled(void* pParam)
+{
+	TClosure* pClosure = *static_cast<TClosure**>(pParam);
+	// a cancelled job only returns its closure block
+	if (!IsJobCancelled())
+		(*pClosure)();
+	pClosure->~TClosure();
+	GetJobManagerInterface()->FreeLambdaClosure(pClosure, sizeof(TClosure));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+template<typename TLambda>
+inline void IJobManager::AddLambdaJob(const char* jobName, TLambda&& lambdaCallback, TPriorityLevel priority, SJobState* pJobState)
+{
+	CJobLambda job(jobName, std::forward<TLambda>(lambdaCallback));
+	job.SetPriorityLevel(priority);
+	if (pJobState)
+		job.RegisterJobState(pJobState);
+	job.Run();
+}
+
 //! Interface of the Producer/Consumer Queue for JobManager.
 //! Producer - consumer queue.
 //! - All implemented inline using a template:.
@@ -1078,95 +1617,127 @@ inline const bool SJobState::Wait()
 //!     - Param type of job.
 //! - Factory with macro instantiating the queue (knowing the exact names for a job).
 //! - Queue consists of:.
-//!     - Ring buffer consists of 1 instance of param type of job.
-//!     - For atomic test on finished and push pointer update, the queue is 128 byte aligned and push, pull ptr and DMA job state are lying within that first 128 byte.
+//!     - Ring buffer of packets, each packet is followed by its SAddPacketData (job state, profiler and invoker index).
 //!     - Volatile push (only modified by producer) /pull (only modified by consumer) pointer, point to ring buffer, both equal in the beginning.
+//!     - Drain state, 1 while a job is scheduled to process the packets of the queue.
 //!     - Job instance (create with def. ctor).
-//!     - DMA job state (running, finished).
-//!     - AddPacket - method to add a packet.
+//!     - AddPacket/AddPackets - methods to add packets.
 //!         - Wait on current push/pull if any space is available.
-//!         - Need atomically test if a job is running and update the push pointer, if job is finished, start new job.
+//!         - Copy the packets, then publish them with a single store of the push pointer.
+//!         - The producer which switches the drain state from 0 to 1 starts the job, one job runs for any number of packets.
 //!     - Finished method, returns push==pull.
-//! Job producer side:
-//!     - provide RegisterProdConsumerQueue - method, set flags accordingly.
 //! Job side:
-//!     - Check if it has  a prod/consumer queue.
-//!     - If it is part of queue, it must obtain DMA address for job state and of push/pull (static offset to pointer).
-//!     - A flag tells if job state is job state or queue.
-//!     - Lock is obtained when current push/pull ptr is obtained, snooping therefore enabled.
-//!     - Before FlushCacheComplete, get next parameter packet if multiple packets needs to be processed.
-//!     - If all packets were processed, try to write updated pull pointer and set finished state. If it fails, push pointer was updated during processing time, in that case get lock again and with it the new push pointer.
-//!     - loop till the lock and finished state was updated successfully.
-//!     - no HandleCallback method, only 1 JOb is permitted to run with queue.
+//!     - Check if it has a prod/consumer queue.
+//!     - Process packets till the pull pointer caught up with the push pointer, the pull pointer is updated after each packet to free its slot.
+//!     - Once caught up, ContinueDrain resets the drain state and checks the push pointer again, it continues if packets were
+//!       added meanwhile and no producer has started a new job. Neither side needs to update state and push pointer in one atomic operation.
+//!     - no HandleCallback method, only 1 Job is permitted to run with queue.
 //!     - no write back to external job state, always just one inner packet loop.
+//! Only a single thread may add packets to a queue, a job draining the queue must not add packets to it.
 struct SProdConsQueueBase
 {
-	// Don't move the state and push ptr to another place in this struct - they are updated together with an atomic operation.
-	SJobSyncVariable               m_QueueRunningState;     //!< Waiting state of the queue.
-	void*                          m_pPush;                 //!< Push pointer, current ptr to push packets into (written by Producer.
+	SJobSyncVariable               m_QueueRunningState;     //!< Running while a drain job is scheduled, used by WaitFinished.
+	volatile LONG                  m_nDrainScheduled;       //!< 1 while a job is scheduled to drain the queue.
+	void* volatile                 m_pPush;                 //!< Push pointer, current ptr to push packets into (written by Producer).
 
-	volatile void*                 m_pPull;                 //!< Pull pointer, current ptr to pull packets from (written by Consumer).
-	_declspec(align(16)) unsigned int m_PullIncrement;                   //!< Increment of pull.
-	unsigned int                         m_AddPacketDataOffset;   //!< Offset of additional data relative to push ptr.
+	_declspec(align(64)) volatile void* m_pPull;            //!< Pull pointer, current ptr to pull packets from (written by Consumer), not sharing a cache line with the producer side.
+	unsigned int                   m_PullIncrement;         //!< Increment of pull.
+	unsigned int                   m_AddPacketDataOffset;   //!< Offset of additional data relative to push ptr.
 	INT_PTR                        m_RingBufferStart;       //!< Start of ring buffer.
 	INT_PTR                        m_RingBufferEnd;         //!< End of ring buffer.
-	SJobFinishedConditionVariable* m_pQueueFullSemaphore;   //!< Semaphore used for yield-waiting when the queue is full.
 
 	SProdConsQueueBase();
+
+	//! Called by the draining job once its pull pointer caught up with the push pointer.
+	//! Returns true if packets were added meanwhile and the job has to continue, else the job must stop the queue state and return.
+	bool ContinueDrain();
 };
 
 //! Utility functions namespace for the producer consumer queue.
 namespace ProdConsQueueBase
 {
-inline INT_PTR MarkPullPtrThatWeAreWaitingOnASemaphore(INT_PTR nOrgValue) { assert((nOrgValue & 1) == 0); return nOrgValue | 1; }
-inline bool    IsPullPtrMarked(INT_PTR nOrgValue)                         { return (nOrgValue & 1) == 1; }
+//! Orders the packet stores before the push pointer store and the push pointer load before the packet loads.
+//! x86/x64 don't reorder stores with stores or loads with loads, only the compiler has to be kept from doing it.
+inline void PacketBarrier()
+{
+#if ANGELICA_PLATFORM_X86 || ANGELICA_PLATFORM_X64
+	MEMORY_RW_REORDERING_BARRIER;
+#else
+	MemoryBarrier();
+#endif
+}
 }
 
-//template<class TJobType, unsigned int Size>
-//class _declspec(align(128)) CProdConsQueue: public SProdConsQueueBase
-//{
-//public:
-//	CProdConsQueue();
-//	~CProdConsQueue();
-//
-//	//! Add a new parameter packet with different job type (job invocation).
-//	template<class TAnotherJobType>
-//	void AddPacket
-//	(
-//	  const typename TJobType::packet & crPacket,
-//	  JobManager::TPriorityLevel nPriorityLevel,
-//	  TAnotherJobType * pJobParam,
-//	  bool differentJob = true
-//	);
-//
-//	//! Adds a new parameter packet (job invocation).
-//	void AddPacket
-//	(
-//	  const typename TJobType::packet & crPacket,
-//	  JobManager::TPriorityLevel nPriorityLevel = JobManager::eRegularPriority
-//	);
-//
-//	//! Wait til all current jobs have been finished and been processed.
-//	void WaitFinished();
-//
-//	//! Returns true if queue is empty.
-//	bool IsEmpty();
-//
-//private:
-//	//! Initializes queue.
-//	void Init(const unsigned int cPacketSize);
-//
-//	//! Get incremented pointer, takes care of wrapping.
-//	void* const GetIncrementedPointer();
-//
-//	//! The ring buffer.
-//	_declspec(align(128)) void* m_pRingBuffer;
-//
-//	//! Job instance.
-//	TJobType m_JobInstance;
-//	int m_Initialized;
-//
-//};
+template<class TJobType, unsigned int Size>
+class _declspec(align(128)) CProdConsQueue: public SProdConsQueueBase
+{
+public:
+	CProdConsQueue();
+	~CProdConsQueue();
+
+	//! Add a new parameter packet with different job type (job invocation).
+	template<class TAnotherJobType>
+	void AddPacket
+	(
+	  const typename TJobType::packet & crPacket,
+	  JobManager::TPriorityLevel nPriorityLevel,
+	  TAnotherJobType * pJobParam,
+	  bool differentJob = true
+	);
+
+	//! Adds a new parameter packet (job invocation).
+	void AddPacket
+	(
+	  const typename TJobType::packet & crPacket,
+	  JobManager::TPriorityLevel nPriorityLevel = JobManager::eRegularPriority
+	);
+
+	//! Adds nCount packets, they are published together and at most one job is started for them.
+	void AddPackets
+	(
+	  const typename TJobType::packet * pPackets,
+	  unsigned int nCount,
+	  JobManager::TPriorityLevel nPriorityLevel = JobManager::eRegularPriority
+	);
+
+	//! Wait til all current jobs have been finished and been processed.
+	void WaitFinished();
+
+	//! Returns true if queue is empty.
+	bool IsEmpty();
+
+private:
+	//! Initializes queue.
+	void Init(const unsigned int cPacketSize);
+
+	//! Get incremented pointer, takes care of wrapping.
+	void* const GetIncrementedPointer(void* const cpPushPtr) const;
+
+	//! Returns true if cpNextPushPtr would overtake the pull ptr, reloads the pull ptr only if its cached copy says so.
+	bool IsFull(void* const cpNextPushPtr);
+
+	//! Wait for the drain job to free the slot in front of cpNextPushPtr.
+	void WaitForFreeSlot(void* const cpNextPushPtr);
+
+	//! Copy a packet into the slot at cpPushPtr.
+	template<class TAnotherJobType>
+	void WritePacket(void* const cpPushPtr, const typename TJobType::packet& crPacket, TAnotherJobType* pJobParam);
+
+	//! Make all packets up to cpNextPushPtr visible and start the drain job if none is scheduled.
+	template<class TAnotherJobType>
+	void PublishPackets(void* const cpNextPushPtr, JobManager::TPriorityLevel nPriorityLevel, TAnotherJobType* pJobParam);
+
+	//! The ring buffer.
+	_declspec(align(128)) void* m_pRingBuffer;
+
+	//! Copy of the pull ptr owned by the producer, saves reading the consumer's cache line for each packet.
+	void* m_pPullCache;
+
+	//! Job instance.
+	TJobType m_JobInstance;
+	int m_Initialized;
+
+};
 
 //! Interface to track BackEnd worker utilisation and job execution timings.
 class IWorkerBackEndProfiler
@@ -1198,6 +1769,12 @@ public:
 	//! Record execution information for a registered job.
 	virtual void RecordJob(const unsigned short profileIndex, const unsigned char workerId, const unsigned int jobId, const unsigned int runTimeMicroSec) = 0;
 
+	//! Record a queued job which was skipped because it was cancelled.
+	virtual void RecordCancelledJob(const unsigned short profileIndex, const unsigned int jobId) = 0;
+
+	//! Record the completion of a job with a deadline, negative lateness if it finished in time.
+	virtual void RecordDeadline(const unsigned short profileIndex, const unsigned int jobId, const int latenessMicroSec) = 0;
+
 	//! Get worker frame stats.
 	virtual void GetFrameStats(JobManager::CWorkerFrameStats& rStats) const = 0;
 	virtual void GetFrameStats(TJobFrameStatsContainer& rJobStats, EJobSortOrder jobSortOrder) const = 0;
@@ -1207,6 +1784,9 @@ public:
 	virtual void GetFrameStatsSummary(SWorkerFrameStatsSummary& rStats) const = 0;
 	virtual void GetFrameStatsSummary(SJobFrameStatsSummary& rStats) const = 0;
 
+	//! Get deadline stats of the last frame.
+	virtual void GetDeadlineStats(SJobDeadlineStats& rStats) const = 0;
+
 	//! Returns the index of the active multi-buffered profile data.
 	virtual unsigned short GetProfileIndex() const = 0;
 
@@ -1233,260 +1813,256 @@ extern "C"
 }
 
 //! Implementation of Producer Consumer functions.
-//! Currently adding jobs to a producer/consumer queue is not supported.
-//template<class TJobType, unsigned int Size>
-//inline JobManager::CProdConsQueue<TJobType, Size>::~CProdConsQueue()
-//{
-//	if (m_pRingBuffer)
-//		_aligned_free(m_pRingBuffer);
-//}
+template<class TJobType, unsigned int Size>
+inline JobManager::CProdConsQueue<TJobType, Size>::~CProdConsQueue()
+{
+	assert(!m_QueueRunningState.IsRunning());
+	if (m_pRingBuffer)
+		_aligned_free(m_pRingBuffer);
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 inline JobManager::SProdConsQueueBase::SProdConsQueueBase() :
-	m_pPush(NULL), m_pPull(NULL), m_PullIncrement(0), m_AddPacketDataOffset(0),
-	m_RingBufferStart(0), m_RingBufferEnd(0), m_pQueueFullSemaphore(NULL)
+	m_nDrainScheduled(0), m_pPush(NULL), m_pPull(NULL), m_PullIncrement(0), m_AddPacketDataOffset(0),
+	m_RingBufferStart(0), m_RingBufferEnd(0)
 {
 
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-//template<class TJobType, unsigned int Size>
-//inline JobManager::CProdConsQueue<TJobType, Size>::CProdConsQueue() : m_Initialized(0), m_pRingBuffer(NULL)
-//{
-//	assert(Size > 2);
-//	m_JobInstance.RegisterQueue(this);
-//}
+inline bool JobManager::SProdConsQueueBase::ContinueDrain()
+{
+	// leave the queue first, a producer publishing from now on starts a new job
+	AngelicaInterlockedExchange(&m_nDrainScheduled, 0);
+
+	// the exchange is a full barrier, a push ptr stored before the producer read the drain state is seen here
+	IF (m_pPush == m_pPull, 1)
+		return false;
+
+	// packets were added meanwhile, continue unless their producer already started a new job for them
+	return AngelicaInterlockedCompareExchange(&m_nDrainScheduled, 1, 0) == 0;
+}
 
 ///////////////////////////////////////////////////////////////////////////////
-//template<class TJobType, unsigned int Size>
-//inline void JobManager::CProdConsQueue<TJobType, Size >::Init(const unsigned int cPacketSize)
-//{
-//	assert((cPacketSize & 15) == 0);
-//	m_AddPacketDataOffset = cPacketSize;
-//	m_PullIncrement = m_AddPacketDataOffset + sizeof(SAddPacketData);
-//	m_pRingBuffer = _aligned_malloc(Size * m_PullIncrement, 128);
-//
-//	assert(m_pRingBuffer);
-//	m_pPush = m_pRingBuffer;
-//	m_pPull = m_pRingBuffer;
-//	m_RingBufferStart = (INT_PTR)m_pRingBuffer;
-//	m_RingBufferEnd = m_RingBufferStart + Size * m_PullIncrement;
-//	m_Initialized = 1;
-//	((TJobType*)&m_JobInstance)->SetParamDataSize(cPacketSize);
-//	m_pQueueFullSemaphore = NULL;
-//}
-//
-/////////////////////////////////////////////////////////////////////////////////
-//template<class TJobType, unsigned int Size>
-//inline void JobManager::CProdConsQueue<TJobType, Size >::WaitFinished()
-//{
-//	m_QueueRunningState.Wait();
-//	// ensure that the pull ptr is set right
-//	assert(m_pPull == m_pPush);
-//
-//}
-//
-/////////////////////////////////////////////////////////////////////////////////
-//template<class TJobType, unsigned int Size>
-//inline bool JobManager::CProdConsQueue<TJobType, Size >::IsEmpty()
-//{
-//	return (INT_PTR)m_pPush == (INT_PTR)m_pPull;
-//}
-//
-/////////////////////////////////////////////////////////////////////////////////
-//template<class TJobType, unsigned int Size>
-//inline void* const JobManager::CProdConsQueue<TJobType, Size >::GetIncrementedPointer()
-//{
-//	//returns branch free the incremented wrapped aware param pointer
-//	INT_PTR cNextPtr = (INT_PTR)m_pPush + m_PullIncrement;
-//#if ANGELICA_PLATFORM_64BIT
-//	if ((INT_PTR)cNextPtr >= (INT_PTR)m_RingBufferEnd) cNextPtr = (INT_PTR)m_RingBufferStart;
-//	return (void*)cNextPtr;
-//#else
-//	const unsigned int cNextPtrMask = (unsigned int)(((int)(cNextPtr - m_RingBufferEnd)) >> 31);
-//	return (void*)(cNextPtr & cNextPtrMask | m_RingBufferStart & ~cNextPtrMask);
-//#endif
-//}
-//
-/////////////////////////////////////////////////////////////////////////////////
-//template<class TJobType, unsigned int Size>
-//inline void JobManager::CProdConsQueue<TJobType, Size >::AddPacket
-//(
-//  const typename TJobType::packet& crPacket,
-//  JobManager::TPriorityLevel nPriorityLevel
-//)
-//{
-//	AddPacket<TJobType>(crPacket, nPriorityLevel, (TJobType*)&m_JobInstance, false);
-//}
+template<class TJobType, unsigned int Size>
+inline JobManager::CProdConsQueue<TJobType, Size>::CProdConsQueue() : m_pRingBuffer(NULL), m_pPullCache(NULL), m_Initialized(0)
+{
+	assert(Size > 2);
+	m_JobInstance.RegisterQueue(this);
+}
 
 ///////////////////////////////////////////////////////////////////////////////
-//template<class TJobType, unsigned int Size>
-//template<class TAnotherJobType>
-//inline void JobManager::CProdConsQueue<TJobType, Size >::AddPacket
-//(
-//  const typename TJobType::packet& crPacket,
-//  JobManager::TPriorityLevel nPriorityLevel,
-//  TAnotherJobType* pJobParam,
-//  bool differentJob
-//)
-//{
-//	const unsigned int cPacketSize = crPacket.GetPacketSize();
-//	IF (m_Initialized == 0,0)
-//		Init(cPacketSize);
-//
-//	assert(m_RingBufferEnd == m_RingBufferStart + Size * (cPacketSize + sizeof(SAddPacketData)));
-//
-//	const void* const cpCurPush = m_pPush;
-//
-//	// don't overtake the pull ptr
-//
-//	SJobSyncVariable curQueueRunningState = m_QueueRunningState;
-//	IF ((cpCurPush == m_pPull) && (curQueueRunningState.IsRunning()), 0)
-//	{
-//
-//		INT_PTR nPushPtr = (INT_PTR)cpCurPush;
-//		INT_PTR markedPushPtr = JobManager::ProdConsQueueBase::MarkPullPtrThatWeAreWaitingOnASemaphore(nPushPtr);
-//		TSemaphoreHandle nSemaphoreHandle = GetJobManagerInterface()->AllocateSemaphore(this);
-//		m_pQueueFullSemaphore = GetJobManagerInterface()->GetSemaphore(nSemaphoreHandle, this);
-//
-//		bool bNeedSemaphoreWait = false;
-//#if ANGELICA_PLATFORM_64BIT // for 64 bit, we need to atomicly swap 128 bit
-//		long long compareValue[2] = { *alias_cast<long long*>(&curQueueRunningState), (long long)nPushPtr };
-//		AngelicaInterlockedCompareExchange128((volatile long long*)this, (long long)markedPushPtr, *alias_cast<long long*>(&curQueueRunningState), compareValue);
-//		// make sure nobody set the state to stopped in the meantime
-//		bNeedSemaphoreWait = (compareValue[0] == *alias_cast<long long*>(&curQueueRunningState) && compareValue[1] == (long long)nPushPtr);
-//#else
-//		// union used to construct 64 bit value for atomic updates
-//		union T64BitValue
-//		{
-//			long long doubleWord;
-//			struct
-//			{
-//				unsigned int word0;
-//				unsigned int word1;
-//			};
-//		};
-//
-//		// job system is process the queue right now, we need an atomic update
-//		T64BitValue compareValue;
-//		compareValue.word0 = *alias_cast<unsigned int*>(&curQueueRunningState);
-//		compareValue.word1 = (unsigned int)nPushPtr;
-//
-//		T64BitValue exchangeValue;
-//		exchangeValue.word0 = *alias_cast<unsigned int*>(&curQueueRunningState);
-//		exchangeValue.word1 = (unsigned int)markedPushPtr;
-//
-//		T64BitValue resultValue;
-//		resultValue.doubleWord = AngelicaInterlockedCompareExchange64((volatile long long*)this, exchangeValue.doubleWord, compareValue.doubleWord);
-//
-//		bNeedSemaphoreWait = (resultValue.word0 == *alias_cast<unsigned int*>(&curQueueRunningState) && resultValue.word1 == nPushPtr);
-//#endif
-//
-//		// C-A-S successful, now we need to do a yield-wait
-//		IF (bNeedSemaphoreWait, 0)
-//			m_pQueueFullSemaphore->Acquire();
-//		else
-//			m_pQueueFullSemaphore->SetStopped();
-//
-//		GetJobManagerInterface()->DeallocateSemaphore(nSemaphoreHandle, this);
-//		m_pQueueFullSemaphore = NULL;
-//	}
-//
-//	if (crPacket.GetJobStateAddress())
-//	{
-//		JobManager::SJobState* pJobState = reinterpret_cast<JobManager::SJobState*>(crPacket.GetJobStateAddress());
-//		pJobState->SetRunning();
-//	}
-//
-//	//get incremented push pointer and check if there is a slot to push it into
-//	void* const cpNextPushPtr = GetIncrementedPointer();
-//
-//	const SVEC4_UINT* __restrict pPacketCont = crPacket.GetPacketCont();
-//	SVEC4_UINT* __restrict pPushCont = (SVEC4_UINT*)cpCurPush;
-//
-//	//copy packet data
-//	const unsigned int cIters = cPacketSize >> 4;
-//	for (unsigned int i = 0; i < cIters; ++i)
-//		pPushCont[i] = pPacketCont[i];
-//
-//	// setup addpacket data for Jobs
-//	SAddPacketData* const __restrict pAddPacketData = (SAddPacketData*)((unsigned char*)cpCurPush + m_AddPacketDataOffset);
-//	pAddPacketData->pJobState = crPacket.GetJobStateAddress();
-//
-//#if defined(JOBMANAGER_SUPPORT_PROFILING)
-//	SJobProfilingData* pJobProfilingData = GetJobManagerInterface()->GetProfilingData(crPacket.GetProfilerIndex());
-//	pJobProfilingData->jobHandle = pJobParam->GetJobProgramData();
-//	pAddPacketData->profilerIndex = crPacket.GetProfilerIndex();
-//	if (pAddPacketData->pJobState) // also store profilerindex in syncvar, so be able to record wait times
-//	{
-//		pAddPacketData->pJobState->nProfilerIndex = pAddPacketData->profilerIndex;
-//	}
-//#endif
-//
-//	// set invoker, for the case the the job changes within the queue
-//	pAddPacketData->nInvokerIndex = pJobParam->GetProgramHandle()->nJobInvokerIdx;
-//
-//	// new job queue, or empty job queue
-//	if (!m_QueueRunningState.IsRunning())
-//	{
-//		m_pPush = cpNextPushPtr;//make visible
-//		m_QueueRunningState.SetRunning();
-//
-//		pJobParam->RegisterQueue(this);
-//		pJobParam->SetParamDataSize(((TJobType*)&m_JobInstance)->GetParamDataSize());
-//		pJobParam->SetPriorityLevel(nPriorityLevel);
-//		pJobParam->Run();
-//
-//		return;
-//	}
-//
-//	bool bAtomicSwapSuccessfull = false;
-//	JobManager::SJobSyncVariable newSyncVar;
-//	newSyncVar.SetRunning();
-//#if ANGELICA_PLATFORM_64BIT // for 64 bit, we need to atomicly swap 128 bit
-//	long long compareValue[2] = { *alias_cast<long long*>(&newSyncVar), (long long)cpCurPush };
-//	AngelicaInterlockedCompareExchange128((volatile long long*)this, (long long)cpNextPushPtr, *alias_cast<long long*>(&newSyncVar), compareValue);
-//	// make sure nobody set the state to stopped in the meantime
-//	bAtomicSwapSuccessfull = (compareValue[0] > 0);
-//#else
-//	// union used to construct 64 bit value for atomic updates
-//	union T64BitValue
-//	{
-//		long long doubleWord;
-//		struct
-//		{
-//			unsigned int word0;
-//			unsigned int word1;
-//		};
-//	};
-//
-//	// job system is process the queue right now, we need an atomic update
-//	T64BitValue compareValue;
-//	compareValue.word0 = *alias_cast<unsigned int*>(&newSyncVar);
-//	compareValue.word1 = (unsigned int)(TRUNCATE_PTR)cpCurPush;
-//
-//	T64BitValue exchangeValue;
-//	exchangeValue.word0 = *alias_cast<unsigned int*>(&newSyncVar);
-//	exchangeValue.word1 = (unsigned int)(TRUNCATE_PTR)cpNextPushPtr;
-//
-//	T64BitValue resultValue;
-//	resultValue.doubleWord = AngelicaInterlockedCompareExchange64((volatile long long*)this, exchangeValue.doubleWord, compareValue.doubleWord);
-//
-//	bAtomicSwapSuccessfull = (resultValue.word0 > 0);
-//#endif
-//
-//	// job system finished in the meantime, next to issue a new job
-//	if (!bAtomicSwapSuccessfull)
-//	{
-//		m_pPush = cpNextPushPtr;//make visible
-//		m_QueueRunningState.SetRunning();
-//
-//		pJobParam->RegisterQueue(this);
-//		pJobParam->SetParamDataSize(((TJobType*)&m_JobInstance)->GetParamDataSize());
-//		pJobParam->SetPriorityLevel(nPriorityLevel);
-//		pJobParam->Run();
-//	}
-//}
+template<class TJobType, unsigned int Size>
+inline void JobManager::CProdConsQueue<TJobType, Size >::Init(const unsigned int cPacketSize)
+{
+	assert((cPacketSize & 15) == 0);
+	m_AddPacketDataOffset = cPacketSize;
+	m_PullIncrement = m_AddPacketDataOffset + sizeof(SAddPacketData);
+	m_pRingBuffer = _aligned_malloc(Size * m_PullIncrement, 128);
+
+	assert(m_pRingBuffer);
+	m_pPush = m_pRingBuffer;
+	m_pPull = m_pRingBuffer;
+	m_pPullCache = m_pRingBuffer;
+	m_RingBufferStart = (INT_PTR)m_pRingBuffer;
+	m_RingBufferEnd = m_RingBufferStart + Size * m_PullIncrement;
+	m_Initialized = 1;
+	((TJobType*)&m_JobInstance)->SetParamDataSize(cPacketSize);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template<class TJobType, unsigned int Size>
+inline void JobManager::CProdConsQueue<TJobType, Size >::WaitFinished()
+{
+	m_QueueRunningState.Wait();
+	// ensure that the pull ptr is set right
+	assert(m_pPull == m_pPush);
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template<class TJobType, unsigned int Size>
+inline bool JobManager::CProdConsQueue<TJobType, Size >::IsEmpty()
+{
+	return (INT_PTR)m_pPush == (INT_PTR)m_pPull;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template<class TJobType, unsigned int Size>
+inline void* const JobManager::CProdConsQueue<TJobType, Size >::GetIncrementedPointer(void* const cpPushPtr) const
+{
+	//returns branch free the incremented wrapped aware param pointer
+	INT_PTR cNextPtr = (INT_PTR)cpPushPtr + m_PullIncrement;
+#if ANGELICA_PLATFORM_64BIT
+	if ((INT_PTR)cNextPtr >= (INT_PTR)m_RingBufferEnd) cNextPtr = (INT_PTR)m_RingBufferStart;
+	return (void*)cNextPtr;
+#else
+	const unsigned int cNextPtrMask = (unsigned int)(((int)(cNextPtr - m_RingBufferEnd)) >> 31);
+	return (void*)(cNextPtr & cNextPtrMask | m_RingBufferStart & ~cNextPtrMask);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template<class TJobType, unsigned int Size>
+inline bool JobManager::CProdConsQueue<TJobType, Size >::IsFull(void* const cpNextPushPtr)
+{
+	IF (cpNextPushPtr != m_pPullCache, 1)
+		return false;
+
+	m_pPullCache = (void*)m_pPull;
+	return cpNextPushPtr == m_pPullCache;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template<class TJobType, unsigned int Size>
+inline void JobManager::CProdConsQueue<TJobType, Size >::WaitForFreeSlot(void* const cpNextPushPtr)
+{
+	// the queue is full, so all its packets are published and a drain job is scheduled
+	// spin shortly, then give the worker running it the core in case it shares it with the producer
+	unsigned int nSpins = 0;
+	while (IsFull(cpNextPushPtr))
+	{
+		if (++nSpins < 64)
+			YieldProcessor();
+		else
+			SwitchToThread();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template<class TJobType, unsigned int Size>
+inline void JobManager::CProdConsQueue<TJobType, Size >::AddPacket
+(
+  const typename TJobType::packet& crPacket,
+  JobManager::TPriorityLevel nPriorityLevel
+)
+{
+	AddPacket<TJobType>(crPacket, nPriorityLevel, (TJobType*)&m_JobInstance, false);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template<class TJobType, unsigned int Size>
+template<class TAnotherJobType>
+inline void JobManager::CProdConsQueue<TJobType, Size >::AddPacket
+(
+  const typename TJobType::packet& crPacket,
+  JobManager::TPriorityLevel nPriorityLevel,
+  TAnotherJobType* pJobParam,
+  bool differentJob
+)
+{
+	IF (m_Initialized == 0, 0)
+		Init(crPacket.GetPacketSize());
+
+	void* const cpCurPush = m_pPush;
+	void* const cpNextPushPtr = GetIncrementedPointer(cpCurPush);
+
+	// don't overtake the pull ptr
+	IF (IsFull(cpNextPushPtr), 0)
+		WaitForFreeSlot(cpNextPushPtr);
+
+	WritePacket(cpCurPush, crPacket, pJobParam);
+	PublishPackets(cpNextPushPtr, nPriorityLevel, pJobParam);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template<class TJobType, unsigned int Size>
+inline void JobManager::CProdConsQueue<TJobType, Size >::AddPackets
+(
+  const typename TJobType::packet* pPackets,
+  unsigned int nCount,
+  JobManager::TPriorityLevel nPriorityLevel
+)
+{
+	IF (nCount == 0, 0)
+		return;
+
+	IF (m_Initialized == 0, 0)
+		Init(pPackets[0].GetPacketSize());
+
+	TJobType* pJobParam = (TJobType*)&m_JobInstance;
+	void* cpCurPush = m_pPush;
+	for (unsigned int i = 0; i < nCount; ++i)
+	{
+		void* const cpNextPushPtr = GetIncrementedPointer(cpCurPush);
+
+		IF (IsFull(cpNextPushPtr), 0)
+		{
+			// the drain job can only free slots of published packets
+			if (cpCurPush != m_pPush)
+				PublishPackets(cpCurPush, nPriorityLevel, pJobParam);
+			WaitForFreeSlot(cpNextPushPtr);
+		}
+
+		WritePacket(cpCurPush, pPackets[i], pJobParam);
+		cpCurPush = cpNextPushPtr;
+	}
+
+	PublishPackets(cpCurPush, nPriorityLevel, pJobParam);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template<class TJobType, unsigned int Size>
+template<class TAnotherJobType>
+inline void JobManager::CProdConsQueue<TJobType, Size >::WritePacket(void* const cpPushPtr, const typename TJobType::packet& crPacket, TAnotherJobType* pJobParam)
+{
+	const unsigned int cPacketSize = crPacket.GetPacketSize();
+	assert(m_RingBufferEnd == m_RingBufferStart + Size * (cPacketSize + sizeof(SAddPacketData)));
+
+	if (crPacket.GetJobStateAddress())
+	{
+		JobManager::SJobState* pJobState = reinterpret_cast<JobManager::SJobState*>(crPacket.GetJobStateAddress());
+		pJobState->SetRunning();
+	}
+
+	const SVEC4_UINT* __restrict pPacketCont = crPacket.GetPacketCont();
+	SVEC4_UINT* __restrict pPushCont = (SVEC4_UINT*)cpPushPtr;
+
+	//copy packet data
+	const unsigned int cIters = cPacketSize >> 4;
+	for (unsigned int i = 0; i < cIters; ++i)
+		pPushCont[i] = pPacketCont[i];
+
+	// setup addpacket data for Jobs
+	SAddPacketData* const __restrict pAddPacketData = (SAddPacketData*)((unsigned char*)cpPushPtr + m_AddPacketDataOffset);
+	pAddPacketData->pJobState = crPacket.GetJobStateAddress();
+
+#if defined(JOBMANAGER_SUPPORT_PROFILING)
+	SJobProfilingData* pJobProfilingData = GetJobManagerInterface()->GetProfilingData(crPacket.GetProfilerIndex());
+	pJobProfilingData->jobHandle = pJobParam->GetJobProgramData();
+	pAddPacketData->profilerIndex = crPacket.GetProfilerIndex();
+	if (pAddPacketData->pJobState) // also store profilerindex in syncvar, so be able to record wait times
+	{
+		pAddPacketData->pJobState->nProfilerIndex = pAddPacketData->profilerIndex;
+	}
+#endif
+
+	// set invoker, for the case the the job changes within the queue
+	pAddPacketData->nInvokerIndex = pJobParam->GetProgramHandle()->nJobInvokerIdx;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template<class TJobType, unsigned int Size>
+template<class TAnotherJobType>
+inline void JobManager::CProdConsQueue<TJobType, Size >::PublishPackets(void* const cpNextPushPtr, JobManager::TPriorityLevel nPriorityLevel, TAnotherJobType* pJobParam)
+{
+	// the packets have to be complete before the drain job can see them
+	ProdConsQueueBase::PacketBarrier();
+	m_pPush = cpNextPushPtr;
+
+	// the interlocked operation orders the push ptr store before the read of the drain state,
+	// so a job leaving the queue meanwhile either sees the new packets or we see it has left
+	IF (AngelicaInterlockedCompareExchange(&m_nDrainScheduled, 1, 0) != 0, 1)
+		return;
+
+	// new job queue, or empty job queue
+	m_QueueRunningState.SetRunning();
+
+	pJobParam->RegisterQueue(this);
+	pJobParam->SetParamDataSize(((TJobType*)&m_JobInstance)->GetParamDataSize());
+	pJobParam->SetPriorityLevel(nPriorityLevel);
+	pJobParam->Run();
+}
 
 //! CCommonDMABase Function implementations.
 inline JobManager::CCommonDMABase::CCommonDMABase()
@@ -1527,6 +2103,10 @@ inline JobManager::CJobDelegator::CJobDelegator() : m_ParamDataSize(0), m_CurThr
 	m_pJobState = NULL;
 	m_nPrioritylevel = JobManager::eRegularPriority;
 	m_bIsBlocking = false;
+	m_nDeadlineTicks = 0;
+	m_pCancellationToken = NULL;
+	m_bInvokeOnCancel = false;
+	m_nTargetWorker = JobManager::eTW_AnyWorker;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1611,85 +2191,89 @@ inline bool JobManager::SJobSyncVariable::IsRunning() const volatile
 /////////////////////////////////////////////////////////////////////////////////
 inline void JobManager::SJobSyncVariable::Wait() volatile
 {
-	if (syncVar.wordValue == 0)
-		return;
-
-	IJobManager* pJobManager = GetJobManagerInterface();
-
 	SyncVar currentValue;
 	SyncVar newValue;
-	SyncVar resValue;
-	TSemaphoreHandle semaphoreHandle = GetJobManagerInterface()->AllocateSemaphore(this);
-
-retry:
-	// volatile read
-	currentValue.wordValue = syncVar.wordValue;
 
-	if (currentValue.wordValue != 0)
+	for (;; )
 	{
-		// there is already a semaphore, wait for this one
-		if (currentValue.semaphoreHandle)
-		{
-			// prevent the following race condition: Thread A Gets the semaphore and waits, then Thread B fails the earlier C-A-S
-			// thus will wait for the same semaphore, but Thread A already release the semaphore and now another Thread (could even be A again)
-			// is using the same semaphore to wait for the job (executed by thread B) which waits for the samephore -> Deadlock
-			// this works since the jobmanager semphore function internally are using locks
-			// so if the following line succeeds, we got the lock before the release and have increased the use counter
-			// if not, it means that thread A release the semaphore, which also means thread B doesn't have to wait anymore
-
-			if (pJobManager->AddRefSemaphore(currentValue.semaphoreHandle, this))
-			{
-				pJobManager->GetSemaphore(currentValue.semaphoreHandle, this)->Acquire();
-				pJobManager->DeallocateSemaphore(currentValue.semaphoreHandle, this);
-			}
-		}
-		else // no semaphore found
+		// volatile read
+		currentValue.wordValue = syncVar.wordValue;
+
+		// no job running and no SetStopped in flight which still has to wake us
+		if (currentValue.wordValue == 0)
+			return;
+
+		// register as waiter, only possible while jobs are running, else SetStopped is already about to wake us
+		if (currentValue.nRunningCounter != 0 && currentValue.nWaiterFlag == 0)
 		{
 			newValue = currentValue;
-			newValue.semaphoreHandle = semaphoreHandle;
-			resValue.wordValue = AngelicaInterlockedCompareExchange((volatile LONG*)&syncVar.wordValue, newValue.wordValue, currentValue.wordValue);
+			newValue.nWaiterFlag = 1;
+			if ((unsigned int)AngelicaInterlockedCompareExchange((volatile LONG*)&syncVar.wordValue, newValue.wordValue, currentValue.wordValue) != currentValue.wordValue)
+				continue;
+			currentValue = newValue;
+		}
 
-			// four case are now possible:
-			//a) job has finished -> we only need to free our semaphore
-			//b) we succeeded setting our semaphore, thus wait for it
-			//c) another waiter has set it's sempahore wait for the other one
-			//d) another thread has increased/decreased the num runner variable, we need to do the run again
+		// sleep on the word itself, returns immediately if it was changed since the read above
+		// a job running on a fiber only suspends itself and leaves the worker to other jobs
+		if (!JobManager::Fiber::WaitOnAddress(&syncVar.wordValue, currentValue.wordValue))
+			AngelicaMT::AngelicaWaitOnAddress(&syncVar.wordValue, currentValue.wordValue);
+	}
+}
 
-			if (resValue.wordValue != 0) // case a), do nothing
-			{
-				if (resValue.wordValue == currentValue.wordValue) // case b)
-				{
-					pJobManager->GetSemaphore(semaphoreHandle, this)->Acquire();
-				}
-				else // C-A-S not succeeded, check how to proceed
-				{
-					if (resValue.semaphoreHandle) // case c)
-					{
-						// prevent the following race condition: Thread A Gets the semaphore and waits, then Thread B fails the earlier C-A-S
-						// thus will wait for the same semaphore, but Thread A already release the semaphore and now another Thread (could even be A again)
-						// is using the same semaphore to wait for the job (executed by thread B) which waits for the samephore -> Deadlock
-						// this works since the jobmanager semphore function internally are using locks
-						// so if the following line succeeds, we got the lock before the release and have increased the use counter
-						// if not, it means that thread A release the semaphore, which also means thread B doesn't have to wait anymore
-
-						if (pJobManager->AddRefSemaphore(resValue.semaphoreHandle, this))
-						{
-							pJobManager->GetSemaphore(resValue.semaphoreHandle, this)->Acquire();
-							pJobManager->DeallocateSemaphore(resValue.semaphoreHandle, this);
-						}
-					}
-					else // case d
-					{
-						goto retry;
-					}
-				}
-			}
+/////////////////////////////////////////////////////////////////////////////////
+inline bool JobManager::SJobSyncVariable::AddContinuation(SJobStateContinuation* pContinuation) volatile
+{
+	SyncVar currentValue;
+	SyncVar newValue;
+
+	for (;; )
+	{
+		// volatile read
+		currentValue.wordValue = syncVar.wordValue;
+
+		// same as Wait, the waiter flag makes SetStopped resume the continuation
+		if (currentValue.wordValue == 0)
+			return false;
+
+		if (currentValue.nRunningCounter != 0 && currentValue.nWaiterFlag == 0)
+		{
+			newValue = currentValue;
+			newValue.nWaiterFlag = 1;
+			if ((unsigned int)AngelicaInterlockedCompareExchange((volatile LONG*)&syncVar.wordValue, newValue.wordValue, currentValue.wordValue) != currentValue.wordValue)
+				continue;
+			currentValue = newValue;
 		}
+
+		// only parked if the word wasn't changed since the read above
+		if (JobManager::detail::ParkContinuation(&syncVar.wordValue, currentValue.wordValue, pContinuation))
+			return true;
 	}
+}
 
-	// mark an old semaphore as stopped, in case we didn't use use	(if we did use it, this is a nop)
-	pJobManager->GetSemaphore(semaphoreHandle, this)->SetStopped();
-	pJobManager->DeallocateSemaphore(semaphoreHandle, this);
+/////////////////////////////////////////////////////////////////////////////////
+inline bool JobManager::SJobSyncVariable::KeepWaiting(volatile void* pWordValue)
+{
+	volatile unsigned int* pWord = static_cast<volatile unsigned int*>(pWordValue);
+	SyncVar currentValue;
+	SyncVar newValue;
+
+	for (;; )
+	{
+		// volatile read
+		currentValue.wordValue = *pWord;
+
+		if (currentValue.nRunningCounter == 0)
+			return false;
+
+		if (currentValue.nWaiterFlag)
+			return true;
+
+		// started again after the stopping thread cleared the flag, the next SetStopped has to resume the continuations
+		newValue = currentValue;
+		newValue.nWaiterFlag = 1;
+		if ((unsigned int)AngelicaInterlockedCompareExchange((volatile LONG*)pWord, newValue.wordValue, currentValue.wordValue) == currentValue.wordValue)
+			return true;
+	}
 }
 
 /////////////////////////////////////////////////////////////////////////////////
@@ -1750,26 +2334,27 @@ inline bool JobManager::SJobSyncVariable::SetStopped(SJobStateBase* pPostCallbac
 	if (pPostCallback)
 		pPostCallback->AddPostJob();
 
-	//! Do we need to release a semaphore?
-	if (currentValue.semaphoreHandle)
+	//! Do we need to wake up waiters?
+	if (currentValue.nWaiterFlag)
 	{
-		// try to set the running counter to 0 atomically
-		bool bNeedSemaphoreRelease = true;
+		// try to clear the waiter flag atomically
 		do
 		{
 			// volatile read
 			currentValue.wordValue = syncVar.wordValue;
 			newValue = currentValue;
-			newValue.semaphoreHandle = 0;
+			newValue.nWaiterFlag = 0;
 
-			// another thread increased the running counter again, don't call semaphore release in this case
+			// another thread increased the running counter again, the waiters are woken once that one is stopped
 			if (currentValue.nRunningCounter)
 				return false;
 
 		}
 		while (AngelicaInterlockedCompareExchange((volatile LONG*)&syncVar.wordValue, newValue.wordValue, currentValue.wordValue) != currentValue.wordValue);
-		// set the running successfull to 0, now we can release the semaphore
-		GetJobManagerInterface()->GetSemaphore(resValue.semaphoreHandle, this)->Release();
+		// the word is 0 now, waiters can return and may already have freed it, waking only uses the address as key
+		AngelicaMT::AngelicaWakeByAddressAll(&syncVar.wordValue);
+		JobManager::Fiber::WakeByAddressAll(&syncVar.wordValue);
+		JobManager::detail::ResumeContinuations(&syncVar.wordValue);
 	}
 
 	return true;
@@ -1802,12 +2387,6 @@ inline void JobManager::SInfoBlock::Release(unsigned int nMaxValue)
 	// do we need to release a semaphore
 	if (currentInfoBlockState.nSemaphoreHandle)
 		GetJobManagerInterface()->GetSemaphore(currentInfoBlockState.nSemaphoreHandle, this)->Release();
-
-	if (jobLambdaInvoker)
-	{
-		std::function<void()> empty;
-		jobLambdaInvoker.swap(empty);
-	}
 }
 
 /////////////////////////////////////////////////////////////////////////////////
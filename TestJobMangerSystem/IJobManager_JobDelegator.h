@@ -1392,6 +1392,9 @@ void VerifyThisPtr(void (* func)(Params ...), const T&)
     void SetPriorityLevel(unsigned int nPriorityLevel);                                                                                                                  \
     void ForceUpdateOfProfilingDataIndex();                                                                                                                              \
     void SetBlocking();                                                                                                                                                  \
+    void SetDeadline(unsigned long long nDeadlineTicks);                                                                                                                 \
+    void SetCancellationToken(const JobManager::CJobCancellationToken* pToken);                                                                                          \
+    void SetTargetWorker(unsigned int nWorkerId);                                                                                                                        \
     unsigned int GetParamDataSize();                                                                                                                                     \
     void SetJobParamData(void* paramMem);                                                                                                                                \
     Invoker GetGenericDelegator() const;                                                                                                                                 \
@@ -1655,6 +1658,21 @@ void VerifyThisPtr(void (* func)(Params ...), const T&)
     this->m_JobDelegator.SetBlocking();                                                                                                                                  \
   }                                                                                                                                                                      \
                                                                                                                                                                          \
+  inline void SGenericJob ## type::SetDeadline(unsigned long long nDeadlineTicks)                                                                                        \
+  {                                                                                                                                                                      \
+    this->m_JobDelegator.SetDeadline(nDeadlineTicks);                                                                                                                    \
+  }                                                                                                                                                                      \
+                                                                                                                                                                         \
+  inline void SGenericJob ## type::SetCancellationToken(const JobManager::CJobCancellationToken* pToken)                                                                 \
+  {                                                                                                                                                                      \
+    this->m_JobDelegator.SetCancellationToken(pToken);                                                                                                                   \
+  }                                                                                                                                                                      \
+                                                                                                                                                                         \
+  inline void SGenericJob ## type::SetTargetWorker(unsigned int nWorkerId)                                                                                               \
+  {                                                                                                                                                                      \
+    this->m_JobDelegator.SetTargetWorker(nWorkerId);                                                                                                                     \
+  }                                                                                                                                                                      \
+                                                                                                                                                                         \
   inline unsigned int SGenericJob ## type::GetParamDataSize()                                                                                                            \
   {                                                                                                                                                                      \
     return this->m_JobDelegator.GetParamDataSize();                                                                                                                      \
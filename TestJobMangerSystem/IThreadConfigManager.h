@@ -46,6 +46,10 @@ public:
 	virtual const SThreadConfig* GetThreadConfig(const char* sThreadName, ...) = 0;
 	virtual const SThreadConfig* GetDefaultThreadConfig() const = 0;
 
+	//! Adds or overrides the configuration for threads named rThreadConfig.szThreadName.
+	//! The name may contain '*' wildcards, e.g. "JobSystem_Worker_*". Has to be called before the thread is spawned.
+	virtual void SetThreadConfig(const SThreadConfig& rThreadConfig) = 0;
+
 	//! Dump a detailed description of the thread startup configurations for this platform to the log file.
 	virtual void DumpThreadConfigurationsToLog() = 0;
 };
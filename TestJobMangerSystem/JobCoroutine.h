@@ -0,0 +1,163 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   JobCoroutine.h
+//  Version:     v1.00
+//  Description: Coroutine awaitables for job states and worker scheduling
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "IJobManager.h"
+#include <exception>
+
+// C++20 coroutines, or the coroutines TS of older compilers (MSVC /await)
+#if defined(__cpp_impl_coroutine)
+	#include <coroutine>
+	#define JOBMANAGER_SUPPORT_COROUTINES
+namespace JobManager { namespace detail { namespace coro = std; } }
+#elif defined(__cpp_coroutines) || defined(_RESUMABLE_FUNCTIONS_SUPPORTED)
+	#include <experimental/coroutine>
+	#define JOBMANAGER_SUPPORT_COROUTINES
+namespace JobManager { namespace detail { namespace coro = std::experimental; } }
+#endif
+
+#if defined(JOBMANAGER_SUPPORT_COROUTINES)
+
+namespace JobManager
+{
+namespace detail
+{
+//! Continue a suspended coroutine in a lambda job.
+inline void ResumeAsJob(coro::coroutine_handle<> handle, TPriorityLevel priority)
+{
+	GetJobManagerInterface()->AddLambdaJob("JobCoroutine", [handle]() { handle.resume(); }, priority);
+}
+} // namespace detail
+
+//! Awaitable suspending the coroutine until the job state stopped, the coroutine then continues on a worker.
+//! No thread waits meanwhile, the awaiter is parked on the job state like a waiting thread.
+class CJobStateAwaiter : private SJobStateContinuation
+{
+public:
+	CJobStateAwaiter(SJobState& rJobState, TPriorityLevel priority = eRegularPriority)
+		: m_rJobState(rJobState)
+		, m_priority(priority)
+	{
+		pResume = &CJobStateAwaiter::Resume;
+		pNext = NULL;
+		pWaitAddress = NULL;
+	}
+
+	bool await_ready() const { return !m_rJobState.IsRunning(); }
+
+	//! Returns false to continue at once if the job state stopped in the meantime.
+	bool await_suspend(detail::coro::coroutine_handle<> handle)
+	{
+		m_handle = handle;
+		return m_rJobState.AddContinuation(this);
+	}
+
+	void await_resume() const {}
+
+private:
+	static void Resume(SJobStateContinuation* pContinuation)
+	{
+		CJobStateAwaiter* pAwaiter = static_cast<CJobStateAwaiter*>(pContinuation);
+		detail::ResumeAsJob(pAwaiter->m_handle, pAwaiter->m_priority);
+	}
+
+	SJobState&                       m_rJobState;
+	TPriorityLevel                   m_priority;
+	detail::coro::coroutine_handle<> m_handle;
+};
+
+//! co_await jobState; continues with regular priority once all jobs of jobState finished.
+inline CJobStateAwaiter operator co_await(SJobState& rJobState)
+{
+	return CJobStateAwaiter(rJobState);
+}
+
+//! co_await Await(jobState, priority); as above with the priority of the job which continues the coroutine.
+inline CJobStateAwaiter Await(SJobState& rJobState, TPriorityLevel priority)
+{
+	return CJobStateAwaiter(rJobState, priority);
+}
+
+//! Awaitable moving the coroutine into a job of the given priority.
+class CScheduleAwaiter
+{
+public:
+	explicit CScheduleAwaiter(TPriorityLevel priority) : m_priority(priority) {}
+
+	bool await_ready() const                                { return false; }
+	void await_suspend(detail::coro::coroutine_handle<> handle) { detail::ResumeAsJob(handle, m_priority); }
+	void await_resume() const                               {}
+
+private:
+	TPriorityLevel m_priority;
+};
+
+//! co_await Schedule(priority); continues the coroutine on a worker thread.
+inline CScheduleAwaiter Schedule(TPriorityLevel priority = eRegularPriority)
+{
+	return CScheduleAwaiter(priority);
+}
+
+//! Return type of a coroutine started explicitly with Run, the frame is released when it returns.
+//! The coroutine runs on the calling thread until its first co_await.
+class CJobCoroutine
+{
+public:
+	struct promise_type
+	{
+		promise_type() : pJobState(NULL) {}
+
+		CJobCoroutine                  get_return_object()   { return CJobCoroutine(detail::coro::coroutine_handle<promise_type>::from_promise(*this)); }
+		detail::coro::suspend_always   initial_suspend()     { return detail::coro::suspend_always(); }
+		detail::coro::suspend_never    final_suspend() noexcept { return detail::coro::suspend_never(); }
+		void                           unhandled_exception() { std::terminate(); }
+
+		// the job state is stopped last, the frame is released right after and nothing touches it anymore
+		void return_void()
+		{
+			if (pJobState)
+				pJobState->SetStopped();
+		}
+
+		SJobState* pJobState;
+	};
+
+	CJobCoroutine(CJobCoroutine&& rOther) : m_handle(rOther.m_handle) { rOther.m_handle = nullptr; }
+	~CJobCoroutine()
+	{
+		// never started
+		if (m_handle)
+			m_handle.destroy();
+	}
+
+	//! Start the coroutine on the calling thread, pJobState stays running until the coroutine returned.
+	void Run(SJobState* pJobState = NULL)
+	{
+		assert(m_handle);
+		detail::coro::coroutine_handle<promise_type> handle = m_handle;
+		m_handle = nullptr;
+
+		if (pJobState)
+			pJobState->SetRunning();
+		handle.promise().pJobState = pJobState;
+		handle.resume();
+	}
+
+private:
+	explicit CJobCoroutine(detail::coro::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+	CJobCoroutine(const CJobCoroutine&);
+	CJobCoroutine& operator=(const CJobCoroutine&);
+
+	detail::coro::coroutine_handle<promise_type> m_handle;
+};
+} // namespace JobManager
+
+#endif // JOBMANAGER_SUPPORT_COROUTINES
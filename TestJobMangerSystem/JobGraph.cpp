@@ -0,0 +1,183 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   JobGraph.cpp
+//  Version:     v1.00
+//  Description: Job graph, jobs with any number of predecessors released by the job system
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "AngelicaPlatformDefines.h"
+#if ANGELICA_PLATFORM_WINDOWS
+	#include "Win32specific.h"
+	#include "MSVCspecific.h"
+#else
+	#include "Linuxspecific.h"
+	#include "GCCspecific.h"
+#endif
+#include "AngelicaAtomics.h"
+#include "JobGraph.h"
+#include <algorithm>
+
+///////////////////////////////////////////////////////////////////////////////
+JobManager::SJobGraphNode::SJobGraphNode(CJobGraph* pOwner, CJobBase* pNodeJob, const char* szNodeJobName, const std::function<void()>& nodeLambda, TPriorityLevel nodePriority)
+	: pGraph(pOwner)
+	, pJob(pNodeJob)
+	, szJobName(szNodeJobName)
+	, lambda(nodeLambda)
+	, priority(nodePriority)
+	, nNumPredecessors(0)
+	, nPendingPredecessors(0)
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::SJobGraphNode::Dispatch()
+{
+	if (pJob)
+	{
+		pJob->RegisterJobState(this);
+		pJob->Run();
+	}
+	else
+	{
+		// only pass the node, the closure stays in the job slot and the lambda isn't copied per run
+		SJobGraphNode* pNode = this;
+		GetJobManagerInterface()->AddLambdaJob(szJobName, [pNode]() { pNode->lambda(); }, priority, this);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::SJobGraphNode::AddPostJob()
+{
+	SJobState::AddPostJob();
+
+	// release the successors for which this was the last pending predecessor
+	for (size_t i = 0, nNumSuccessors = successors.size(); i < nNumSuccessors; ++i)
+	{
+		SJobGraphNode* pSuccessor = successors[i];
+		if (AngelicaInterlockedDecrement(&pSuccessor->nPendingPredecessors) == 0)
+			pSuccessor->Dispatch();
+	}
+
+	// must be last, once the graph state is stopped the owner may reuse or destroy the nodes
+	pGraph->m_graphState.SetStopped();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+JobManager::CJobGraph::CJobGraph()
+{
+}
+
+///////////////////////////////////////////////////////////////////////////////
+JobManager::CJobGraph::~CJobGraph()
+{
+	Wait();
+	Clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+JobManager::CJobGraph::TNodeHandle JobManager::CJobGraph::AddNode(SJobGraphNode* pNode)
+{
+	assert(!IsRunning());
+	// the graph state counts the nodes of a run in the 16 bit running counter
+	assert(m_nodes.size() < 0xFFFF);
+
+	m_nodes.push_back(pNode);
+	return (TNodeHandle)(m_nodes.size() - 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+JobManager::CJobGraph::TNodeHandle JobManager::CJobGraph::AddJob(CJobBase* pJob)
+{
+	assert(pJob);
+	return AddNode(new SJobGraphNode(this, pJob, NULL, std::function<void()>(), eRegularPriority));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+JobManager::CJobGraph::TNodeHandle JobManager::CJobGraph::AddLambda(const char* szJobName, const std::function<void()>& lambda, TPriorityLevel priority)
+{
+	assert(lambda);
+	return AddNode(new SJobGraphNode(this, NULL, szJobName, lambda, priority));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::CJobGraph::AddDependency(TNodeHandle nPredecessor, TNodeHandle nSuccessor)
+{
+	assert(!IsRunning());
+	assert(nPredecessor < m_nodes.size() && nSuccessor < m_nodes.size());
+	assert(nPredecessor != nSuccessor);
+
+	m_nodes[nPredecessor]->successors.push_back(m_nodes[nSuccessor]);
+	m_nodes[nSuccessor]->nNumPredecessors++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::CJobGraph::Run()
+{
+	assert(!IsRunning());
+
+#if !defined(_RELEASE)
+	{
+		// a cycle would never be released, check that all nodes are reachable in topological order
+		std::vector<unsigned int> arrPending(m_nodes.size());
+		std::vector<SJobGraphNode*> arrReady;
+		for (size_t i = 0, nNumNodes = m_nodes.size(); i < nNumNodes; ++i)
+		{
+			arrPending[i] = m_nodes[i]->nNumPredecessors;
+			if (arrPending[i] == 0)
+				arrReady.push_back(m_nodes[i]);
+		}
+
+		size_t nNumVisited = 0;
+		while (!arrReady.empty())
+		{
+			SJobGraphNode* pNode = arrReady.back();
+			arrReady.pop_back();
+			++nNumVisited;
+			for (size_t i = 0, nNumSuccessors = pNode->successors.size(); i < nNumSuccessors; ++i)
+			{
+				const size_t nSuccessor = std::find(m_nodes.begin(), m_nodes.end(), pNode->successors[i]) - m_nodes.begin();
+				if (--arrPending[nSuccessor] == 0)
+					arrReady.push_back(m_nodes[nSuccessor]);
+			}
+		}
+		assert(nNumVisited == m_nodes.size() && "job graph contains a cycle");
+	}
+#endif
+
+	// arm all nodes before dispatching anything, a root can finish while the others are still being set up
+	for (size_t i = 0, nNumNodes = m_nodes.size(); i < nNumNodes; ++i)
+	{
+		m_nodes[i]->nPendingPredecessors = (int)m_nodes[i]->nNumPredecessors;
+		m_graphState.SetRunning();
+	}
+
+	for (size_t i = 0, nNumNodes = m_nodes.size(); i < nNumNodes; ++i)
+	{
+		if (m_nodes[i]->nNumPredecessors == 0)
+			m_nodes[i]->Dispatch();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::CJobGraph::Wait()
+{
+	GetJobManagerInterface()->WaitForJob(m_graphState);
+
+	// the graph state is stopped from inside the node's SetStopped, a thread waiting on a single node
+	// may still be woken up through the node's sync variable, let it finish before the nodes are touched
+	for (size_t i = 0, nNumNodes = m_nodes.size(); i < nNumNodes; ++i)
+		GetJobManagerInterface()->WaitForJob(*m_nodes[i]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::CJobGraph::Clear()
+{
+	assert(!IsRunning());
+
+	for (size_t i = 0, nNumNodes = m_nodes.size(); i < nNumNodes; ++i)
+		delete m_nodes[i];
+	m_nodes.clear();
+}
@@ -0,0 +1,89 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   JobGraph.h
+//  Version:     v1.00
+//  Description: Job graph, jobs with any number of predecessors released by the job system
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "IJobManager.h"
+#include <vector>
+
+namespace JobManager
+{
+class CJobGraph;
+
+//! Node of a CJobGraph, the node is the job state of its own job.
+//! When the job stops, the dependency counter of every successor is decremented,
+//! a successor reaching 0 is dispatched by the thread which finished the last predecessor.
+struct SJobGraphNode : public SJobState
+{
+	SJobGraphNode(CJobGraph* pOwner, CJobBase* pNodeJob, const char* szNodeJobName, const std::function<void()>& nodeLambda, TPriorityLevel nodePriority);
+
+	void* operator new(size_t nSize) { return _aligned_malloc(nSize, 16); }
+	void  operator delete(void* pMem) { _aligned_free(pMem); }
+
+	//! Hands the node to the job manager, the node is the job state of the dispatched job.
+	void Dispatch();
+
+	virtual void AddPostJob() override;
+
+	CJobGraph*                  pGraph;
+	CJobBase*                   pJob;                 //!< Job to run, if NULL the lambda is run.
+	const char*                 szJobName;
+	std::function<void()>       lambda;
+	TPriorityLevel              priority;
+	std::vector<SJobGraphNode*> successors;
+	unsigned int                nNumPredecessors;
+	volatile int                nPendingPredecessors; //!< Predecessors which didn't finish yet in the current run.
+};
+
+//! Graph of jobs with explicit dependencies.
+//! Nodes without predecessors are dispatched by Run(), all other nodes are started by the job system
+//! as soon as their last predecessor stopped, no thread has to wait between the stages.
+//! The graph can be run again once it finished, nodes and edges may only be changed while it is not running.
+class CJobGraph
+{
+public:
+	typedef unsigned int TNodeHandle;
+
+	CJobGraph();
+	~CJobGraph();
+
+	//! Add a node running a job declared with DECLARE_JOB, the job must stay alive while the graph is running.
+	TNodeHandle AddJob(CJobBase* pJob);
+
+	//! Add a node running a lambda.
+	TNodeHandle AddLambda(const char* szJobName, const std::function<void()>& lambda, TPriorityLevel priority = eRegularPriority);
+
+	//! nSuccessor can only start after nPredecessor finished, a node can have any number of predecessors.
+	void AddDependency(TNodeHandle nPredecessor, TNodeHandle nSuccessor);
+
+	//! Dispatch all nodes without predecessors.
+	void Run();
+
+	//! Wait until all nodes of the current run finished.
+	void Wait();
+
+	bool         IsRunning() const { return m_graphState.IsRunning(); }
+	unsigned int GetNumNodes() const { return (unsigned int)m_nodes.size(); }
+
+	//! Remove all nodes, the graph must not be running.
+	void Clear();
+
+private:
+	friend struct SJobGraphNode;
+
+	CJobGraph(const CJobGraph&);
+	CJobGraph& operator=(const CJobGraph&);
+
+	TNodeHandle AddNode(SJobGraphNode* pNode);
+
+	std::vector<SJobGraphNode*> m_nodes;
+	SJobState                   m_graphState;   // running once per node of the current run
+};
+} // namespace JobManager
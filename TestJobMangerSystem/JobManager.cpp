@@ -4,23 +4,34 @@
    implementation of job manager
    DMA memory mappings can be issued in any order
  */
-#include "StdAfx.h"
+#include "stdafx.h"
 #include "AngelicaPlatformDefines.h"
 #include <type_traits>
 #include <functional>
-#include "Win32specific.h"
-#include "MSVCspecific.h"
+#if ANGELICA_PLATFORM_WINDOWS
+	#include "Win32specific.h"
+	#include "MSVCspecific.h"
+#else
+	#include "Linuxspecific.h"
+	#include "GCCspecific.h"
+#endif
 #include "AngelicaAtomics.h"
 #include "AngelicaThread.h"
 #include "JobManager.h"
-#include "BlockingBackend\BlockingBackEnd.h"
-#include "FallbackBackend\FallBackBackend.h"
-#include "PCBackEnd\ThreadBackEnd.h"
+#include "BlockingBackend/BlockingBackEnd.h"
+#include "FallbackBackend/FallBackBackend.h"
+#include "PCBackEnd/ThreadBackEnd.h"
 #include "BitFiddling.h"
+#include "CpuTopology.h"
+#include "JobTimerWheel.h"
 #include <string>
-#include <DbgHelp.h>
 #include <iosfwd>
-#include <atlstr.h>
+#if ANGELICA_PLATFORM_WINDOWS
+	#include <DbgHelp.h>
+	#include <atlstr.h>
+#else
+	#include <execinfo.h>
+#endif
 using namespace std;
 
 namespace JobManager {
@@ -57,7 +68,9 @@ JobManager::CWorkerBackEndProfiler::~CWorkerBackEndProfiler()
 void JobManager::CWorkerBackEndProfiler::Init(unsigned short numWorkers)
 {
 	// Init Job Stats
-	ZeroMemory(m_JobStatsInfo.m_pJobStats, sizeof(m_JobStatsInfo.m_pJobStats));
+	for (UINT32 i = 0; i < JobManager::detail::eJOB_FRAME_STATS * JobManager::detail::eJOB_FRAME_STATS_MAX_SUPP_JOBS; ++i)
+		m_JobStatsInfo.m_pJobStats[i] = JobManager::SJobFrameStats();
+	ZeroMemory(m_arrDeadlineStats, sizeof(m_arrDeadlineStats));
 
 	// Init Worker Stats
 	for (UINT32 i = 0; i < JobManager::detail::eJOB_FRAME_STATS; ++i)
@@ -174,6 +187,7 @@ void JobManager::CWorkerBackEndProfiler::GetFrameStatsSummary(SJobFrameStatsSumm
 	unsigned short totalIndividualJobCount = 0;
 	UINT32 totalJobsExecutionTime = 0;
 	UINT32 totalJobCount = 0;
+	UINT32 totalCancelledJobCount = 0;
 	for (unsigned short i = 0; i < JobManager::detail::eJOB_FRAME_STATS_MAX_SUPP_JOBS; ++i)
 	{
 		const JobManager::SJobFrameStats& rJobStats = pJobStatsToCopyFrom[i];
@@ -183,11 +197,22 @@ void JobManager::CWorkerBackEndProfiler::GetFrameStatsSummary(SJobFrameStatsSumm
 			totalJobCount += rJobStats.count;
 			totalIndividualJobCount++;
 		}
+		totalCancelledJobCount += rJobStats.cancelledCount;
 	}
 
 	rStats.nTotalExecutionTime = totalJobsExecutionTime;
 	rStats.nNumJobsExecuted = totalJobCount;
 	rStats.nNumIndividualJobsExecuted = totalIndividualJobCount;
+	rStats.nNumJobsCancelled = totalCancelledJobCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::CWorkerBackEndProfiler::GetDeadlineStats(SJobDeadlineStats& rStats) const
+{
+	unsigned char nTailIndex = (m_nCurBufIndex + 1);
+	nTailIndex = (nTailIndex > (JobManager::detail::eJOB_FRAME_STATS - 1)) ? 0 : nTailIndex;
+
+	rStats = m_arrDeadlineStats[nTailIndex];
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -241,6 +266,40 @@ void JobManager::CWorkerBackEndProfiler::RecordJob(const unsigned short profileI
 	while (AngelicaInterlockedCompareExchange(alias_cast<volatile LONG*>(&workerStats.nNumJobsExecuted), numJobsExecuted + 1, numJobsExecuted) != numJobsExecuted);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::CWorkerBackEndProfiler::RecordCancelledJob(const unsigned short profileIndex, const UINT32 jobId)
+{
+	JobManager::SJobFrameStats& jobStats = m_JobStatsInfo.m_pJobStats[(profileIndex* JobManager::detail::eJOB_FRAME_STATS_MAX_SUPP_JOBS) +jobId];
+	AngelicaInterlockedIncrement(alias_cast<volatile int*>(&jobStats.cancelledCount));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::CWorkerBackEndProfiler::RecordDeadline(const unsigned short profileIndex, const UINT32 jobId, const int latenessMicroSec)
+{
+	JobManager::SJobDeadlineStats& deadlineStats = m_arrDeadlineStats[profileIndex];
+
+	AngelicaInterlockedIncrement(alias_cast<volatile int*>(&deadlineStats.nNumJobsWithDeadline));
+	if (latenessMicroSec <= 0)
+		return;
+
+	AngelicaInterlockedIncrement(alias_cast<volatile int*>(&deadlineStats.nNumMissedDeadlines));
+
+	// bucket i holds latenesses below 2^i us
+	UINT32 nBucket = 0;
+	while (nBucket < JobManager::SJobDeadlineStats::eNumLatenessBuckets - 1 && ((UINT32)latenessMicroSec >> nBucket) != 0)
+		++nBucket;
+	AngelicaInterlockedIncrement(alias_cast<volatile int*>(&deadlineStats.arrLatenessHistogram[nBucket]));
+
+	UINT32 nMaxLateness = ~0;
+	do
+	{
+		nMaxLateness = *const_cast<volatile UINT32*>(&deadlineStats.nMaxLatenessMicroSec);
+		if (nMaxLateness >= (UINT32)latenessMicroSec)
+			break;
+	}
+	while (AngelicaInterlockedCompareExchange(alias_cast<volatile LONG*>(&deadlineStats.nMaxLatenessMicroSec), latenessMicroSec, nMaxLateness) != nMaxLateness);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 unsigned short JobManager::CWorkerBackEndProfiler::GetProfileIndex() const
 {
@@ -298,7 +357,7 @@ void JobManager::CWorkerBackEndProfiler::GetJobStats(const unsigned char nBuffer
 	for (unsigned short i = 0; i < JobManager::detail::eJOB_FRAME_STATS_MAX_SUPP_JOBS; ++i)
 	{
 		const JobManager::SJobFrameStats& rJobStats = pJobStatsToCopyFrom[i];
-		if (rJobStats.count > 0)
+		if (rJobStats.count > 0 || rJobStats.cancelledCount > 0)
 		{
 			rJobStatsContainer.push_back(rJobStats);
 		}
@@ -344,6 +403,9 @@ void JobManager::CWorkerBackEndProfiler::ResetJobStats(const unsigned char nBuff
 		JobManager::SJobFrameStats& rJobStats = pJobStatsToReset[i];
 		rJobStats.Reset();
 	}
+
+	// Reset deadline stats
+	ZeroMemory(&m_arrDeadlineStats[nBufferIndex], sizeof(JobManager::SJobDeadlineStats));
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -362,14 +424,16 @@ extern "C"
 }
 
 JobManager::CJobManager::CJobManager()
-	: m_Initialized(false),
+	: m_pJobFilter(NULL),
+	m_nJobSystemEnabled(1),
+	m_bJobSystemProfilerEnabled(false),
+	m_bJobSystemProfilerPaused(0),
+	m_Initialized(false),
 	m_pFallBackBackEnd(NULL),
 	m_pThreadBackEnd(NULL),
 	m_pBlockingBackEnd(NULL),
+	m_pTimerWheel(NULL),
 	m_nJobIdCounter(0),
-	m_nJobSystemEnabled(1),
-	m_bJobSystemProfilerPaused(0),
-	m_bJobSystemProfilerEnabled(false),
 	m_nJobsRunCounter(0),
 	m_nFallbackJobsRunCounter(0),
 	m_bSuspendWorkerForMP(false)
@@ -377,12 +441,29 @@ JobManager::CJobManager::CJobManager()
 	// create backends
 	m_pThreadBackEnd = new ThreadBackEnd::CThreadBackEnd();
 
-#if ANGELICA_PLATFORM_DURANGO || ANGELICA_PLATFORM_ORBIS
-	m_nRegularWorkerThreads = 6;
-#else
-	int numWorkers = 7;
-	m_nRegularWorkerThreads = numWorkers;
-#endif
+	// the worker count is only known after Init, size the per worker fallback lists for the largest possible pool
+	m_nRegularWorkerThreads = JobManager::SCpuTopology::eMaxLogicalCores;
+
+	memset(&m_cpuTopology, 0, sizeof(m_cpuTopology));
+	memset(&m_workerPoolLayout, 0, sizeof(m_workerPoolLayout));
+	m_workerPoolLayout.policy = JobManager::eWPP_LogicalMinusReserved;
+	m_workerPoolLayout.nReservedCores = 1;
+	memset(m_arrJobQueueCapacity, 0, sizeof(m_arrJobQueueCapacity));
+	// workers sleep right away by default, spinning is opt-in as it costs cpu time while idle
+	m_workerIdleSettings.policy = JobManager::eWIP_Park;
+	m_workerIdleSettings.nMaxSpinUS = 50;
+	m_workerIdleSettings.nYieldUS = 50;
+	m_workerIdleSettings.nMinJobTimeBeforeWaitUS = 1000;
+	// strict order without aging by default, weighted fair share and aging are opt-in
+	m_prioritySchedulingSettings.policy = JobManager::ePSP_Strict;
+	m_prioritySchedulingSettings.arrWeights[JobManager::eHighPriority] = 32;
+	m_prioritySchedulingSettings.arrWeights[JobManager::eRegularPriority] = 8;
+	m_prioritySchedulingSettings.arrWeights[JobManager::eLowPriority] = 2;
+	m_prioritySchedulingSettings.arrWeights[JobManager::eStreamPriority] = 1;
+	m_prioritySchedulingSettings.nMaxWaitUS = 0;
+	m_bFiberMode = false;
+	m_nFiberStackSize = 0;
+	m_bDeadlineScheduling = false;
 
 	m_pRegularWorkerFallbacks = new JobManager::SInfoBlock*[m_nRegularWorkerThreads];
 	memset(m_pRegularWorkerFallbacks, 0, sizeof(JobManager::SInfoBlock*) * m_nRegularWorkerThreads);
@@ -390,6 +471,7 @@ JobManager::CJobManager::CJobManager()
 	m_pBlockingBackEnd = new(pAlignedMemory) BlockingBackEnd::CBlockingBackEnd(m_pRegularWorkerFallbacks, m_nRegularWorkerThreads);
 	//m_pBlockingBackEnd = AngelicaAlignedNew<BlockingBackEnd::CBlockingBackEnd>(m_pRegularWorkerFallbacks, m_nRegularWorkerThreads);
 	m_pFallBackBackEnd = new FallBackBackEnd::CFallBackBackEnd();
+	m_pTimerWheel = new JobManager::detail::CJobTimerWheel();
 
 #if defined(JOBMANAGER_SUPPORT_PROFILING)
 	m_profilingData.nFrameIdx = 0;
@@ -397,6 +479,13 @@ JobManager::CJobManager::CJobManager()
 
 	memset(m_arrJobInvokers, 0, sizeof(m_arrJobInvokers));
 	m_nJobInvokerIdx = 0;
+	memset(m_arrRegisteredJobs, 0, sizeof(m_arrRegisteredJobs));
+	m_nNumRegisteredJobs = 0;
+	memset((void*)m_arrJobHandleTable, 0, sizeof(m_arrJobHandleTable));
+	memset((void*)m_arrFilteredJobs, 0, sizeof(m_arrFilteredJobs));
+
+	for (unsigned int i = 0; i < nLambdaClosureSizeClasses; ++i)
+		AngelicaInitializeSListHead(m_lambdaClosurePool[i]);
 
 	// init fallback backend early to be able to handle jobs before jobmanager is initialized
 	if (m_pFallBackBackEnd)  m_pFallBackBackEnd->Init(-1 /*not used for fallback*/);
@@ -420,6 +509,136 @@ const bool JobManager::CJobManager::WaitForJob(JobManager::SJobState& rJobState)
 	return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+namespace
+{
+// shared by the continuations WaitForAll/WaitForAny park on the job states, the waiter sleeps on nPending
+struct SJobStateWaitGroup
+{
+	volatile int  nPending;            // parked continuations which didn't finish resuming yet
+	volatile LONG nFirstResumedIndex;  // job state index of the first resumed continuation, -1 before
+	bool          bWakeOnEachResume;   // WaitForAny, else only the last resume wakes the waiter
+};
+
+struct SJobStateWaitContinuation : JobManager::SJobStateContinuation
+{
+	SJobStateWaitGroup* pGroup;
+	unsigned int        nIndex;
+	bool                bParked;
+};
+
+// continuations kept on the stack of the waiter, waiting for more job states allocates them
+enum { eNumWaitContinuationsOnStack = 32 };
+
+void ResumeJobStateWaitGroup(JobManager::SJobStateContinuation* pContinuation)
+{
+	SJobStateWaitContinuation* pWaitContinuation = static_cast<SJobStateWaitContinuation*>(pContinuation);
+	SJobStateWaitGroup* pGroup = pWaitContinuation->pGroup;
+	const bool bWakeOnEachResume = pGroup->bWakeOnEachResume;
+	volatile int* pPending = &pGroup->nPending;
+
+	AngelicaInterlockedCompareExchange(&pGroup->nFirstResumedIndex, (LONG)pWaitContinuation->nIndex, -1);
+
+	// the waiter can return and release the group right after the decrement, waking only uses the address as key
+	if (AngelicaInterlockedDecrement(pPending) == 0 || bWakeOnEachResume)
+	{
+		AngelicaMT::AngelicaWakeByAddressAll(pPending);
+		JobManager::Fiber::WakeByAddressAll(pPending);
+	}
+}
+
+// sleeps until nPending changed, a job running on a fiber only suspends itself
+int WaitForJobStateWaitGroup(SJobStateWaitGroup& rGroup, int nPending)
+{
+	if (!JobManager::Fiber::WaitOnAddress(&rGroup.nPending, (unsigned int)nPending))
+		AngelicaMT::AngelicaWaitOnAddress(&rGroup.nPending, (unsigned int)nPending);
+	return rGroup.nPending;
+}
+
+// parks a continuation on each running job state, then sleeps once until all of them resumed
+// with bWaitForAny only until the first one resumed, the others are taken out again before returning
+unsigned int WaitForJobStates(JobManager::SJobState* const* ppJobStates, unsigned int nNumJobStates, bool bWaitForAny)
+{
+	SJobStateWaitContinuation arrStackContinuations[eNumWaitContinuationsOnStack];
+	SJobStateWaitContinuation* pContinuations = nNumJobStates <= eNumWaitContinuationsOnStack ? arrStackContinuations : new SJobStateWaitContinuation[nNumJobStates];
+
+	// the waiter holds one count while parking, so no resume can drop nPending to 0 before all continuations are parked
+	SJobStateWaitGroup group;
+	group.nPending = 1;
+	group.nFirstResumedIndex = -1;
+	group.bWakeOnEachResume = bWaitForAny;
+
+	unsigned int nStoppedIndex = ~0U;
+	unsigned int nNumRegistered = 0;
+	int nNumParked = 0;
+	for (; nNumRegistered < nNumJobStates && nStoppedIndex == ~0U; ++nNumRegistered)
+	{
+		SJobStateWaitContinuation& rContinuation = pContinuations[nNumRegistered];
+		rContinuation.pResume = &ResumeJobStateWaitGroup;
+		rContinuation.pNext = NULL;
+		rContinuation.pWaitAddress = NULL;
+		rContinuation.pGroup = &group;
+		rContinuation.nIndex = nNumRegistered;
+
+		AngelicaInterlockedIncrement(&group.nPending);
+		rContinuation.bParked = ppJobStates[nNumRegistered]->AddContinuation(&rContinuation);
+		if (rContinuation.bParked)
+		{
+			++nNumParked;
+			continue;
+		}
+
+		// stopped already, WaitForAny doesn't need to look at the others
+		AngelicaInterlockedDecrement(&group.nPending);
+		if (bWaitForAny)
+			nStoppedIndex = nNumRegistered;
+	}
+
+	int nPending = AngelicaInterlockedDecrement(&group.nPending);
+
+	if (bWaitForAny)
+	{
+		// nothing resumed as long as every parked continuation is pending
+		if (nStoppedIndex == ~0U)
+		{
+			while (nPending == nNumParked)
+				nPending = WaitForJobStateWaitGroup(group, nPending);
+			nStoppedIndex = (unsigned int)group.nFirstResumedIndex;
+		}
+
+		// take the continuations which weren't resumed out again, the others are being resumed at the moment
+		for (unsigned int i = 0; i < nNumRegistered; ++i)
+		{
+			if (pContinuations[i].bParked && JobManager::detail::UnparkContinuation(&pContinuations[i]))
+				AngelicaInterlockedDecrement(&group.nPending);
+		}
+		nPending = group.nPending;
+	}
+
+	// until the last resume is done with the group, which lives on this stack
+	while (nPending != 0)
+		nPending = WaitForJobStateWaitGroup(group, nPending);
+
+	if (pContinuations != arrStackContinuations)
+		delete[] pContinuations;
+
+	return nStoppedIndex;
+}
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::CJobManager::WaitForAll(JobManager::SJobState* const* ppJobStates, unsigned int nNumJobStates) const
+{
+	WaitForJobStates(ppJobStates, nNumJobStates, false);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+unsigned int JobManager::CJobManager::WaitForAny(JobManager::SJobState* const* ppJobStates, unsigned int nNumJobStates) const
+{
+	assert(nNumJobStates > 0);
+	return WaitForJobStates(ppJobStates, nNumJobStates, true);
+}
+
 //ColorB JobManager::CJobManager::GenerateColorBasedOnName(const char* name)
 //{
 //	ColorB color;
@@ -432,45 +651,66 @@ const bool JobManager::CJobManager::WaitForJob(JobManager::SJobState& rJobState)
 //	return color;
 //}
 
+JobManager::TJobHandle JobManager::CJobManager::FindJobHandle(const char* cpJobName, unsigned int nStrLen, unsigned int nNameHash) const
+{
+	for (unsigned int nSlot = nNameHash; ; ++nSlot)
+	{
+		JobManager::TJobHandle pJobHandle = m_arrJobHandleTable[nSlot & (nJobHandleTableSize - 1)];
+		if (pJobHandle == NULL)
+			return NULL;
+		if (pJobHandle->nNameHash == nNameHash && pJobHandle->strLen == nStrLen && strncmp(pJobHandle->cpString, cpJobName, nStrLen) == 0)
+			return pJobHandle;
+	}
+}
+
 const JobManager::TJobHandle JobManager::CJobManager::GetJobHandle(const char* cpJobName, const UINT32 cStrLen, JobManager::Invoker pInvoker)
 {
-	static JobManager::SJobStringHandle cFailedLookup = { "", 0 };
-	JobManager::SJobStringHandle cLookup = { cpJobName, cStrLen };
-	bool bJobIdSet = false;
+	static JobManager::SJobStringHandle cFailedLookup = { "", 0, -1 };
+	const unsigned int nNameHash = JobManager::JobNameHash(cpJobName, cStrLen);
 
-	// mis-use the JobQueue lock, this shouldn't create contention,
-	// since this functions is only called once per job
-	AUTO_LOCK(m_JobManagerLock);
+	// registered names are found without locking, the table is at most half full so the probe sequences stay short
+	JobManager::TJobHandle ret = FindJobHandle(cpJobName, cStrLen, nNameHash);
+	if (ret)
+		return ret;
 
 	// don't insert in list when we only look up the job for debugging settings
 	if (pInvoker == NULL)
-	{
-		std::set<JobManager::SJobStringHandle>::iterator it = m_registeredJobs.find(cLookup);
-		return it == m_registeredJobs.end() ? &cFailedLookup : (JobManager::TJobHandle)&(*(it));
-	}
+		return &cFailedLookup;
 
-	std::pair<std::set<JobManager::SJobStringHandle>::iterator, bool> it = m_registeredJobs.insert(cLookup);
-	JobManager::TJobHandle ret = (JobManager::TJobHandle)&(*(it.first));
+	// this is only reached once per job name
+	AUTO_LOCK(m_JobManagerLock);
+
+	// another thread could have registered the name since the lookup above
+	ret = FindJobHandle(cpJobName, cStrLen, nNameHash);
+	if (ret)
+		return ret;
+
+	if (m_nNumRegisteredJobs == JOBSYSTEM_INVOKER_COUNT)
+		__debugbreak(); // breaking here means that more job names are used than JOBSYSTEM_INVOKER_COUNT supports
 
-	bJobIdSet = !it.second;
+	ret = &m_arrRegisteredJobs[m_nNumRegisteredJobs];
+	ret->cpString = cpJobName;
+	ret->strLen = cStrLen;
+	ret->nNameHash = nNameHash;
+	ret->jobId = m_nJobIdCounter;
+	m_nJobIdCounter++;
 
 	// generate color for each entry
-	if (it.second)
-	{
 #if defined(JOBMANAGER_SUPPORT_PROFILING)
-		m_JobColors[cLookup] = GenerateColorBasedOnName(cpJobName);
+	m_JobColors[*ret] = GenerateColorBasedOnName(cpJobName);
 #endif
-		m_arrJobInvokers[m_nJobInvokerIdx] = pInvoker;
-		ret->nJobInvokerIdx = m_nJobInvokerIdx;
-		m_nJobInvokerIdx += 1;
-		//assert(m_nJobInvokerIdx < ANGELICA_ARRAY_COUNT(m_arrJobInvokers));
-	}
-
-	if (!bJobIdSet)
-	{
-		ret->jobId = m_nJobIdCounter;
-		m_nJobIdCounter++;
-	}
+	m_arrJobInvokers[m_nJobInvokerIdx] = pInvoker;
+	ret->nJobInvokerIdx = m_nJobInvokerIdx;
+	m_nJobInvokerIdx += 1;
+	UpdateJobFilterBit(*ret);
+
+	// the handle has to be complete before lock free readers can find it
+	MemoryBarrier();
+	unsigned int nSlot = nNameHash;
+	while (m_arrJobHandleTable[nSlot & (nJobHandleTableSize - 1)] != NULL)
+		++nSlot;
+	m_arrJobHandleTable[nSlot & (nJobHandleTableSize - 1)] = ret;
+	m_nNumRegisteredJobs = m_nNumRegisteredJobs + 1;
 
 	return ret;
 }
@@ -492,10 +732,10 @@ const char* JobManager::CJobManager::GetJobName(JobManager::Invoker invoker)
 		return "JobNotFound";
 
 	// now search for thix idx in all registered jobs
-	for (std::set<JobManager::SJobStringHandle>::iterator it = m_registeredJobs.begin(), end = m_registeredJobs.end(); it != end; ++it)
+	for (unsigned int i = 0, nNumRegisteredJobs = m_nNumRegisteredJobs; i < nNumRegisteredJobs; ++i)
 	{
-		if (it->nJobInvokerIdx == idx)
-			return it->cpString;
+		if (m_arrRegisteredJobs[i].nJobInvokerIdx == idx)
+			return m_arrRegisteredJobs[i].cpString;
 	}
 
 	return "JobNotFound";
@@ -503,15 +743,62 @@ const char* JobManager::CJobManager::GetJobName(JobManager::Invoker invoker)
 
 void JobManager::CJobManager::AddJob(JobManager::CJobDelegator& crJob, const JobManager::TJobHandle cJobHandle)
 {
-	char job_info[128];
-	sprintf_s(job_info, "AddJob_%s", cJobHandle->cpString);
-	//AngelicaProfile::detail::SetProfilingEvent(0, job_info);
-
 	JobManager::SInfoBlock infoBlock;
 
 	// Test if the job should be invoked
 	bool bUseJobSystem = m_nJobSystemEnabled ? CJobManager::InvokeAsJob(cJobHandle) : false;
 
+	InitInfoBlock(crJob, cJobHandle, infoBlock);
+
+	// main thread jobs are queued even while the job system is disabled, only the main thread may run them
+	IF (crJob.GetTargetWorker() == JobManager::eTW_MainThread && m_pThreadBackEnd && m_Initialized, 0)
+		return static_cast<ThreadBackEnd::CThreadBackEnd*>(m_pThreadBackEnd)->ThreadBackEnd::CThreadBackEnd::AddMainThreadJob(crJob, cJobHandle, infoBlock);
+
+	// == dispatch to the right BackEnd == //
+	IF (crJob.IsBlocking() == false && (bUseJobSystem == false || m_Initialized == false), 0)
+		return static_cast<FallBackBackEnd::CFallBackBackEnd*>(m_pFallBackBackEnd)->FallBackBackEnd::CFallBackBackEnd::AddJob(crJob, cJobHandle, infoBlock);
+
+	IF (m_pBlockingBackEnd && crJob.IsBlocking(), 0)
+		return static_cast<BlockingBackEnd::CBlockingBackEnd*>(m_pBlockingBackEnd)->BlockingBackEnd::CBlockingBackEnd::AddJob(crJob, cJobHandle, infoBlock);
+
+	// default case is the threadbackend
+	if (m_pThreadBackEnd)
+		return static_cast<ThreadBackEnd::CThreadBackEnd*>(m_pThreadBackEnd)->ThreadBackEnd::CThreadBackEnd::AddJob(crJob, cJobHandle, infoBlock);
+
+	// last resort - fallback backend
+	return static_cast<FallBackBackEnd::CFallBackBackEnd*>(m_pFallBackBackEnd)->FallBackBackEnd::CFallBackBackEnd::AddJob(crJob, cJobHandle, infoBlock);
+}
+
+void JobManager::CJobManager::AddJobs(JobManager::CJobBase* const* ppJobs, unsigned int nNumJobs)
+{
+	IF (m_Initialized == false || m_nJobSystemEnabled == 0 || m_pThreadBackEnd == NULL, 0)
+	{
+		for (unsigned int i = 0; i < nNumJobs; ++i)
+			ppJobs[i]->Run();
+		return;
+	}
+
+	// hand runs of thread backend jobs over in one go, blocking and filtered jobs take the regular path
+	unsigned int nRunStart = 0;
+	for (unsigned int i = 0; i < nNumJobs; ++i)
+	{
+		CJobBase* pJob = ppJobs[i];
+		if (pJob->GetJobDelegator()->IsBlocking() == false && pJob->GetJobDelegator()->GetTargetWorker() != JobManager::eTW_MainThread &&
+		    CJobManager::InvokeAsJob(pJob->GetJobProgramData()))
+			continue;
+
+		if (i > nRunStart)
+			static_cast<ThreadBackEnd::CThreadBackEnd*>(m_pThreadBackEnd)->ThreadBackEnd::CThreadBackEnd::AddJobs(ppJobs + nRunStart, i - nRunStart);
+		pJob->Run();
+		nRunStart = i + 1;
+	}
+
+	if (nNumJobs > nRunStart)
+		static_cast<ThreadBackEnd::CThreadBackEnd*>(m_pThreadBackEnd)->ThreadBackEnd::CThreadBackEnd::AddJobs(ppJobs + nRunStart, nNumJobs - nRunStart);
+}
+
+void JobManager::CJobManager::InitInfoBlock(JobManager::CJobDelegator& crJob, const JobManager::TJobHandle cJobHandle, JobManager::SInfoBlock& infoBlock)
+{
 	// get producer/consumer queue settings
 	JobManager::SProdConsQueueBase* cpQueue = crJob.GetQueue();
 	const bool cNoQueue = (cpQueue == NULL);
@@ -521,12 +808,17 @@ void JobManager::CJobManager::AddJob(JobManager::CJobDelegator& crJob, const Job
 
 	//reset info block
 	unsigned int flagSet = cNoQueue ? 0 : (unsigned int)JobManager::SInfoBlock::scHasQueue;
+	if (crJob.IsInvokeOnCancel())
+		flagSet |= (unsigned int)JobManager::SInfoBlock::scInvokeOnCancel;
+	if (crJob.GetTargetWorker() != JobManager::eTW_AnyWorker)
+		flagSet |= (unsigned int)JobManager::SInfoBlock::scBoundToWorker;
 
 	infoBlock.pQueue = cpQueue;
 	infoBlock.nflags = (unsigned char)(flagSet);
 	infoBlock.paramSize = cParamSize;
 	infoBlock.jobInvoker = crJob.GetGenericDelegator();
-	infoBlock.jobLambdaInvoker = crJob.GetLambda();
+	infoBlock.nDeadlineTicks = crJob.GetDeadline();
+	infoBlock.pCancellationToken = cNoQueue ? crJob.GetCancellationToken() : NULL; // producer/consumer queue jobs run until the queue is drained
 #if defined(JOBMANAGER_SUPPORT_PROFILING)
 	infoBlock.profilerIndex = crJob.GetProfilingDataIndex();
 #endif
@@ -541,24 +833,11 @@ void JobManager::CJobManager::AddJob(JobManager::CJobDelegator& crJob, const Job
 	SJobProfilingData* pJobProfilingData = GetJobManagerInterface()->GetProfilingData(infoBlock.profilerIndex);
 	pJobProfilingData->jobHandle = cJobHandle;
 #endif
-
-	// == dispatch to the right BackEnd == //
-	IF (crJob.IsBlocking() == false && (bUseJobSystem == false || m_Initialized == false), 0)
-		return static_cast<FallBackBackEnd::CFallBackBackEnd*>(m_pFallBackBackEnd)->FallBackBackEnd::CFallBackBackEnd::AddJob(crJob, cJobHandle, infoBlock);
-
-	IF (m_pBlockingBackEnd && crJob.IsBlocking(), 0)
-		return static_cast<BlockingBackEnd::CBlockingBackEnd*>(m_pBlockingBackEnd)->BlockingBackEnd::CBlockingBackEnd::AddJob(crJob, cJobHandle, infoBlock);
-
-	// default case is the threadbackend
-	if (m_pThreadBackEnd)
-		return static_cast<ThreadBackEnd::CThreadBackEnd*>(m_pThreadBackEnd)->ThreadBackEnd::CThreadBackEnd::AddJob(crJob, cJobHandle, infoBlock);
-
-	// last resort - fallback backend
-	return static_cast<FallBackBackEnd::CFallBackBackEnd*>(m_pFallBackBackEnd)->FallBackBackEnd::CFallBackBackEnd::AddJob(crJob, cJobHandle, infoBlock);
 }
 
 void JobManager::CJobManager::AddLambdaJob(const char* jobName, const std::function<void()>& callback, TPriorityLevel priority, SJobState* pJobState)
 {
+	// std::function isn't trivially copyable, it is copied into a pooled closure block
 	CJobLambda job(jobName, callback);
 	job.SetPriorityLevel(priority);
 	if (pJobState)
@@ -566,13 +845,59 @@ void JobManager::CJobManager::AddLambdaJob(const char* jobName, const std::funct
 	job.Run();
 }
 
+JobManager::TJobTimerHandle JobManager::CJobManager::AddDelayedJob(unsigned int nDelayMilliSec, const char* jobName, const std::function<void()>& callback, TPriorityLevel priority, SJobState* pJobState)
+{
+	return m_pTimerWheel->AddTimer(nDelayMilliSec, 0, jobName, callback, priority, pJobState);
+}
+
+JobManager::TJobTimerHandle JobManager::CJobManager::AddPeriodicJob(unsigned int nPeriodMilliSec, const char* jobName, const std::function<void()>& callback, TPriorityLevel priority)
+{
+	// a period of 0 would be a delayed job
+	return m_pTimerWheel->AddTimer(nPeriodMilliSec, nPeriodMilliSec ? nPeriodMilliSec : 1, jobName, callback, priority, NULL);
+}
+
+bool JobManager::CJobManager::CancelJobTimer(JobManager::TJobTimerHandle hTimer)
+{
+	return m_pTimerWheel->CancelTimer(hTimer);
+}
+
+void JobManager::CJobManager::SetJobTimerSlack(unsigned int nSlackMilliSec)
+{
+	m_pTimerWheel->SetSlack(nSlackMilliSec);
+}
+
+unsigned int JobManager::CJobManager::PumpMainThreadJobs(unsigned int nBudgetMicroSec)
+{
+	if (m_pThreadBackEnd == NULL)
+		return 0;
+
+	return static_cast<ThreadBackEnd::CThreadBackEnd*>(m_pThreadBackEnd)->PumpMainThreadJobs(nBudgetMicroSec);
+}
+
+JobManager::CJobManager::~CJobManager()
+{
+	// the worker and timer threads still use the backends if ShutDown wasn't called, a second ShutDown does nothing
+	ShutDown();
+
+	delete m_pThreadBackEnd;
+	delete m_pFallBackBackEnd;
+	// constructed with placement new into aligned memory
+	if (m_pBlockingBackEnd)
+		m_pBlockingBackEnd->~IBackend();
+	_aligned_free(m_pBlockingBackEnd);
+	delete m_pTimerWheel;
+}
+
 void JobManager::CJobManager::ShutDown()
 {
+	// stop the timers first, they submit into the backends
+	if (m_pTimerWheel) m_pTimerWheel->ShutDown();
 	if (m_pFallBackBackEnd) m_pFallBackBackEnd->ShutDown();
 	if (m_pThreadBackEnd) m_pThreadBackEnd->ShutDown();
 	if (m_pBlockingBackEnd) m_pBlockingBackEnd->ShutDown();
 }
 
+#if ANGELICA_PLATFORM_WINDOWS
 CStringA TraceStack()
 
 {
@@ -643,31 +968,67 @@ CStringA TraceStack()
 	return result;
 
 }
+#else
+std::string TraceStack()
+{
+	static const int MAX_STACK_FRAMES = 10;
+
+	void* pStack[MAX_STACK_FRAMES];
+	const int frames = backtrace(pStack, MAX_STACK_FRAMES);
+	char** ppSymbols = backtrace_symbols(pStack, frames);
+
+	std::string result;
+	for (int i = 0; i < frames; ++i)
+	{
+		result += "\t";
+		result += ppSymbols ? ppSymbols[i] : "error";
+		result += "\n";
+	}
+	free(ppSymbols);
+
+	return result;
+}
+#endif
 
 void JobManager::CJobManager::Init(UINT32 nSysMaxWorker)
 {
 	// only init once
 	if (m_Initialized)
 		return;
-	CStringA result = TraceStack();
+	TraceStack();
 	m_Initialized = true;
 
+	// size the worker pool from the cpu topology
+	JobManager::detail::DetectCpuTopology(m_cpuTopology);
+	JobManager::detail::BuildWorkerPoolLayout(m_cpuTopology, nSysMaxWorker, m_workerPoolLayout);
+
 	// initialize the backends for this platform
 	if (m_pThreadBackEnd)
 	{
-		if (!m_pThreadBackEnd->Init(nSysMaxWorker))
+		if (!m_pThreadBackEnd->Init(m_workerPoolLayout.nNumWorkers))
 		{
 			delete m_pThreadBackEnd;
 			m_pThreadBackEnd = NULL;
 		}
 	}
 	if (m_pBlockingBackEnd)    m_pBlockingBackEnd->Init(1);
+
+	// timer jobs are only submitted once the backends run
+	if (m_pTimerWheel)         m_pTimerWheel->Start();
 }
 
 bool JobManager::CJobManager::InvokeAsJob(const JobManager::TJobHandle cJobHandle) const
 {
-	const char* cpJobName = cJobHandle->cpString;
-	return this->CJobManager::InvokeAsJob(cpJobName);
+#if defined(_RELEASE)
+	return true; // no support for fallback interface in release
+#endif
+
+	// the filter was matched against the name when the job was registered or the filter was set
+	const unsigned int nJobId = (unsigned int)cJobHandle->jobId;
+	IF (nJobId < JOBSYSTEM_INVOKER_COUNT && (m_arrFilteredJobs[nJobId / 32] & (1u << (nJobId % 32))), 0)
+		return false;
+
+	return m_nJobSystemEnabled != 0;
 }
 
 bool JobManager::CJobManager::InvokeAsJob(const char* cpJobName) const
@@ -676,6 +1037,14 @@ bool JobManager::CJobManager::InvokeAsJob(const char* cpJobName) const
 	return true; // no support for fallback interface in release
 #endif
 
+	IF (IsInJobFilter(cpJobName), 0)
+		return false;
+
+	return m_nJobSystemEnabled != 0;
+}
+
+bool JobManager::CJobManager::IsInJobFilter(const char* cpJobName) const
+{
 	// try to find the jobname in the job filter list
 	IF (m_pJobFilter, 0)
 	{
@@ -684,11 +1053,28 @@ bool JobManager::CJobManager::InvokeAsJob(const char* cpJobName) const
 			{
 				p += strlen(cpJobName);
 				if (*p == 0 || *p == ',')
-					return false;
+					return true;
 			}
 	}
 
-	return m_nJobSystemEnabled != 0;
+	return false;
+}
+
+void JobManager::CJobManager::SetJobFilter(const char* pFilter)
+{
+	AUTO_LOCK(m_JobManagerLock);
+	m_pJobFilter = pFilter;
+	for (unsigned int i = 0, nNumRegisteredJobs = m_nNumRegisteredJobs; i < nNumRegisteredJobs; ++i)
+		UpdateJobFilterBit(m_arrRegisteredJobs[i]);
+}
+
+void JobManager::CJobManager::UpdateJobFilterBit(const JobManager::SJobStringHandle& rJobHandle)
+{
+	const unsigned int nJobId = (unsigned int)rJobHandle.jobId;
+	if (IsInJobFilter(rJobHandle.cpString))
+		m_arrFilteredJobs[nJobId / 32] = m_arrFilteredJobs[nJobId / 32] | (1u << (nJobId % 32));
+	else
+		m_arrFilteredJobs[nJobId / 32] = m_arrFilteredJobs[nJobId / 32] & ~(1u << (nJobId % 32));
 }
 
 UINT32 JobManager::CJobManager::GetWorkerThreadId() const
@@ -1013,7 +1399,7 @@ void JobManager::CJobManager::Update(int nJobSystemProfiler)
 	float pixelPerTime = (float)fGraphWidth / diffTime.GetValue();
 
 	const int nNumWorker = m_pThreadBackEnd->GetNumWorkerThreads();
-	const int nNumJobs = m_registeredJobs.size();
+	const int nNumJobs = m_nNumRegisteredJobs;
 	const int nGraphSize = (int)fGraphWidth;
 	int nNumRegions = m_nMainThreadMarkerIndex[nFrameId] + m_nRenderThreadMarkerIndex[nFrameId];
 
@@ -1097,12 +1483,10 @@ void JobManager::CJobManager::Update(int nJobSystemProfiler)
 	memset(arrJobProfilingRenderData, 0, nNumJobs * sizeof(SJobProflingRenderData));
 
 	// init job data
-	int nJobIndex = 0;
-	for (std::set<JobManager::SJobStringHandle>::const_iterator it = m_registeredJobs.begin(); it != m_registeredJobs.end(); ++it)
+	for (int nJobIndex = 0; nJobIndex < nNumJobs; ++nJobIndex)
 	{
-		arrJobProfilingRenderData[nJobIndex].pName = it->cpString;
-		arrJobProfilingRenderData[nJobIndex].color = m_JobColors[*it];
-		++nJobIndex;
+		arrJobProfilingRenderData[nJobIndex].pName = m_arrRegisteredJobs[nJobIndex].cpString;
+		arrJobProfilingRenderData[nJobIndex].color = m_JobColors[m_arrRegisteredJobs[nJobIndex]];
 	}
 
 	std::sort(arrJobProfilingRenderData, arrJobProfilingRenderData + nNumJobs);
@@ -1472,6 +1856,13 @@ void JobManager::CJobManager::Update(int nJobSystemProfiler)
 #endif
 }
 
+bool JobManager::CJobManager::IsCurrentJobCancelled() const
+{
+	const JobManager::CJobCancellationToken* pToken = JobManager::detail::GetCurrentJobCancellationToken();
+	return pToken && pToken->IsCancelled();
+}
+
+///////////////////////////////////////////////////////////////////////////////
 void JobManager::CJobManager::SetFrameStartTime(const CTimeValue& rFrameStartTime)
 {
 #if defined(JOBMANAGER_SUPPORT_PROFILING)
@@ -1620,14 +2011,150 @@ SJobFinishedConditionVariable* JobManager::CJobManager::GetSemaphore(JobManager:
 	return &m_JobSemaphorePool[nIndex];
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void* JobManager::CJobManager::AllocateLambdaClosure(size_t nSize)
+{
+	const unsigned int nShift = LambdaClosureSizeShift(nSize);
+	IF (nShift > nLambdaClosureMaxSizeShift, 0)
+		return _aligned_malloc(nSize, 16);
+
+	// reuse a block of the size class, only allocate while the pool is warming up
+	void* pBlock = AngelicaInterlockedPopEntrySList(m_lambdaClosurePool[nShift - nLambdaClosureMinSizeShift]);
+	if (pBlock == NULL)
+		pBlock = _aligned_malloc((size_t)1 << nShift, 16);
+	return pBlock;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::CJobManager::FreeLambdaClosure(void* pClosure, size_t nSize)
+{
+	const unsigned int nShift = LambdaClosureSizeShift(nSize);
+	IF (nShift > nLambdaClosureMaxSizeShift, 0)
+	{
+		_aligned_free(pClosure);
+		return;
+	}
+
+	// the closure is destroyed, its memory is reused as free list entry
+	AngelicaInterlockedPushEntrySList(m_lambdaClosurePool[nShift - nLambdaClosureMinSizeShift], *static_cast<SLockFreeSingleLinkedListEntry*>(pClosure));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::CJobManager::SetWorkerPoolPolicy(JobManager::EWorkerPoolPolicy policy, unsigned int nReservedCores, bool bPinWorkers)
+{
+	// the worker pool is created in Init, changing the policy afterwards has no effect
+	if (m_Initialized)
+		return;
+
+	m_workerPoolLayout.policy = policy;
+	m_workerPoolLayout.nReservedCores = nReservedCores;
+	m_workerPoolLayout.bPinWorkers = bPinWorkers;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::CJobManager::DumpWorkerPoolLayout()
+{
+	char szLine[256];
+	OutputDebugStringA("== JobManager CPU Topology ==\n");
+	sprintf_s(szLine, "Logical cores: %u | Physical cores: %u | Packages: %u | L2 domains: %u | L3 domains: %u | NUMA nodes: %u\n",
+	          m_cpuTopology.nNumLogicalCores, m_cpuTopology.nNumPhysicalCores, m_cpuTopology.nNumPackages, m_cpuTopology.nNumL2Domains, m_cpuTopology.nNumL3Domains, m_cpuTopology.nNumNumaNodes);
+	OutputDebugStringA(szLine);
+	for (unsigned int i = 0; i < m_cpuTopology.nNumLogicalCores; ++i)
+	{
+		sprintf_s(szLine, "  Logical core %2u: physical core %u | package %u | L2 %u | L3 %u | node %u\n", i,
+		          m_cpuTopology.arrPhysicalCore[i], m_cpuTopology.arrPackage[i], m_cpuTopology.arrL2Domain[i], m_cpuTopology.arrL3Domain[i],
+		          m_cpuTopology.arrNumaNodeId[m_cpuTopology.arrNumaNode[i]]);
+		OutputDebugStringA(szLine);
+	}
+
+	OutputDebugStringA("== JobManager Worker Pool Layout ==\n");
+	sprintf_s(szLine, "Policy: %s | Reserved cores: %u | Pinned: %s | Workers: %u\n",
+	          JobManager::detail::GetWorkerPoolPolicyName(m_workerPoolLayout.policy), m_workerPoolLayout.nReservedCores,
+	          m_workerPoolLayout.bPinWorkers ? "yes" : "no", m_workerPoolLayout.nNumWorkers);
+	OutputDebugStringA(szLine);
+	for (unsigned int i = 0; i < m_workerPoolLayout.nNumWorkers; ++i)
+	{
+		const unsigned int nLogicalCore = m_workerPoolLayout.arrWorkerLogicalCore[i];
+		sprintf_s(szLine, "  JobSystem_Worker_%u: logical core %u | physical core %u | L3 %u | node %u\n", i,
+		          nLogicalCore, m_cpuTopology.arrPhysicalCore[nLogicalCore], m_cpuTopology.arrL3Domain[nLogicalCore],
+		          m_cpuTopology.arrNumaNodeId[m_workerPoolLayout.arrWorkerNumaNode[i]]);
+		OutputDebugStringA(szLine);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::CJobManager::SetJobQueueCapacity(JobManager::TPriorityLevel priority, unsigned int nCapacity)
+{
+	// the queues are allocated in Init, changing the capacity afterwards has no effect
+	if (m_Initialized || priority >= JobManager::eNumPriorityLevel)
+		return;
+
+	m_arrJobQueueCapacity[priority] = nCapacity;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::CJobManager::SetWorkerIdleSettings(const JobManager::SWorkerIdleSettings& rSettings)
+{
+	// the workers copy the settings each time they go idle, a torn update only affects one idle period
+	m_workerIdleSettings = rSettings;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::CJobManager::GetWorkerIdleStats(JobManager::SWorkerIdleStats& rStats) const
+{
+	memset(&rStats, 0, sizeof(rStats));
+	if (m_Initialized && m_pThreadBackEnd)
+		static_cast<ThreadBackEnd::CThreadBackEnd*>(m_pThreadBackEnd)->GetWorkerIdleStats(rStats);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::CJobManager::ResetWorkerIdleStats()
+{
+	if (m_Initialized && m_pThreadBackEnd)
+		static_cast<ThreadBackEnd::CThreadBackEnd*>(m_pThreadBackEnd)->ResetWorkerIdleStats();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::CJobManager::SetFiberMode(bool bEnable, unsigned int nFiberStackSize)
+{
+	// the workers are created in Init, changing the mode afterwards has no effect
+	if (m_Initialized)
+		return;
+
+	m_bFiberMode = bEnable;
+	m_nFiberStackSize = nFiberStackSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::CJobManager::GetJobQueueStats(JobManager::SJobQueueStats& rStats) const
+{
+	memset(&rStats, 0, sizeof(rStats));
+	if (m_Initialized && m_pThreadBackEnd)
+		static_cast<ThreadBackEnd::CThreadBackEnd*>(m_pThreadBackEnd)->GetJobQueueStats(rStats);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::CJobManager::ResetJobQueueStats()
+{
+	if (m_Initialized && m_pThreadBackEnd)
+		static_cast<ThreadBackEnd::CThreadBackEnd*>(m_pThreadBackEnd)->ResetJobQueueStats();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::CJobManager::SetPrioritySchedulingSettings(const JobManager::SPrioritySchedulingSettings& rSettings)
+{
+	// like the idle settings, a torn update only affects the selection of a few jobs
+	m_prioritySchedulingSettings = rSettings;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void JobManager::CJobManager::DumpJobList()
 {
 	int i = 1;
 	//AngelicaLogAlways("== JobManager registered Job List ==");
-	for (std::set<JobManager::SJobStringHandle>::iterator it = m_registeredJobs.begin(); it != m_registeredJobs.end(); ++it)
+	for (unsigned int j = 0, nNumRegisteredJobs = m_nNumRegisteredJobs; j < nNumRegisteredJobs; ++j)
 	{
-		//AngelicaLogAlways("%3d. %s", i++, it->cpString);
+		//AngelicaLogAlways("%3d. %s", i++, m_arrRegisteredJobs[j].cpString);
 	}
 }
 
@@ -1660,6 +2187,7 @@ void JobManager::CJobManager::AddBlockingFallbackJob(JobManager::SInfoBlock* pIn
 	assert(m_pFallBackBackEnd);
 	static_cast<BlockingBackEnd::CBlockingBackEnd*>(m_pBlockingBackEnd)->AddBlockingFallbackJob(pInfoBlock, nWorkerThreadID);
 }
+#if ANGELICA_PLATFORM_WINDOWS
 extern "C" {
 	__declspec(dllimport) unsigned long __stdcall TlsAlloc();
 	__declspec(dllimport) void* __stdcall         TlsGetValue(unsigned long dwTlsIndex);
@@ -1681,10 +2209,20 @@ extern "C" {
 	  Init ## var g_init ## var;
 #define TLS_GET(type, var)                              (type)TlsGetValue(var ## idx)
 #define TLS_SET(var, val)                               TlsSetValue(var ## idx, (void*)(val))
+#else
+// compiler TLS, a worker id lookup is a single fs/gs relative load
+#define TLS_DECLARE(type, var)                     extern thread_local type var;
+#define TLS_DEFINE(type, var)                      thread_local type var = 0;
+#define TLS_DEFINE_DEFAULT_VALUE(type, var, value) thread_local type var = (type)(value);
+#define TLS_GET(type, var)                         (type)(var)
+#define TLS_SET(var, val)                          (var = (val))
+#endif
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 TLS_DEFINE(UINT32, gWorkerThreadId);
 TLS_DEFINE(uintptr_t, gFallbackInfoBlocks);
+TLS_DEFINE(uintptr_t, gFiberThreadState);
+TLS_DEFINE(uintptr_t, gCancellationToken);
 
 ///////////////////////////////////////////////////////////////////////////////
 namespace JobManager {
@@ -1710,6 +2248,30 @@ UINT32 JobManager::detail::GetWorkerThreadId()
 	return is_marked_worker_thread_id(nID) ? unmark_worker_thread_id(nID) : ~0;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::detail::SetFiberThreadState(void* pFiberThreadState)
+{
+	TLS_SET(gFiberThreadState, (uintptr_t)pFiberThreadState);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void* JobManager::detail::GetFiberThreadState()
+{
+	return (void*)TLS_GET(uintptr_t, gFiberThreadState);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::detail::SetCurrentJobCancellationToken(const JobManager::CJobCancellationToken* pToken)
+{
+	TLS_SET(gCancellationToken, (uintptr_t)pToken);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+const JobManager::CJobCancellationToken* JobManager::detail::GetCurrentJobCancellationToken()
+{
+	return (const JobManager::CJobCancellationToken*)TLS_GET(uintptr_t, gCancellationToken);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void JobManager::detail::PushToFallbackJobList(JobManager::SInfoBlock* pInfoBlock)
 {
@@ -1726,3 +2288,103 @@ JobManager::SInfoBlock* JobManager::detail::PopFromFallbackJobList()
 	}
 	return pRet;
 }
+
+///////////////////////////////////////////////////////////////////////////////
+namespace
+{
+// continuations parked on job states, in address hashed lists so unrelated job states rarely share a lock
+// parking and resuming both take the list lock, which makes the value check of the parking side atomic to the resuming side
+enum { eNumContinuationBuckets = 64 };
+
+struct _declspec(align(64)) SContinuationBucket
+{
+	volatile int                       nLock;
+	JobManager::SJobStateContinuation* pContinuations;
+};
+
+SContinuationBucket g_arrContinuationBuckets[eNumContinuationBuckets];
+
+inline SContinuationBucket& GetContinuationBucket(volatile void* pAddress)
+{
+	return g_arrContinuationBuckets[((UINT_PTR)pAddress >> 2) % eNumContinuationBuckets];
+}
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+bool JobManager::detail::ParkContinuation(volatile void* pAddress, unsigned int nCompareValue, JobManager::SJobStateContinuation* pContinuation)
+{
+	SContinuationBucket& rBucket = GetContinuationBucket(pAddress);
+
+	AngelicaSpinLock(&rBucket.nLock, 0, 1);
+	if (*static_cast<volatile unsigned int*>(pAddress) != nCompareValue)
+	{
+		AngelicaReleaseSpinLock(&rBucket.nLock, 0);
+		return false;
+	}
+
+	pContinuation->pWaitAddress = pAddress;
+	pContinuation->pNext = rBucket.pContinuations;
+	rBucket.pContinuations = pContinuation;
+	AngelicaReleaseSpinLock(&rBucket.nLock, 0);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::detail::ResumeContinuations(volatile void* pAddress)
+{
+	SContinuationBucket& rBucket = GetContinuationBucket(pAddress);
+	JobManager::SJobStateContinuation* pResumed = NULL;
+
+	AngelicaSpinLock(&rBucket.nLock, 0, 1);
+	bool bCheckedStopped = false;
+	JobManager::SJobStateContinuation** ppLink = &rBucket.pContinuations;
+	while (JobManager::SJobStateContinuation* pContinuation = *ppLink)
+	{
+		if (pContinuation->pWaitAddress != pAddress)
+		{
+			ppLink = &pContinuation->pNext;
+			continue;
+		}
+
+		// the job state can have been started again, or reused at the same address, since the caller stopped it
+		// its parked continuations then wait for the next stop, the memory is valid as their owners are still waiting on it
+		if (!bCheckedStopped)
+		{
+			if (JobManager::SJobSyncVariable::KeepWaiting(pAddress))
+				break;
+			bCheckedStopped = true;
+		}
+
+		*ppLink = pContinuation->pNext;
+		pContinuation->pNext = pResumed;
+		pResumed = pContinuation;
+	}
+	AngelicaReleaseSpinLock(&rBucket.nLock, 0);
+
+	// outside of the lock, a continuation can park itself again or release its memory
+	while (pResumed)
+	{
+		JobManager::SJobStateContinuation* pNext = pResumed->pNext;
+		pResumed->pResume(pResumed);
+		pResumed = pNext;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool JobManager::detail::UnparkContinuation(JobManager::SJobStateContinuation* pContinuation)
+{
+	SContinuationBucket& rBucket = GetContinuationBucket(pContinuation->pWaitAddress);
+
+	AngelicaSpinLock(&rBucket.nLock, 0, 1);
+	for (JobManager::SJobStateContinuation** ppLink = &rBucket.pContinuations; *ppLink; ppLink = &(*ppLink)->pNext)
+	{
+		if (*ppLink == pContinuation)
+		{
+			*ppLink = pContinuation->pNext;
+			AngelicaReleaseSpinLock(&rBucket.nLock, 0);
+			return true;
+		}
+	}
+	AngelicaReleaseSpinLock(&rBucket.nLock, 0);
+	return false;
+}
@@ -13,7 +13,9 @@
 
 
 #include <map>
+#if defined(_WIN32)
 #include<windows.h>
+#endif
 #include "IJobManager.h"
 #include "JobStructs.h"
 ///////////////////////////////////////////////////////////////////////////////
@@ -30,6 +32,16 @@ JobManager::SInfoBlock* PopFromFallbackJobList();
 void   SetWorkerThreadId(unsigned int nWorkerThreadId);
 unsigned int GetWorkerThreadId();
 
+// functions to access the per thread state of the fiber scheduler, NULL on threads which don't run job fibers
+void  SetFiberThreadState(void* pFiberThreadState);
+void* GetFiberThreadState();
+
+// functions to access the cancellation token of the job running on this thread, NULL while no job with a token runs
+void                                     SetCurrentJobCancellationToken(const JobManager::CJobCancellationToken* pToken);
+const JobManager::CJobCancellationToken* GetCurrentJobCancellationToken();
+
+class CJobTimerWheel;
+
 } // namespace detail
 
 // Tracks CPU/PPU worker thread(s) utilization and job execution time per frame
@@ -51,6 +63,12 @@ public:
 	// Record execution information for a registered job
 	virtual void RecordJob(const unsigned short profileIndex, const unsigned char workerId, const unsigned int jobId, const unsigned int runTimeMicroSec);
 
+	// Record a queued job which was skipped because it was cancelled
+	virtual void RecordCancelledJob(const unsigned short profileIndex, const unsigned int jobId);
+
+	// Record the completion of a job with a deadline
+	virtual void RecordDeadline(const unsigned short profileIndex, const unsigned int jobId, const int latenessMicroSec);
+
 	// Get worker frame stats for the JobManager::detail::eJOB_FRAME_STATS - 1 frame
 	virtual void GetFrameStats(JobManager::CWorkerFrameStats& rStats) const;
 	virtual void GetFrameStats(TJobFrameStatsContainer& rJobStats, IWorkerBackEndProfiler::EJobSortOrder jobSortOrder) const;
@@ -60,6 +78,9 @@ public:
 	virtual void GetFrameStatsSummary(SWorkerFrameStatsSummary& rStats) const;
 	virtual void GetFrameStatsSummary(SJobFrameStatsSummary& rStats) const;
 
+	// Get deadline stats for the JobManager::detail::eJOB_FRAME_STATS - 1 frame
+	virtual void GetDeadlineStats(SJobDeadlineStats& rStats) const;
+
 	// Returns the index of the active multi-buffered profile data
 	virtual unsigned short GetProfileIndex() const;
 
@@ -90,36 +111,7 @@ protected:
 	unsigned char            m_nCurBufIndex;      // Current buffer index [0,(JobManager::detail::eJOB_FRAME_STATS-1)]
 	SJobStatsInfo    m_JobStatsInfo;      // Information about all job activities
 	SWorkerStatsInfo m_WorkerStatsInfo;   // Information about each worker's utilization
-};
-
-class CJobLambda : public CJobBase
-{
-public:
-	CJobLambda(const char* jobName, const std::function<void()>& lambda)
-	{
-		m_jobHandle = GetJobManagerInterface()->GetJobHandle(jobName, &Invoke);
-		m_JobDelegator.SetJobParamData(0);
-		m_JobDelegator.SetParamDataSize(0);
-		m_JobDelegator.SetDelegator(Invoke);
-		m_JobDelegator.SetLambda(lambda);
-		SetJobProgramData(m_jobHandle);
-	}
-	void SetPriorityLevel(unsigned int nPriorityLevel)
-	{
-		m_JobDelegator.SetPriorityLevel(nPriorityLevel);
-	}
-	void SetBlocking()
-	{
-		m_JobDelegator.SetBlocking();
-	}
-
-private:
-	static void Invoke(void* p)
-	{
-	}
-
-public:
-	TJobHandle m_jobHandle;
+	JobManager::SJobDeadlineStats m_arrDeadlineStats[JobManager::detail::eJOB_FRAME_STATS]; // Deadline stats (multi buffered)
 };
 
 // singleton managing the job queues
@@ -129,23 +121,38 @@ public:
 	// singleton stuff
 	static CJobManager* Instance();
 
-	//destructor
-	virtual ~CJobManager()
-	{
-		delete m_pThreadBackEnd;
-		delete m_pFallBackBackEnd;
-		_aligned_free(m_pBlockingBackEnd);
-	}
+	//destructor, defined next to the CJobTimerWheel definition
+	virtual ~CJobManager();
 
 	virtual void Init(unsigned int nSysMaxWorker) override;
 
 	// wait for a job, preempt the calling thread if the job is not done yet
 	virtual const bool WaitForJob(JobManager::SJobState & rJobState) const override;
 
+	// wait for several jobs with a single park of the calling thread
+	virtual void         WaitForAll(JobManager::SJobState* const* ppJobStates, unsigned int nNumJobStates) const override;
+	virtual unsigned int WaitForAny(JobManager::SJobState* const* ppJobStates, unsigned int nNumJobStates) const override;
+
 	//adds a job
 	virtual void AddJob(JobManager::CJobDelegator & crJob, const JobManager::TJobHandle cJobHandle) override;
 
+	//adds a batch of jobs, runs of thread backend jobs are submitted together
+	virtual void AddJobs(JobManager::CJobBase* const* ppJobs, unsigned int nNumJobs) override;
+
+	//fills the SInfoBlock describing a job and marks its job state as running, used by AddJob and the backends batch submission
+	void InitInfoBlock(JobManager::CJobDelegator& crJob, const JobManager::TJobHandle cJobHandle, JobManager::SInfoBlock& rInfoBlock);
+
 	virtual void AddLambdaJob(const char* jobName, const std::function<void()> &lambdaCallback, TPriorityLevel priority = JobManager::eRegularPriority, SJobState * pJobState = nullptr) override;
+	using IJobManager::AddLambdaJob;
+
+	// delayed and periodic lambda jobs, serviced by the timer wheel thread
+	virtual JobManager::TJobTimerHandle AddDelayedJob(unsigned int nDelayMilliSec, const char* jobName, const std::function<void()>& lambdaCallback, TPriorityLevel priority = JobManager::eRegularPriority, SJobState* pJobState = nullptr) override;
+	virtual JobManager::TJobTimerHandle AddPeriodicJob(unsigned int nPeriodMilliSec, const char* jobName, const std::function<void()>& lambdaCallback, TPriorityLevel priority = JobManager::eRegularPriority) override;
+	virtual bool                        CancelJobTimer(JobManager::TJobTimerHandle hTimer) override;
+	virtual void                        SetJobTimerSlack(unsigned int nSlackMilliSec) override;
+
+	// runs the jobs targeted at the main thread on the calling thread
+	virtual unsigned int PumpMainThreadJobs(unsigned int nBudgetMicroSec = 0) override;
 
 	//obtain job handle from name
 	virtual const JobManager::TJobHandle GetJobHandle(const char* cpJobName, const unsigned int cStrLen, JobManager::Invoker pInvoker) override;
@@ -180,10 +187,8 @@ public:
 	virtual bool InvokeAsJob(const char* cpJobName) const override;
 	virtual bool InvokeAsJob(const JobManager::TJobHandle cJobHandle) const override;
 
-	virtual void SetJobFilter(const char* pFilter) override
-	{
-		m_pJobFilter = pFilter;
-	}
+	// the filter is matched against the registered jobs here and against new jobs when they are registered
+	virtual void SetJobFilter(const char* pFilter) override;
 
 	virtual void SetJobSystemEnabled(int nEnable) override
 	{
@@ -222,6 +227,12 @@ public:
 	//copy the job parameter into the jobinfo  structure
 	static void CopyJobParameter(const unsigned int cJobParamSize, void* pDest, const void* pSrc);
 
+	//copy the job parameter into a slot of a fixed size job queue, parameters which don't fit into a compact slot are moved into a pooled block
+	void CopyJobParameterToQueueSlot(const unsigned int cJobParamSize, JobManager::SInfoBlock& rJobSlot, const void* pSrc);
+
+	//copy a job out of a slot of a fixed size job queue, a pooled parameter block is returned to its pool
+	void CopyJobFromQueueSlot(const JobManager::SInfoBlock& rJobSlot, JobManager::SInfoBlock& rInfoBlock);
+
 	unsigned int GetWorkerThreadId() const override;
 
 	virtual JobManager::SJobProfilingData* GetProfilingData(unsigned short nProfilerIndex) override;
@@ -231,6 +242,8 @@ public:
 
 	virtual void SetFrameStartTime(const CTimeValue &rFrameStartTime) override;
 
+	virtual bool IsCurrentJobCancelled() const override;
+
 	//ColorB GetRegionColor(SMarker::TMarkerString marker);
 	JobManager::Invoker GetJobInvoker(unsigned int nIdx)
 	{
@@ -255,8 +268,39 @@ public:
 	// 'allocate' a semaphore in the jobmanager, and return the index of it
 	virtual SJobFinishedConditionVariable* GetSemaphore(JobManager::TSemaphoreHandle nSemaphoreHandle, volatile const void* pOwner) override;
 
+	// get a block for a lambda closure from the size class pools
+	virtual void* AllocateLambdaClosure(size_t nSize) override;
+
+	// return a lambda closure block to its size class pool
+	virtual void FreeLambdaClosure(void* pClosure, size_t nSize) override;
+
 	virtual void DumpJobList() override;
 
+	virtual void SetWorkerPoolPolicy(JobManager::EWorkerPoolPolicy policy, unsigned int nReservedCores = 1, bool bPinWorkers = false) override;
+	virtual const JobManager::SCpuTopology&      GetCpuTopology() const override      { return m_cpuTopology; }
+	virtual const JobManager::SWorkerPoolLayout& GetWorkerPoolLayout() const override { return m_workerPoolLayout; }
+	virtual void DumpWorkerPoolLayout() override;
+
+	virtual void SetJobQueueCapacity(JobManager::TPriorityLevel priority, unsigned int nCapacity) override;
+	virtual void GetJobQueueStats(JobManager::SJobQueueStats& rStats) const override;
+	virtual void ResetJobQueueStats() override;
+
+	virtual void SetPrioritySchedulingSettings(const JobManager::SPrioritySchedulingSettings& rSettings) override;
+	virtual const JobManager::SPrioritySchedulingSettings& GetPrioritySchedulingSettings() const override { return m_prioritySchedulingSettings; }
+	const unsigned int* GetJobQueueCapacities() const { return m_arrJobQueueCapacity; }
+
+	virtual void SetWorkerIdleSettings(const JobManager::SWorkerIdleSettings& rSettings) override;
+	virtual const JobManager::SWorkerIdleSettings& GetWorkerIdleSettings() const override { return m_workerIdleSettings; }
+	virtual void GetWorkerIdleStats(JobManager::SWorkerIdleStats& rStats) const override;
+	virtual void ResetWorkerIdleStats() override;
+
+	virtual void SetFiberMode(bool bEnable, unsigned int nFiberStackSize = 0) override;
+	bool         IsFiberModeEnabled() const { return m_bFiberMode; }
+	unsigned int GetFiberStackSize() const  { return m_nFiberStackSize; }
+
+	virtual void SetDeadlineScheduling(bool bEnable) override { m_bDeadlineScheduling = bEnable; }
+	virtual bool IsDeadlineSchedulingEnabled() const override { return m_bDeadlineScheduling; }
+
 	//virtual bool OnInputEvent(const SInputEvent &event) override;
 
 	void IncreaseRunJobs();
@@ -274,6 +318,12 @@ private:
 	unsigned int m_nJobInvokerIdx;
 
 	const char* m_pJobFilter;
+	volatile unsigned int m_arrFilteredJobs[JOBSYSTEM_INVOKER_COUNT / 32];   // bit per job id, set if the job filter lists the job
+
+	// true if the job filter lists the name
+	bool IsInJobFilter(const char* cpJobName) const;
+	// update the filter bit of a job, called with m_JobManagerLock held
+	void UpdateJobFilterBit(const JobManager::SJobStringHandle& rJobHandle);
 	int m_nJobSystemEnabled;                                // should the job system be used
 	int m_bJobSystemProfilerEnabled;                        // should the job system profiler be enabled
 	bool m_bJobSystemProfilerPaused;                        // should the job system profiler be paused
@@ -284,14 +334,36 @@ private:
 	IBackend* m_pThreadBackEnd;                 // Backend for regular jobs, available on PC/XBOX. on Xbox threads are polling with a low priority
 	IBackend* m_pBlockingBackEnd;               // Backend for tasks which can block to prevent stalling regular jobs in this case
 
+	JobManager::detail::CJobTimerWheel* m_pTimerWheel;  // delayed and periodic jobs, its thread runs from Init to ShutDown
+
 	unsigned short m_nJobIdCounter;                     // JobId counter for jobs dynamically allocated at runtime
 
-	std::set<JobManager::SJobStringHandle> m_registeredJobs;
+	// registered job handles, only appended under m_JobManagerLock and never moved, so a handle stays valid
+	JobManager::SJobStringHandle m_arrRegisteredJobs[JOBSYSTEM_INVOKER_COUNT];
+	volatile unsigned int m_nNumRegisteredJobs;
+
+	// open addressing table over the registered handles by name hash, a slot is written once after its handle is filled in
+	// so lookups don't lock, a NULL slot ends the probe sequence
+	enum { nJobHandleTableSize = 2 * JOBSYSTEM_INVOKER_COUNT };
+	JobManager::SJobStringHandle* volatile m_arrJobHandleTable[nJobHandleTableSize];
+
+	// lock free lookup, returns NULL if the name isn't registered
+	JobManager::TJobHandle FindJobHandle(const char* cpJobName, unsigned int nStrLen, unsigned int nNameHash) const;
 
 	enum { nSemaphorePoolSize = 16 };
 	SJobFinishedConditionVariable m_JobSemaphorePool[nSemaphorePoolSize];
 	unsigned int m_nCurrentSemaphoreIndex;
 
+	// pooled blocks for lambda closures not fitting into the job parameters, one free list per power of two size class
+	enum { nLambdaClosureMinSizeShift = 6, nLambdaClosureMaxSizeShift = 12, nLambdaClosureSizeClasses = nLambdaClosureMaxSizeShift - nLambdaClosureMinSizeShift + 1 };
+	SLockFreeSingleLinkedListHeader m_lambdaClosurePool[nLambdaClosureSizeClasses];
+
+	// power of two size class of a closure, at least nLambdaClosureMinSizeShift
+	static unsigned int LambdaClosureSizeShift(size_t nSize)
+	{
+		return nSize <= ((size_t)1 << nLambdaClosureMinSizeShift) ? (unsigned int)nLambdaClosureMinSizeShift : IntegerLog2((unsigned int)(nSize - 1)) + 1;
+	}
+
 	// per frame counter for jobs run/fallback jobs
 	unsigned int m_nJobsRunCounter;
 	unsigned int m_nFallbackJobsRunCounter;
@@ -299,6 +371,15 @@ private:
 	JobManager::SInfoBlock** m_pRegularWorkerFallbacks;
 	unsigned int m_nRegularWorkerThreads;
 
+	JobManager::SCpuTopology m_cpuTopology;                 // topology detected in Init
+	JobManager::SWorkerPoolLayout m_workerPoolLayout;       // policy set before Init, worker placement computed in Init
+	unsigned int m_arrJobQueueCapacity[JobManager::eNumPriorityLevel]; // global queue sizes of the thread backend set before Init, 0 for the default
+	JobManager::SWorkerIdleSettings m_workerIdleSettings;   // read by the workers each time they run out of work
+	JobManager::SPrioritySchedulingSettings m_prioritySchedulingSettings; // read by the workers each time they look for a job
+	bool m_bFiberMode;                                      // run thread backend jobs on fibers, set before Init
+	unsigned int m_nFiberStackSize;                         // stack size of the job fibers, 0 for the default
+	bool m_bDeadlineScheduling;                             // queue jobs with a deadline earliest deadline first in the thread backend
+
 	bool m_bSuspendWorkerForMP;
 #if defined(JOBMANAGER_SUPPORT_PROFILING)
 	SJobProfilingDataContainer m_profilingData;
@@ -330,6 +411,43 @@ inline void JobManager::CJobManager::CopyJobParameter(const unsigned int cJobPar
 	memcpy(pDestParam, pSrcParam, cJobParamSize);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+inline void JobManager::CJobManager::CopyJobParameterToQueueSlot(const unsigned int cJobParamSize, JobManager::SInfoBlock& rJobSlot, const void* pSrcParam)
+{
+	IF (cJobParamSize <= JobManager::SInfoBlock::scJobQueueSlotParamSize, 1)
+	{
+		CopyJobParameter(cJobParamSize, rJobSlot.GetParamAddress(), pSrcParam);
+		return;
+	}
+
+	// the parameter blocks share the size class pools of the lambda closures
+	void* pParamBlock = CJobManager::AllocateLambdaClosure(cJobParamSize);
+	CopyJobParameter(cJobParamSize, pParamBlock, pSrcParam);
+	memcpy(rJobSlot.GetParamAddress(), &pParamBlock, sizeof(pParamBlock));
+	rJobSlot.nflags |= (unsigned char)JobManager::SInfoBlock::scParamsPooled;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+inline void JobManager::CJobManager::CopyJobFromQueueSlot(const JobManager::SInfoBlock& rJobSlot, JobManager::SInfoBlock& rInfoBlock)
+{
+	rJobSlot.AssignHeaderTo(&rInfoBlock);
+	if (rInfoBlock.HasQueue())
+		return;
+
+	const unsigned int cJobParamSize = rInfoBlock.paramSize << 4;
+	IF (rInfoBlock.nflags & (unsigned char)JobManager::SInfoBlock::scParamsPooled, 0)
+	{
+		void* pParamBlock;
+		memcpy(&pParamBlock, rJobSlot.paramData, sizeof(pParamBlock));
+		CopyJobParameter(cJobParamSize, rInfoBlock.GetParamAddress(), pParamBlock);
+		CJobManager::FreeLambdaClosure(pParamBlock, cJobParamSize);
+		rInfoBlock.nflags &= ~(unsigned char)JobManager::SInfoBlock::scParamsPooled;
+		return;
+	}
+
+	CopyJobParameter(cJobParamSize, rInfoBlock.GetParamAddress(), rJobSlot.paramData);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 inline void JobManager::CJobManager::IncreaseRunJobs()
 {
@@ -6,7 +6,10 @@
 
 #pragma once
 
-#include "ijobmanager.h"
+#include "IJobManager.h"
+#include "BitFiddling.h"
+#include "CpuTopology.h"
+#include <algorithm>
 
 //forward declarations for friend usage
 namespace JobManager
@@ -40,6 +43,10 @@ static const unsigned int cMaxWorkQueueJobs_BlockingBackEnd_RegularPriority = 25
 static const unsigned int cMaxWorkQueueJobs_BlockingBackEnd_LowPriority = 512;
 static const unsigned int cMaxWorkQueueJobs_BlockingBackEnd_StreamPriority = 128;
 
+// bounds for queue sizes configured at runtime, the 16 bit index per priority level needs some round ids to detect a full queue
+static const unsigned int cMinWorkQueueJobs = 16;
+static const unsigned int cMaxWorkQueueJobs = 16384;
+
 // struct to manage the state of a job slot
 // used to indicate that a info block has been finished writing
 struct SJobQueueSlotState
@@ -59,6 +66,20 @@ private:
 	volatile StateT m_state;
 };
 
+// publication state of a job queue slot, a sequence number in the style of a bounded MPMC queue
+// the producer stores the queue index it reserved once the SInfoBlock is completely written,
+// workers only claim a queue index whose slot carries that index, so they never wait for a half written SInfoBlock
+// the slot keeps the index until the next round publishes into it, the SInfoBlock round id protects it from reuse meanwhile
+struct SJobQueueSlotSequence
+{
+public:
+	bool IsPublished(unsigned int nIndex) const { return m_nSequence == nIndex + 1; }
+	void Publish(unsigned int nIndex)           { m_nSequence = nIndex + 1; }
+
+private:
+	volatile unsigned int m_nSequence;   // queue index + 1 of the last job published into the slot, 0 if none yet
+};
+
 }   // namespace detail
 
 // queue node where jobs are pushed into and pulled from
@@ -79,16 +100,37 @@ struct SJobQueue
 	ANGELICA_ALIGN(128) JobManager::SJobQueuePos push;                     // position in which jobs are pushed by the PPU
 	ANGELICA_ALIGN(128) JobManager::SJobQueuePos pull;                     // position from which jobs are pulled
 
-	JobManager::SInfoBlock*                 jobInfoBlocks[eNumPriorityLevel];      // aligned array of SInfoBlocks per priority level
-	JobManager::detail::SJobQueueSlotState* jobInfoBlockStates[eNumPriorityLevel]; // aligned array of SInfoBlocks states per priority level
+	JobManager::SInfoBlock*                 jobInfoBlocks[eNumPriorityLevel];      // aligned array of SInfoBlock::scSizeOfJobQueueSlot byte slots per priority level, use GetJobInfoBlock
+	JobManager::detail::SJobQueueSlotSequence* jobInfoBlockStates[eNumPriorityLevel]; // aligned array of SInfoBlocks publication states per priority level
+	unsigned int                            maxWorkQueueJobs[eNumPriorityLevel];   // number of SInfoBlocks per priority level, power of two
+	unsigned int                            nNumaNodeId;                           // OS node number the queues were allocated on, ~0 for none
 
 	// initialize the jobqueue, should only be called once
-	void Init();
+	// pMaxWorkQueueJobs holds one queue size per priority level, if NULL the compile time sizes are used
+	// the SInfoBlocks are placed on the NUMA node with the OS node number nNumaNodeId, ~0 for no preference
+	void Init(const unsigned int* pMaxWorkQueueJobs = NULL, unsigned int nNumaNodeId = ~0);
+
+	// release the queues allocated by Init, no jobs may be pushed or pulled anymore
+	void Shutdown();
 
 	//gets job slot for next job (to get storage index for SJobdata), waits until a job slots becomes available again since data get overwritten
 	JobManager::detail::EAddJobRes GetJobSlot(unsigned int& rJobSlot, unsigned int nPriorityLevel, bool bWaitForFreeJobSlot);
 
-	static unsigned int                  GetMaxWorkerQueueJobs(unsigned int nPriorityLevel);
+	//reserves up to nNumJobs consecutive job slots with a single C-A-S on the push index, starting at rFirstJobSlot
+	//returns the number of reserved slots, 0 if the next slot is still in use and bWaitForFreeJobSlot is false
+	unsigned int GetJobSlots(unsigned int& rFirstJobSlot, unsigned int nNumJobs, unsigned int nPriorityLevel, bool bWaitForFreeJobSlot);
+
+	//makes the completely written SInfoBlocks of nNumJobSlots consecutive reserved job slots available to the workers
+	void PublishJobSlots(unsigned int nFirstJobSlot, unsigned int nNumJobSlots, unsigned int nPriorityLevel);
+
+	//returns currentPushIndex with each priority level limited to the published jobs in front of the pull index
+	//a level whose next job is reserved but not yet published looks empty, so workers never claim it
+	unsigned long long GetPublishedPushIndex(unsigned long long currentPullIndex, unsigned long long currentPushIndex) const;
+
+	unsigned int                         GetMaxWorkerQueueJobs(unsigned int nPriorityLevel) const;
+
+	//the slot only holds the header and up to SInfoBlock::scJobQueueSlotParamSize bytes of parameters
+	JobManager::SInfoBlock&              GetJobInfoBlock(unsigned int nPriorityLevel, unsigned int nJobSlot) const { return push.GetInfoBlock(nPriorityLevel, nJobSlot); }
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -130,7 +172,7 @@ inline JobManager::detail::EAddJobRes JobManager::SJobQueue<nMaxWorkQueueJobsHig
 
 		// compute the job slot for this fetch index
 		unsigned int jobSlot = nExtractedIndex & (nMaxWorkerQueueJobs - 1);
-		pPushInfoBlock = &curPushEntry.jobQueue[nPriorityLevel][jobSlot];
+		pPushInfoBlock = &curPushEntry.GetInfoBlock(nPriorityLevel, jobSlot);
 
 		//do not overtake pull pointer
 		bool bWait = false;
@@ -163,7 +205,103 @@ inline JobManager::detail::EAddJobRes JobManager::SJobQueue<nMaxWorkQueueJobsHig
 
 ///////////////////////////////////////////////////////////////////////////////
 template<int nMaxWorkQueueJobsHighPriority, int nMaxWorkQueueJobsRegularPriority, int nMaxWorkQueueJobsLowPriority, int nMaxWorkQueueJobsStreamPriority>
-inline void JobManager::SJobQueue<nMaxWorkQueueJobsHighPriority, nMaxWorkQueueJobsRegularPriority, nMaxWorkQueueJobsLowPriority, nMaxWorkQueueJobsStreamPriority >::Init()
+inline unsigned int JobManager::SJobQueue<nMaxWorkQueueJobsHighPriority, nMaxWorkQueueJobsRegularPriority, nMaxWorkQueueJobsLowPriority, nMaxWorkQueueJobsStreamPriority >::GetJobSlots(unsigned int& rFirstJobSlot, unsigned int nNumJobs, unsigned int nPriorityLevel, bool bWaitForFreeJobSlot)
+{
+	SJobQueuePos& RESTRICT_REFERENCE curPushEntry = push;
+
+	const unsigned int nMaxWorkerQueueJobs = GetMaxWorkerQueueJobs(nPriorityLevel);
+	const unsigned int nMaxRoundID = (1 << JobManager::SJobQueuePos::eBitsPerPriorityLevel) / nMaxWorkerQueueJobs;
+	const unsigned int nIndexMask = (1 << JobManager::SJobQueuePos::eBitsPerPriorityLevel) - 1;
+	nNumJobs = std::min(nNumJobs, nMaxWorkerQueueJobs);
+
+	do
+	{
+		// fetch next to update field
+#if ANGELICA_PLATFORM_WINDOWS || ANGELICA_PLATFORM_APPLE || ANGELICA_PLATFORM_LINUX // emulate a 64bit atomic read on PC platfom
+		const unsigned long long currentIndex = AngelicaInterlockedCompareExchange64(alias_cast<volatile long long*>(&curPushEntry.index), 0, 0);
+#else
+		const unsigned long long currentIndex = *const_cast<volatile unsigned long long*>(&curPushEntry.index);
+#endif
+		const unsigned int nExtractedIndex = static_cast<unsigned int>(JobManager::SJobQueuePos::ExtractIndex(currentIndex, nPriorityLevel));
+
+		// count the free slots following the push index, do not overtake the pull pointer
+		bool bWait = false;
+		bool bRetry = false;
+		unsigned int nNumFreeSlots = 0;
+		for (; nNumFreeSlots < nNumJobs; ++nNumFreeSlots)
+		{
+			const unsigned int nIndex = (nExtractedIndex + nNumFreeSlots) & nIndexMask;
+			curPushEntry.GetInfoBlock(nPriorityLevel, nIndex & (nMaxWorkerQueueJobs - 1)).IsInUse(nIndex / nMaxWorkerQueueJobs, bWait, bRetry, nMaxRoundID);
+			if (bWait || bRetry)
+				break;
+		}
+
+		if (nNumFreeSlots == 0)
+		{
+			if (bRetry) // need to refetch due long suspending time
+				continue;
+
+			if (!bWaitForFreeJobSlot)
+				return 0;
+
+			curPushEntry.GetInfoBlock(nPriorityLevel, nExtractedIndex & (nMaxWorkerQueueJobs - 1)).Wait(nExtractedIndex / nMaxWorkerQueueJobs, nMaxRoundID);
+			continue;
+		}
+
+		const unsigned long long nextIndex = JobManager::SJobQueuePos::IncreasePushIndex(currentIndex, nPriorityLevel, nNumFreeSlots);
+		if ((unsigned long long)AngelicaInterlockedCompareExchange64(alias_cast<volatile long long*>(&curPushEntry.index), nextIndex, currentIndex) == currentIndex)
+		{
+			rFirstJobSlot = nExtractedIndex & (nMaxWorkerQueueJobs - 1);
+			return nNumFreeSlots;
+		}
+	}
+	while (true);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template<int nMaxWorkQueueJobsHighPriority, int nMaxWorkQueueJobsRegularPriority, int nMaxWorkQueueJobsLowPriority, int nMaxWorkQueueJobsStreamPriority>
+inline void JobManager::SJobQueue<nMaxWorkQueueJobsHighPriority, nMaxWorkQueueJobsRegularPriority, nMaxWorkQueueJobsLowPriority, nMaxWorkQueueJobsStreamPriority >::PublishJobSlots(unsigned int nFirstJobSlot, unsigned int nNumJobSlots, unsigned int nPriorityLevel)
+{
+	const unsigned int nMaxWorkerQueueJobs = GetMaxWorkerQueueJobs(nPriorityLevel);
+
+	// all writes to the SInfoBlocks have to be visible before the sequences
+	MemoryBarrier();
+	for (unsigned int i = 0; i < nNumJobSlots; ++i)
+	{
+		// the round id of the SInfoBlock only advances once a worker released it, so it still belongs to our reservation
+		const unsigned int nJobSlot = (nFirstJobSlot + i) & (nMaxWorkerQueueJobs - 1);
+		const unsigned int nRoundID = GetJobInfoBlock(nPriorityLevel, nJobSlot).jobState.nRoundID;
+		jobInfoBlockStates[nPriorityLevel][nJobSlot].Publish(nRoundID * nMaxWorkerQueueJobs + nJobSlot);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template<int nMaxWorkQueueJobsHighPriority, int nMaxWorkQueueJobsRegularPriority, int nMaxWorkQueueJobsLowPriority, int nMaxWorkQueueJobsStreamPriority>
+inline unsigned long long JobManager::SJobQueue<nMaxWorkQueueJobsHighPriority, nMaxWorkQueueJobsRegularPriority, nMaxWorkQueueJobsLowPriority, nMaxWorkQueueJobsStreamPriority >::GetPublishedPushIndex(unsigned long long currentPullIndex, unsigned long long currentPushIndex) const
+{
+	unsigned long long publishedPushIndex = currentPushIndex;
+	for (unsigned int nPriorityLevel = 0; nPriorityLevel < eNumPriorityLevel; ++nPriorityLevel)
+	{
+		const unsigned int nPullIndex = static_cast<unsigned int>(JobManager::SJobQueuePos::ExtractIndex(currentPullIndex, nPriorityLevel));
+		if (nPullIndex == static_cast<unsigned int>(JobManager::SJobQueuePos::ExtractIndex(currentPushIndex, nPriorityLevel)))
+			continue;
+
+		const unsigned int nJobSlot = nPullIndex & (GetMaxWorkerQueueJobs(nPriorityLevel) - 1);
+		if (!jobInfoBlockStates[nPriorityLevel][nJobSlot].IsPublished(nPullIndex))
+		{
+			const unsigned long long nMask = JobManager::SJobQueuePos::GetIndexMask(nPriorityLevel);
+			publishedPushIndex = (publishedPushIndex & ~nMask) | (currentPullIndex & nMask);
+		}
+	}
+
+	// the SInfoBlock may only be read after its sequence was seen
+	MemoryBarrier();
+	return publishedPushIndex;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+template<int nMaxWorkQueueJobsHighPriority, int nMaxWorkQueueJobsRegularPriority, int nMaxWorkQueueJobsLowPriority, int nMaxWorkQueueJobsStreamPriority>
+inline void JobManager::SJobQueue<nMaxWorkQueueJobsHighPriority, nMaxWorkQueueJobsRegularPriority, nMaxWorkQueueJobsLowPriority, nMaxWorkQueueJobsStreamPriority >::Init(const unsigned int* pMaxWorkQueueJobs, unsigned int nNumaNodeId)
 {
 	// verify assumation about queue size at compile time
 	STATIC_CHECK(IsPowerOfTwoCompileTime<eMaxWorkQueueJobsHighPriority>::IsPowerOfTwo, ERROR_MAX_JOB_QUEUE_SIZE__HIGH_PRIORITY_IS_NOT_POWER_OF_TWO);
@@ -171,64 +309,64 @@ inline void JobManager::SJobQueue<nMaxWorkQueueJobsHighPriority, nMaxWorkQueueJo
 	STATIC_CHECK(IsPowerOfTwoCompileTime<eMaxWorkQueueJobsLowPriority>::IsPowerOfTwo, ERROR_MAX_JOB_QUEUE_SIZE__LOW_PRIORITY_IS_NOT_POWER_OF_TWO);
 	STATIC_CHECK(IsPowerOfTwoCompileTime<eMaxWorkQueueJobsStreamPriority>::IsPowerOfTwo, ERROR_MAX_JOB_QUEUE_SIZE__LOW_PRIORITY_IS_NOT_POWER_OF_TWO);
 
-	// init job queues
-	jobInfoBlocks[eHighPriority] = static_cast<JobManager::SInfoBlock*>(_aligned_malloc(eMaxWorkQueueJobsHighPriority * sizeof(JobManager::SInfoBlock), 128));
-	jobInfoBlockStates[eHighPriority] = static_cast<JobManager::detail::SJobQueueSlotState*>(_aligned_malloc(eMaxWorkQueueJobsHighPriority * sizeof(JobManager::detail::SJobQueueSlotState), 128));
-	memset(jobInfoBlocks[eHighPriority], 0, eMaxWorkQueueJobsHighPriority * sizeof(JobManager::SInfoBlock));
-	memset(jobInfoBlockStates[eHighPriority], 0, eMaxWorkQueueJobsHighPriority * sizeof(JobManager::detail::SJobQueueSlotState));
-
-	jobInfoBlocks[eRegularPriority] = static_cast<JobManager::SInfoBlock*>(_aligned_malloc(eMaxWorkQueueJobsRegularPriority * sizeof(JobManager::SInfoBlock), 128));
-	jobInfoBlockStates[eRegularPriority] = static_cast<JobManager::detail::SJobQueueSlotState*>(_aligned_malloc(eMaxWorkQueueJobsRegularPriority * sizeof(JobManager::detail::SJobQueueSlotState), 128));
-	memset(jobInfoBlocks[eRegularPriority], 0, eMaxWorkQueueJobsRegularPriority * sizeof(JobManager::SInfoBlock));
-	memset(jobInfoBlockStates[eRegularPriority], 0, eMaxWorkQueueJobsRegularPriority * sizeof(JobManager::detail::SJobQueueSlotState));
-
-	jobInfoBlocks[eLowPriority] = static_cast<JobManager::SInfoBlock*>(_aligned_malloc(eMaxWorkQueueJobsLowPriority * sizeof(JobManager::SInfoBlock), 128));
-	jobInfoBlockStates[eLowPriority] = static_cast<JobManager::detail::SJobQueueSlotState*>(_aligned_malloc(eMaxWorkQueueJobsLowPriority * sizeof(JobManager::detail::SJobQueueSlotState), 128));
-	memset(jobInfoBlocks[eLowPriority], 0, eMaxWorkQueueJobsLowPriority * sizeof(JobManager::SInfoBlock));
-	memset(jobInfoBlockStates[eLowPriority], 0, eMaxWorkQueueJobsLowPriority * sizeof(JobManager::detail::SJobQueueSlotState));
-
-	jobInfoBlocks[eStreamPriority] = static_cast<JobManager::SInfoBlock*>(_aligned_malloc(eMaxWorkQueueJobsStreamPriority * sizeof(JobManager::SInfoBlock), 128));
-	jobInfoBlockStates[eStreamPriority] = static_cast<JobManager::detail::SJobQueueSlotState*>(_aligned_malloc(eMaxWorkQueueJobsStreamPriority * sizeof(JobManager::detail::SJobQueueSlotState), 128));
-	memset(jobInfoBlocks[eStreamPriority], 0, eMaxWorkQueueJobsStreamPriority * sizeof(JobManager::SInfoBlock));
-	memset(jobInfoBlockStates[eStreamPriority], 0, eMaxWorkQueueJobsStreamPriority * sizeof(JobManager::detail::SJobQueueSlotState));
-
-	// init queue pos objects
-	push.jobQueue[eHighPriority] = jobInfoBlocks[eHighPriority];
-	push.jobQueue[eRegularPriority] = jobInfoBlocks[eRegularPriority];
-	push.jobQueue[eLowPriority] = jobInfoBlocks[eLowPriority];
-	push.jobQueue[eStreamPriority] = jobInfoBlocks[eStreamPriority];
-	push.jobQueueStates[eHighPriority] = jobInfoBlockStates[eHighPriority];
-	push.jobQueueStates[eRegularPriority] = jobInfoBlockStates[eRegularPriority];
-	push.jobQueueStates[eLowPriority] = jobInfoBlockStates[eLowPriority];
-	push.jobQueueStates[eStreamPriority] = jobInfoBlockStates[eStreamPriority];
-	push.index = 0;
+	// the slots hold everything in front of the parameters
+	STATIC_CHECK(offsetof(JobManager::SInfoBlock, paramData) == JobManager::SInfoBlock::scSizeOfJobQueueEntryHeader, ERROR_SINFOBLOCK_HEADER_DOES_NOT_MATCH_ITS_SIZE);
+
+	maxWorkQueueJobs[eHighPriority] = eMaxWorkQueueJobsHighPriority;
+	maxWorkQueueJobs[eRegularPriority] = eMaxWorkQueueJobsRegularPriority;
+	maxWorkQueueJobs[eLowPriority] = eMaxWorkQueueJobsLowPriority;
+	maxWorkQueueJobs[eStreamPriority] = eMaxWorkQueueJobsStreamPriority;
+	this->nNumaNodeId = nNumaNodeId;
 
-	pull.jobQueue[eHighPriority] = jobInfoBlocks[eHighPriority];
-	pull.jobQueue[eRegularPriority] = jobInfoBlocks[eRegularPriority];
-	pull.jobQueue[eLowPriority] = jobInfoBlocks[eLowPriority];
-	pull.jobQueue[eStreamPriority] = jobInfoBlocks[eStreamPriority];
-	pull.jobQueueStates[eHighPriority] = jobInfoBlockStates[eHighPriority];
-	pull.jobQueueStates[eRegularPriority] = jobInfoBlockStates[eRegularPriority];
-	pull.jobQueueStates[eLowPriority] = jobInfoBlockStates[eLowPriority];
-	pull.jobQueueStates[eStreamPriority] = jobInfoBlockStates[eStreamPriority];
+	for (unsigned int nPriorityLevel = 0; nPriorityLevel < eNumPriorityLevel; ++nPriorityLevel)
+	{
+		// runtime sizes are rounded up to the next power of two
+		if (pMaxWorkQueueJobs && pMaxWorkQueueJobs[nPriorityLevel])
+			maxWorkQueueJobs[nPriorityLevel] = NextPower2(std::min(std::max(pMaxWorkQueueJobs[nPriorityLevel], JobManager::detail::cMinWorkQueueJobs), JobManager::detail::cMaxWorkQueueJobs));
+
+		// init job queues
+		const unsigned int nNumJobs = maxWorkQueueJobs[nPriorityLevel];
+		jobInfoBlocks[nPriorityLevel] = static_cast<JobManager::SInfoBlock*>(JobManager::detail::NumaAlignedMalloc(nNumJobs * JobManager::SInfoBlock::scSizeOfJobQueueSlot, 128, nNumaNodeId));
+		jobInfoBlockStates[nPriorityLevel] = static_cast<JobManager::detail::SJobQueueSlotSequence*>(JobManager::detail::NumaAlignedMalloc(nNumJobs * sizeof(JobManager::detail::SJobQueueSlotSequence), 128, nNumaNodeId));
+		// raw storage of slots, with compact slots not an array of SInfoBlocks, a zero round id marks a slot free for the first round
+		memset(static_cast<void*>(jobInfoBlocks[nPriorityLevel]), 0, nNumJobs * JobManager::SInfoBlock::scSizeOfJobQueueSlot);
+		memset(jobInfoBlockStates[nPriorityLevel], 0, nNumJobs * sizeof(JobManager::detail::SJobQueueSlotSequence));
+
+		// init queue pos objects
+		push.jobQueue[nPriorityLevel] = jobInfoBlocks[nPriorityLevel];
+		push.jobQueueStates[nPriorityLevel] = jobInfoBlockStates[nPriorityLevel];
+		pull.jobQueue[nPriorityLevel] = jobInfoBlocks[nPriorityLevel];
+		pull.jobQueueStates[nPriorityLevel] = jobInfoBlockStates[nPriorityLevel];
+	}
+
+	push.index = 0;
 	pull.index = 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 template<int nMaxWorkQueueJobsHighPriority, int nMaxWorkQueueJobsRegularPriority, int nMaxWorkQueueJobsLowPriority, int nMaxWorkQueueJobsStreamPriority>
-inline unsigned int JobManager::SJobQueue<nMaxWorkQueueJobsHighPriority, nMaxWorkQueueJobsRegularPriority, nMaxWorkQueueJobsLowPriority, nMaxWorkQueueJobsStreamPriority >::GetMaxWorkerQueueJobs(unsigned int nPriorityLevel)
+inline void JobManager::SJobQueue<nMaxWorkQueueJobsHighPriority, nMaxWorkQueueJobsRegularPriority, nMaxWorkQueueJobsLowPriority, nMaxWorkQueueJobsStreamPriority >::Shutdown()
 {
-	switch (nPriorityLevel)
+	for (unsigned int nPriorityLevel = 0; nPriorityLevel < eNumPriorityLevel; ++nPriorityLevel)
 	{
-	case eHighPriority:
-		return eMaxWorkQueueJobsHighPriority;
-	case eRegularPriority:
-		return eMaxWorkQueueJobsRegularPriority;
-	case eLowPriority:
-		return eMaxWorkQueueJobsLowPriority;
-	case eStreamPriority:
-		return eMaxWorkQueueJobsStreamPriority;
-	default:
-		return ~0;
+		// same node as in Init, NUMA placed memory is not released by _aligned_free on every platform
+		if (jobInfoBlocks[nPriorityLevel])
+			JobManager::detail::NumaAlignedFree(jobInfoBlocks[nPriorityLevel], nNumaNodeId);
+		if (jobInfoBlockStates[nPriorityLevel])
+			JobManager::detail::NumaAlignedFree(jobInfoBlockStates[nPriorityLevel], nNumaNodeId);
+
+		jobInfoBlocks[nPriorityLevel] = NULL;
+		jobInfoBlockStates[nPriorityLevel] = NULL;
+		push.jobQueue[nPriorityLevel] = NULL;
+		push.jobQueueStates[nPriorityLevel] = NULL;
+		pull.jobQueue[nPriorityLevel] = NULL;
+		pull.jobQueueStates[nPriorityLevel] = NULL;
 	}
 }
+
+///////////////////////////////////////////////////////////////////////////////
+template<int nMaxWorkQueueJobsHighPriority, int nMaxWorkQueueJobsRegularPriority, int nMaxWorkQueueJobsLowPriority, int nMaxWorkQueueJobsStreamPriority>
+inline unsigned int JobManager::SJobQueue<nMaxWorkQueueJobsHighPriority, nMaxWorkQueueJobsRegularPriority, nMaxWorkQueueJobsLowPriority, nMaxWorkQueueJobsStreamPriority >::GetMaxWorkerQueueJobs(unsigned int nPriorityLevel) const
+{
+	return nPriorityLevel < eNumPriorityLevel ? maxWorkQueueJobs[nPriorityLevel] : ~0;
+}
@@ -0,0 +1,426 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   JobTimerWheel.cpp
+//  Version:     v1.00
+//  Compilers:   Visual Studio.NET
+//  Description: Hierarchical timer wheel of the job manager, runs delayed and
+//               periodic lambda jobs from a single service thread
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "AngelicaPlatformDefines.h"
+#if ANGELICA_PLATFORM_WINDOWS
+	#include "Win32specific.h"
+	#include "MSVCspecific.h"
+#else
+	#include "Linuxspecific.h"
+	#include "GCCspecific.h"
+#endif
+#include "AngelicaAtomics.h"
+#include "JobTimerWheel.h"
+
+namespace
+{
+// the handle keeps the timer index in the low bits and the generation of the timer in the high bits
+enum { eTimerHandleIndexBits = 20, eTimerHandleIndexMask = (1 << eTimerHandleIndexBits) - 1 };
+
+inline unsigned int GetSlotIndex(unsigned long long nTick, unsigned int nLevel)
+{
+	return (unsigned int)(nTick >> (nLevel * JobManager::detail::eTimerWheelSlotBits)) & (JobManager::detail::eTimerWheelSlots - 1);
+}
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+JobManager::detail::CJobTimerWheel::CJobTimerWheel() :
+	m_nCurrentTick(0),
+	m_nWakeTick(~0ULL),
+	m_nNumTimers(0),
+	m_nSlackMS(1),
+	m_bStop(false),
+	m_bStarted(false)
+{
+	memset(m_arrSlots, 0, sizeof(m_arrSlots));
+
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	m_nTicksPerMS = (unsigned long long)freq.QuadPart / 1000;
+	if (m_nTicksPerMS == 0)
+		m_nTicksPerMS = 1;
+	m_nStartTicks = (unsigned long long)GetRealTicks();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+JobManager::detail::CJobTimerWheel::~CJobTimerWheel()
+{
+	// the thread still reads the wheel until it is joined
+	ShutDown();
+
+	for (size_t i = 0; i < m_arrTimers.size(); ++i)
+		delete m_arrTimers[i];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::detail::CJobTimerWheel::Start()
+{
+	m_bStarted = true;
+	if (!GetGlobalThreadManager()->SpawnThread(this, "JobSystem_Timer"))
+	{
+		//AngelicaFatalError("Error spawning \"JobSystem_Timer\" thread.");
+		m_bStarted = false;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::detail::CJobTimerWheel::ShutDown()
+{
+	if (!m_bStarted)
+		return;
+
+	m_bStop = true;
+	m_wakeEvent.Set();
+	GetGlobalThreadManager()->JoinThread(this, eJM_Join);
+	m_bStarted = false;
+
+	// jobs which never ran don't keep their job states running
+	AUTO_LOCK_T(AngelicaCriticalSectionNonRecursive, m_lock);
+	for (size_t i = 0; i < m_arrTimers.size(); ++i)
+	{
+		SJobTimer* pTimer = m_arrTimers[i];
+		if (!pTimer->bActive)
+			continue;
+
+		Unlink(pTimer);
+		if (pTimer->pJobState)
+			pTimer->pJobState->SetStopped();
+		ReleaseTimer(pTimer);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+unsigned long long JobManager::detail::CJobTimerWheel::GetCurrentTick() const
+{
+	return ((unsigned long long)GetRealTicks() - m_nStartTicks) / m_nTicksPerMS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+JobManager::detail::SJobTimer* JobManager::detail::CJobTimerWheel::AllocateTimer()
+{
+	SJobTimer* pTimer = NULL;
+	if (!m_arrFreeTimers.empty())
+	{
+		pTimer = m_arrTimers[m_arrFreeTimers.back()];
+		m_arrFreeTimers.pop_back();
+	}
+	else
+	{
+		assert(m_arrTimers.size() < eTimerHandleIndexMask);
+		pTimer = new SJobTimer;
+		pTimer->nIndex = (unsigned int)m_arrTimers.size();
+		pTimer->nGeneration = 1;
+		m_arrTimers.push_back(pTimer);
+	}
+
+	pTimer->pNext = NULL;
+	pTimer->pPrev = NULL;
+	pTimer->ppSlot = NULL;
+	pTimer->bActive = true;
+	return pTimer;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::detail::CJobTimerWheel::ReleaseTimer(SJobTimer* pTimer)
+{
+	// old handles don't match the timer anymore
+	pTimer->bActive = false;
+	pTimer->nGeneration += 1;
+	pTimer->callback = nullptr;
+	m_arrFreeTimers.push_back(pTimer->nIndex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+JobManager::detail::SJobTimer* JobManager::detail::CJobTimerWheel::GetTimer(TJobTimerHandle hTimer) const
+{
+	const unsigned int nIndex = (hTimer & eTimerHandleIndexMask) - 1;
+	if (hTimer == 0 || nIndex >= m_arrTimers.size())
+		return NULL;
+
+	SJobTimer* pTimer = m_arrTimers[nIndex];
+	if (!pTimer->bActive || (pTimer->nGeneration & (~0U >> eTimerHandleIndexBits)) != (hTimer >> eTimerHandleIndexBits))
+		return NULL;
+
+	return pTimer;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+JobManager::TJobTimerHandle JobManager::detail::CJobTimerWheel::AddTimer(unsigned int nDelayMS, unsigned int nPeriodMS, const char* szJobName, const std::function<void()>& callback, TPriorityLevel priority, SJobState* pJobState)
+{
+	// running from now on, so waiting on the job state also waits for the delay
+	if (pJobState)
+		pJobState->SetRunning();
+
+	const unsigned long long nExpireTick = GetCurrentTick() + nDelayMS;
+
+	AUTO_LOCK_T(AngelicaCriticalSectionNonRecursive, m_lock);
+
+	// the slot of the current tick was already processed, the earliest tick a new timer can be taken is the next one
+	SJobTimer* pTimer = AllocateTimer();
+	pTimer->nExpireTick = nExpireTick > m_nCurrentTick ? nExpireTick : m_nCurrentTick + 1;
+	pTimer->nPeriodMS = nPeriodMS;
+	pTimer->szJobName = szJobName;
+	pTimer->priority = priority;
+	pTimer->pJobState = pJobState;
+	pTimer->callback = callback;
+	Insert(pTimer);
+
+	// the service thread has to look at the wheel again if it would sleep past the new timer
+	if (pTimer->nExpireTick + m_nSlackMS < m_nWakeTick)
+	{
+		m_nWakeTick = pTimer->nExpireTick + m_nSlackMS;
+		m_wakeEvent.Set();
+	}
+
+	return ((pTimer->nGeneration << eTimerHandleIndexBits) | (pTimer->nIndex + 1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool JobManager::detail::CJobTimerWheel::CancelTimer(TJobTimerHandle hTimer)
+{
+	SJobState* pJobState = NULL;
+	{
+		AUTO_LOCK_T(AngelicaCriticalSectionNonRecursive, m_lock);
+
+		SJobTimer* pTimer = GetTimer(hTimer);
+		if (!pTimer)
+			return false;
+
+		Unlink(pTimer);
+		pJobState = pTimer->pJobState;
+		ReleaseTimer(pTimer);
+	}
+
+	// outside of the lock, stopping the job state can run post jobs
+	if (pJobState)
+		pJobState->SetStopped();
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::detail::CJobTimerWheel::SetSlack(unsigned int nSlackMS)
+{
+	m_nSlackMS = nSlackMS;
+	m_wakeEvent.Set();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::detail::CJobTimerWheel::Insert(SJobTimer* pTimer)
+{
+	// a timer due at the current tick only comes from a cascade, Advance collects that slot right after cascading
+	const unsigned long long nExpireTick = pTimer->nExpireTick > m_nCurrentTick ? pTimer->nExpireTick : m_nCurrentTick;
+	unsigned long long nDelta = nExpireTick - m_nCurrentTick;
+	unsigned long long nSlotTick = nExpireTick;
+
+	unsigned int nLevel = 0;
+	while (nLevel < eTimerWheelLevels - 1 && nDelta >= (1ULL << ((nLevel + 1) * eTimerWheelSlotBits)))
+		++nLevel;
+
+	// beyond the top level, park the timer in the furthest slot, it is sorted in again once that slot cascades
+	const unsigned long long nMaxDelta = (1ULL << (eTimerWheelLevels * eTimerWheelSlotBits)) - 1;
+	if (nDelta > nMaxDelta)
+		nSlotTick = m_nCurrentTick + nMaxDelta;
+
+	SJobTimer** ppSlot = &m_arrSlots[nLevel][GetSlotIndex(nSlotTick, nLevel)];
+	pTimer->ppSlot = ppSlot;
+	pTimer->pPrev = NULL;
+	pTimer->pNext = *ppSlot;
+	if (*ppSlot)
+		(*ppSlot)->pPrev = pTimer;
+	*ppSlot = pTimer;
+	++m_nNumTimers;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::detail::CJobTimerWheel::Unlink(SJobTimer* pTimer)
+{
+	if (pTimer->pPrev)
+		pTimer->pPrev->pNext = pTimer->pNext;
+	else
+		*pTimer->ppSlot = pTimer->pNext;
+
+	if (pTimer->pNext)
+		pTimer->pNext->pPrev = pTimer->pPrev;
+
+	pTimer->pNext = NULL;
+	pTimer->pPrev = NULL;
+	pTimer->ppSlot = NULL;
+	--m_nNumTimers;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::detail::CJobTimerWheel::Cascade(unsigned int nLevel)
+{
+	// sort the timers of the slot reached by the current tick into the lower levels
+	SJobTimer*& rSlot = m_arrSlots[nLevel][GetSlotIndex(m_nCurrentTick, nLevel)];
+	SJobTimer* pTimer = rSlot;
+	rSlot = NULL;
+
+	while (pTimer)
+	{
+		SJobTimer* pNext = pTimer->pNext;
+		--m_nNumTimers;
+		Insert(pTimer);
+		pTimer = pNext;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::detail::CJobTimerWheel::Advance(unsigned long long nTick)
+{
+	// nothing to process, skip the idle ticks
+	if (m_nNumTimers == 0)
+	{
+		if (nTick > m_nCurrentTick)
+			m_nCurrentTick = nTick;
+		return;
+	}
+
+	while (m_nCurrentTick < nTick)
+	{
+		++m_nCurrentTick;
+
+		// a level wrapped around, move the next slot of the level above down
+		for (unsigned int nLevel = 1; nLevel < eTimerWheelLevels; ++nLevel)
+		{
+			if ((m_nCurrentTick & ((1ULL << (nLevel * eTimerWheelSlotBits)) - 1)) != 0)
+				break;
+			Cascade(nLevel);
+		}
+
+		SJobTimer*& rSlot = m_arrSlots[0][GetSlotIndex(m_nCurrentTick, 0)];
+		while (SJobTimer* pTimer = rSlot)
+		{
+			rSlot = pTimer->pNext;
+			if (rSlot)
+				rSlot->pPrev = NULL;
+			--m_nNumTimers;
+
+			SExpiredTimer expired;
+			expired.szJobName = pTimer->szJobName;
+			expired.priority = pTimer->priority;
+			expired.pJobState = pTimer->pJobState;
+
+			if (pTimer->nPeriodMS)
+			{
+				// periodic timers keep their rate, a period missed completely is skipped instead of run in a burst
+				expired.callback = pTimer->callback;
+				pTimer->nExpireTick += pTimer->nPeriodMS;
+				if (pTimer->nExpireTick <= m_nCurrentTick)
+					pTimer->nExpireTick = m_nCurrentTick + pTimer->nPeriodMS;
+				pTimer->pNext = NULL;
+				pTimer->pPrev = NULL;
+				Insert(pTimer);
+			}
+			else
+			{
+				expired.callback = std::move(pTimer->callback);
+				ReleaseTimer(pTimer);
+			}
+
+			m_arrExpired.push_back(std::move(expired));
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+unsigned long long JobManager::detail::CJobTimerWheel::GetNextExpiryTick() const
+{
+	if (m_nNumTimers == 0)
+		return ~0ULL;
+
+	// level 0 slots hold timers due exactly at their tick, slots of the levels above are a lower bound
+	// of the timers in them, waking at such a bound only cascades them down
+	unsigned long long nNextTick = ~0ULL;
+	for (unsigned int nLevel = 0; nLevel < eTimerWheelLevels; ++nLevel)
+	{
+		const unsigned int nShift = nLevel * eTimerWheelSlotBits;
+		const unsigned long long nCurrentSlot = m_nCurrentTick >> nShift;
+		for (unsigned int i = 1; i <= eTimerWheelSlots; ++i)
+		{
+			if (m_arrSlots[nLevel][(nCurrentSlot + i) & (eTimerWheelSlots - 1)] == NULL)
+				continue;
+
+			const unsigned long long nSlotTick = (nCurrentSlot + i) << nShift;
+			if (nSlotTick < nNextTick)
+				nNextTick = nSlotTick;
+			break;
+		}
+	}
+
+	return nNextTick;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::detail::CJobTimerWheel::SubmitExpiredTimers()
+{
+	// CJobLambda points into itself, so the jobs of a batch are constructed in place
+	_declspec(align(16)) unsigned char arrJobMemory[eTimerWheelSubmitBatchSize][sizeof(CJobLambda)];
+	CJobBase* arrJobs[eTimerWheelSubmitBatchSize];
+
+	for (size_t nFirst = 0; nFirst < m_arrExpired.size(); nFirst += eTimerWheelSubmitBatchSize)
+	{
+		const unsigned int nNumJobs = (unsigned int)std::min<size_t>(m_arrExpired.size() - nFirst, eTimerWheelSubmitBatchSize);
+		for (unsigned int i = 0; i < nNumJobs; ++i)
+		{
+			SExpiredTimer& rExpired = m_arrExpired[nFirst + i];
+			CJobLambda* pJob = new(arrJobMemory[i]) CJobLambda(rExpired.szJobName, std::move(rExpired.callback));
+			pJob->SetPriorityLevel(rExpired.priority);
+			if (rExpired.pJobState)
+				pJob->RegisterJobState(rExpired.pJobState);
+			arrJobs[i] = pJob;
+		}
+
+		GetJobManagerInterface()->AddJobs(arrJobs, nNumJobs);
+
+		for (unsigned int i = 0; i < nNumJobs; ++i)
+		{
+			static_cast<CJobLambda*>(arrJobs[i])->~CJobLambda();
+
+			// the job holds the job state running now, release the count taken by AddTimer
+			if (m_arrExpired[nFirst + i].pJobState)
+				m_arrExpired[nFirst + i].pJobState->SetStopped();
+		}
+	}
+
+	m_arrExpired.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::detail::CJobTimerWheel::ThreadEntry()
+{
+	while (!m_bStop)
+	{
+		unsigned long long nWakeTick;
+		{
+			AUTO_LOCK_T(AngelicaCriticalSectionNonRecursive, m_lock);
+			Advance(GetCurrentTick());
+
+			// sleep past the next expiry by the slack, timers expiring meanwhile are submitted with it
+			const unsigned long long nNextTick = GetNextExpiryTick();
+			nWakeTick = nNextTick == ~0ULL ? ~0ULL : nNextTick + m_nSlackMS;
+			m_nWakeTick = nWakeTick;
+		}
+
+		SubmitExpiredTimers();
+
+		if (nWakeTick == ~0ULL)
+		{
+			m_wakeEvent.Wait();
+			continue;
+		}
+
+		const unsigned long long nCurrentTick = GetCurrentTick();
+		if (nWakeTick > nCurrentTick)
+			m_wakeEvent.Wait((unsigned int)std::min<unsigned long long>(nWakeTick - nCurrentTick, 0x7FFFFFFF));
+	}
+}
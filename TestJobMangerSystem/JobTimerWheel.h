@@ -0,0 +1,123 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   JobTimerWheel.h
+//  Version:     v1.00
+//  Compilers:   Visual Studio.NET
+//  Description: Hierarchical timer wheel of the job manager, runs delayed and
+//               periodic lambda jobs from a single service thread
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef JOB_TIMER_WHEEL_H_
+#define JOB_TIMER_WHEEL_H_
+
+#include "IJobManager.h"
+#include "IThreadManager.h"
+#include "AngelicaThread.h"
+
+#include <vector>
+
+namespace JobManager {
+namespace detail {
+
+// each level has 64 slots, a slot of level 0 is one tick of 1 ms, a slot of level n covers 64^n ticks
+// timers further away than the top level are parked in it and sorted in again once it cascades
+enum
+{
+	eTimerWheelSlotBits = 6,
+	eTimerWheelSlots    = 1 << eTimerWheelSlotBits,
+	eTimerWheelLevels   = 4,
+};
+
+// expired timers are handed to the job manager in batches of this size
+enum { eTimerWheelSubmitBatchSize = 32 };
+
+// a delayed or periodic job, linked into a slot of the wheel
+struct SJobTimer
+{
+	SJobTimer*            pNext;
+	SJobTimer*            pPrev;
+	SJobTimer**           ppSlot;          // slot the timer is linked into
+	unsigned long long    nExpireTick;     // tick the job is due
+	unsigned int          nIndex;          // index in the timer array, part of the handle
+	unsigned int          nPeriodMS;       // 0 for a delayed job
+	unsigned int          nGeneration;     // part of the handle, incremented each time the timer is released
+	bool                  bActive;
+	const char*           szJobName;
+	TPriorityLevel        priority;
+	SJobState*            pJobState;       // kept running from AddTimer until the submitted job finished
+	std::function<void()> callback;
+};
+
+// the timers are kept in a hierarchical wheel protected by a short lock, the service thread sleeps until the
+// earliest expiry plus the configured slack and submits all timers expired by then together
+// so timers expiring close to each other share one wakeup
+class CJobTimerWheel : public IThread
+{
+public:
+	CJobTimerWheel();
+	~CJobTimerWheel();
+
+	// spawn and stop the service thread, timers left at shutdown are dropped
+	void Start();
+	void ShutDown();
+
+	TJobTimerHandle AddTimer(unsigned int nDelayMS, unsigned int nPeriodMS, const char* szJobName, const std::function<void()>& callback, TPriorityLevel priority, SJobState* pJobState);
+	bool            CancelTimer(TJobTimerHandle hTimer);
+
+	void            SetSlack(unsigned int nSlackMS);
+	unsigned int    GetSlack() const { return m_nSlackMS; }
+
+	// service thread
+	virtual void ThreadEntry();
+
+private:
+	// a timer taken out of the wheel, its job is created outside of the lock
+	struct SExpiredTimer
+	{
+		const char*           szJobName;
+		TPriorityLevel        priority;
+		SJobState*            pJobState;
+		std::function<void()> callback;
+	};
+
+	unsigned long long GetCurrentTick() const;
+
+	SJobTimer* AllocateTimer();
+	void       ReleaseTimer(SJobTimer* pTimer);
+	SJobTimer* GetTimer(TJobTimerHandle hTimer) const;
+
+	// wheel operations, called with m_lock held
+	void               Insert(SJobTimer* pTimer);
+	void               Unlink(SJobTimer* pTimer);
+	void               Cascade(unsigned int nLevel);
+	void               Advance(unsigned long long nTick);
+	unsigned long long GetNextExpiryTick() const;
+
+	void SubmitExpiredTimers();
+
+	AngelicaCriticalSectionNonRecursive m_lock;
+	SJobTimer*                          m_arrSlots[eTimerWheelLevels][eTimerWheelSlots];
+	unsigned long long                  m_nCurrentTick;       // last tick the wheel processed
+	unsigned long long                  m_nWakeTick;          // tick the service thread sleeps until, ~0 without timers
+	unsigned int                        m_nNumTimers;         // timers in the wheel
+
+	std::vector<SJobTimer*>             m_arrTimers;          // all timers allocated, the index is part of the handle
+	std::vector<unsigned int>           m_arrFreeTimers;
+	std::vector<SExpiredTimer>          m_arrExpired;         // only used by the service thread
+
+	unsigned long long                  m_nStartTicks;        // GetRealTicks of tick 0
+	unsigned long long                  m_nTicksPerMS;
+	volatile unsigned int               m_nSlackMS;
+
+	AngelicaEvent                       m_wakeEvent;          // set when a timer due before m_nWakeTick is added and on shutdown
+	volatile bool                       m_bStop;
+	bool                                m_bStarted;
+};
+
+} // namespace detail
+} // namespace JobManager
+
+#endif // JOB_TIMER_WHEEL_H_
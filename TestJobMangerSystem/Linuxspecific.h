@@ -0,0 +1,218 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   Linuxspecific.h
+//  Version:     v1.00
+//  Compilers:   gcc, clang
+//  Description: Specific to Linux declarations, inline functions etc.
+//               Provides the small subset of the Win32 API used by the job system.
+// -------------------------------------------------------------------------
+//  History:
+//
+////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////////
+// Standard includes.
+//////////////////////////////////////////////////////////////////////////
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <assert.h>
+#include <signal.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#if ANGELICA_PLATFORM_X86 || ANGELICA_PLATFORM_X64
+	#include <immintrin.h>
+#endif
+//////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////
+// Define platform independent types.
+//////////////////////////////////////////////////////////////////////////
+
+#define THREADID_NULL 0
+
+typedef int                LONG;
+typedef unsigned long      DWORD;
+typedef int                BOOL;
+typedef unsigned int       UINT32;
+typedef intptr_t           INT_PTR;
+typedef uintptr_t          UINT_PTR;
+typedef uintptr_t          ULONG_PTR;
+typedef void*              HANDLE;
+
+typedef void* THREAD_HANDLE;
+typedef void* EVENT_HANDLE;
+
+#ifndef TRUE
+	#define TRUE  1
+#endif
+#ifndef FALSE
+	#define FALSE 0
+#endif
+
+#define INFINITE      0xFFFFFFFF
+#define WAIT_OBJECT_0 0x00000000L
+#define WAIT_TIMEOUT  0x00000102L
+#define WAIT_FAILED   0xFFFFFFFF
+
+#define ERROR_INVALID_FUNCTION 1L
+
+// thread priorities as used in SThreadConfig, mapped to nice values by AngelicaThreadUtil
+#define THREAD_PRIORITY_IDLE          -15
+#define THREAD_PRIORITY_LOWEST        -2
+#define THREAD_PRIORITY_BELOW_NORMAL  -1
+#define THREAD_PRIORITY_NORMAL        0
+#define THREAD_PRIORITY_ABOVE_NORMAL  1
+#define THREAD_PRIORITY_HIGHEST       2
+#define THREAD_PRIORITY_TIME_CRITICAL 15
+
+union LARGE_INTEGER
+{
+	struct
+	{
+		DWORD LowPart;
+		LONG  HighPart;
+	};
+	long long QuadPart;
+};
+
+#define TARGET_DEFAULT_ALIGN (0x4U)
+
+//////////////////////////////////////////////////////////////////////////
+// Win32 functions used by the job system.
+//////////////////////////////////////////////////////////////////////////
+inline void Sleep(unsigned int dwMilliseconds)
+{
+	if (dwMilliseconds == 0)
+	{
+		sched_yield();
+		return;
+	}
+
+	struct timespec req;
+	req.tv_sec = dwMilliseconds / 1000;
+	req.tv_nsec = (dwMilliseconds % 1000) * 1000000;
+	while (nanosleep(&req, &req) != 0)
+		;
+}
+
+inline BOOL SwitchToThread()
+{
+	return sched_yield() == 0;
+}
+
+inline void YieldProcessor()
+{
+#if ANGELICA_PLATFORM_X86 || ANGELICA_PLATFORM_X64
+	_mm_pause();
+#else
+	__asm__ __volatile__ ("" ::: "memory");
+#endif
+}
+
+inline void MemoryBarrier()
+{
+	__sync_synchronize();
+}
+
+inline DWORD GetCurrentThreadId()
+{
+	return (DWORD)syscall(SYS_gettid);
+}
+
+inline void* _aligned_malloc(size_t size, size_t alignment)
+{
+	void* pMem = NULL;
+	if (posix_memalign(&pMem, alignment < sizeof(void*) ? sizeof(void*) : alignment, size) != 0)
+		return NULL;
+	return pMem;
+}
+
+inline void _aligned_free(void* pMem)
+{
+	free(pMem);
+}
+
+#define ZeroMemory(dst, size) memset((dst), 0, (size))
+#define _stricmp              strcasecmp
+#define __debugbreak()        raise(SIGTRAP)
+
+inline void OutputDebugStringA(const char* szOutput)
+{
+	fputs(szOutput, stderr);
+}
+
+template<size_t nSize>
+inline int sprintf_s(char (&szBuffer)[nSize], const char* szFormat, ...)
+{
+	va_list args;
+	va_start(args, szFormat);
+	const int nRet = vsnprintf(szBuffer, nSize, szFormat, args);
+	va_end(args);
+	return nRet;
+}
+
+// monotonic clock with nanosecond ticks, QueryPerformanceFrequency reports the matching frequency
+inline signed long long GetRealTicks()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (signed long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+inline BOOL QueryPerformanceCounter(LARGE_INTEGER* pCounter)
+{
+	pCounter->QuadPart = GetRealTicks();
+	return TRUE;
+}
+
+inline BOOL QueryPerformanceFrequency(LARGE_INTEGER* pFrequency)
+{
+	pFrequency->QuadPart = 1000000000LL;
+	return TRUE;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// futex helpers, used to park threads directly on a 32 bit word
+//////////////////////////////////////////////////////////////////////////
+namespace AngelicaMT {
+namespace detail {
+
+// blocks while *pAddr == nExpected, returns false on timeout
+inline bool FutexWait(volatile int* pAddr, int nExpected, unsigned int nTimeoutMillis = INFINITE)
+{
+	struct timespec timeout;
+	struct timespec* pTimeout = NULL;
+	if (nTimeoutMillis != INFINITE)
+	{
+		timeout.tv_sec = nTimeoutMillis / 1000;
+		timeout.tv_nsec = (nTimeoutMillis % 1000) * 1000000;
+		pTimeout = &timeout;
+	}
+	const long nRet = syscall(SYS_futex, (int*)pAddr, FUTEX_WAIT_PRIVATE, nExpected, pTimeout, NULL, 0);
+	return !(nRet != 0 && errno == ETIMEDOUT);
+}
+
+// wakes up to nCount threads parked on pAddr
+inline void FutexWake(volatile int* pAddr, int nCount)
+{
+	syscall(SYS_futex, (int*)pAddr, FUTEX_WAKE_PRIVATE, nCount, NULL, NULL, 0);
+}
+
+} // namespace detail
+} // namespace AngelicaMT
+
+#define STATIC_CHECK(expr, msg) static_assert((expr) != 0, # msg)
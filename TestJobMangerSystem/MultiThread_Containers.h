@@ -43,7 +43,7 @@ public:
 	bool                empty() const    { AutoLock lock(m_cs); return v.empty(); }
 	int                 size() const     { AutoLock lock(m_cs); return v.size(); }
 	void                clear()          { AutoLock lock(m_cs); v.clear(); }
-	void                free_memory()    { AutoLock lock(m_cs); stl::free_container(v); }
+	void                free_memory()    { AutoLock lock(m_cs); container_type().swap(v); }
 
 	template<class Func>
 	void sort(const Func& compare_less) { AutoLock lock(m_cs); std::sort(v.begin(), v.end(), compare_less); }
@@ -108,7 +108,7 @@ public:
 
 	AngelicaCriticalSection& get_lock() const { return m_cs; }
 
-	void                free_memory()    { AutoLock lock(m_cs); stl::free_container(v); }
+	void                free_memory()    { AutoLock lock(m_cs); std::vector<T>().swap(v); }
 
 	// std::vector interface
 	bool     empty() const                { AutoLock lock(m_cs); return v.empty(); }
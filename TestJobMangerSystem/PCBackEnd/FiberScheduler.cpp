@@ -0,0 +1,352 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   FiberScheduler.cpp
+//  Version:     v1.00
+//  Compilers:   Visual Studio.NET
+//  Description: Runs thread backend jobs on pooled fibers, a job waiting on
+//               a sync variable suspends its fiber instead of the worker
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "../AngelicaPlatformDefines.h"
+#if ANGELICA_PLATFORM_WINDOWS
+	#include "../Win32specific.h"
+	#include "../MSVCspecific.h"
+#else
+	#include "../Linuxspecific.h"
+	#include "../GCCspecific.h"
+#endif
+#include "../AngelicaAtomics.h"
+#include "FiberScheduler.h"
+#include "ThreadBackEnd.h"
+#include "../JobManager.h"
+
+JobManager::ThreadBackEnd::detail::CFiberScheduler* JobManager::ThreadBackEnd::detail::CFiberScheduler::s_pInstance = NULL;
+
+// a fiber can continue on another worker than the one it was suspended on, the thread state is
+// always read through the job manager TLS accessors and never kept across a switch
+namespace
+{
+inline JobManager::ThreadBackEnd::detail::SFiberThreadState* GetFiberThreadState()
+{
+	return static_cast<JobManager::ThreadBackEnd::detail::SFiberThreadState*>(JobManager::detail::GetFiberThreadState());
+}
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+bool JobManager::Fiber::WaitOnAddress(volatile void* pAddress, unsigned int nCompareValue)
+{
+	ThreadBackEnd::detail::CFiberScheduler* pScheduler = ThreadBackEnd::detail::CFiberScheduler::GetInstance();
+	return pScheduler ? pScheduler->WaitOnAddress(pAddress, nCompareValue) : false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::Fiber::WakeByAddressAll(volatile void* pAddress)
+{
+	ThreadBackEnd::detail::CFiberScheduler* pScheduler = ThreadBackEnd::detail::CFiberScheduler::GetInstance();
+	if (pScheduler)
+		pScheduler->WakeByAddressAll(pAddress);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+JobManager::ThreadBackEnd::detail::CFiberScheduler::CFiberScheduler(CWaitForJobObject& rSemaphore, TExecuteJobFunc pExecuteJob, unsigned int nStackSize)
+	: m_nRunnableLock(0)
+	, m_nNumRunnableFibers(0)
+	, m_pRunnableHead(NULL)
+	, m_pRunnableTail(NULL)
+	, m_nFreeListLock(0)
+	, m_pFreeFibers(NULL)
+	, m_nNumFibers(0)
+	, m_rSemaphore(rSemaphore)
+	, m_pExecuteJob(pExecuteJob)
+	, m_nStackSize(nStackSize ? nStackSize : (unsigned int)eStackSize)
+{
+	memset(m_arrWaitBuckets, 0, sizeof(m_arrWaitBuckets));
+	memset(m_arrFibers, 0, sizeof(m_arrFibers));
+
+	assert(s_pInstance == NULL);
+	s_pInstance = this;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+JobManager::ThreadBackEnd::detail::CFiberScheduler::~CFiberScheduler()
+{
+	s_pInstance = NULL;
+
+	// the workers are gone, fibers still waiting at this point belong to jobs which never finished
+	for (unsigned int i = 0; i < m_nNumFibers; ++i)
+	{
+		SFiber* pFiber = m_arrFibers[i];
+#if ANGELICA_PLATFORM_WINDOWS
+		DeleteFiber(pFiber->pContext);
+#else
+		_aligned_free(pFiber->pStack);
+#endif
+		_aligned_free(pFiber);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::detail::CFiberScheduler::AttachWorkerThread()
+{
+	SFiberThreadState* pThreadState = new SFiberThreadState;
+	memset(pThreadState, 0, sizeof(SFiberThreadState));
+#if ANGELICA_PLATFORM_WINDOWS
+	// only a fiber can switch to another fiber
+	pThreadState->pSchedulerContext = ConvertThreadToFiber(NULL);
+#endif
+	JobManager::detail::SetFiberThreadState(pThreadState);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::detail::CFiberScheduler::DetachWorkerThread()
+{
+	SFiberThreadState* pThreadState = GetFiberThreadState();
+	if (pThreadState == NULL)
+		return;
+
+#if ANGELICA_PLATFORM_WINDOWS
+	ConvertFiberToThread();
+#endif
+	JobManager::detail::SetFiberThreadState(NULL);
+	delete pThreadState;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::detail::CFiberScheduler::RunJob(const JobManager::SInfoBlock& rInfoBlock)
+{
+	SFiber* pFiber = AllocateFiber();
+	if (pFiber == NULL)
+	{
+		JobManager::SInfoBlock infoBlock;
+		rInfoBlock.AssignMembersTo(&infoBlock);
+		m_pExecuteJob(infoBlock);
+		return;
+	}
+
+	rInfoBlock.AssignMembersTo(&pFiber->infoBlock);
+	pFiber->state = SFiber::eFS_Running;
+	SwitchToFiber(GetFiberThreadState(), pFiber);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool JobManager::ThreadBackEnd::detail::CFiberScheduler::ResumeFiber()
+{
+	if (!HasRunnableFibers())
+		return false;
+
+	AngelicaSpinLock(&m_nRunnableLock, 0, 1);
+	SFiber* pFiber = m_pRunnableHead;
+	if (pFiber)
+	{
+		m_pRunnableHead = pFiber->pNext;
+		if (m_pRunnableHead == NULL)
+			m_pRunnableTail = NULL;
+		AngelicaInterlockedDecrement(&m_nNumRunnableFibers);
+	}
+	AngelicaReleaseSpinLock(&m_nRunnableLock, 0);
+
+	if (pFiber == NULL)
+		return false;
+
+	pFiber->pNext = NULL;
+	pFiber->state = SFiber::eFS_Running;
+	SwitchToFiber(GetFiberThreadState(), pFiber);
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool JobManager::ThreadBackEnd::detail::CFiberScheduler::WaitOnAddress(volatile void* pAddress, unsigned int nCompareValue)
+{
+	SFiberThreadState* pThreadState = GetFiberThreadState();
+	if (pThreadState == NULL || pThreadState->pCurrentFiber == NULL)
+		return false;
+
+	SFiber* pFiber = pThreadState->pCurrentFiber;
+	SWaitBucket& rBucket = GetWaitBucket(pAddress);
+
+	AngelicaSpinLock(&rBucket.nLock, 0, 1);
+	if (*static_cast<volatile unsigned int*>(pAddress) != nCompareValue)
+	{
+		AngelicaReleaseSpinLock(&rBucket.nLock, 0);
+		return true;
+	}
+
+	pFiber->pWaitAddress = pAddress;
+	pFiber->state = SFiber::eFS_Waiting;
+	pFiber->pNext = rBucket.pWaiters;
+	rBucket.pWaiters = pFiber;
+
+	// the worker loop releases the lock once this fiber is switched out
+	pThreadState->pWaitListLock = &rBucket.nLock;
+	SwitchToWorker(pThreadState, pFiber);
+
+	// woken up, possibly on another worker thread, the caller rechecks its condition
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::detail::CFiberScheduler::WakeByAddressAll(volatile void* pAddress)
+{
+	SWaitBucket& rBucket = GetWaitBucket(pAddress);
+
+	// the list can't be checked without the lock, a waiter may have checked the value before it was changed
+	// and not be linked in yet
+	SFiber* pWokenHead = NULL;
+	SFiber* pWokenTail = NULL;
+	int nNumWoken = 0;
+
+	AngelicaSpinLock(&rBucket.nLock, 0, 1);
+	SFiber** ppLink = &rBucket.pWaiters;
+	while (SFiber* pFiber = *ppLink)
+	{
+		if (pFiber->pWaitAddress != pAddress)
+		{
+			ppLink = &pFiber->pNext;
+			continue;
+		}
+
+		*ppLink = pFiber->pNext;
+		pFiber->pWaitAddress = NULL;
+		pFiber->pNext = pWokenHead;
+		pWokenHead = pFiber;
+		if (pWokenTail == NULL)
+			pWokenTail = pFiber;
+		++nNumWoken;
+	}
+	AngelicaReleaseSpinLock(&rBucket.nLock, 0);
+
+	if (nNumWoken == 0)
+		return;
+
+	AngelicaSpinLock(&m_nRunnableLock, 0, 1);
+	if (m_pRunnableTail)
+		m_pRunnableTail->pNext = pWokenHead;
+	else
+		m_pRunnableHead = pWokenHead;
+	m_pRunnableTail = pWokenTail;
+	AngelicaInterlockedAdd(&m_nNumRunnableFibers, nNumWoken);
+	AngelicaReleaseSpinLock(&m_nRunnableLock, 0);
+
+	m_rSemaphore.SignalNewJobs((unsigned int)nNumWoken);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+JobManager::ThreadBackEnd::detail::SFiber* JobManager::ThreadBackEnd::detail::CFiberScheduler::AllocateFiber()
+{
+	AngelicaSpinLock(&m_nFreeListLock, 0, 1);
+
+	SFiber* pFiber = m_pFreeFibers;
+	if (pFiber)
+	{
+		m_pFreeFibers = pFiber->pNext;
+		AngelicaReleaseSpinLock(&m_nFreeListLock, 0);
+		pFiber->pNext = NULL;
+		return pFiber;
+	}
+
+	if (m_nNumFibers == eMaxFibers)
+	{
+		AngelicaReleaseSpinLock(&m_nFreeListLock, 0);
+		return NULL;
+	}
+
+	pFiber = static_cast<SFiber*>(_aligned_malloc(sizeof(SFiber), 128));
+	// raw storage, the context and the job SInfoBlock are set up before the fiber first runs
+	memset(static_cast<void*>(pFiber), 0, sizeof(SFiber));
+#if ANGELICA_PLATFORM_WINDOWS
+	pFiber->pContext = CreateFiber(m_nStackSize, &CFiberScheduler::FiberEntry, pFiber);
+	if (pFiber->pContext == NULL)
+	{
+		AngelicaReleaseSpinLock(&m_nFreeListLock, 0);
+		_aligned_free(pFiber);
+		return NULL;
+	}
+#else
+	pFiber->pStack = _aligned_malloc(m_nStackSize, JobManager::Fiber::FIBERTASK_ALIGNMENT);
+	getcontext(&pFiber->context);
+	pFiber->context.uc_stack.ss_sp = pFiber->pStack;
+	pFiber->context.uc_stack.ss_size = m_nStackSize;
+	pFiber->context.uc_link = NULL;
+	makecontext(&pFiber->context, &CFiberScheduler::FiberEntry, 0);
+#endif
+	m_arrFibers[m_nNumFibers++] = pFiber;
+
+	AngelicaReleaseSpinLock(&m_nFreeListLock, 0);
+	return pFiber;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::detail::CFiberScheduler::FreeFiber(SFiber* pFiber)
+{
+	AngelicaSpinLock(&m_nFreeListLock, 0, 1);
+	pFiber->pNext = m_pFreeFibers;
+	m_pFreeFibers = pFiber;
+	AngelicaReleaseSpinLock(&m_nFreeListLock, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::detail::CFiberScheduler::SwitchToFiber(SFiberThreadState* pThreadState, SFiber* pFiber)
+{
+	pThreadState->pCurrentFiber = pFiber;
+	// a job continued on another worker still sees its cancellation token
+	JobManager::detail::SetCurrentJobCancellationToken(pFiber->infoBlock.pCancellationToken);
+#if ANGELICA_PLATFORM_WINDOWS
+	::SwitchToFiber(pFiber->pContext);
+#else
+	swapcontext(&pThreadState->schedulerContext, &pFiber->context);
+#endif
+	pThreadState->pCurrentFiber = NULL;
+
+	// back in the worker loop, the fiber is completely switched out now
+	// a waiting fiber can be resumed by another worker as soon as the lock is released, don't touch it afterwards
+	if (pThreadState->pWaitListLock)
+	{
+		AngelicaReleaseSpinLock(pThreadState->pWaitListLock, 0);
+		pThreadState->pWaitListLock = NULL;
+	}
+	else if (pFiber->state == SFiber::eFS_Finished)
+	{
+		FreeFiber(pFiber);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::detail::CFiberScheduler::SwitchToWorker(SFiberThreadState* pThreadState, SFiber* pFiber)
+{
+#if ANGELICA_PLATFORM_WINDOWS
+	::SwitchToFiber(pThreadState->pSchedulerContext);
+#else
+	swapcontext(&pFiber->context, &pThreadState->schedulerContext);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::detail::CFiberScheduler::RunFiber(SFiber* pFiber)
+{
+	for (;; )
+	{
+		s_pInstance->m_pExecuteJob(pFiber->infoBlock);
+
+		// the job may have been continued on another worker, look up the thread state again
+		pFiber->state = SFiber::eFS_Finished;
+		SwitchToWorker(GetFiberThreadState(), pFiber);
+	}
+}
+
+#if ANGELICA_PLATFORM_WINDOWS
+///////////////////////////////////////////////////////////////////////////////
+void __stdcall JobManager::ThreadBackEnd::detail::CFiberScheduler::FiberEntry(void* pFiber)
+{
+	RunFiber(static_cast<SFiber*>(pFiber));
+}
+#else
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::detail::CFiberScheduler::FiberEntry()
+{
+	// makecontext only passes int arguments, the fiber is taken from the thread which starts it
+	RunFiber(GetFiberThreadState()->pCurrentFiber);
+}
+#endif
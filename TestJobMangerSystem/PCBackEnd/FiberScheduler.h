@@ -0,0 +1,149 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   FiberScheduler.h
+//  Version:     v1.00
+//  Compilers:   Visual Studio.NET
+//  Description: Runs thread backend jobs on pooled fibers, a job waiting on
+//               a sync variable suspends its fiber instead of the worker
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef FIBER_SCHEDULER_H_
+#define FIBER_SCHEDULER_H_
+
+#include "../IJobManager.h"
+#include "../JobStructs.h"
+
+#if !ANGELICA_PLATFORM_WINDOWS
+	#include <ucontext.h>
+#endif
+
+namespace JobManager {
+namespace ThreadBackEnd {
+namespace detail {
+
+class CWaitForJobObject;
+
+// upper bound of fibers alive at once, jobs started while all fibers are in use run on the worker stack
+enum { eMaxFibers = 256 };
+
+// number of address hashed wait lists, fibers suspended on different addresses rarely share a lock
+enum { eNumFiberWaitBuckets = 64 };
+
+// runs a job which was already taken from the queues on the current stack
+typedef void (* TExecuteJobFunc)(JobManager::SInfoBlock& rInfoBlock);
+
+// a pooled fiber, it runs one job after the other and is parked in a wait list while its job waits
+struct _declspec(align(128)) SFiber
+{
+	enum EState
+	{
+		eFS_Running,
+		eFS_Waiting,
+		eFS_Finished
+	};
+
+	JobManager::SInfoBlock infoBlock;           // copy of the job the fiber runs
+	SFiber*                pNext;               // link in the free list, a wait list or the runnable queue
+	volatile void*         pWaitAddress;        // address the fiber is suspended on
+	EState                 state;
+#if ANGELICA_PLATFORM_WINDOWS
+	void*                  pContext;            // fiber handle returned by CreateFiber
+#else
+	ucontext_t             context;             // registers saved while the fiber is switched out
+	void*                  pStack;
+#endif
+};
+
+// state of a worker thread which runs job fibers, only touched by the owning thread
+struct SFiberThreadState
+{
+#if ANGELICA_PLATFORM_WINDOWS
+	void*         pSchedulerContext;            // the worker thread converted to a fiber
+#else
+	ucontext_t    schedulerContext;             // the worker loop while a job fiber runs
+#endif
+	SFiber*       pCurrentFiber;                // fiber running on this thread, NULL while in the worker loop
+	volatile int* pWaitListLock;                // wait list lock to release once the suspended fiber is switched out
+};
+
+// fiber pool, wait lists and runnable queue shared by all workers of the thread backend
+// a waiting fiber is only resumed after it was switched out completely: it is linked into its wait list
+// under the list lock, the lock is released by the worker loop after the switch and WakeByAddressAll needs it
+// to take the fiber out again, which also makes the value check and the suspend atomic to the waker
+// each runnable fiber accounts for one semaphore count, like a job in the queues
+class CFiberScheduler
+{
+public:
+	CFiberScheduler(CWaitForJobObject& rSemaphore, TExecuteJobFunc pExecuteJob, unsigned int nStackSize);
+	~CFiberScheduler();
+
+	// called on each worker thread before it takes the first job and before it exits
+	void AttachWorkerThread();
+	void DetachWorkerThread();
+
+	// runs the job on a pooled fiber, returns once the job finished or suspended
+	// without a free fiber the job runs on the worker stack and waits block the worker as before
+	void RunJob(const JobManager::SInfoBlock& rInfoBlock);
+
+	// continues the oldest woken up fiber, returns false if there is none
+	bool ResumeFiber();
+
+	// racy check used to decide if the runnable queue lock needs to be taken
+	bool HasRunnableFibers() const { return m_nNumRunnableFibers != 0; }
+
+	// implementation of JobManager::Fiber::WaitOnAddress/WakeByAddressAll for the scheduler of the thread backend
+	bool WaitOnAddress(volatile void* pAddress, unsigned int nCompareValue);
+	void WakeByAddressAll(volatile void* pAddress);
+
+	// scheduler used by the fiber functions, NULL if fiber mode is disabled
+	static CFiberScheduler* GetInstance() { return s_pInstance; }
+
+private:
+	struct _declspec(align(64)) SWaitBucket
+	{
+		volatile int nLock;
+		SFiber*      pWaiters;
+	};
+
+	SFiber* AllocateFiber();
+	void    FreeFiber(SFiber* pFiber);
+	void    SwitchToFiber(SFiberThreadState* pThreadState, SFiber* pFiber);
+
+	SWaitBucket& GetWaitBucket(volatile void* pAddress) { return m_arrWaitBuckets[((UINT_PTR)pAddress >> 2) % eNumFiberWaitBuckets]; }
+
+	// entry point of every fiber, runs the jobs handed to it until the scheduler is destroyed
+	static void RunFiber(SFiber* pFiber);
+#if ANGELICA_PLATFORM_WINDOWS
+	static void __stdcall FiberEntry(void* pFiber);
+#else
+	static void           FiberEntry();
+#endif
+	static void SwitchToWorker(SFiberThreadState* pThreadState, SFiber* pFiber);
+
+	static CFiberScheduler* s_pInstance;
+
+	SWaitBucket        m_arrWaitBuckets[eNumFiberWaitBuckets];
+
+	volatile int       m_nRunnableLock;
+	volatile int       m_nNumRunnableFibers;     // fibers in the runnable queue, readable without the lock
+	SFiber*            m_pRunnableHead;          // oldest woken up fiber
+	SFiber*            m_pRunnableTail;
+
+	volatile int       m_nFreeListLock;
+	SFiber*            m_pFreeFibers;            // fibers which are not running a job
+	unsigned int       m_nNumFibers;
+	SFiber*            m_arrFibers[eMaxFibers];  // all fibers created, released on destruction
+
+	CWaitForJobObject& m_rSemaphore;
+	TExecuteJobFunc    m_pExecuteJob;
+	unsigned int       m_nStackSize;
+};
+
+} // namespace detail
+} // namespace ThreadBackEnd
+} // namespace JobManager
+
+#endif // FIBER_SCHEDULER_H_
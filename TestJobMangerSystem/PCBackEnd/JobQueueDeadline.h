@@ -0,0 +1,156 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   JobQueueDeadline.h
+//  Version:     v1.00
+//  Compilers:   Visual Studio.NET
+//  Description: Earliest deadline first queue used by the thread backend for
+//               jobs which carry a deadline while deadline scheduling is on
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef JOB_QUEUE_DEADLINE_H_
+#define JOB_QUEUE_DEADLINE_H_
+
+#include "../IJobManager.h"
+#include "../JobStructs.h"
+#include "../AngelicaThread.h"
+
+#include <vector>
+#include <algorithm>
+
+namespace JobManager {
+namespace ThreadBackEnd {
+namespace detail {
+
+// number of heap entries reserved up front, the heap grows beyond it on demand
+enum { eJobQueueDeadlineInitialSize = 256 };
+
+// min heap of SInfoBlocks ordered by deadline, jobs with the same deadline keep their submission order
+// the SInfoBlocks are pooled in a free list and only released on destruction
+// like the overflow queue a short lock is used, deadline jobs are expected to be a small part of all jobs
+class CJobQueueDeadline
+{
+public:
+	CJobQueueDeadline() :
+		m_nNumJobs(0),
+		m_pFreeInfoBlocks(NULL),
+		m_nNumInfoBlocks(0),
+		m_nNextSequence(0)
+	{
+		m_heap.reserve(eJobQueueDeadlineInitialSize);
+	}
+
+	~CJobQueueDeadline()
+	{
+		for (size_t i = 0; i < m_heap.size(); ++i)
+			_aligned_free(m_heap[i].pInfoBlock);
+
+		while (m_pFreeInfoBlocks)
+		{
+			JobManager::SInfoBlock* pNext = m_pFreeInfoBlocks->pNext;
+			_aligned_free(m_pFreeInfoBlocks);
+			m_pFreeInfoBlocks = pNext;
+		}
+	}
+
+	// returns the SInfoBlock to fill for the next job, the queue stays locked until PublishPush
+	JobManager::SInfoBlock* BeginPush()
+	{
+		m_lock.Lock();
+
+		JobManager::SInfoBlock* pInfoBlock = m_pFreeInfoBlocks;
+		if (pInfoBlock)
+		{
+			m_pFreeInfoBlocks = pInfoBlock->pNext;
+		}
+		else
+		{
+			pInfoBlock = static_cast<JobManager::SInfoBlock*>(_aligned_malloc(sizeof(JobManager::SInfoBlock), 128));
+			// raw storage, the job is assigned member by member right after
+			memset(static_cast<void*>(pInfoBlock), 0, sizeof(JobManager::SInfoBlock));
+			++m_nNumInfoBlocks;
+		}
+
+		m_pPushInfoBlock = pInfoBlock;
+		return pInfoBlock;
+	}
+
+	// inserts the SInfoBlock returned by BeginPush by its deadline and unlocks the queue
+	// nPriorityLevel is the level of the job, only kept for the dequeue stats
+	void PublishPush(unsigned int nPriorityLevel)
+	{
+		SEntry entry;
+		entry.nDeadlineTicks = m_pPushInfoBlock->nDeadlineTicks;
+		entry.nSequence = m_nNextSequence++;
+		entry.nPriorityLevel = nPriorityLevel;
+		entry.pInfoBlock = m_pPushInfoBlock;
+		m_heap.push_back(entry);
+		std::push_heap(m_heap.begin(), m_heap.end(), SEntry::Later);
+
+		AngelicaInterlockedIncrement(&m_nNumJobs);
+		m_lock.Unlock();
+	}
+
+	// takes the job with the earliest deadline and copies it into rInfoBlock, rPriorityLevel is the level passed to PublishPush
+	bool Pop(JobManager::SInfoBlock& rInfoBlock, unsigned int& rPriorityLevel)
+	{
+		if (IsEmpty())
+			return false;
+
+		AUTO_LOCK_T(AngelicaCriticalSectionNonRecursive, m_lock);
+
+		if (m_heap.empty())
+			return false;
+
+		std::pop_heap(m_heap.begin(), m_heap.end(), SEntry::Later);
+		JobManager::SInfoBlock* pInfoBlock = m_heap.back().pInfoBlock;
+		rPriorityLevel = m_heap.back().nPriorityLevel;
+		m_heap.pop_back();
+		AngelicaInterlockedDecrement(&m_nNumJobs);
+
+		pInfoBlock->AssignMembersTo(&rInfoBlock);
+		pInfoBlock->pNext = m_pFreeInfoBlocks;
+		m_pFreeInfoBlocks = pInfoBlock;
+		return true;
+	}
+
+	// racy check used to decide if the lock needs to be taken
+	bool         IsEmpty() const { return m_nNumJobs == 0; }
+	unsigned int GetNumJobs() const { return (unsigned int)m_nNumJobs; }
+
+	// number of SInfoBlocks allocated so far
+	unsigned int GetNumInfoBlocks() const { return m_nNumInfoBlocks; }
+
+private:
+	struct SEntry
+	{
+		unsigned long long      nDeadlineTicks;
+		unsigned int            nSequence;      // submission order, breaks ties between equal deadlines
+		unsigned int            nPriorityLevel;
+		JobManager::SInfoBlock* pInfoBlock;
+
+		// heap predicate, the entry which is due first ends up at the top
+		static bool Later(const SEntry& a, const SEntry& b)
+		{
+			if (a.nDeadlineTicks != b.nDeadlineTicks)
+				return a.nDeadlineTicks > b.nDeadlineTicks;
+			return (int)(a.nSequence - b.nSequence) > 0;
+		}
+	};
+
+	volatile int                        m_nNumJobs;          // jobs in the queue, readable without the lock
+	AngelicaCriticalSectionNonRecursive m_lock;
+	std::vector<SEntry>                 m_heap;
+	JobManager::SInfoBlock*             m_pPushInfoBlock;    // SInfoBlock handed out by BeginPush
+	JobManager::SInfoBlock*             m_pFreeInfoBlocks;   // SInfoBlocks kept for reuse, linked by pNext
+	unsigned int                        m_nNumInfoBlocks;
+	unsigned int                        m_nNextSequence;
+};
+
+} // namespace detail
+} // namespace ThreadBackEnd
+} // namespace JobManager
+
+#endif // JOB_QUEUE_DEADLINE_H_
@@ -0,0 +1,190 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   JobQueueOverflow.h
+//  Version:     v1.00
+//  Compilers:   Visual Studio.NET
+//  Description: Growable overflow queue used by the thread backend when the
+//               fixed size global queue of a priority level is full
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef JOB_QUEUE_OVERFLOW_H_
+#define JOB_QUEUE_OVERFLOW_H_
+
+#include "../IJobManager.h"
+#include "../JobStructs.h"
+#include "../AngelicaThread.h"
+
+namespace JobManager {
+namespace ThreadBackEnd {
+namespace detail {
+
+// number of SInfoBlocks per overflow segment
+enum { eJobQueueOverflowSegmentSize = 64 };
+
+// FIFO of SInfoBlocks shared by all workers, the storage grows by chaining segments
+// drained segments are kept in a free list for the next burst and only released on destruction
+// the queue is only used while the global queue is full, thus a short lock is acceptable here,
+// in exchange producers never have to wait for a worker to free a slot
+// the same queue holds the jobs targeted at one worker or at the main thread
+class CJobQueueOverflow
+{
+public:
+	CJobQueueOverflow() :
+		m_nNumJobs(0),
+		m_pPullSegment(NULL),
+		m_pPushSegment(NULL),
+		m_pFreeSegments(NULL),
+		m_nNumSegments(0),
+		m_nNumPushedJobs(0)
+	{
+	}
+
+	~CJobQueueOverflow()
+	{
+		FreeSegmentList(m_pPullSegment);
+		FreeSegmentList(m_pFreeSegments);
+	}
+
+	// returns the SInfoBlock to fill for the next job, the queue stays locked until PublishPush
+	JobManager::SInfoBlock* BeginPush()
+	{
+		m_lock.Lock();
+
+		if (m_pPushSegment == NULL || m_pPushSegment->nPush == eJobQueueOverflowSegmentSize)
+		{
+			SSegment* pSegment = AllocateSegment();
+			if (m_pPushSegment)
+				m_pPushSegment->pNext = pSegment;
+			else
+				m_pPullSegment = pSegment;
+			m_pPushSegment = pSegment;
+		}
+
+		return &m_pPushSegment->infoBlocks[m_pPushSegment->nPush];
+	}
+
+	// make the SInfoBlock returned by BeginPush visible to the workers and unlock the queue
+	void PublishPush()
+	{
+		m_pPushSegment->nPush++;
+		m_nNumPushedJobs++;
+		AngelicaInterlockedIncrement(&m_nNumJobs);
+		m_lock.Unlock();
+	}
+
+	// takes the oldest job and copies it into rInfoBlock
+	bool Pop(JobManager::SInfoBlock& rInfoBlock)
+	{
+		if (IsEmpty())
+			return false;
+
+		AUTO_LOCK_T(AngelicaCriticalSectionNonRecursive, m_lock);
+
+		SSegment* pSegment = m_pPullSegment;
+		if (pSegment == NULL || pSegment->nPull == pSegment->nPush)
+			return false;
+
+		pSegment->infoBlocks[pSegment->nPull++].AssignMembersTo(&rInfoBlock);
+		AngelicaInterlockedDecrement(&m_nNumJobs);
+
+		// a full segment which was drained completely can be reused
+		if (pSegment->nPull == eJobQueueOverflowSegmentSize)
+		{
+			m_pPullSegment = pSegment->pNext;
+			if (m_pPushSegment == pSegment)
+				m_pPushSegment = NULL;
+
+			pSegment->pNext = m_pFreeSegments;
+			m_pFreeSegments = pSegment;
+		}
+
+		return true;
+	}
+
+	// enqueue time of the oldest job, false if the queue is empty
+	bool PeekEnqueueTicks(unsigned long long& rEnqueueTicks)
+	{
+		if (IsEmpty())
+			return false;
+
+		AUTO_LOCK_T(AngelicaCriticalSectionNonRecursive, m_lock);
+
+		const SSegment* pSegment = m_pPullSegment;
+		if (pSegment == NULL || pSegment->nPull == pSegment->nPush)
+			return false;
+
+		rEnqueueTicks = pSegment->infoBlocks[pSegment->nPull].nEnqueueTicks;
+		return true;
+	}
+
+	// racy check used to decide if the lock needs to be taken
+	bool         IsEmpty() const { return m_nNumJobs == 0; }
+	unsigned int GetNumJobs() const { return (unsigned int)m_nNumJobs; }
+
+	// number of segments allocated so far and number of jobs which went through the overflow since the last reset
+	unsigned int GetNumSegments() const { return m_nNumSegments; }
+	unsigned int GetNumPushedJobs() const { return m_nNumPushedJobs; }
+	void         ResetNumPushedJobs()
+	{
+		AUTO_LOCK_T(AngelicaCriticalSectionNonRecursive, m_lock);
+		m_nNumPushedJobs = 0;
+	}
+
+private:
+	struct SSegment
+	{
+		JobManager::SInfoBlock infoBlocks[eJobQueueOverflowSegmentSize];
+		SSegment*              pNext;
+		unsigned int           nPush;   // next SInfoBlock to fill
+		unsigned int           nPull;   // next SInfoBlock to hand out
+	};
+
+	// called with the lock held
+	SSegment* AllocateSegment()
+	{
+		SSegment* pSegment = m_pFreeSegments;
+		if (pSegment)
+		{
+			m_pFreeSegments = pSegment->pNext;
+		}
+		else
+		{
+			pSegment = static_cast<SSegment*>(_aligned_malloc(sizeof(SSegment), 128));
+			// raw storage, the SInfoBlocks of a segment are assigned member by member before they are handed out
+			memset(static_cast<void*>(pSegment), 0, sizeof(SSegment));
+			++m_nNumSegments;
+		}
+
+		pSegment->pNext = NULL;
+		pSegment->nPush = 0;
+		pSegment->nPull = 0;
+		return pSegment;
+	}
+
+	static void FreeSegmentList(SSegment* pSegment)
+	{
+		while (pSegment)
+		{
+			SSegment* pNext = pSegment->pNext;
+			_aligned_free(pSegment);
+			pSegment = pNext;
+		}
+	}
+
+	volatile int                        m_nNumJobs;         // jobs in the queue, readable without the lock
+	AngelicaCriticalSectionNonRecursive m_lock;
+	SSegment*                           m_pPullSegment;     // oldest segment, jobs are popped from here
+	SSegment*                           m_pPushSegment;     // newest segment, jobs are pushed into it
+	SSegment*                           m_pFreeSegments;    // drained segments kept for reuse
+	unsigned int                        m_nNumSegments;
+	unsigned int                        m_nNumPushedJobs;
+};
+
+} // namespace detail
+} // namespace ThreadBackEnd
+} // namespace JobManager
+
+#endif // JOB_QUEUE_OVERFLOW_H_
@@ -8,26 +8,44 @@
 // -------------------------------------------------------------------------
 //  History:
 ////////////////////////////////////////////////////////////////////////////
-#include "StdAfx.h"
-#include "..\AngelicaPlatformDefines.h"
-#include"../Win32specific.h"
-#include "../MSVCspecific.h"
+#include "stdafx.h"
+#include "../AngelicaPlatformDefines.h"
+#if ANGELICA_PLATFORM_WINDOWS
+	#include "../Win32specific.h"
+	#include "../MSVCspecific.h"
+#else
+	#include "../Linuxspecific.h"
+	#include "../GCCspecific.h"
+#endif
 //#include <minwindef.h>
 #include "ThreadBackEnd.h"
+#include "../IThreadConfigManager.h"
 #include "../BitFiddling.h"
 #include "../JobManager.h"
 #include <algorithm>
 //#include "../../System.h"
 //#include "../../CPUDetect.h"
 #define PrefetchLine(ptr, off) angelicaPrefetchT0SSE((void*)((unsigned char*)(ptr) + off))
-#define ResetLine128(ptr, off) (void)(0)
-#define FlushLine128(ptr, off) (void)(0)
 ///////////////////////////////////////////////////////////////////////////////
 JobManager::ThreadBackEnd::CThreadBackEnd::CThreadBackEnd() 
-	: m_Semaphore(SJobQueue_ThreadBackEnd::eMaxWorkQueueJobsRegularPriority)
+	: m_pNodeJobQueues(NULL)
+	, m_nNumNumaNodes(1)
 	, m_nNumWorkerThreads(0)
+#if defined(JOBMANAGER_SUPPORT_WORK_STEALING)
+	, m_pWorkerDeques(NULL)
+#endif
+	, m_pWorkerInboxes(NULL)
+	, m_pFiberScheduler(NULL)
+	, m_nIdleStatsGeneration(0)
+	, m_nQueueStatsGeneration(0)
 {
-	m_JobQueue.Init();
+	memset((void*)m_arrPeakOccupancy, 0, sizeof(m_arrPeakOccupancy));
+	memset(m_arrWorkerNumaNode, 0, sizeof(m_arrWorkerNumaNode));
+	memset(m_arrCoreNumaNode, 0, sizeof(m_arrCoreNumaNode));
+
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	m_nTicksPerUS = freq.QuadPart >= 1000000 ? freq.QuadPart / 1000000 : 1;
 
 #if defined(JOBMANAGER_SUPPORT_FRAMEPROFILER)
 	m_pBackEndWorkerProfiler = 0;
@@ -37,36 +55,102 @@ JobManager::ThreadBackEnd::CThreadBackEnd::CThreadBackEnd()
 ///////////////////////////////////////////////////////////////////////////////
 JobManager::ThreadBackEnd::CThreadBackEnd::~CThreadBackEnd()
 {
+	// kept until here, the other backends can still submit jobs while they shut down
+	for (unsigned int nNumaNode = 0; m_pNodeJobQueues && nNumaNode < m_nNumNumaNodes; ++nNumaNode)
+		m_pNodeJobQueues[nNumaNode].Shutdown();
+	delete[] m_pNodeJobQueues;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 bool JobManager::ThreadBackEnd::CThreadBackEnd::Init(unsigned int nSysMaxWorker)
 {
-
-	// find out how many workers to create
-#if ANGELICA_PLATFORM_DURANGO || ANGELICA_PLATFORM_ORBIS
-	const unsigned int nNumCores = 4;
-#else
-	const unsigned int nNumCores = 8;
-#endif
-
-	unsigned int nNumWorkerToCreate = 0;
-
-	if (nSysMaxWorker)
-		nNumWorkerToCreate = std::min(nSysMaxWorker, nNumCores);
-	else
-		nNumWorkerToCreate = nNumCores;
-
+	// the job manager already sized the pool from the cpu topology, see SWorkerPoolLayout
+	const unsigned int nNumWorkerToCreate = std::min(nSysMaxWorker, (unsigned int)SCpuTopology::eMaxLogicalCores);
 	if (nNumWorkerToCreate == 0)
 		return false;
 
 	m_nNumWorkerThreads = nNumWorkerToCreate;
 
+	// one job queue per NUMA node, its SInfoBlocks are allocated on the node, a single node doesn't prefer any memory
+	// queue sizes can be configured until the job manager is initialized
+	const SCpuTopology& rTopology = CJobManager::Instance()->GetCpuTopology();
+	const SWorkerPoolLayout& rLayout = CJobManager::Instance()->GetWorkerPoolLayout();
+	m_nNumNumaNodes = std::max(rTopology.nNumNumaNodes, 1u);
+	memcpy(m_arrCoreNumaNode, rTopology.arrNumaNode, sizeof(m_arrCoreNumaNode));
+	for (unsigned int i = 0; i < nNumWorkerToCreate; ++i)
+		m_arrWorkerNumaNode[i] = i < rLayout.nNumWorkers ? rLayout.arrWorkerNumaNode[i] : 0;
+
+	m_pNodeJobQueues = new JobManager::SJobQueue_ThreadBackEnd[m_nNumNumaNodes];
+	for (unsigned int nNumaNode = 0; nNumaNode < m_nNumNumaNodes; ++nNumaNode)
+		m_pNodeJobQueues[nNumaNode].Init(CJobManager::Instance()->GetJobQueueCapacities(), m_nNumNumaNodes > 1 ? rTopology.arrNumaNodeId[nNumaNode] : ~0);
+
 	m_arrWorkerThreads.resize(nNumWorkerToCreate);
+	m_Semaphore.SetNumWorkers(nNumWorkerToCreate);
+	m_pWorkerInboxes = new detail::CJobQueueOverflow[nNumWorkerToCreate];
+
+#if defined(JOBMANAGER_SUPPORT_WORK_STEALING)
+	// deques need to exist before the first worker can push or steal
+	m_pWorkerDeques = new detail::CWorkStealingDeque[nNumWorkerToCreate * eNumPriorityLevel];
+	for (unsigned int i = 0; i < nNumWorkerToCreate * eNumPriorityLevel; ++i)
+		m_pWorkerDeques[i].Init(m_nNumNumaNodes > 1 ? rTopology.arrNumaNodeId[m_arrWorkerNumaNode[i / eNumPriorityLevel]] : ~0);
+#endif
+
+	// workers attach to the fiber scheduler when they start
+	if (CJobManager::Instance()->IsFiberModeEnabled())
+		m_pFiberScheduler = new detail::CFiberScheduler(m_Semaphore, &CThreadBackEndWorkerThread::ExecuteJob, CJobManager::Instance()->GetFiberStackSize());
+
+	// workers run small job functions only, spawn them with the backend stack size instead of the platform default
+	IThreadConfigManager* pThreadConfigManager = GetGlobalThreadManager()->GetThreadConfigManager();
+	SThreadConfig workerConfig = *pThreadConfigManager->GetDefaultThreadConfig();
+	workerConfig.szThreadName = "JobSystem_Worker_*";
+	workerConfig.stackSizeBytes = detail::eStackSize;
+	pThreadConfigManager->SetThreadConfig(workerConfig);
+
+	// bind each worker to the logical core chosen by the layout, SThreadConfig affinity masks only cover 32 cores
+	// on NUMA machines unpinned workers are still bound to the cores of their node, so they stay next to their queue
+	if (rLayout.bPinWorkers)
+	{
+		for (unsigned int i = 0; i < nNumWorkerToCreate && i < rLayout.nNumWorkers; ++i)
+		{
+			const unsigned int nLogicalCore = rLayout.arrWorkerLogicalCore[i];
+			if (nLogicalCore >= 32)
+				continue;
+
+			char szWorkerName[THREAD_NAME_LENGTH_MAX];
+			sprintf_s(szWorkerName, "JobSystem_Worker_%u", i);
+			SThreadConfig pinnedConfig = workerConfig;
+			pinnedConfig.szThreadName = szWorkerName;
+			pinnedConfig.affinityFlag = BIT(nLogicalCore);
+			pinnedConfig.paramActivityFlag |= SThreadConfig::eThreadParamFlag_Affinity;
+			pThreadConfigManager->SetThreadConfig(pinnedConfig);
+		}
+	}
+	else if (m_nNumNumaNodes > 1)
+	{
+		for (unsigned int i = 0; i < nNumWorkerToCreate; ++i)
+		{
+			unsigned int nNodeMask = 0;
+			for (unsigned int nLogicalCore = 0; nLogicalCore < rTopology.nNumLogicalCores && nLogicalCore < 32; ++nLogicalCore)
+			{
+				if (m_arrCoreNumaNode[nLogicalCore] == m_arrWorkerNumaNode[i])
+					nNodeMask |= BIT(nLogicalCore);
+			}
+			if (nNodeMask == 0)
+				continue;
+
+			char szWorkerName[THREAD_NAME_LENGTH_MAX];
+			sprintf_s(szWorkerName, "JobSystem_Worker_%u", i);
+			SThreadConfig nodeConfig = workerConfig;
+			nodeConfig.szThreadName = szWorkerName;
+			nodeConfig.affinityFlag = nNodeMask;
+			nodeConfig.paramActivityFlag |= SThreadConfig::eThreadParamFlag_Affinity;
+			pThreadConfigManager->SetThreadConfig(nodeConfig);
+		}
+	}
 
 	for (unsigned int i = 0; i < nNumWorkerToCreate; ++i)
 	{
-		m_arrWorkerThreads[i] = new CThreadBackEndWorkerThread(this, m_Semaphore, m_JobQueue, i);
+		m_arrWorkerThreads[i] = new CThreadBackEndWorkerThread(this, m_Semaphore, i, m_arrWorkerNumaNode[i]);
 
 		if (!GetGlobalThreadManager()->SpawnThread(m_arrWorkerThreads[i], "JobSystem_Worker_%u", i))
 		{
@@ -113,6 +197,17 @@ bool JobManager::ThreadBackEnd::CThreadBackEnd::ShutDown()
 		}
 	}
 
+#if defined(JOBMANAGER_SUPPORT_WORK_STEALING)
+	delete[] m_pWorkerDeques;
+	m_pWorkerDeques = NULL;
+#endif
+
+	delete[] m_pWorkerInboxes;
+	m_pWorkerInboxes = NULL;
+
+	delete m_pFiberScheduler;
+	m_pFiberScheduler = NULL;
+
 #if defined(JOBMANAGER_SUPPORT_FRAMEPROFILER)
 	SAFE_DELETE(m_pBackEndWorkerProfiler);
 #endif
@@ -126,78 +221,88 @@ void JobManager::ThreadBackEnd::CThreadBackEnd::AddJob(JobManager::CJobDelegator
 	unsigned int nJobPriority = crJob.GetPriorityLevel();
 	CJobManager* __restrict pJobManager = CJobManager::Instance();
 
+	IF (UseWorkerInbox(crJob), 0)
+	{
+		AddWorkerInboxJob(crJob, cJobHandle, rInfoBlock);
+		return;
+	}
+
+	// jobs with a deadline are shared by all workers and taken earliest deadline first
+	IF (UseQueueDeadline(crJob), 0)
+	{
+#if !defined(_RELEASE)
+		pJobManager->IncreaseRunJobs();
+#endif
+		InitJobInfoBlock(crJob, cJobHandle, rInfoBlock, *m_queueDeadline.BeginPush());
+		m_queueDeadline.PublishPush(nJobPriority);
+
+		// Release semaphore count to signal the workers that work is available
+		m_Semaphore.SignalNewJob();
+		return;
+	}
+
+#if defined(JOBMANAGER_SUPPORT_WORK_STEALING)
+	// jobs spawned by one of our workers stay in the deque of that worker
+	// blocking jobs still go through the global path to reach the blocking backend
+	const unsigned int nWorkerThreadId = JobManager::IsWorkerThread() ? JobManager::GetWorkerThreadId() : ~0;
+	if (nWorkerThreadId < m_nNumWorkerThreads && !crJob.IsBlocking())
+	{
+		detail::CWorkStealingDeque& rDeque = GetWorkerDeque(nWorkerThreadId, nJobPriority);
+		JobManager::SInfoBlock* pLocalInfoBlock = rDeque.BeginPush();
+		IF (pLocalInfoBlock, 1)
+		{
+#if !defined(_RELEASE)
+			pJobManager->IncreaseRunJobs();
+#endif
+			InitJobInfoBlock(crJob, cJobHandle, rInfoBlock, *pLocalInfoBlock);
+			rDeque.PublishPush();
+
+			// Release semaphore count to signal the workers that work is available
+			m_Semaphore.SignalNewJob();
+			return;
+		}
+		// deque is full, fall through to the global queue
+	}
+#endif
+
 	/////////////////////////////////////////////////////////////////////////////
-	// Acquire Infoblock to use
-	unsigned int jobSlot;
+	// Acquire Infoblock to use, from the queue of the node the job is submitted on
+	unsigned int jobSlot = 0;
 	JobManager::SInfoBlock* pFallbackInfoBlock = NULL;
-	// only wait for a jobslot if we are submitting from a regular thread, or if we are submitting
-	// a blocking job from a regular worker thread
-	bool bWaitForFreeJobSlot = (JobManager::IsWorkerThread() == false) && (JobManager::IsBlockingWorkerThread() == false);
-	JobManager::detail::EAddJobRes cEnqRes = m_JobQueue.GetJobSlot(jobSlot, nJobPriority, bWaitForFreeJobSlot);
+	JobManager::SJobQueue_ThreadBackEnd& rJobQueue = m_pNodeJobQueues[GetSubmitNumaNode()];
+	// never wait for a jobslot, if the queue is full the job goes into the overflow queue which all workers pull from
+	detail::CJobQueueOverflow& rQueueOverflow = m_arrQueueOverflows[nJobPriority];
+	JobManager::detail::EAddJobRes cEnqRes = UseQueueOverflow(nJobPriority) ? JobManager::detail::eAJR_NeedFallbackJobInfoBlock : rJobQueue.GetJobSlot(jobSlot, nJobPriority, false);
 
 #if !defined(_RELEASE)
 	pJobManager->IncreaseRunJobs();
 	if (cEnqRes == JobManager::detail::eAJR_NeedFallbackJobInfoBlock)
 		pJobManager->IncreaseRunFallbackJobs();
 #endif
-	// allocate fallback infoblock if needed
+	// get fallback infoblock if needed, blocking jobs submitted from regular workers are handed over to the blocking backend
+	const bool bBlockingFallback = crJob.IsBlocking() && JobManager::IsWorkerThread();
 	IF (cEnqRes == JobManager::detail::eAJR_NeedFallbackJobInfoBlock, 0)
-		pFallbackInfoBlock = new JobManager::SInfoBlock();
+		pFallbackInfoBlock = bBlockingFallback ? new JobManager::SInfoBlock() : rQueueOverflow.BeginPush();
 
 	// copy info block into job queue
 	PREFAST_ASSUME(pFallbackInfoBlock);
 	JobManager::SInfoBlock& RESTRICT_REFERENCE rJobInfoBlock = (cEnqRes == JobManager::detail::eAJR_NeedFallbackJobInfoBlock ?
-	                                                            *pFallbackInfoBlock : m_JobQueue.jobInfoBlocks[nJobPriority][jobSlot]);
+	                                                            *pFallbackInfoBlock : rJobQueue.GetJobInfoBlock(nJobPriority, jobSlot));
 
-	// since we will use the whole InfoBlock, and it is aligned to 128 bytes, clear the cacheline, this is faster than a cachemiss on write
-#if ANGELICA_PLATFORM_64BIT
-	//STATIC_CHECK( sizeof(JobManager::SInfoBlock) == 512, ERROR_SIZE_OF_SINFOBLOCK_NOT_EQUALS_512 );
-#else
-	//STATIC_CHECK( sizeof(JobManager::SInfoBlock) == 384, ERROR_SIZE_OF_SINFOBLOCK_NOT_EQUALS_384 );
-#endif
-
-	// first cache line needs to be persistent
-	ResetLine128(&rJobInfoBlock, 128);
-	ResetLine128(&rJobInfoBlock, 256);
-#if ANGELICA_PLATFORM_64BIT
-	ResetLine128(&rJobInfoBlock, 384);
-#endif
+	// a job queue slot is only SInfoBlock::scSizeOfJobQueueSlot bytes, the following slots belong to other jobs
+	// so only the header and the parameters in use are written, fallback blocks are full SInfoBlocks
 
 	/////////////////////////////////////////////////////////////////////////////
 	// Initialize the InfoBlock
-	rInfoBlock.AssignMembersTo(&rJobInfoBlock);
-
-	// copy job parameter if it is a non-queue job
-	if (crJob.GetQueue() == NULL)
-	{
-		JobManager::CJobManager::CopyJobParameter(crJob.GetParamDataSize(), rJobInfoBlock.GetParamAddress(), crJob.GetJobParamData());
-	}
-
-	assert(rInfoBlock.jobInvoker);
-
-	const unsigned int cJobId = cJobHandle->jobId;
-	rJobInfoBlock.jobId = (unsigned char)cJobId;
-
-#if defined(JOBMANAGER_SUPPORT_FRAMEPROFILER)
-	assert(cJobId < JobManager::detail::eJOB_FRAME_STATS_MAX_SUPP_JOBS);
-	m_pBackEndWorkerProfiler->RegisterJob(cJobId, pJobManager->GetJobName(rInfoBlock.jobInvoker));
-	rJobInfoBlock.frameProfIndex = (unsigned char)m_pBackEndWorkerProfiler->GetProfileIndex();
-#endif
+	InitJobInfoBlock(crJob, cJobHandle, rInfoBlock, rJobInfoBlock, cEnqRes != JobManager::detail::eAJR_NeedFallbackJobInfoBlock);
 
 	/////////////////////////////////////////////////////////////////////////////
 	// initialization finished, make all visible for worker threads
-	// the producing thread won't need the info block anymore, flush it from the cache
-	FlushLine128(&rJobInfoBlock, 0);
-	FlushLine128(&rJobInfoBlock, 128);
-#if ANGELICA_PLATFORM_64BIT
-	FlushLine128(&rJobInfoBlock, 256);
-	FlushLine128(&rJobInfoBlock, 384);
-#endif
 
 	IF (cEnqRes == JobManager::detail::eAJR_NeedFallbackJobInfoBlock, 0)
 	{
 		// catch submission from regular workers to the blocking backend
-		if (crJob.IsBlocking())
+		if (bBlockingFallback)
 		{
 			pJobManager->AddBlockingFallbackJob(pFallbackInfoBlock, JobManager::GetWorkerThreadId());
 
@@ -206,13 +311,17 @@ void JobManager::ThreadBackEnd::CThreadBackEnd::AddJob(JobManager::CJobDelegator
 		}
 		else
 		{
-			JobManager::detail::PushToFallbackJobList(&rJobInfoBlock);
+			rQueueOverflow.PublishPush();
+			RecordQueueOccupancy(nJobPriority, rJobQueue);
+
+			// Release semaphore count to signal the workers that work is available
+			m_Semaphore.SignalNewJob();
 		}
 	}
 	else
 	{
-		MemoryBarrier();
-		m_JobQueue.jobInfoBlockStates[nJobPriority][jobSlot].SetReady();
+		rJobQueue.PublishJobSlots(jobSlot, 1, nJobPriority);
+		RecordQueueOccupancy(nJobPriority, rJobQueue);
 
 		// Release semaphore count to signal the workers that work is available
 		m_Semaphore.SignalNewJob();
@@ -220,254 +329,1221 @@ void JobManager::ThreadBackEnd::CThreadBackEnd::AddJob(JobManager::CJobDelegator
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::SignalStopWork()
-{
-	m_bStop = true;
-}
-
-//inline CFrameProfiler* GetFrameProfilerForName(const char* name)
-//{
-//	static std::vector<std::pair<const char*, CFrameProfiler*>> s_profilers;
-//	static AngelicaRWLock s_profilersLock;
-//
-//	s_profilersLock.RLock();
-//	for (auto& p : s_profilers)
-//	{
-//		if (p.first == name) // compare pointer address. not content.
-//		{
-//			s_profilersLock.RUnlock();
-//			return p.second;
-//		}
-//	}
-//	s_profilersLock.RUnlock();
-//	
-//
-//	s_profilersLock.WLock();
-//	for (auto& p : s_profilers)
-//	{
-//		if (p.first == name) // compare pointer address. not content.
-//		{
-//			s_profilersLock.WUnlock();
-//			return p.second;
-//		}
-//	}
-//	CFrameProfiler* pNewProfiler = new CFrameProfiler(PROFILE_SYSTEM, EProfileDescription::REGION, name, "", 0);
-//	s_profilers.reserve(256);
-//	s_profilers.push_back(std::make_pair(name, pNewProfiler));
-//	s_profilersLock.WUnlock();
-//
-//	return pNewProfiler;
-//}
-
-//////////////////////////////////////////////////////////////////////////
-void JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::ThreadEntry()
+void JobManager::ThreadBackEnd::CThreadBackEnd::AddJobs(JobManager::CJobBase* const* ppJobs, unsigned int nNumJobs)
 {
-	// set up thread id
-	JobManager::detail::SetWorkerThreadId(m_nId);
-
-#if defined(JOB_SPIN_DURING_IDLE)
-	HANDLE nThreadID = GetCurrentThread();
-#endif
-
-	LARGE_INTEGER freq;
-	double frequency;
-	QueryPerformanceFrequency(&freq);
-	frequency = 1.f / static_cast<double>(freq.QuadPart);
-	unsigned long long nTicksInJobExecution = 0;
-	const float fMinTimeInJobExecution = 1.0f;
-
 	CJobManager* __restrict pJobManager = CJobManager::Instance();
-
-	do
+	JobManager::SInfoBlock infoBlock;
+	unsigned int nNumPublishedJobs = 0;
+	unsigned int nJob = 0;
+
+#if defined(JOBMANAGER_SUPPORT_WORK_STEALING)
+	// jobs spawned by one of our workers stay in the deque of that worker
+	const unsigned int nWorkerThreadId = JobManager::IsWorkerThread() ? JobManager::GetWorkerThreadId() : ~0;
+	if (nWorkerThreadId < m_nNumWorkerThreads)
 	{
-		SInfoBlock infoBlock;
-		CJobManager* __restrict pJobManager = CJobManager::Instance();
-		unsigned int nPriorityLevel = ~0;
-		JobManager::SInfoBlock* pFallbackInfoBlock = JobManager::detail::PopFromFallbackJobList();
-
-		IF (pFallbackInfoBlock, 0)
+		for (; nJob < nNumJobs; ++nJob)
 		{
-			//ANGELICA_PROFILE_REGION(PROFILE_SYSTEM, "JobWorkerThread: Fallback");
+			JobManager::CJobDelegator& crJob = *ppJobs[nJob]->GetJobDelegator();
+			const JobManager::TJobHandle cJobHandle = ppJobs[nJob]->GetJobProgramData();
+			pJobManager->InitInfoBlock(crJob, cJobHandle, infoBlock);
 
-			// in case of a fallback job, just get it from the global per thread list
-			pFallbackInfoBlock->AssignMembersTo(&infoBlock);
-			if (!infoBlock.HasQueue())  // copy parameters for non producer/consumer jobs
+			detail::CWorkStealingDeque& rDeque = GetWorkerDeque(nWorkerThreadId, crJob.GetPriorityLevel());
+			JobManager::SInfoBlock* pLocalInfoBlock = (UseQueueDeadline(crJob) || UseWorkerInbox(crJob)) ? NULL : rDeque.BeginPush();
+			IF (pLocalInfoBlock == NULL, 0)
 			{
-				JobManager::CJobManager::CopyJobParameter(infoBlock.paramSize << 4, infoBlock.GetParamAddress(), pFallbackInfoBlock->GetParamAddress());
+				// deque is full or the job has a deadline or a target worker, the regular path picks the queue
+				AddJob(crJob, cJobHandle, infoBlock);
+				continue;
 			}
 
-			// free temp info block again
-			delete pFallbackInfoBlock;
+#if !defined(_RELEASE)
+			pJobManager->IncreaseRunJobs();
+#endif
+			InitJobInfoBlock(crJob, cJobHandle, infoBlock, *pLocalInfoBlock);
+			rDeque.PublishPush();
+			++nNumPublishedJobs;
 		}
-		else
+	}
+#endif
+
+	// the rest of the batch goes into the queue of the node it is submitted on
+	JobManager::SJobQueue_ThreadBackEnd& rJobQueue = m_pNodeJobQueues[GetSubmitNumaNode()];
+	while (nJob < nNumJobs)
+	{
+		// jobs targeted at a worker go into its inbox one by one, each wakes only its worker
+		IF (UseWorkerInbox(*ppJobs[nJob]->GetJobDelegator()), 0)
 		{
-			///////////////////////////////////////////////////////////////////////////
-			// wait for new work
-			// we will only do a real wait if jobs accumulated time was more
-			// than fMinTimeInJobExecution ms, to prevent system calls when we
-			// execute a massive number of small jobs
+			JobManager::CJobDelegator& crJob = *ppJobs[nJob]->GetJobDelegator();
+			const JobManager::TJobHandle cJobHandle = ppJobs[nJob]->GetJobProgramData();
+			pJobManager->InitInfoBlock(crJob, cJobHandle, infoBlock);
+			AddWorkerInboxJob(crJob, cJobHandle, infoBlock);
 
-			//ANGELICA_PROFILE_REGION_WAITING(PROFILE_SYSTEM, "Wait - JobWorkerThread");
+			++nJob;
+			continue;
+		}
 
-			float fMSInJobExecution = static_cast<float>(nTicksInJobExecution * 1000.0f * frequency);
-			if (fMSInJobExecution > fMinTimeInJobExecution || !m_rSemaphore.TryGetJob())
-			{
-#if defined(JOB_SPIN_DURING_IDLE)
-				SetThreadPriority(nThreadID, THREAD_PRIORITY_IDLE);
+		// jobs with a deadline go into the deadline queue one by one
+		IF (UseQueueDeadline(*ppJobs[nJob]->GetJobDelegator()), 0)
+		{
+			JobManager::CJobDelegator& crJob = *ppJobs[nJob]->GetJobDelegator();
+			const JobManager::TJobHandle cJobHandle = ppJobs[nJob]->GetJobProgramData();
+			pJobManager->InitInfoBlock(crJob, cJobHandle, infoBlock);
+#if !defined(_RELEASE)
+			pJobManager->IncreaseRunJobs();
 #endif
-				m_rSemaphore.WaitForNewJob(m_nId);
-#if defined(JOB_SPIN_DURING_IDLE)
-				SetThreadPriority(nThreadID, THREAD_PRIORITY_TIME_CRITICAL);
+			InitJobInfoBlock(crJob, cJobHandle, infoBlock, *m_queueDeadline.BeginPush());
+			m_queueDeadline.PublishPush(crJob.GetPriorityLevel());
+
+			++nNumPublishedJobs;
+			++nJob;
+			continue;
+		}
+
+		// consecutive jobs of the same priority are reserved together
+		const unsigned int nJobPriority = ppJobs[nJob]->GetJobDelegator()->GetPriorityLevel();
+		unsigned int nRunLength = 1;
+		while (nJob + nRunLength < nNumJobs && ppJobs[nJob + nRunLength]->GetJobDelegator()->GetPriorityLevel() == nJobPriority &&
+		       !UseQueueDeadline(*ppJobs[nJob + nRunLength]->GetJobDelegator()) && !UseWorkerInbox(*ppJobs[nJob + nRunLength]->GetJobDelegator()))
+			++nRunLength;
+
+		unsigned int nFirstJobSlot = 0;
+		const unsigned int nNumReservedSlots = UseQueueOverflow(nJobPriority) ? 0 : rJobQueue.GetJobSlots(nFirstJobSlot, nRunLength, nJobPriority, false);
+		IF (nNumReservedSlots == 0, 0)
+		{
+			// queue is full, the rest of the run goes into the overflow queue
+			detail::CJobQueueOverflow& rQueueOverflow = m_arrQueueOverflows[nJobPriority];
+			for (unsigned int i = 0; i < nRunLength; ++i)
+			{
+				JobManager::CJobDelegator& crJob = *ppJobs[nJob + i]->GetJobDelegator();
+				const JobManager::TJobHandle cJobHandle = ppJobs[nJob + i]->GetJobProgramData();
+				pJobManager->InitInfoBlock(crJob, cJobHandle, infoBlock);
+#if !defined(_RELEASE)
+				pJobManager->IncreaseRunJobs();
+				pJobManager->IncreaseRunFallbackJobs();
 #endif
-				nTicksInJobExecution = 0;
+				InitJobInfoBlock(crJob, cJobHandle, infoBlock, *rQueueOverflow.BeginPush());
+				rQueueOverflow.PublishPush();
 			}
+			RecordQueueOccupancy(nJobPriority, rJobQueue);
 
-			IF (m_bStop == true, 0)
-				break;
+			nNumPublishedJobs += nRunLength;
+			nJob += nRunLength;
+			continue;
+		}
 
-			///////////////////////////////////////////////////////////////////////////
-			// multiple steps to get a job of the queue
-			// 1. get our job slot index
-			unsigned long long currentPushIndex = ~0;
-			unsigned long long currentPullIndex = ~0;
-			unsigned long long newPullIndex = ~0;
-			do
-			{
-				// volatile load
-#if ANGELICA_PLATFORM_WINDOWS || ANGELICA_PLATFORM_APPLE || ANGELICA_PLATFORM_LINUX || ANGELICA_PLATFORM_ANDROID// emulate a 64bit atomic read on PC platfom
-				currentPullIndex = AngelicaInterlockedCompareExchange64(alias_cast<volatile signed long long*>(&m_rJobQueue.pull.index), 0, 0);
-				currentPushIndex = AngelicaInterlockedCompareExchange64(alias_cast<volatile signed long long*>(&m_rJobQueue.push.index), 0, 0);
-#else
-				currentPullIndex = *const_cast<volatile unsigned long long*>(&m_rJobQueue.pull.index);
-				currentPushIndex = *const_cast<volatile unsigned long long*>(&m_rJobQueue.push.index);
+		const unsigned int nQueueMask = rJobQueue.GetMaxWorkerQueueJobs(nJobPriority) - 1;
+		for (unsigned int i = 0; i < nNumReservedSlots; ++i)
+		{
+			JobManager::CJobDelegator& crJob = *ppJobs[nJob + i]->GetJobDelegator();
+			const JobManager::TJobHandle cJobHandle = ppJobs[nJob + i]->GetJobProgramData();
+			pJobManager->InitInfoBlock(crJob, cJobHandle, infoBlock);
+#if !defined(_RELEASE)
+			pJobManager->IncreaseRunJobs();
 #endif
-				// spin if the updated push ptr didn't reach us yet
-				if (currentPushIndex == currentPullIndex)
-					continue;
+			InitJobInfoBlock(crJob, cJobHandle, infoBlock, rJobQueue.GetJobInfoBlock(nJobPriority, (nFirstJobSlot + i) & nQueueMask), true);
+		}
 
-				// compute priority level from difference between push/pull
-				if (!JobManager::SJobQueuePos::IncreasePullIndex(currentPullIndex, currentPushIndex, newPullIndex, nPriorityLevel,
-				                                                 m_rJobQueue.GetMaxWorkerQueueJobs(eHighPriority), m_rJobQueue.GetMaxWorkerQueueJobs(eRegularPriority), m_rJobQueue.GetMaxWorkerQueueJobs(eLowPriority), m_rJobQueue.GetMaxWorkerQueueJobs(eStreamPriority)))
-					continue;
+		// make all slots of the run visible with one barrier
+		rJobQueue.PublishJobSlots(nFirstJobSlot, nNumReservedSlots, nJobPriority);
+		RecordQueueOccupancy(nJobPriority, rJobQueue);
 
-				// stop spinning when we succesfull got the index
-				if (AngelicaInterlockedCompareExchange64(alias_cast<volatile signed long long*>(&m_rJobQueue.pull.index), newPullIndex, currentPullIndex) == currentPullIndex)
-					break;
+		nNumPublishedJobs += nNumReservedSlots;
+		nJob += nNumReservedSlots;
+	}
 
-			}
-			while (true);
+	// Release semaphore count once for the whole batch, only as many workers as jobs are woken
+	if (nNumPublishedJobs)
+		m_Semaphore.SignalNewJobs(nNumPublishedJobs);
+}
 
-			// compute our jobslot index from the only increasing publish index
-			unsigned int nExtractedCurIndex = static_cast<unsigned int>(JobManager::SJobQueuePos::ExtractIndex(currentPullIndex, nPriorityLevel));
-			unsigned int nNumWorkerQUeueJobs = m_rJobQueue.GetMaxWorkerQueueJobs(nPriorityLevel);
-			unsigned int nJobSlot = nExtractedCurIndex & (nNumWorkerQUeueJobs - 1);
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::CThreadBackEnd::AddWorkerInboxJob(JobManager::CJobDelegator& crJob, const JobManager::TJobHandle cJobHandle, JobManager::SInfoBlock& rInfoBlock)
+{
+#if !defined(_RELEASE)
+	CJobManager::Instance()->IncreaseRunJobs();
+#endif
+	const unsigned int nWorkerId = crJob.GetTargetWorker();
+	detail::CJobQueueOverflow& rInbox = m_pWorkerInboxes[nWorkerId];
+	InitJobInfoBlock(crJob, cJobHandle, rInfoBlock, *rInbox.BeginPush());
+	rInbox.PublishPush();
 
-			// 2. Wait still the produces has finished writing all data to the SInfoBlock
-			JobManager::detail::SJobQueueSlotState* pJobInfoBlockState = &m_rJobQueue.jobInfoBlockStates[nPriorityLevel][nJobSlot];
-			int iter = 0;
-			while (!pJobInfoBlockState->IsReady())
-			{
-				Sleep(iter++ > 10 ? 1 : 0);
-			}
-			;
+	// the job is counted for its worker only, a shared signal could wake a worker which can't take it
+	m_Semaphore.SignalWorkerJob(nWorkerId);
+}
 
-			// 3. Get a local copy of the info block as asson as it is ready to be used
-			JobManager::SInfoBlock* pCurrentJobSlot = &m_rJobQueue.jobInfoBlocks[nPriorityLevel][nJobSlot];
-			pCurrentJobSlot->AssignMembersTo(&infoBlock);
-			if (!infoBlock.HasQueue())  // copy parameters for non producer/consumer jobs
-			{
-				JobManager::CJobManager::CopyJobParameter(infoBlock.paramSize << 4, infoBlock.GetParamAddress(), pCurrentJobSlot->GetParamAddress());
-			}
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::CThreadBackEnd::AddMainThreadJob(JobManager::CJobDelegator& crJob, const JobManager::TJobHandle cJobHandle, JobManager::SInfoBlock& rInfoBlock)
+{
+	assert(!rInfoBlock.HasQueue());
+#if !defined(_RELEASE)
+	CJobManager::Instance()->IncreaseRunJobs();
+#endif
+	InitJobInfoBlock(crJob, cJobHandle, rInfoBlock, *m_queueMainThread.BeginPush());
+	m_queueMainThread.PublishPush();
+}
 
-			// 4. Remark the job state as suspended
-			MemoryBarrier();
-			pJobInfoBlockState->SetNotReady();
+///////////////////////////////////////////////////////////////////////////////
+unsigned int JobManager::ThreadBackEnd::CThreadBackEnd::PumpMainThreadJobs(unsigned int nBudgetMicroSec)
+{
+	// jobs queued by the jobs run here wait for the next pump, a job queueing itself again can't keep the pump busy
+	const unsigned int nNumQueuedJobs = m_queueMainThread.GetNumJobs();
+	const long long nEndTicks = GetRealTicks() + (long long)nBudgetMicroSec * m_nTicksPerUS;
+	unsigned int nNumJobsRun = 0;
 
-			// 5. Mark the jobslot as free again
-			MemoryBarrier();
-			pCurrentJobSlot->Release((1 << JobManager::SJobQueuePos::eBitsPerPriorityLevel) / m_rJobQueue.GetMaxWorkerQueueJobs(nPriorityLevel));
-		}
+	JobManager::SInfoBlock infoBlock;
+	while (nNumJobsRun < nNumQueuedJobs && m_queueMainThread.Pop(infoBlock))
+	{
+		++nNumJobsRun;
 
-		///////////////////////////////////////////////////////////////////////////
-		// now we have a valid SInfoBlock to start work on it
-		// check if it is a producer/consumer queue job
-		IF (infoBlock.HasQueue(), 0)
+		IF (infoBlock.IsCancelled(), 0)
 		{
-			DoWorkProducerConsumerQueue(infoBlock);
+			CThreadBackEndWorkerThread::SkipCancelledJob(infoBlock);
 		}
 		else
 		{
-			// Now we are safe to use the info block
-			assert(infoBlock.jobInvoker);
-			assert(infoBlock.GetParamAddress());
-
-			// store job start time
-#if defined(JOBMANAGER_SUPPORT_PROFILING)
-			SJobProfilingData* pJobProfilingData = gEnv->GetJobManager()->GetProfilingData(infoBlock.profilerIndex);
-			pJobProfilingData->nStartTime = gEnv->pTimer->GetAsyncTime();
-			pJobProfilingData->nWorkerThread = GetWorkerThreadId();
-#endif
-
-#if defined(JOBMANAGER_SUPPORT_FRAMEPROFILER)
-			const unsigned long long nStartTime = JobManager::IWorkerBackEndProfiler::GetTimeSample();
-#endif
-
-			{
-				// call delegator function to invoke job entry
-//#if !defined(_RELEASE) || defined(PERFORMANCE_BUILD)
-//				const char* jobName = pJobManager->GetJobName(infoBlock.jobInvoker);
-//
-//				char job_info[128];
-//				CFrameProfiler* pProfiler = GetFrameProfilerForName(jobName);
-//				CFrameProfilerSection frameProfilerSection2(pProfiler, jobName, jobName, EProfileDescription::SECTION);
-//				BROFILER_SECTION(jobName)
-//
-//				angelica_sprintf(job_info, "%s (Prio %u)", jobName, nPriorityLevel);
-//
-//				ANGELICAPROFILE_SCOPE_PROFILE_MARKER(job_info);
-//				ANGELICAPROFILE_SCOPE_PLATFORM_MARKER(job_info);
-//#endif
-
-				unsigned long long nJobStartTicks = GetRealTicks();
-
-				if (infoBlock.jobLambdaInvoker)
-				{
-					infoBlock.jobLambdaInvoker();
-				}
-				else
-				{
-					(*infoBlock.jobInvoker)(infoBlock.GetParamAddress());
-				}
-				nTicksInJobExecution += GetRealTicks() - nJobStartTicks;
-			}
-
-#if defined(JOBMANAGER_SUPPORT_FRAMEPROFILER)
-			JobManager::IWorkerBackEndProfiler* workerProfiler = m_pThreadBackend->GetBackEndWorkerProfiler();
-			const unsigned long long nEndTime = JobManager::IWorkerBackEndProfiler::GetTimeSample();
-			workerProfiler->RecordJob(infoBlock.frameProfIndex, m_nId, static_cast<const unsigned int>(infoBlock.jobId), static_cast<const unsigned int>(nEndTime - nStartTime));
-#endif
+			JobManager::detail::SetCurrentJobCancellationToken(infoBlock.pCancellationToken);
+			(*infoBlock.jobInvoker)(infoBlock.GetParamAddress());
+			JobManager::detail::SetCurrentJobCancellationToken(NULL);
 
 			IF (infoBlock.GetJobState(), 1)
-			{
-				SJobState* pJobState = infoBlock.GetJobState();
-				pJobState->SetStopped();
-			}
-#if defined(JOBMANAGER_SUPPORT_PROFILING)
-			pJobProfilingData->nEndTime = gEnv->pTimer->GetAsyncTime();
-#endif
+				infoBlock.GetJobState()->SetStopped();
 		}
 
+		if (nBudgetMicroSec && GetRealTicks() >= nEndTicks)
+			break;
 	}
-	while (m_bStop == false);
 
+	return nNumJobsRun;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-inline void IncrQueuePullPointer(INT_PTR& rCurPullAddr, const INT_PTR cIncr, const INT_PTR cQueueStart, const INT_PTR cQueueEnd)
+void JobManager::ThreadBackEnd::CThreadBackEnd::InitJobInfoBlock(JobManager::CJobDelegator& crJob, const JobManager::TJobHandle cJobHandle, JobManager::SInfoBlock& rInfoBlock, JobManager::SInfoBlock& rJobInfoBlock, bool bJobQueueSlot)
 {
-	const INT_PTR cNextPull = rCurPullAddr + cIncr;
-	rCurPullAddr = (cNextPull >= cQueueEnd) ? cQueueStart : cNextPull;
-}
+	// the parameters are copied from the job, rInfoBlock only holds the header
+	rInfoBlock.AssignHeaderTo(&rJobInfoBlock);
+
+	// copy job parameter if it is a non-queue job
+	if (crJob.GetQueue() == NULL)
+	{
+		if (bJobQueueSlot)
+			CJobManager::Instance()->CopyJobParameterToQueueSlot(crJob.GetParamDataSize(), rJobInfoBlock, crJob.GetJobParamData());
+		else
+			JobManager::CJobManager::CopyJobParameter(crJob.GetParamDataSize(), rJobInfoBlock.GetParamAddress(), crJob.GetJobParamData());
+	}
+
+	assert(rInfoBlock.jobInvoker);
+
+	const unsigned int cJobId = cJobHandle->jobId;
+	rJobInfoBlock.jobId = (unsigned char)cJobId;
+	rJobInfoBlock.nEnqueueTicks = GetRealTicks();
+
+#if defined(JOBMANAGER_SUPPORT_FRAMEPROFILER)
+	assert(cJobId < JobManager::detail::eJOB_FRAME_STATS_MAX_SUPP_JOBS);
+	m_pBackEndWorkerProfiler->RegisterJob(cJobId, cJobHandle->cpString);
+	rJobInfoBlock.frameProfIndex = (unsigned char)m_pBackEndWorkerProfiler->GetProfileIndex();
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool JobManager::ThreadBackEnd::CThreadBackEnd::UseQueueDeadline(const JobManager::CJobDelegator& crJob) const
+{
+	return crJob.GetDeadline() != 0 && !crJob.IsBlocking() && CJobManager::Instance()->IsDeadlineSchedulingEnabled();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+unsigned int JobManager::ThreadBackEnd::CThreadBackEnd::GetSubmitNumaNode() const
+{
+	if (m_nNumNumaNodes == 1)
+		return 0;
+
+	const unsigned int nWorkerThreadId = JobManager::IsWorkerThread() ? JobManager::GetWorkerThreadId() : ~0;
+	if (nWorkerThreadId < m_nNumWorkerThreads)
+		return m_arrWorkerNumaNode[nWorkerThreadId];
+
+	// other threads can move between nodes, the core they run on right now is good enough
+	const unsigned int nLogicalCore = JobManager::detail::GetCurrentLogicalCore();
+	return nLogicalCore < SCpuTopology::eMaxLogicalCores ? m_arrCoreNumaNode[nLogicalCore] : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::CThreadBackEnd::RecordQueueOccupancy(unsigned int nPriorityLevel, const JobManager::SJobQueue_ThreadBackEnd& rJobQueue)
+{
+	const unsigned long long currentPushIndex = *const_cast<volatile unsigned long long*>(&rJobQueue.push.index);
+	const unsigned long long currentPullIndex = *const_cast<volatile unsigned long long*>(&rJobQueue.pull.index);
+	const unsigned int nIndexMask = (1 << JobManager::SJobQueuePos::eBitsPerPriorityLevel) - 1;
+	const int nOccupancy = (int)((JobManager::SJobQueuePos::ExtractIndex(currentPushIndex, nPriorityLevel) - JobManager::SJobQueuePos::ExtractIndex(currentPullIndex, nPriorityLevel)) & nIndexMask) +
+	                       (int)m_arrQueueOverflows[nPriorityLevel].GetNumJobs();
+
+	int nPeakOccupancy = m_arrPeakOccupancy[nPriorityLevel];
+	while (nOccupancy > nPeakOccupancy)
+	{
+		if (AngelicaInterlockedCompareExchange(alias_cast<volatile LONG*>(&m_arrPeakOccupancy[nPriorityLevel]), nOccupancy, nPeakOccupancy) == nPeakOccupancy)
+			break;
+		nPeakOccupancy = m_arrPeakOccupancy[nPriorityLevel];
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::CThreadBackEnd::GetJobQueueStats(JobManager::SJobQueueStats& rStats) const
+{
+	for (unsigned int nPriorityLevel = 0; nPriorityLevel < eNumPriorityLevel; ++nPriorityLevel)
+	{
+		rStats.nCapacity[nPriorityLevel] = m_pNodeJobQueues[0].GetMaxWorkerQueueJobs(nPriorityLevel) * m_nNumNumaNodes;
+		rStats.nPeakOccupancy[nPriorityLevel] = (unsigned int)m_arrPeakOccupancy[nPriorityLevel];
+		rStats.nOverflowJobs[nPriorityLevel] = m_arrQueueOverflows[nPriorityLevel].GetNumPushedJobs();
+		rStats.nOverflowSegments[nPriorityLevel] = m_arrQueueOverflows[nPriorityLevel].GetNumSegments();
+	}
+
+	const unsigned int nGeneration = GetJobQueueStatsGeneration();
+	for (unsigned int i = 0; i < m_arrWorkerThreads.size(); ++i)
+	{
+		// a worker which didn't take a job since the last reset still holds the old values
+		if (m_arrWorkerThreads[i] == NULL || m_arrWorkerThreads[i]->GetSchedulingState().nStatsGeneration != nGeneration)
+			continue;
+
+		const JobManager::SJobQueueStats& rWorkerStats = m_arrWorkerThreads[i]->GetSchedulingState().stats;
+		for (unsigned int nPriorityLevel = 0; nPriorityLevel < eNumPriorityLevel; ++nPriorityLevel)
+		{
+			rStats.nDequeuedJobs[nPriorityLevel] += rWorkerStats.nDequeuedJobs[nPriorityLevel];
+			rStats.nAgedJobs[nPriorityLevel] += rWorkerStats.nAgedJobs[nPriorityLevel];
+			rStats.nTotalWaitUS[nPriorityLevel] += rWorkerStats.nTotalWaitUS[nPriorityLevel];
+			rStats.nMaxWaitUS[nPriorityLevel] = std::max(rStats.nMaxWaitUS[nPriorityLevel], rWorkerStats.nMaxWaitUS[nPriorityLevel]);
+		}
+		rStats.nLocalNodeJobs += rWorkerStats.nLocalNodeJobs;
+		rStats.nRemoteNodeJobs += rWorkerStats.nRemoteNodeJobs;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::CThreadBackEnd::ResetJobQueueStats()
+{
+	for (unsigned int nPriorityLevel = 0; nPriorityLevel < eNumPriorityLevel; ++nPriorityLevel)
+	{
+		m_arrPeakOccupancy[nPriorityLevel] = 0;
+		m_arrQueueOverflows[nPriorityLevel].ResetNumPushedJobs();
+	}
+
+	AngelicaInterlockedIncrement(&m_nQueueStatsGeneration);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool JobManager::ThreadBackEnd::CThreadBackEnd::GetOldestJobEnqueueTicks(unsigned int nPriorityLevel, unsigned long long& rEnqueueTicks)
+{
+	// while the overflow holds jobs, new jobs go there, so the oldest head of the node queues is the oldest job
+	bool bFound = false;
+	for (unsigned int nNumaNode = 0; nNumaNode < m_nNumNumaNodes; ++nNumaNode)
+	{
+		const JobManager::SJobQueue_ThreadBackEnd& rJobQueue = m_pNodeJobQueues[nNumaNode];
+		const unsigned long long currentPullIndex = *const_cast<volatile unsigned long long*>(&rJobQueue.pull.index);
+		const unsigned long long currentPushIndex = *const_cast<volatile unsigned long long*>(&rJobQueue.push.index);
+		const unsigned int nPullIndex = static_cast<unsigned int>(JobManager::SJobQueuePos::ExtractIndex(currentPullIndex, nPriorityLevel));
+		if (nPullIndex == static_cast<unsigned int>(JobManager::SJobQueuePos::ExtractIndex(currentPushIndex, nPriorityLevel)))
+			continue;
+
+		// racy, the slot can be taken and refilled meanwhile which only makes the level look younger
+		const unsigned int nJobSlot = nPullIndex & (rJobQueue.GetMaxWorkerQueueJobs(nPriorityLevel) - 1);
+		if (!rJobQueue.jobInfoBlockStates[nPriorityLevel][nJobSlot].IsPublished(nPullIndex))
+			continue;
+
+		const unsigned long long nEnqueueTicks = rJobQueue.GetJobInfoBlock(nPriorityLevel, nJobSlot).nEnqueueTicks;
+		if (!bFound || nEnqueueTicks < rEnqueueTicks)
+			rEnqueueTicks = nEnqueueTicks;
+		bFound = true;
+	}
+
+	return bFound || m_arrQueueOverflows[nPriorityLevel].PeekEnqueueTicks(rEnqueueTicks);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::CThreadBackEnd::GetWorkerIdleStats(JobManager::SWorkerIdleStats& rStats) const
+{
+	const unsigned int nGeneration = GetWorkerIdleStatsGeneration();
+	for (unsigned int i = 0; i < m_arrWorkerThreads.size(); ++i)
+	{
+		// a worker which didn't go idle since the last reset still holds the old values
+		if (m_arrWorkerThreads[i] == NULL || m_arrWorkerThreads[i]->GetIdleState().nStatsGeneration != nGeneration)
+			continue;
+
+		const JobManager::SWorkerIdleStats& rWorkerStats = m_arrWorkerThreads[i]->GetIdleState().stats;
+		rStats.nSpinWakeups += rWorkerStats.nSpinWakeups;
+		rStats.nYieldWakeups += rWorkerStats.nYieldWakeups;
+		rStats.nParkWakeups += rWorkerStats.nParkWakeups;
+		rStats.nSpinTimeUS += rWorkerStats.nSpinTimeUS;
+		rStats.nParkTimeUS += rWorkerStats.nParkTimeUS;
+		rStats.nTotalWakeLatencyUS += rWorkerStats.nTotalWakeLatencyUS;
+		rStats.nMaxWakeLatencyUS = std::max(rStats.nMaxWakeLatencyUS, rWorkerStats.nMaxWakeLatencyUS);
+		for (unsigned int j = 0; j < JobManager::SWorkerIdleStats::eNumWakeLatencyBuckets; ++j)
+			rStats.arrWakeLatencyHistogram[j] += rWorkerStats.arrWakeLatencyHistogram[j];
+	}
+}
+
+#if !defined(JOB_SPIN_DURING_IDLE)
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::detail::CWaitForJobObject::WaitIdle(unsigned int nWorkerID, SWorkerIdleState& rIdleState)
+{
+	const JobManager::SWorkerIdleSettings settings = CJobManager::Instance()->GetWorkerIdleSettings();
+	JobManager::SWorkerIdleStats& rStats = rIdleState.stats;
+
+	const long long nIdleStartTicks = GetRealTicks();
+	const long long nMaxSpinTicks = (long long)settings.nMaxSpinUS * m_nTicksPerUS;
+	long long nSpinTicks = 0;
+	long long nYieldTicks = 0;    // -1 to yield until work arrives
+
+	switch (settings.policy)
+	{
+	case eWIP_Spin:
+		nSpinTicks = nMaxSpinTicks;
+		nYieldTicks = -1;
+		break;
+	case eWIP_SpinThenPark:
+		// spin about twice as long as the usual idle time, a worker which usually waits longer than the budget gains nothing from spinning
+		if (rIdleState.nAvgIdleTicks < 0)
+			nSpinTicks = nMaxSpinTicks;
+		else if (rIdleState.nAvgIdleTicks <= nMaxSpinTicks)
+			nSpinTicks = std::min(std::max(rIdleState.nAvgIdleTicks * 2, nMaxSpinTicks / 16), nMaxSpinTicks);
+		nYieldTicks = nSpinTicks ? (long long)settings.nYieldUS * m_nTicksPerUS : 0;
+		break;
+	default:
+		break;
+	}
+
+	long long nNowTicks = nIdleStartTicks;
+	bool bGotJob = false;
+
+	// 1. spin, the job count is only read until it becomes positive
+	if (nSpinTicks > 0)
+	{
+		const long long nSpinEndTicks = nIdleStartTicks + nSpinTicks;
+		do
+		{
+			if (TryAcquire(nWorkerID))
+			{
+				rStats.nSpinWakeups++;
+				bGotJob = true;
+				break;
+			}
+
+			for (int i = 0; i < 16; ++i)
+				YieldProcessor();
+			nNowTicks = GetRealTicks();
+		}
+		while (nNowTicks < nSpinEndTicks);
+	}
+
+	// 2. give the core to other threads but stay runnable
+	if (!bGotJob && nYieldTicks != 0)
+	{
+		const long long nYieldEndTicks = nNowTicks + nYieldTicks;
+		do
+		{
+			if (TryAcquire(nWorkerID))
+			{
+				rStats.nYieldWakeups++;
+				bGotJob = true;
+				break;
+			}
+
+			SwitchToThread();
+			nNowTicks = GetRealTicks();
+		}
+		while (nYieldTicks < 0 || nNowTicks < nYieldEndTicks);
+	}
+
+	if (bGotJob)
+		nNowTicks = GetRealTicks();
+	rStats.nSpinTimeUS += (unsigned long long)((nNowTicks - nIdleStartTicks) / m_nTicksPerUS);
+
+	// 3. sleep until a job for us is signaled
+	if (!bGotJob)
+	{
+		const long long nParkStartTicks = nNowTicks;
+		Park(nWorkerID);
+		nNowTicks = GetRealTicks();
+
+		// a signal older than the start of the sleep was meant for someone else, the job was already there
+		const long long nLastSignalTicks = m_nLastSignalTicks;
+		const long long nWakeLatencyTicks = nNowTicks - std::max(nLastSignalTicks, nParkStartTicks);
+		const unsigned int nWakeLatencyUS = (unsigned int)std::max(nWakeLatencyTicks / m_nTicksPerUS, 0LL);
+
+		rStats.nParkWakeups++;
+		rStats.nParkTimeUS += (unsigned long long)((nNowTicks - nParkStartTicks) / m_nTicksPerUS);
+		rStats.nTotalWakeLatencyUS += nWakeLatencyUS;
+		rStats.nMaxWakeLatencyUS = std::max(rStats.nMaxWakeLatencyUS, nWakeLatencyUS);
+		const unsigned int nBucket = nWakeLatencyUS ? std::min<unsigned int>(IntegerLog2(nWakeLatencyUS) + 1, JobManager::SWorkerIdleStats::eNumWakeLatencyBuckets - 1) : 0;
+		rStats.arrWakeLatencyHistogram[nBucket]++;
+	}
+
+	// learn the idle time, sleeping included, so a worker starts spinning again once jobs arrive more frequently
+	const long long nIdleTicks = nNowTicks - nIdleStartTicks;
+	rIdleState.nAvgIdleTicks = rIdleState.nAvgIdleTicks < 0 ? nIdleTicks : rIdleState.nAvgIdleTicks + (nIdleTicks - rIdleState.nAvgIdleTicks) / 8;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::detail::CWaitForJobObject::Park(unsigned int nWorkerID)
+{
+	SWorkerWakeState& rState = m_arrWorkerWakeStates[nWorkerID];
+	AngelicaInterlockedIncrement(alias_cast<volatile LONG*>(&m_nNumParked));
+
+	do
+	{
+		// a signal either sees us parked or we see its count after marking ourself
+		rState.nWakeSignal = 0;
+		AngelicaInterlockedExchange(alias_cast<volatile LONG*>(&rState.nParked), 1);
+		if (TryAcquire(nWorkerID))
+		{
+			// if a signal cleared the flag meanwhile its wakeup is dropped, we took a count anyway
+			AngelicaInterlockedExchange(alias_cast<volatile LONG*>(&rState.nParked), 0);
+			break;
+		}
+
+		// woken workers race with spinning ones for the count, the loser sleeps again
+		AngelicaMT::AngelicaWaitOnAddress(&rState.nWakeSignal, 0);
+	}
+	while (true);
+
+	AngelicaInterlockedDecrement(alias_cast<volatile LONG*>(&m_nNumParked));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::detail::CWaitForJobObject::WakeParkedWorkers(unsigned int nCount)
+{
+	// each worker is only woken by the signal which cleared its flag
+	for (unsigned int i = 0; i < m_nNumWorkers && nCount > 0; ++i)
+	{
+		SWorkerWakeState& rState = m_arrWorkerWakeStates[i];
+		if (rState.nParked && AngelicaInterlockedExchange(alias_cast<volatile LONG*>(&rState.nParked), 0) == 1)
+		{
+			WakeWorker(rState);
+			--nCount;
+		}
+	}
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::SignalStopWork()
+{
+	m_bStop = true;
+}
+
+//inline CFrameProfiler* GetFrameProfilerForName(const char* name)
+//{
+//	static std::vector<std::pair<const char*, CFrameProfiler*>> s_profilers;
+//	static AngelicaRWLock s_profilersLock;
+//
+//	s_profilersLock.RLock();
+//	for (auto& p : s_profilers)
+//	{
+//		if (p.first == name) // compare pointer address. not content.
+//		{
+//			s_profilersLock.RUnlock();
+//			return p.second;
+//		}
+//	}
+//	s_profilersLock.RUnlock();
+//	
+//
+//	s_profilersLock.WLock();
+//	for (auto& p : s_profilers)
+//	{
+//		if (p.first == name) // compare pointer address. not content.
+//		{
+//			s_profilersLock.WUnlock();
+//			return p.second;
+//		}
+//	}
+//	CFrameProfiler* pNewProfiler = new CFrameProfiler(PROFILE_SYSTEM, EProfileDescription::REGION, name, "", 0);
+//	s_profilers.reserve(256);
+//	s_profilers.push_back(std::make_pair(name, pNewProfiler));
+//	s_profilersLock.WUnlock();
+//
+//	return pNewProfiler;
+//}
+
+//////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::ThreadEntry()
+{
+	// set up thread id
+	JobManager::detail::SetWorkerThreadId(m_nId);
+
+	if (m_pFiberScheduler)
+		m_pFiberScheduler->AttachWorkerThread();
+
+#if defined(JOB_SPIN_DURING_IDLE)
+	HANDLE nThreadID = GetCurrentThread();
+#endif
+
+	LARGE_INTEGER freq;
+	double frequency;
+	QueryPerformanceFrequency(&freq);
+	frequency = 1.f / static_cast<double>(freq.QuadPart);
+	unsigned long long nTicksInJobExecution = 0;
+
+	CJobManager* __restrict pJobManager = CJobManager::Instance();
+
+	do
+	{
+		SInfoBlock infoBlock;
+		CJobManager* __restrict pJobManager = CJobManager::Instance();
+		JobManager::SInfoBlock* pFallbackInfoBlock = JobManager::detail::PopFromFallbackJobList();
+
+		IF (pFallbackInfoBlock, 0)
+		{
+			//ANGELICA_PROFILE_REGION(PROFILE_SYSTEM, "JobWorkerThread: Fallback");
+
+			// in case of a fallback job, just get it from the global per thread list
+			pFallbackInfoBlock->AssignMembersTo(&infoBlock);
+
+			// free temp info block again
+			delete pFallbackInfoBlock;
+		}
+		else
+		{
+			///////////////////////////////////////////////////////////////////////////
+			// wait for new work
+			// we will only do a real wait if jobs accumulated time was more
+			// than fMinTimeInJobExecution ms, to prevent system calls when we
+			// execute a massive number of small jobs
+
+			//ANGELICA_PROFILE_REGION_WAITING(PROFILE_SYSTEM, "Wait - JobWorkerThread");
+
+			const float fMinTimeInJobExecution = pJobManager->GetWorkerIdleSettings().nMinJobTimeBeforeWaitUS / 1000.0f;
+			float fMSInJobExecution = static_cast<float>(nTicksInJobExecution * 1000.0f * frequency);
+			if (fMSInJobExecution > fMinTimeInJobExecution || !m_rSemaphore.TryGetJob())
+			{
+#if defined(JOB_SPIN_DURING_IDLE)
+				SetThreadPriority(nThreadID, THREAD_PRIORITY_IDLE);
+#endif
+				// apply a ResetWorkerIdleStats
+				const unsigned int nStatsGeneration = m_pThreadBackend->GetWorkerIdleStatsGeneration();
+				if (m_idleState.nStatsGeneration != nStatsGeneration)
+				{
+					memset(&m_idleState.stats, 0, sizeof(m_idleState.stats));
+					m_idleState.nStatsGeneration = nStatsGeneration;
+				}
+
+#if defined(JOBMANAGER_SUPPORT_IN_PLACE_EXECUTION)
+				ReleaseDeferredJobSlots();
+#endif
+				m_rSemaphore.WaitForNewJob(m_nId, m_idleState);
+#if defined(JOB_SPIN_DURING_IDLE)
+				SetThreadPriority(nThreadID, THREAD_PRIORITY_TIME_CRITICAL);
+#endif
+				nTicksInJobExecution = 0;
+			}
+
+			IF (m_bStop == true, 0)
+				break;
+
+			///////////////////////////////////////////////////////////////////////////
+			// the semaphore count guarantees that a job was published for us, but another
+			// worker may still be in the process of making it visible, so spin until we got one
+			// in fiber mode the count can also stand for a woken up fiber, those are continued first to return their fiber to the pool
+			// unless the count was taken for a job of our inbox, which no other worker can run
+			bool bResumedFiber = false;
+			do
+			{
+				if (m_pFiberScheduler && !m_rSemaphore.HoldsInboxJob(m_nId) && m_pFiberScheduler->HasRunnableFibers())
+				{
+					const unsigned long long nResumeStartTicks = GetRealTicks();
+					bResumedFiber = m_pFiberScheduler->ResumeFiber();
+					nTicksInJobExecution += GetRealTicks() - nResumeStartTicks;
+					if (bResumedFiber)
+						break;
+				}
+				if (GetNextJob(infoBlock))
+					break;
+#if defined(JOBMANAGER_SUPPORT_IN_PLACE_EXECUTION)
+				ReleaseDeferredJobSlots();
+#endif
+				YieldProcessor();
+			}
+			while (true);
+
+			// the fiber ran until it finished or suspended again
+			if (bResumedFiber)
+				continue;
+		}
+
+		///////////////////////////////////////////////////////////////////////////
+		// now we have a valid SInfoBlock to start work on it
+		// a small job of the node queue wasn't copied, it runs from its queue slot
+#if defined(JOBMANAGER_SUPPORT_IN_PLACE_EXECUTION)
+		SInfoBlock& rInfoBlock = m_pInPlaceJobSlot ? *m_pInPlaceJobSlot : infoBlock;
+#else
+		SInfoBlock& rInfoBlock = infoBlock;
+#endif
+
+		// jobs cancelled while they were queued don't run, their job state completes right away
+		IF (rInfoBlock.IsCancelled(), 0)
+		{
+			SkipCancelledJob(rInfoBlock);
+		}
+		// check if it is a producer/consumer queue job
+		else IF (rInfoBlock.HasQueue(), 0)
+		{
+			DoWorkProducerConsumerQueue(rInfoBlock);
+		}
+		else
+		{
+			// a job bound to its worker doesn't run on a fiber, after a wait the fiber could continue on another worker
+			const unsigned long long nJobStartTicks = GetRealTicks();
+			if (m_pFiberScheduler && !rInfoBlock.IsBoundToWorker())
+				m_pFiberScheduler->RunJob(rInfoBlock);
+			else
+				ExecuteJob(rInfoBlock);
+			nTicksInJobExecution += GetRealTicks() - nJobStartTicks;
+		}
+
+#if defined(JOBMANAGER_SUPPORT_IN_PLACE_EXECUTION)
+		// the job is done with its slot
+		IF (m_pInPlaceJobSlot, 1)
+		{
+			DeferJobSlotRelease(m_pInPlaceJobSlot, m_nInPlaceMaxRoundID);
+			m_pInPlaceJobSlot = NULL;
+		}
+#endif
+	}
+	while (m_bStop == false);
+
+#if defined(JOBMANAGER_SUPPORT_IN_PLACE_EXECUTION)
+	ReleaseDeferredJobSlots();
+#endif
+
+	if (m_pFiberScheduler)
+		m_pFiberScheduler->DetachWorkerThread();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::ExecuteJob(SInfoBlock& infoBlock)
+{
+	// Now we are safe to use the info block
+	assert(infoBlock.jobInvoker);
+	assert(infoBlock.GetParamAddress());
+
+	// store job start time
+#if defined(JOBMANAGER_SUPPORT_PROFILING)
+	SJobProfilingData* pJobProfilingData = gEnv->GetJobManager()->GetProfilingData(infoBlock.profilerIndex);
+	pJobProfilingData->nStartTime = gEnv->pTimer->GetAsyncTime();
+	pJobProfilingData->nWorkerThread = GetWorkerThreadId();
+#endif
+
+#if defined(JOBMANAGER_SUPPORT_FRAMEPROFILER)
+	const unsigned long long nStartTime = JobManager::IWorkerBackEndProfiler::GetTimeSample();
+#endif
+
+	{
+		// call delegator function to invoke job entry
+//#if !defined(_RELEASE) || defined(PERFORMANCE_BUILD)
+//				const char* jobName = pJobManager->GetJobName(infoBlock.jobInvoker);
+//
+//				char job_info[128];
+//				CFrameProfiler* pProfiler = GetFrameProfilerForName(jobName);
+//				CFrameProfilerSection frameProfilerSection2(pProfiler, jobName, jobName, EProfileDescription::SECTION);
+//				BROFILER_SECTION(jobName)
+//
+//				angelica_sprintf(job_info, "%s (Prio %u)", jobName, nPriorityLevel);
+//
+//				ANGELICAPROFILE_SCOPE_PROFILE_MARKER(job_info);
+//				ANGELICAPROFILE_SCOPE_PLATFORM_MARKER(job_info);
+//#endif
+
+		JobManager::detail::SetCurrentJobCancellationToken(infoBlock.pCancellationToken);
+		(*infoBlock.jobInvoker)(infoBlock.GetParamAddress());
+		JobManager::detail::SetCurrentJobCancellationToken(NULL);
+	}
+
+#if defined(JOBMANAGER_SUPPORT_FRAMEPROFILER)
+	// a fiber can finish its job on another worker than the one it started on
+	JobManager::IWorkerBackEndProfiler* workerProfiler = CJobManager::Instance()->GetBackEnd(eBET_Thread)->GetBackEndWorkerProfiler();
+	const unsigned long long nEndTime = JobManager::IWorkerBackEndProfiler::GetTimeSample();
+	workerProfiler->RecordJob(infoBlock.frameProfIndex, GetWorkerThreadId(), static_cast<const unsigned int>(infoBlock.jobId), static_cast<const unsigned int>(nEndTime - nStartTime));
+
+	// lateness is measured when the job finished, before its job state is stopped
+	IF (infoBlock.nDeadlineTicks, 0)
+	{
+		const long long nTicksPerUS = static_cast<CThreadBackEnd*>(CJobManager::Instance()->GetBackEnd(eBET_Thread))->GetTicksPerUS();
+		const long long nLatenessUS = (GetRealTicks() - (long long)infoBlock.nDeadlineTicks) / nTicksPerUS;
+		workerProfiler->RecordDeadline(infoBlock.frameProfIndex, static_cast<const unsigned int>(infoBlock.jobId), (int)std::max(std::min(nLatenessUS, (long long)INT_MAX), (long long)INT_MIN));
+	}
+#endif
+
+	IF (infoBlock.GetJobState(), 1)
+	{
+		SJobState* pJobState = infoBlock.GetJobState();
+		pJobState->SetStopped();
+	}
+#if defined(JOBMANAGER_SUPPORT_PROFILING)
+	pJobProfilingData->nEndTime = gEnv->pTimer->GetAsyncTime();
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::SkipCancelledJob(SInfoBlock& infoBlock)
+{
+	// some invokers own their parameters, they see the cancellation and only release them
+	IF (infoBlock.InvokeOnCancel(), 0)
+	{
+		JobManager::detail::SetCurrentJobCancellationToken(infoBlock.pCancellationToken);
+		(*infoBlock.jobInvoker)(infoBlock.GetParamAddress());
+		JobManager::detail::SetCurrentJobCancellationToken(NULL);
+	}
+
+#if defined(JOBMANAGER_SUPPORT_FRAMEPROFILER)
+	JobManager::IWorkerBackEndProfiler* workerProfiler = CJobManager::Instance()->GetBackEnd(eBET_Thread)->GetBackEndWorkerProfiler();
+	workerProfiler->RecordCancelledJob(infoBlock.frameProfIndex, static_cast<const unsigned int>(infoBlock.jobId));
+#endif
+
+	IF (infoBlock.GetJobState(), 1)
+	{
+		SJobState* pJobState = infoBlock.GetJobState();
+		pJobState->SetStopped();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::TryPullFromNodeQueue(unsigned int nNumaNode, SInfoBlock& rInfoBlock, unsigned int nOnlyPriorityLevel)
+{
+	JobManager::SJobQueue_ThreadBackEnd& rJobQueue = m_pThreadBackend->GetNodeJobQueue(nNumaNode);
+
+	///////////////////////////////////////////////////////////////////////////
+	// multiple steps to get a job of the queue
+	unsigned int nPriorityLevel = ~0;
+
+	// 1. get our job slot index
+	unsigned long long currentPushIndex = ~0;
+#if defined(JOBMANAGER_SUPPORT_IN_PLACE_EXECUTION)
+	unsigned long long reservedPushIndex = ~0;
+#endif
+	unsigned long long currentPullIndex = ~0;
+	unsigned long long newPullIndex = ~0;
+	do
+	{
+		// volatile load
+#if ANGELICA_PLATFORM_WINDOWS || ANGELICA_PLATFORM_APPLE || ANGELICA_PLATFORM_LINUX || ANGELICA_PLATFORM_ANDROID// emulate a 64bit atomic read on PC platfom
+		currentPullIndex = AngelicaInterlockedCompareExchange64(alias_cast<volatile signed long long*>(&rJobQueue.pull.index), 0, 0);
+		currentPushIndex = AngelicaInterlockedCompareExchange64(alias_cast<volatile signed long long*>(&rJobQueue.push.index), 0, 0);
+#else
+		currentPullIndex = *const_cast<volatile unsigned long long*>(&rJobQueue.pull.index);
+		currentPushIndex = *const_cast<volatile unsigned long long*>(&rJobQueue.push.index);
+#endif
+#if defined(JOBMANAGER_SUPPORT_IN_PLACE_EXECUTION)
+		reservedPushIndex = currentPushIndex;
+#endif
+
+		// only consider jobs which are already completely written, a producer which got suspended
+		// between reserving and publishing its slot only holds back the jobs of its priority level behind it
+		currentPushIndex = rJobQueue.GetPublishedPushIndex(currentPullIndex, currentPushIndex);
+
+		// hide the jobs of all other levels
+		if (nOnlyPriorityLevel < eNumPriorityLevel)
+		{
+			const unsigned long long nMask = JobManager::SJobQueuePos::GetIndexMask(nOnlyPriorityLevel);
+			currentPushIndex = (currentPullIndex & ~nMask) | (currentPushIndex & nMask);
+		}
+
+		// nothing to pull, or the updated push ptr didn't reach us yet
+		if (currentPushIndex == currentPullIndex)
+			return false;
+
+		// compute priority level from difference between push/pull
+		if (!JobManager::SJobQueuePos::IncreasePullIndex(currentPullIndex, currentPushIndex, newPullIndex, nPriorityLevel,
+		                                                 rJobQueue.GetMaxWorkerQueueJobs(eHighPriority), rJobQueue.GetMaxWorkerQueueJobs(eRegularPriority), rJobQueue.GetMaxWorkerQueueJobs(eLowPriority), rJobQueue.GetMaxWorkerQueueJobs(eStreamPriority)))
+			return false;
+
+		// stop spinning when we succesfull got the index
+		if ((unsigned long long)AngelicaInterlockedCompareExchange64(alias_cast<volatile signed long long*>(&rJobQueue.pull.index), newPullIndex, currentPullIndex) == currentPullIndex)
+			break;
+
+	}
+	while (true);
+
+	// compute our jobslot index from the only increasing publish index
+	unsigned int nExtractedCurIndex = static_cast<unsigned int>(JobManager::SJobQueuePos::ExtractIndex(currentPullIndex, nPriorityLevel));
+	unsigned int nNumWorkerQUeueJobs = rJobQueue.GetMaxWorkerQueueJobs(nPriorityLevel);
+	unsigned int nJobSlot = nExtractedCurIndex & (nNumWorkerQUeueJobs - 1);
+
+	JobManager::SInfoBlock* pCurrentJobSlot = &rJobQueue.GetJobInfoBlock(nPriorityLevel, nJobSlot);
+	const unsigned int nMaxRoundID = (1 << JobManager::SJobQueuePos::eBitsPerPriorityLevel) / nNumWorkerQUeueJobs;
+	const detail::EJobSourceNode sourceNode = nNumaNode == m_nNumaNode ? detail::eJSN_Local : detail::eJSN_Remote;
+
+#if defined(JOBMANAGER_SUPPORT_IN_PLACE_EXECUTION)
+	// 2. A small job runs from its slot, it was published before we claimed it
+	// the slot is released by the worker loop after the job ran
+	const unsigned int nQueuedJobs = static_cast<unsigned int>((JobManager::SJobQueuePos::ExtractIndex(reservedPushIndex, nPriorityLevel) - nExtractedCurIndex) & ((1 << JobManager::SJobQueuePos::eBitsPerPriorityLevel) - 1));
+	IF (CanExecuteInPlace(*pCurrentJobSlot, nQueuedJobs, nNumWorkerQUeueJobs), 1)
+	{
+		m_pInPlaceJobSlot = pCurrentJobSlot;
+		m_nInPlaceMaxRoundID = nMaxRoundID;
+		RecordDequeue(*pCurrentJobSlot, nPriorityLevel, sourceNode);
+		return true;
+	}
+#endif
+
+	// 2. Get a local copy of the info block, it was published before we claimed it
+	CJobManager::Instance()->CopyJobFromQueueSlot(*pCurrentJobSlot, rInfoBlock);
+
+	// 3. Mark the jobslot as free again
+	MemoryBarrier();
+	pCurrentJobSlot->Release(nMaxRoundID);
+
+	RecordDequeue(rInfoBlock, nPriorityLevel, sourceNode);
+	return true;
+}
+
+#if defined(JOBMANAGER_SUPPORT_IN_PLACE_EXECUTION)
+///////////////////////////////////////////////////////////////////////////////
+bool JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::CanExecuteInPlace(const SInfoBlock& rJobSlot, unsigned int nQueuedJobs, unsigned int nMaxQueueJobs) const
+{
+	// a job on a fiber could suspend and keep its slot for long
+	if (m_pFiberScheduler && !rJobSlot.IsBoundToWorker())
+		return false;
+
+	// producer/consumer queue jobs run until their queue is drained, pooled parameters are returned to the pool when they are copied out
+	if (rJobSlot.HasQueue() || (rJobSlot.nflags & (unsigned char)SInfoBlock::scParamsPooled))
+		return false;
+
+	// a producer reaching a slot still in use goes to the overflow queue, so keep at least half of the level free
+	return nQueuedJobs + m_deferredReleases.nNumSlots + 1 <= nMaxQueueJobs / 2;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::DeferJobSlotRelease(SInfoBlock* pJobSlot, unsigned int nMaxRoundID)
+{
+	detail::SDeferredJobSlotReleases& rReleases = m_deferredReleases;
+	rReleases.arrSlots[rReleases.nNumSlots] = pJobSlot;
+	rReleases.arrMaxRoundIDs[rReleases.nNumSlots] = nMaxRoundID;
+
+	IF (++rReleases.nNumSlots == detail::SDeferredJobSlotReleases::eMaxDeferredReleases, 0)
+		ReleaseDeferredJobSlots();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::ReleaseDeferredJobSlots()
+{
+	detail::SDeferredJobSlotReleases& rReleases = m_deferredReleases;
+	if (rReleases.nNumSlots == 0)
+		return;
+
+	// one barrier orders the reads of all jobs of the batch before their slots can be reused
+	MemoryBarrier();
+	for (unsigned int i = 0; i < rReleases.nNumSlots; ++i)
+		rReleases.arrSlots[i]->Release(rReleases.arrMaxRoundIDs[i]);
+
+	rReleases.nNumSlots = 0;
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+bool JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::TryPullFromRemoteNodeQueues(SInfoBlock& rInfoBlock, unsigned int nPriorityLevel, unsigned int nOnlyPriorityLevel)
+{
+	// start behind the own node, so the workers of all nodes don't drain the same remote queue first
+	const unsigned int nNumNumaNodes = m_pThreadBackend->GetNumNumaNodes();
+	for (unsigned int i = 1; i < nNumNumaNodes; ++i)
+	{
+		const unsigned int nNumaNode = (m_nNumaNode + i) % nNumNumaNodes;
+		if (HasNodeQueueJobs(nNumaNode, nPriorityLevel) && TryPullFromNodeQueue(nNumaNode, rInfoBlock, nOnlyPriorityLevel))
+			return true;
+	}
+
+	return false;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::TryPullFromQueueOverflow(SInfoBlock& rInfoBlock)
+{
+	for (unsigned int nPriorityLevel = 0; nPriorityLevel < eNumPriorityLevel; ++nPriorityLevel)
+	{
+		if (m_pThreadBackend->GetQueueOverflow(nPriorityLevel).Pop(rInfoBlock))
+		{
+			RecordDequeue(rInfoBlock, nPriorityLevel);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::HasNodeQueueJobs(unsigned int nNumaNode, unsigned int nPriorityLevel) const
+{
+	const JobManager::SJobQueue_ThreadBackEnd& rJobQueue = m_pThreadBackend->GetNodeJobQueue(nNumaNode);
+	const unsigned long long currentPullIndex = *const_cast<volatile unsigned long long*>(&rJobQueue.pull.index);
+	const unsigned long long currentPushIndex = *const_cast<volatile unsigned long long*>(&rJobQueue.push.index);
+	return JobManager::SJobQueuePos::ExtractIndex(currentPullIndex, nPriorityLevel) != JobManager::SJobQueuePos::ExtractIndex(currentPushIndex, nPriorityLevel);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::HasGlobalQueueJobs(unsigned int nPriorityLevel) const
+{
+	const unsigned int nNumNumaNodes = m_pThreadBackend->GetNumNumaNodes();
+	for (unsigned int i = 0; i < nNumNumaNodes; ++i)
+	{
+		if (HasNodeQueueJobs((m_nNumaNode + i) % nNumNumaNodes, nPriorityLevel))
+			return true;
+	}
+
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::HasPendingJobs(unsigned int nPriorityLevel) const
+{
+	if (HasGlobalQueueJobs(nPriorityLevel) || !m_pThreadBackend->GetQueueOverflow(nPriorityLevel).IsEmpty())
+		return true;
+
+#if defined(JOBMANAGER_SUPPORT_WORK_STEALING)
+	return !m_pThreadBackend->GetWorkerDeque(m_nId, nPriorityLevel).IsEmpty();
+#else
+	return false;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+unsigned int JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::SelectPriorityLevel(bool& rAged)
+{
+	const JobManager::SPrioritySchedulingSettings& rSettings = CJobManager::Instance()->GetPrioritySchedulingSettings();
+	rAged = false;
+	if (rSettings.policy == ePSP_Strict && rSettings.nMaxWaitUS == 0)
+		return ~0;
+
+	unsigned int nPendingLevels = 0;
+	for (unsigned int nPriorityLevel = 0; nPriorityLevel < eNumPriorityLevel; ++nPriorityLevel)
+	{
+		if (HasPendingJobs(nPriorityLevel))
+			nPendingLevels |= 1 << nPriorityLevel;
+		else
+			m_schedulingState.arrCurrentWeight[nPriorityLevel] = 0;   // a level coming back starts without old credit
+	}
+
+	// with at most one level holding work the strict walk finds it just as well
+	if ((nPendingLevels & (nPendingLevels - 1)) == 0)
+		return ~0;
+
+	// aging, among the levels below the highest one with work serve the one whose oldest job waited the longest beyond the limit
+	// the highest level is left out, under a flood its own jobs are old too and it is served by the strict walk anyway
+	if (rSettings.nMaxWaitUS)
+	{
+		const long long nNowTicks = GetRealTicks();
+		long long nLongestWaitTicks = (long long)rSettings.nMaxWaitUS * m_pThreadBackend->GetTicksPerUS();
+		unsigned int nAgedLevel = ~0u;
+		const unsigned int nLowerLevels = nPendingLevels & (nPendingLevels - 1);
+		for (unsigned int nPriorityLevel = 0; nPriorityLevel < eNumPriorityLevel; ++nPriorityLevel)
+		{
+			unsigned long long nEnqueueTicks = 0;
+			if ((nLowerLevels & (1 << nPriorityLevel)) && m_pThreadBackend->GetOldestJobEnqueueTicks(nPriorityLevel, nEnqueueTicks) &&
+			    nNowTicks - (long long)nEnqueueTicks > nLongestWaitTicks)
+			{
+				nLongestWaitTicks = nNowTicks - (long long)nEnqueueTicks;
+				nAgedLevel = nPriorityLevel;
+			}
+		}
+
+		if (nAgedLevel != ~0u)
+		{
+			rAged = true;
+			return nAgedLevel;
+		}
+	}
+
+	if (rSettings.policy != ePSP_WeightedFairShare)
+		return ~0;
+
+	// smooth weighted round-robin: every level with work gains its weight, the richest is served and pays the sum
+	// ties go to the higher priority level, which keeps its latency advantage
+	int nTotalWeight = 0;
+	unsigned int nSelectedLevel = ~0u;
+	for (unsigned int nPriorityLevel = 0; nPriorityLevel < eNumPriorityLevel; ++nPriorityLevel)
+	{
+		if ((nPendingLevels & (1 << nPriorityLevel)) == 0)
+			continue;
+
+		m_schedulingState.arrCurrentWeight[nPriorityLevel] += (int)rSettings.arrWeights[nPriorityLevel];
+		nTotalWeight += (int)rSettings.arrWeights[nPriorityLevel];
+		if (nSelectedLevel == ~0u || m_schedulingState.arrCurrentWeight[nPriorityLevel] > m_schedulingState.arrCurrentWeight[nSelectedLevel])
+			nSelectedLevel = nPriorityLevel;
+	}
+
+	if (nTotalWeight == 0)
+		return ~0;
+
+	m_schedulingState.arrCurrentWeight[nSelectedLevel] -= nTotalWeight;
+	return nSelectedLevel;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::TryGetJobOfLevel(SInfoBlock& rInfoBlock, unsigned int nPriorityLevel)
+{
+	if (HasNodeQueueJobs(m_nNumaNode, nPriorityLevel) && TryPullFromNodeQueue(m_nNumaNode, rInfoBlock, nPriorityLevel))
+		return true;
+
+	// jobs which didn't fit into the global queue are older than everything queued after them
+	if (m_pThreadBackend->GetQueueOverflow(nPriorityLevel).Pop(rInfoBlock))
+	{
+		RecordDequeue(rInfoBlock, nPriorityLevel);
+		return true;
+	}
+
+#if defined(JOBMANAGER_SUPPORT_WORK_STEALING)
+	if (m_pThreadBackend->GetWorkerDeque(m_nId, nPriorityLevel).Pop(rInfoBlock) || StealJob(rInfoBlock, nPriorityLevel, false))
+	{
+		RecordDequeue(rInfoBlock, nPriorityLevel, detail::eJSN_Local);
+		return true;
+	}
+#endif
+
+	if (TryPullFromRemoteNodeQueues(rInfoBlock, nPriorityLevel, nPriorityLevel))
+		return true;
+
+#if defined(JOBMANAGER_SUPPORT_WORK_STEALING)
+	if (StealJob(rInfoBlock, nPriorityLevel, true))
+	{
+		RecordDequeue(rInfoBlock, nPriorityLevel, detail::eJSN_Remote);
+		return true;
+	}
+#endif
+
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::RecordDequeue(const SInfoBlock& rInfoBlock, unsigned int nPriorityLevel, detail::EJobSourceNode sourceNode)
+{
+	// apply a ResetJobQueueStats
+	const unsigned int nStatsGeneration = m_pThreadBackend->GetJobQueueStatsGeneration();
+	if (m_schedulingState.nStatsGeneration != nStatsGeneration)
+	{
+		memset(&m_schedulingState.stats, 0, sizeof(m_schedulingState.stats));
+		m_schedulingState.nStatsGeneration = nStatsGeneration;
+	}
+
+	const long long nWaitTicks = GetRealTicks() - (long long)rInfoBlock.nEnqueueTicks;
+	const unsigned int nWaitUS = (unsigned int)std::max(nWaitTicks / m_pThreadBackend->GetTicksPerUS(), 0LL);
+
+	JobManager::SJobQueueStats& rStats = m_schedulingState.stats;
+	rStats.nDequeuedJobs[nPriorityLevel]++;
+	rStats.nTotalWaitUS[nPriorityLevel] += nWaitUS;
+	rStats.nMaxWaitUS[nPriorityLevel] = std::max(rStats.nMaxWaitUS[nPriorityLevel], nWaitUS);
+
+	if (sourceNode == detail::eJSN_Local)
+		rStats.nLocalNodeJobs++;
+	else if (sourceNode == detail::eJSN_Remote)
+		rStats.nRemoteNodeJobs++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::GetNextJob(SInfoBlock& rInfoBlock)
+{
+	// jobs targeted at this worker go first, no other worker can take them
+	if (m_pThreadBackend->GetWorkerInbox(m_nId).Pop(rInfoBlock))
+	{
+		m_rSemaphore.OnInboxJobTaken(m_nId);
+		return true;
+	}
+
+	// jobs with a deadline run before all priority levels, the earliest deadline first
+	unsigned int nDeadlinePriorityLevel = 0;
+	if (m_pThreadBackend->GetQueueDeadline().Pop(rInfoBlock, nDeadlinePriorityLevel))
+	{
+		RecordDequeue(rInfoBlock, nDeadlinePriorityLevel);
+		return true;
+	}
+
+	// the level chosen for fairness or aging goes first
+	bool bAged = false;
+	const unsigned int nSelectedLevel = SelectPriorityLevel(bAged);
+	if (nSelectedLevel < eNumPriorityLevel && TryGetJobOfLevel(rInfoBlock, nSelectedLevel))
+	{
+		if (bAged)
+			m_schedulingState.stats.nAgedJobs[nSelectedLevel]++;
+		return true;
+	}
+
+#if defined(JOBMANAGER_SUPPORT_WORK_STEALING)
+	// walk the priority levels from high to low, so a local low priority job never
+	// runs while a high priority job is waiting in the global queue or in another deque
+	for (unsigned int nPriorityLevel = 0; nPriorityLevel < eNumPriorityLevel; ++nPriorityLevel)
+	{
+		// the node queue always hands out its highest priority job, which is at least nPriorityLevel here
+		if (HasNodeQueueJobs(m_nNumaNode, nPriorityLevel) && TryPullFromNodeQueue(m_nNumaNode, rInfoBlock))
+			return true;
+
+		// jobs which didn't fit into the global queue are older than everything queued after them
+		if (m_pThreadBackend->GetQueueOverflow(nPriorityLevel).Pop(rInfoBlock))
+		{
+			RecordDequeue(rInfoBlock, nPriorityLevel);
+			return true;
+		}
+
+		if (m_pThreadBackend->GetWorkerDeque(m_nId, nPriorityLevel).Pop(rInfoBlock) || StealJob(rInfoBlock, nPriorityLevel, false))
+		{
+			RecordDequeue(rInfoBlock, nPriorityLevel, detail::eJSN_Local);
+			return true;
+		}
+
+		// the jobs of other nodes come last, their SInfoBlocks are read across the interconnect
+		if (TryPullFromRemoteNodeQueues(rInfoBlock, nPriorityLevel))
+			return true;
+
+		if (StealJob(rInfoBlock, nPriorityLevel, true))
+		{
+			RecordDequeue(rInfoBlock, nPriorityLevel, detail::eJSN_Remote);
+			return true;
+		}
+	}
+
+	return false;
+#else
+	if (TryPullFromNodeQueue(m_nNumaNode, rInfoBlock) || TryPullFromQueueOverflow(rInfoBlock))
+		return true;
+
+	for (unsigned int nPriorityLevel = 0; nPriorityLevel < eNumPriorityLevel; ++nPriorityLevel)
+	{
+		if (TryPullFromRemoteNodeQueues(rInfoBlock, nPriorityLevel))
+			return true;
+	}
+
+	return false;
+#endif
+}
+
+#if defined(JOBMANAGER_SUPPORT_WORK_STEALING)
+///////////////////////////////////////////////////////////////////////////////
+bool JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::StealJob(SInfoBlock& rInfoBlock, unsigned int nPriorityLevel, bool bRemoteNodes)
+{
+	const unsigned int nNumWorkers = m_pThreadBackend->GetNumWorkerThreads();
+	if (nNumWorkers < 2 || (bRemoteNodes && m_pThreadBackend->GetNumNumaNodes() < 2))
+		return false;
+
+	// xorshift to start at a random victim, so idle workers don't all hammer the same deque
+	m_nStealSeed ^= m_nStealSeed << 13;
+	m_nStealSeed ^= m_nStealSeed >> 17;
+	m_nStealSeed ^= m_nStealSeed << 5;
+
+	const unsigned int nStartVictim = m_nStealSeed % nNumWorkers;
+	for (unsigned int i = 0; i < nNumWorkers; ++i)
+	{
+		const unsigned int nVictim = (nStartVictim + i) % nNumWorkers;
+		if (nVictim == m_nId || (m_pThreadBackend->GetWorkerNumaNode(nVictim) != m_nNumaNode) != bRemoteNodes)
+			continue;
+
+		detail::CWorkStealingDeque& rDeque = m_pThreadBackend->GetWorkerDeque(nVictim, nPriorityLevel);
+		if (!rDeque.IsEmpty() && rDeque.Steal(rInfoBlock))
+			return true;
+	}
+
+	return false;
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+inline void IncrQueuePullPointer(INT_PTR& rCurPullAddr, const INT_PTR cIncr, const INT_PTR cQueueStart, const INT_PTR cQueueEnd)
+{
+	const INT_PTR cNextPull = rCurPullAddr + cIncr;
+	rCurPullAddr = (cNextPull >= cQueueEnd) ? cQueueStart : cNextPull;
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 void JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::DoWorkProducerConsumerQueue(SInfoBlock& rInfoBlock)
@@ -486,17 +1562,6 @@ void JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::DoWorkProducerConsum
 
 	bool bNewJobFound = true;
 
-	// union used to construct 64 bit value for atomic updates
-	union T64BitValue
-	{
-		signed long long doubleWord;
-		struct
-		{
-			unsigned int word0;
-			unsigned int word1;
-		};
-	};
-
 	const unsigned int cParamSize = (rInfoBlock.paramSize << 4);
 
 	Invoker pInvoker = NULL;
@@ -553,146 +1618,40 @@ void JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::DoWorkProducerConsum
 		// == update queue state == //
 		IncrQueuePullPointer(curPullPtr, queueIncr, queueStart, queueEnd);
 
-		// load cur push once
-		INT_PTR curPushPtr = *pQueuePush;
-
-		// update pull ptr (safe since only change by a single job worker)
+		// update pull ptr (safe since only change by a single job worker), the packet was read completely before
+		ProdConsQueueBase::PacketBarrier();
 		*pQueuePull = curPullPtr;
 
-		// check if we need to wake up the producer from a queue full state
-		IF ((curPushPtr & 1) == 1, 0)
-		{
-			(*pQueuePush) = curPushPtr & ~1;
-			pQueue->m_pQueueFullSemaphore->Release();
-		}
-
-		// clear queue full marker
-		curPushPtr = curPushPtr & ~1;
-
 		// work on next packet if still there
-		IF (curPushPtr != curPullPtr, 1)
+		IF (curPullPtr != *pQueuePush, 1)
 		{
+			ProdConsQueueBase::PacketBarrier();
 			continue;
 		}
 
-		// temp end of queue, try to update the state while checking the push ptr
-		bNewJobFound = false;
-
-		JobManager::SJobSyncVariable runningSyncVar;
-		runningSyncVar.SetRunning();
-		JobManager::SJobSyncVariable stoppedSyncVar;
-
-#if ANGELICA_PLATFORM_64BIT // for 64 bit, we need to atomically swap 128 bit
-		bool bStopLoop = false;
-		bool bUnlockQueueFullstate = false;
-		SJobSyncVariable queueStoppedSemaphore;
-		signed long long resultValue[2] = { *alias_cast<signed long long*>(&runningSyncVar), curPushPtr };
-		signed long long compareValue[2] = { *alias_cast<signed long long*>(&runningSyncVar), curPushPtr };  // use for result comparsion, since the original compareValue is overwritten
-		signed long long exchangeValue[2] = { *alias_cast<signed long long*>(&stoppedSyncVar), curPushPtr };
-		do
-		{
-			resultValue[0] = compareValue[0];
-			resultValue[1] = compareValue[1];
-			unsigned char ret = AngelicaInterlockedCompareExchange128((volatile signed long long*)pQueue, exchangeValue[1], exchangeValue[0], resultValue);
-
-			bNewJobFound = ((resultValue[1] & ~1) != curPushPtr);
-			bStopLoop = bNewJobFound || (resultValue[0] == compareValue[0] && resultValue[1] == compareValue[1]);
-
-			if (bNewJobFound == false && resultValue[0] > 1)
-			{
-				// get a copy of the syncvar for unlock (since we will overwrite it)
-				queueStoppedSemaphore = *alias_cast<SJobSyncVariable*>(&resultValue[0]);
-
-				// update the exchange value to ensure the CAS succeeds
-				compareValue[0] = resultValue[0];
-			}
-
-			if (bNewJobFound == false && ((resultValue[1] & 1) == 1))
-			{
-				// update the exchange value to ensure the CAS succeeds
-				compareValue[1] = resultValue[1];
-				exchangeValue[1] = (resultValue[1] & ~1);
-				bUnlockQueueFullstate = true; // needs to be unset after the loop to ensure a correct state
-			}
-
-		}
-		while (!bStopLoop);
-
-		if (bUnlockQueueFullstate)
-		{
-			assert(bNewJobFound == false);
-			pQueue->m_pQueueFullSemaphore->Release();
-		}
-		if (queueStoppedSemaphore.IsRunning())
-		{
-			assert(bNewJobFound == false);
-			queueStoppedSemaphore.SetStopped();
-		}
-#else
-		bool bStopLoop = false;
-		bool bUnlockQueueFullstate = false;
-		SJobSyncVariable queueStoppedSemaphore;
-		T64BitValue resultValue;
-
-		T64BitValue compareValue;
-		compareValue.word0 = *alias_cast<unsigned int*>(&runningSyncVar);
-		compareValue.word1 = curPushPtr;
-
-		T64BitValue exchangeValue;
-		exchangeValue.word0 = *alias_cast<unsigned int*>(&stoppedSyncVar);
-		exchangeValue.word1 = curPushPtr;
-
-		do
-		{
-
-			resultValue.doubleWord = AngelicaInterlockedCompareExchange64((volatile signed long long*)pQueue, exchangeValue.doubleWord, compareValue.doubleWord);
-
-			bNewJobFound = ((resultValue.word1 & ~1) != curPushPtr);
-			bStopLoop = bNewJobFound || resultValue.doubleWord == compareValue.doubleWord;
-
-			if (bNewJobFound == false && resultValue.word0 > 1)
-			{
-				// get a copy of the syncvar for unlock (since we will overwrite it)
-				queueStoppedSemaphore = *alias_cast<SJobSyncVariable*>(&resultValue.word0);
-
-				// update the exchange value to ensure the CAS succeeds
-				compareValue.word0 = resultValue.word0;
-			}
-
-			if (bNewJobFound == false && ((resultValue.word1 & 1) == 1))
-			{
-				// update the exchange value to ensure the CAS succeeds
-				compareValue.word1 = resultValue.word1;
-				exchangeValue.word1 = (resultValue.word1 & ~1);
-				bUnlockQueueFullstate = true;
-			}
-
-		}
-		while (!bStopLoop);
-
-		if (bUnlockQueueFullstate)
-		{
-			assert(bNewJobFound == false);
-			pQueue->m_pQueueFullSemaphore->Release();
-		}
-		if (queueStoppedSemaphore.IsRunning())
-		{
-			assert(bNewJobFound == false);
-			queueStoppedSemaphore.SetStopped();
-		}
-#endif
-
+		// temp end of queue, leave it unless packets were added in the meantime
+		bNewJobFound = pQueue->ContinueDrain();
 	}
 	while (bNewJobFound);
 
+	// nothing touches the queue after this, the producer may release it once WaitFinished returned
+	pQueue->m_QueueRunningState.SetStopped();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::CThreadBackEndWorkerThread(CThreadBackEnd* pThreadBackend, detail::CWaitForJobObject& rSemaphore, JobManager::SJobQueue_ThreadBackEnd& rJobQueue, unsigned int nId) :
-	m_rSemaphore(rSemaphore),
-	m_rJobQueue(rJobQueue),
-	m_bStop(false),
+JobManager::ThreadBackEnd::CThreadBackEndWorkerThread::CThreadBackEndWorkerThread(CThreadBackEnd* pThreadBackend, detail::CWaitForJobObject& rSemaphore, unsigned int nId, unsigned int nNumaNode) :
 	m_nId(nId),
+	m_nNumaNode(nNumaNode),
+	m_bStop(false),
+	m_pFiberScheduler(pThreadBackend->GetFiberScheduler()),
+#if defined(JOBMANAGER_SUPPORT_WORK_STEALING)
+	m_nStealSeed((nId + 1) * 2654435761u),
+#endif
+#if defined(JOBMANAGER_SUPPORT_IN_PLACE_EXECUTION)
+	m_pInPlaceJobSlot(NULL),
+	m_nInPlaceMaxRoundID(0),
+#endif
+	m_rSemaphore(rSemaphore),
 	m_pThreadBackend(pThreadBackend)
 {
 }
@@ -14,11 +14,26 @@
 
 #include "../IJobManager.h" 
 #include "../JobStructs.h"
+#include "WorkStealingDeque.h"
+#include "JobQueueOverflow.h"
+#include "JobQueueDeadline.h"
+#include "FiberScheduler.h"
 
 #include "../IThreadManager.h"
 
 
 
+// Enable to keep jobs spawned from worker threads in a per worker deque instead of the global queue.
+// Idle workers steal from the deques of other workers, the global queue is only used for jobs
+// submitted from non-worker threads and as overflow if a deque is full.
+// Off by default until a benchmark shows less contention than the shared queue.
+//#define JOBMANAGER_SUPPORT_WORK_STEALING
+
+// Enable to run small jobs of the node queues directly from their queue slot instead of copying them to the worker stack first.
+// The slot stays in use until the job ran, the worker then releases the slots of several jobs at once.
+// Off by default, it showed no measurable gain over the copy (see Benchmarks/InPlaceExecutionBenchmark.cpp).
+//#define JOBMANAGER_SUPPORT_IN_PLACE_EXECUTION
+
 namespace JobManager
 {
 class CJobManager;
@@ -33,16 +48,80 @@ namespace detail {
 // stack size for backend worker threads
 enum { eStackSize = 256 * 1024 };
 
+// idle path state of one worker, only touched by the owning worker
+struct SWorkerIdleState
+{
+	SWorkerIdleState() : nAvgIdleTicks(-1), nStatsGeneration(0) { memset(&stats, 0, sizeof(stats)); }
+
+	long long                    nAvgIdleTicks;     // running average of the time from running out of work to getting a job, -1 until measured
+	unsigned int                 nStatsGeneration;  // the stats are cleared once this falls behind the backend's reset counter
+	JobManager::SWorkerIdleStats stats;
+};
+
+// priority level selection state and wait time stats of one worker, only touched by the owning worker
+struct SWorkerSchedulingState
+{
+	SWorkerSchedulingState() : nStatsGeneration(0) { memset(arrCurrentWeight, 0, sizeof(arrCurrentWeight)); memset(&stats, 0, sizeof(stats)); }
+
+	int                        arrCurrentWeight[eNumPriorityLevel]; // smooth weighted round-robin credit of each level
+	unsigned int               nStatsGeneration;                    // the stats are cleared once this falls behind the backend's reset counter
+	JobManager::SJobQueueStats stats;                               // only the wait time members are used
+};
+
+#if defined(JOBMANAGER_SUPPORT_IN_PLACE_EXECUTION)
+// queue slots of jobs which ran in place and were not handed back to the producers yet, only touched by the owning worker
+struct SDeferredJobSlotReleases
+{
+	enum { eMaxDeferredReleases = 8 };
+
+	SDeferredJobSlotReleases() : nNumSlots(0) {}
+
+	JobManager::SInfoBlock* arrSlots[eMaxDeferredReleases];
+	unsigned int            arrMaxRoundIDs[eMaxDeferredReleases]; // round id range of the queue level each slot belongs to
+	unsigned int            nNumSlots;
+};
+#endif
+
+// where a worker took a job from, for the NUMA node counters of SJobQueueStats
+enum EJobSourceNode
+{
+	eJSN_None,          // queues shared by all nodes, like the deadline and overflow queues
+	eJSN_Local,         // job queue or deque of the node of the worker
+	eJSN_Remote,        // job queue or deque of another node
+};
+
+// wake state of one worker, jobs in the inbox of a worker are counted here since only that worker can take them
+struct _declspec(align(64)) SWorkerWakeState
+{
+	volatile int nInboxJobs;    // jobs signaled into the inbox which no count was taken for yet
+	volatile int nParked;       // 1 while the worker sleeps or is about to, cleared by whoever wakes it
+	volatile int nWakeSignal;   // the sleeping worker waits on this address until it is set
+	bool         bInboxJob;     // the last count taken by the worker was one of its inbox, only touched by the worker
+};
+
+// counts the available jobs, a worker which took a count is guaranteed to find a job it can run
+// shared jobs can be taken by any worker, jobs in a worker inbox only by that worker, so each worker
+// sleeps on its own address and a signal wakes exactly the workers which can take the new jobs
 class CWaitForJobObject
 {
 public:
-	CWaitForJobObject(unsigned int nMaxCount) :
+	CWaitForJobObject() :
 #if defined(JOB_SPIN_DURING_IDLE)
 		m_nCounter(0)
 #else
-		m_Semaphore(nMaxCount)
+		m_nNumJobs(0),
+		m_nNumParked(0),
+		m_nNumWorkers(SCpuTopology::eMaxLogicalCores),
+		m_nLastSignalTicks(0)
 #endif
-	{}
+	{
+		memset((void*)m_arrWorkerWakeStates, 0, sizeof(m_arrWorkerWakeStates));
+#if !defined(JOB_SPIN_DURING_IDLE)
+		LARGE_INTEGER freq;
+		QueryPerformanceFrequency(&freq);
+		m_nTicksPerUS = freq.QuadPart >= 1000000 ? freq.QuadPart / 1000000 : 1;
+#endif
+	}
 
 	void SignalNewJob()
 	{
@@ -54,7 +133,60 @@ public:
 		}
 		while (AngelicaInterlockedCompareExchange(alias_cast<volatile LONG*>(&m_nCounter), nCount + 1, nCount) != nCount);
 #else
-		m_Semaphore.Release();
+		RecordSignalTime();
+		AngelicaInterlockedIncrement(alias_cast<volatile LONG*>(&m_nNumJobs));
+		if (m_nNumParked > 0)
+			WakeParkedWorkers(1);
+#endif
+	}
+
+	// publishes nCount jobs at once, wakes at most nCount sleeping workers with one release
+	void SignalNewJobs(unsigned int nCount)
+	{
+#if defined(JOB_SPIN_DURING_IDLE)
+		AngelicaInterlockedAdd(alias_cast<volatile LONG*>(&m_nCounter), (LONG)nCount);
+#else
+		RecordSignalTime();
+		AngelicaInterlockedAdd(alias_cast<volatile LONG*>(&m_nNumJobs), (LONG)nCount);
+		if (m_nNumParked > 0)
+			WakeParkedWorkers(nCount);
+#endif
+	}
+
+	// a job was put into the inbox of nWorkerID, only that worker is woken for it
+	void SignalWorkerJob(unsigned int nWorkerID)
+	{
+		SWorkerWakeState& rState = m_arrWorkerWakeStates[nWorkerID];
+		AngelicaInterlockedIncrement(alias_cast<volatile LONG*>(&rState.nInboxJobs));
+#if !defined(JOB_SPIN_DURING_IDLE)
+		RecordSignalTime();
+		if (rState.nParked && AngelicaInterlockedExchange(alias_cast<volatile LONG*>(&rState.nParked), 0) == 1)
+			WakeWorker(rState);
+#endif
+	}
+
+	// the worker took a job of its inbox, a shared count it took instead is handed on to the other workers
+	void OnInboxJobTaken(unsigned int nWorkerID)
+	{
+		SWorkerWakeState& rState = m_arrWorkerWakeStates[nWorkerID];
+		if (rState.bInboxJob)
+		{
+			rState.bInboxJob = false;
+			return;
+		}
+
+		AngelicaInterlockedDecrement(alias_cast<volatile LONG*>(&rState.nInboxJobs));
+		SignalNewJob();
+	}
+
+	// true if the count the worker holds belongs to a job of its inbox
+	bool HoldsInboxJob(unsigned int nWorkerID) const { return m_arrWorkerWakeStates[nWorkerID].bInboxJob; }
+
+	// only the states of this many workers are looked at when waking parked workers
+	void SetNumWorkers(unsigned int nNumWorkers)
+	{
+#if !defined(JOB_SPIN_DURING_IDLE)
+		m_nNumWorkers = nNumWorkers;
 #endif
 	}
 
@@ -72,7 +204,7 @@ public:
 		return false;
 #endif
 	}
-	void WaitForNewJob(unsigned int nWorkerID)
+	void WaitForNewJob(unsigned int nWorkerID, SWorkerIdleState& rIdleState)
 	{
 #if defined(JOB_SPIN_DURING_IDLE)
 		int nCount = ~0;
@@ -129,11 +261,17 @@ ExecuteAsyncDip:
 			}
 	#endif    // ANGELICA_PLATFORM_DURANGO
 
+			if (TryAcquireInboxJob(m_arrWorkerWakeStates[nWorkerID]))
+				break;
+
 			nCount = *const_cast<volatile int*>(&m_nCounter);
 			if (nCount > 0)
 			{
 				if (AngelicaInterlockedCompareExchange(alias_cast<volatile LONG*>(&m_nCounter), nCount - 1, nCount) == nCount)
+				{
+					m_arrWorkerWakeStates[nWorkerID].bInboxJob = false;
 					break;
+				}
 			}
 
 			YieldProcessor();
@@ -179,14 +317,78 @@ ExecuteAsyncDip:
 		while (true);
 	#endif  // ANGELICA_PLATFORM_DURANGO
 #else
-		m_Semaphore.Acquire();
+		WaitIdle(nWorkerID, rIdleState);
 #endif
 	}
 private:
+	// takes a count of the inbox of the worker, called by the owning worker only
+	bool TryAcquireInboxJob(SWorkerWakeState& rState)
+	{
+		int nCount = rState.nInboxJobs;
+		while (nCount > 0)
+		{
+			if (AngelicaInterlockedCompareExchange(alias_cast<volatile LONG*>(&rState.nInboxJobs), nCount - 1, nCount) == nCount)
+			{
+				rState.bInboxJob = true;
+				return true;
+			}
+			nCount = rState.nInboxJobs;
+		}
+		return false;
+	}
+
+	SWorkerWakeState m_arrWorkerWakeStates[SCpuTopology::eMaxLogicalCores];
+
 #if defined(JOB_SPIN_DURING_IDLE)
 	volatile int m_nCounter;
 #else
-	AngelicaFastSemaphore m_Semaphore;
+	// spin, yield and sleep as selected by SWorkerIdleSettings
+	void WaitIdle(unsigned int nWorkerID, SWorkerIdleState& rIdleState);
+
+	// takes a count of the inbox of the worker or a shared one, inbox jobs go first
+	bool TryAcquire(unsigned int nWorkerID)
+	{
+		SWorkerWakeState& rState = m_arrWorkerWakeStates[nWorkerID];
+		if (rState.nInboxJobs > 0 && TryAcquireInboxJob(rState))
+			return true;
+
+		int nCount = m_nNumJobs;
+		while (nCount > 0)
+		{
+			if (AngelicaInterlockedCompareExchange(alias_cast<volatile LONG*>(&m_nNumJobs), nCount - 1, nCount) == nCount)
+			{
+				rState.bInboxJob = false;
+				return true;
+			}
+			nCount = m_nNumJobs;
+		}
+		return false;
+	}
+
+	// sleeps until a count was taken
+	void Park(unsigned int nWorkerID);
+
+	// wakes up to nCount sleeping workers for shared jobs
+	void WakeParkedWorkers(unsigned int nCount);
+
+	void WakeWorker(SWorkerWakeState& rState)
+	{
+		rState.nWakeSignal = 1;
+		AngelicaMT::AngelicaWakeByAddressAll(&rState.nWakeSignal);
+	}
+
+	// the wake latency of sleeping workers is measured from the last signal, only taken while one sleeps
+	void RecordSignalTime()
+	{
+		if (m_nNumParked > 0)
+			m_nLastSignalTicks = GetRealTicks();
+	}
+
+	volatile int          m_nNumJobs;             // shared jobs no count was taken for yet
+	volatile int          m_nNumParked;           // workers sleeping or about to sleep
+	unsigned int          m_nNumWorkers;
+	volatile long long    m_nLastSignalTicks;
+	long long             m_nTicksPerUS;
 #endif
 };
 
@@ -198,7 +400,7 @@ class CThreadBackEnd;
 class CThreadBackEndWorkerThread : public IThread
 {
 public:
-	CThreadBackEndWorkerThread(CThreadBackEnd* pThreadBackend, detail::CWaitForJobObject& rSemaphore, JobManager::SJobQueue_ThreadBackEnd& rJobQueue, unsigned int nId);
+	CThreadBackEndWorkerThread(CThreadBackEnd* pThreadBackend, detail::CWaitForJobObject& rSemaphore, unsigned int nId, unsigned int nNumaNode);
 	~CThreadBackEndWorkerThread();
 
 	// Start accepting work on thread
@@ -206,13 +408,82 @@ public:
 
 	// Signals the thread that it should not accept anymore work and exit
 	void SignalStopWork();
+
+	// invokes a job taken from the queues and stops its job state, in fiber mode this runs on the job fiber
+	static void ExecuteJob(SInfoBlock& infoBlock);
+
+	// drops a job which was cancelled before it started and stops its job state
+	static void SkipCancelledJob(SInfoBlock& infoBlock);
+
+	// idle path stats of this worker, cleared lazily after ResetWorkerIdleStats
+	const detail::SWorkerIdleState& GetIdleState() const { return m_idleState; }
+
+	// wait time stats of the jobs this worker took, cleared lazily after ResetJobQueueStats
+	const detail::SWorkerSchedulingState& GetSchedulingState() const { return m_schedulingState; }
 private:
 	void DoWorkProducerConsumerQueue(SInfoBlock& rInfoBlock);
 
+	// takes the next job of the job queue of a NUMA node, returns false if the queue is empty
+	// the highest priority level with work is served unless nOnlyPriorityLevel restricts the pull to one level
+	bool TryPullFromNodeQueue(unsigned int nNumaNode, SInfoBlock& rInfoBlock, unsigned int nOnlyPriorityLevel = ~0);
+
+	// takes a job from the queues of the other nodes, only the queues with jobs of nPriorityLevel are looked at
+	bool TryPullFromRemoteNodeQueues(SInfoBlock& rInfoBlock, unsigned int nPriorityLevel, unsigned int nOnlyPriorityLevel = ~0);
+
+	// takes the oldest job of the overflow queues in priority order, returns false if all are empty
+	bool TryPullFromQueueOverflow(SInfoBlock& rInfoBlock);
+
+	// level picked by SPrioritySchedulingSettings ahead of the strict priority walk, ~0 to keep the strict order
+	// rAged is set if the level was picked because its oldest job waited too long
+	unsigned int SelectPriorityLevel(bool& rAged);
+
+	// takes a job of exactly this level from any source
+	bool TryGetJobOfLevel(SInfoBlock& rInfoBlock, unsigned int nPriorityLevel);
+
+	// racy checks, jobs in the deques of other workers are not looked at
+	bool HasNodeQueueJobs(unsigned int nNumaNode, unsigned int nPriorityLevel) const;
+	bool HasGlobalQueueJobs(unsigned int nPriorityLevel) const;
+	bool HasPendingJobs(unsigned int nPriorityLevel) const;
+
+	// adds the queue wait time of a job taken from nPriorityLevel to the stats
+	void RecordDequeue(const SInfoBlock& rInfoBlock, unsigned int nPriorityLevel, detail::EJobSourceNode sourceNode = detail::eJSN_None);
+
+	// looks for work in priority order: own inbox, queue of the own node, own deque, deques of workers of the own node,
+	// queues of other nodes, deques of workers of other nodes
+	// the level chosen by SelectPriorityLevel is looked at first after the inbox
+	bool GetNextJob(SInfoBlock& rInfoBlock);
+
+#if defined(JOBMANAGER_SUPPORT_WORK_STEALING)
+	// steals from the workers of the own node or, with bRemoteNodes, from the workers of all other nodes
+	bool StealJob(SInfoBlock& rInfoBlock, unsigned int nPriorityLevel, bool bRemoteNodes);
+#endif
+
+#if defined(JOBMANAGER_SUPPORT_IN_PLACE_EXECUTION)
+	// true if the job can run from its node queue slot, the slot can't be reused by the producers until the job ran
+	bool CanExecuteInPlace(const SInfoBlock& rJobSlot, unsigned int nQueuedJobs, unsigned int nMaxQueueJobs) const;
+
+	// queues the slot of a job which ran in place for release, a full batch is released right away
+	void DeferJobSlotRelease(SInfoBlock* pJobSlot, unsigned int nMaxRoundID);
+
+	// hands all deferred slots back to the producers, done before the worker waits so no slot is kept while it idles
+	void ReleaseDeferredJobSlots();
+#endif
+
 	unsigned int                               m_nId;                   // id of the worker thread
+	unsigned int                         m_nNumaNode;             // node index of the worker, selects its job queue
 	volatile bool                        m_bStop;
+	detail::CFiberScheduler*             m_pFiberScheduler;       // NULL if jobs run on the worker stack
+	detail::SWorkerIdleState             m_idleState;
+	detail::SWorkerSchedulingState       m_schedulingState;
+#if defined(JOBMANAGER_SUPPORT_WORK_STEALING)
+	unsigned int                         m_nStealSeed;            // state of the random generator used to pick a victim
+#endif
+#if defined(JOBMANAGER_SUPPORT_IN_PLACE_EXECUTION)
+	SInfoBlock*                          m_pInPlaceJobSlot;       // node queue slot of the job GetNextJob returned, NULL if the job was copied out
+	unsigned int                         m_nInPlaceMaxRoundID;    // round id range of the queue level of m_pInPlaceJobSlot
+	detail::SDeferredJobSlotReleases     m_deferredReleases;
+#endif
 	detail::CWaitForJobObject&           m_rSemaphore;
-	JobManager::SJobQueue_ThreadBackEnd& m_rJobQueue;
 	CThreadBackEnd*                      m_pThreadBackend;
 };
 
@@ -231,8 +502,16 @@ public:
 
 	virtual void   AddJob(JobManager::CJobDelegator& crJob, const JobManager::TJobHandle cJobHandle, JobManager::SInfoBlock& rInfoBlock);
 
+	// adds nNumJobs non-blocking jobs, consecutive jobs of the same priority share one slot reservation
+	// and all workers needed are signaled at the end with a single semaphore release
+	void           AddJobs(JobManager::CJobBase* const* ppJobs, unsigned int nNumJobs);
+
 	virtual unsigned int GetNumWorkerThreads() const { return m_nNumWorkerThreads; }
 
+	// queues a job targeted at the main thread, it is run by PumpMainThreadJobs
+	void           AddMainThreadJob(JobManager::CJobDelegator& crJob, const JobManager::TJobHandle cJobHandle, JobManager::SInfoBlock& rInfoBlock);
+	unsigned int   PumpMainThreadJobs(unsigned int nBudgetMicroSec);
+
 	// returns the index to use for the frame profiler
 	unsigned int GetCurrentFrameBufferIndex() const;
 
@@ -240,13 +519,78 @@ public:
 	JobManager::IWorkerBackEndProfiler* GetBackEndWorkerProfiler() const { return m_pBackEndWorkerProfiler; }
 #endif
 
+#if defined(JOBMANAGER_SUPPORT_WORK_STEALING)
+	detail::CWorkStealingDeque& GetWorkerDeque(unsigned int nWorkerId, unsigned int nPriorityLevel) { return m_pWorkerDeques[nWorkerId * eNumPriorityLevel + nPriorityLevel]; }
+#endif
+
+	// one job queue per NUMA node, allocated on its node, workers take jobs of their own node first
+	unsigned int                         GetNumNumaNodes() const                        { return m_nNumNumaNodes; }
+	unsigned int                         GetWorkerNumaNode(unsigned int nWorkerId) const { return m_arrWorkerNumaNode[nWorkerId]; }
+	JobManager::SJobQueue_ThreadBackEnd& GetNodeJobQueue(unsigned int nNumaNode)         { return m_pNodeJobQueues[nNumaNode]; }
+
+	detail::CJobQueueOverflow& GetQueueOverflow(unsigned int nPriorityLevel) { return m_arrQueueOverflows[nPriorityLevel]; }
+	detail::CJobQueueOverflow& GetWorkerInbox(unsigned int nWorkerId)        { return m_pWorkerInboxes[nWorkerId]; }
+	detail::CJobQueueDeadline& GetQueueDeadline()                            { return m_queueDeadline; }
+
+	// NULL unless fiber mode was enabled before the job manager was initialized
+	detail::CFiberScheduler* GetFiberScheduler() const { return m_pFiberScheduler; }
+
+	// idle stats summed over all workers, a reset is applied by each worker the next time it goes idle
+	void         GetWorkerIdleStats(JobManager::SWorkerIdleStats& rStats) const;
+	void         ResetWorkerIdleStats()             { AngelicaInterlockedIncrement(&m_nIdleStatsGeneration); }
+	unsigned int GetWorkerIdleStatsGeneration() const { return (unsigned int)m_nIdleStatsGeneration; }
+
+	// capacity, peak occupancy and overflow usage of the global queue, wait times summed over all workers
+	void GetJobQueueStats(JobManager::SJobQueueStats& rStats) const;
+	void ResetJobQueueStats();
+	unsigned int GetJobQueueStatsGeneration() const { return (unsigned int)m_nQueueStatsGeneration; }
+
+	// enqueue time of the oldest job of the level in the global queue or the overflow, false if there is none
+	bool GetOldestJobEnqueueTicks(unsigned int nPriorityLevel, unsigned long long& rEnqueueTicks);
+
+	long long GetTicksPerUS() const { return m_nTicksPerUS; }
+
 private:
 	friend class JobManager::CJobManager;
 
-	JobManager::SJobQueue_ThreadBackEnd      m_JobQueue;              // job queue node where jobs are pushed into and from
+	// copies the job data into a SInfoBlock which is about to be published
+	void InitJobInfoBlock(JobManager::CJobDelegator& crJob, const JobManager::TJobHandle cJobHandle, JobManager::SInfoBlock& rInfoBlock, JobManager::SInfoBlock& rJobInfoBlock, bool bJobQueueSlot = false);
+
+	// jobs of a priority level go into the overflow queue while it isn't empty, to keep them in submission order
+	bool UseQueueOverflow(unsigned int nPriorityLevel) const { return !m_arrQueueOverflows[nPriorityLevel].IsEmpty(); }
+
+	// with deadline scheduling enabled non blocking jobs with a deadline go into the deadline queue instead of their priority level
+	bool UseQueueDeadline(const JobManager::CJobDelegator& crJob) const;
+
+	// non blocking jobs targeted at one of our workers go into its inbox
+	bool UseWorkerInbox(const JobManager::CJobDelegator& crJob) const { return crJob.GetTargetWorker() < m_nNumWorkerThreads && !crJob.IsBlocking(); }
+	void AddWorkerInboxJob(JobManager::CJobDelegator& crJob, const JobManager::TJobHandle cJobHandle, JobManager::SInfoBlock& rInfoBlock);
+
+	// node whose job queue takes the jobs submitted by the calling thread, the node of the worker or of the current core
+	unsigned int GetSubmitNumaNode() const;
+
+	// update the peak occupancy of a job queue after jobs were published
+	void RecordQueueOccupancy(unsigned int nPriorityLevel, const JobManager::SJobQueue_ThreadBackEnd& rJobQueue);
+
+	JobManager::SJobQueue_ThreadBackEnd*     m_pNodeJobQueues;        // job queue per NUMA node where jobs are pushed into and from
+	unsigned int                             m_nNumNumaNodes;
+	unsigned char                            m_arrWorkerNumaNode[SCpuTopology::eMaxLogicalCores];
+	unsigned char                            m_arrCoreNumaNode[SCpuTopology::eMaxLogicalCores];   // node of each logical core, for submissions of non worker threads
 	detail::CWaitForJobObject                m_Semaphore;             // semaphore to count available jobs, to allow the workers to go sleeping instead of spinning when no work is required
 	std::vector<CThreadBackEndWorkerThread*> m_arrWorkerThreads;      // array of worker threads
 	unsigned char m_nNumWorkerThreads;                                        // number of worker threads
+#if defined(JOBMANAGER_SUPPORT_WORK_STEALING)
+	detail::CWorkStealingDeque*              m_pWorkerDeques;         // eNumPriorityLevel deques per worker thread
+#endif
+	detail::CJobQueueOverflow                m_arrQueueOverflows[eNumPriorityLevel]; // jobs which didn't fit into the global queue, visible to all workers
+	detail::CJobQueueDeadline                m_queueDeadline;         // jobs with a deadline ordered earliest deadline first, taken ahead of all priority levels
+	detail::CJobQueueOverflow*               m_pWorkerInboxes;        // jobs targeted at a worker, one queue per worker taken ahead of everything else
+	detail::CJobQueueOverflow                m_queueMainThread;       // jobs targeted at the main thread, only taken by PumpMainThreadJobs
+	volatile int                             m_arrPeakOccupancy[eNumPriorityLevel];  // most jobs waiting in global queue and overflow at once
+	detail::CFiberScheduler*                 m_pFiberScheduler;       // pooled job fibers shared by all workers in fiber mode
+	volatile int                             m_nIdleStatsGeneration;  // incremented by ResetWorkerIdleStats
+	volatile int                             m_nQueueStatsGeneration; // incremented by ResetJobQueueStats, clears the wait times of the workers
+	long long                                m_nTicksPerUS;           // to convert the SInfoBlock enqueue ticks
 
 	// members required for profiling jobs in the frame profiler
 #if defined(JOBMANAGER_SUPPORT_FRAMEPROFILER)
@@ -0,0 +1,167 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   WorkStealingDeque.h
+//  Version:     v1.00
+//  Compilers:   Visual Studio.NET
+//  Description: Per worker Chase-Lev style deque used by the thread backend
+//               to keep jobs spawned from worker threads off the global queue
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef WORK_STEALING_DEQUE_H_
+#define WORK_STEALING_DEQUE_H_
+
+#include "../IJobManager.h"
+#include "../JobStructs.h"
+#include "../BitFiddling.h"
+
+namespace JobManager {
+namespace ThreadBackEnd {
+namespace detail {
+
+// number of SInfoBlocks each worker can keep local per priority level
+// if a deque is full, the job is pushed into the global queue instead
+enum { eWorkStealingDequeSize = 128 };
+
+// Chase-Lev style deque over a fixed array of SInfoBlocks
+// the owning worker pushes and pops at the bottom (LIFO), other workers steal from the top (FIFO)
+// a slot is claimed by moving top/bottom first and is only handed back to the owner after
+// the claiming thread copied the SInfoBlock out of it, thus the owner never overwrites a slot
+// which is still read by a thief
+class CWorkStealingDeque
+{
+public:
+	CWorkStealingDeque() :
+		m_nTop(0),
+		m_nBottom(0),
+		m_pInfoBlocks(NULL),
+		m_pSlotStates(NULL),
+		m_nNumaNodeId(~0)
+	{
+		STATIC_CHECK(IsPowerOfTwoCompileTime<eWorkStealingDequeSize>::IsPowerOfTwo, ERROR_WORK_STEALING_DEQUE_SIZE_IS_NOT_POWER_OF_TWO);
+	}
+
+	~CWorkStealingDeque()
+	{
+		if (m_pInfoBlocks)
+			JobManager::detail::NumaAlignedFree(m_pInfoBlocks, m_nNumaNodeId);
+		if (m_pSlotStates)
+			JobManager::detail::NumaAlignedFree(m_pSlotStates, m_nNumaNodeId);
+	}
+
+	// allocate the backing storage on the NUMA node of the owning worker (OS node number, ~0 for any), should only be called once
+	void Init(unsigned int nNumaNodeId = ~0)
+	{
+		m_nNumaNodeId = nNumaNodeId;
+		m_pInfoBlocks = static_cast<JobManager::SInfoBlock*>(JobManager::detail::NumaAlignedMalloc(eWorkStealingDequeSize * sizeof(JobManager::SInfoBlock), 128, nNumaNodeId));
+		m_pSlotStates = static_cast<JobManager::detail::SJobQueueSlotState*>(JobManager::detail::NumaAlignedMalloc(eWorkStealingDequeSize * sizeof(JobManager::detail::SJobQueueSlotState), 128, nNumaNodeId));
+		// raw storage, the all zero SInfoBlock is the empty slot and every job is assigned member by member later on
+		memset(static_cast<void*>(m_pInfoBlocks), 0, eWorkStealingDequeSize * sizeof(JobManager::SInfoBlock));
+		memset(m_pSlotStates, 0, eWorkStealingDequeSize * sizeof(JobManager::detail::SJobQueueSlotState));
+	}
+
+	// owner only: returns the SInfoBlock to fill for the next push, or NULL if the deque is full
+	// the job becomes visible to other workers with PublishPush
+	JobManager::SInfoBlock* BeginPush()
+	{
+		const LONG nBottom = m_nBottom;
+		const LONG nTop = *const_cast<volatile LONG*>(&m_nTop);
+		if ((LONG)(nBottom - nTop) >= (LONG)eWorkStealingDequeSize)
+			return NULL;
+
+		// a thief could have claimed the slot but not yet finished copying it
+		const unsigned int nSlot = (unsigned int)nBottom & (eWorkStealingDequeSize - 1);
+		if (m_pSlotStates[nSlot].IsReady())
+			return NULL;
+
+		return &m_pInfoBlocks[nSlot];
+	}
+
+	// owner only: make the SInfoBlock returned by BeginPush visible for pop/steal
+	void PublishPush()
+	{
+		const LONG nBottom = m_nBottom;
+		m_pSlotStates[(unsigned int)nBottom & (eWorkStealingDequeSize - 1)].SetReady();
+		MemoryBarrier();
+		m_nBottom = nBottom + 1;
+	}
+
+	// owner only: takes the most recently pushed job, copies it into rInfoBlock and frees the slot
+	bool Pop(JobManager::SInfoBlock& rInfoBlock)
+	{
+		const LONG nBottom = m_nBottom - 1;
+		// full barrier, the store to bottom has to be visible before top is read
+		AngelicaInterlockedExchange(&m_nBottom, nBottom);
+		LONG nTop = *const_cast<volatile LONG*>(&m_nTop);
+
+		if ((LONG)(nBottom - nTop) < 0)
+		{
+			// deque was empty, restore bottom
+			m_nBottom = nTop;
+			return false;
+		}
+
+		if (nBottom == nTop)
+		{
+			// last element, race against thieves for it
+			const bool bWon = AngelicaInterlockedCompareExchange(&m_nTop, nTop + 1, nTop) == nTop;
+			m_nBottom = nTop + 1;
+			if (!bWon)
+				return false;
+		}
+
+		CopyOutAndFree((unsigned int)nBottom & (eWorkStealingDequeSize - 1), rInfoBlock);
+		return true;
+	}
+
+	// any thread: takes the oldest job, copies it into rInfoBlock and frees the slot
+	bool Steal(JobManager::SInfoBlock& rInfoBlock)
+	{
+		do
+		{
+			const LONG nTop = *const_cast<volatile LONG*>(&m_nTop);
+			MemoryBarrier();
+			const LONG nBottom = *const_cast<volatile LONG*>(&m_nBottom);
+			if ((LONG)(nBottom - nTop) <= 0)
+				return false;
+
+			if (AngelicaInterlockedCompareExchange(&m_nTop, nTop + 1, nTop) == nTop)
+			{
+				CopyOutAndFree((unsigned int)nTop & (eWorkStealingDequeSize - 1), rInfoBlock);
+				return true;
+			}
+		}
+		while (true);
+	}
+
+	// racy check used to decide where to look for work first
+	bool IsEmpty() const
+	{
+		return (LONG)(*const_cast<volatile LONG*>(&m_nBottom) - *const_cast<volatile LONG*>(&m_nTop)) <= 0;
+	}
+
+private:
+	void CopyOutAndFree(unsigned int nSlot, JobManager::SInfoBlock& rInfoBlock)
+	{
+		JobManager::SInfoBlock* pSlot = &m_pInfoBlocks[nSlot];
+		pSlot->AssignMembersTo(&rInfoBlock);
+
+		// hand the slot back to the owner
+		MemoryBarrier();
+		m_pSlotStates[nSlot].SetNotReady();
+	}
+
+	ANGELICA_ALIGN(128) volatile LONG       m_nTop;         // index thieves steal from, only modified by CAS
+	ANGELICA_ALIGN(128) volatile LONG       m_nBottom;      // index the owner pushes to and pops from
+	JobManager::SInfoBlock*                 m_pInfoBlocks;  // aligned storage for the jobs
+	JobManager::detail::SJobQueueSlotState* m_pSlotStates;  // READY while a slot holds a job which was not yet copied out
+	unsigned int                            m_nNumaNodeId;  // node the storage was allocated on
+};
+
+} // namespace detail
+} // namespace ThreadBackEnd
+} // namespace JobManager
+
+#endif // WORK_STEALING_DEQUE_H_
@@ -0,0 +1,134 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   ParallelFor.cpp
+//  Version:     v1.00
+//  Description: ParallelFor / ParallelReduce loops on top of the job manager
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+#include "stdafx.h"
+#include "AngelicaPlatformDefines.h"
+#if ANGELICA_PLATFORM_WINDOWS
+	#include "Win32specific.h"
+	#include "MSVCspecific.h"
+#else
+	#include "Linuxspecific.h"
+	#include "GCCspecific.h"
+#endif
+#include "AngelicaAtomics.h"
+#include "ParallelFor.h"
+#include <algorithm>
+
+namespace
+{
+// time spent on measuring the iteration cost before the helpers are started
+const long long nProbeTimeUS = 10;
+// aimed duration of one chunk, long enough to hide the cost of the shared cursor, short enough to balance the load
+const long long nTargetChunkTimeUS = 50;
+// minimal number of chunks per participating thread when the chunk size is derived from the measurement
+const size_t nMinChunksPerSlot = 4;
+
+struct SParallelForContext
+{
+	const JobManager::detail::TParallelRangeFunc* pRangeFunc;
+	volatile size_t                               nCursor;
+	size_t                                        nEnd;
+	size_t                                        nChunkSize;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+void RunParallelForChunks(SParallelForContext* pContext, unsigned int nSlot)
+{
+	const size_t nEnd = pContext->nEnd;
+	const size_t nChunkSize = pContext->nChunkSize;
+	do
+	{
+		const size_t nChunkBegin = AngelicaInterlockedExchangeAdd(&pContext->nCursor, nChunkSize);
+		if (nChunkBegin >= nEnd)
+			break;
+
+		(*pContext->pRangeFunc)(nSlot, nChunkBegin, std::min(nChunkBegin + nChunkSize, nEnd));
+	}
+	while (true);
+}
+} // namespace
+
+///////////////////////////////////////////////////////////////////////////////
+unsigned int JobManager::detail::GetParallelForMaxSlots()
+{
+	return GetJobManagerInterface()->GetNumWorkerThreads() + 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void JobManager::detail::ParallelForRange(size_t nBegin, size_t nEnd, const TParallelRangeFunc& rangeFunc, size_t nGrainSize)
+{
+	if (nBegin >= nEnd)
+		return;
+
+	// a worker waiting for its helpers could block the workers needed to run them, nested loops run inline
+	const unsigned int nNumWorkers = GetJobManagerInterface()->GetNumWorkerThreads();
+	if (nNumWorkers == 0 || JobManager::IsWorkerThread())
+	{
+		rangeFunc(0, nBegin, nEnd);
+		return;
+	}
+
+	const unsigned int nNumSlots = nNumWorkers + 1;
+	size_t nCursor = nBegin;
+	size_t nChunkSize = nGrainSize;
+
+	if (nChunkSize == 0)
+	{
+		// run the first iterations on the calling thread with growing batches to measure the cost per iteration
+		LARGE_INTEGER freq;
+		QueryPerformanceFrequency(&freq);
+		const long long nProbeTicks = std::max(freq.QuadPart * nProbeTimeUS / 1000000, 1LL);
+		const long long nTargetChunkTicks = std::max(freq.QuadPart * nTargetChunkTimeUS / 1000000, 1LL);
+
+		const size_t nMaxProbeIterations = (nEnd - nBegin) / (nNumSlots * nMinChunksPerSlot);
+		size_t nBatchSize = 1;
+		long long nElapsedTicks = 0;
+		while (nElapsedTicks < nProbeTicks && nCursor - nBegin < nMaxProbeIterations)
+		{
+			const size_t nBatchEnd = nCursor + std::min(nBatchSize, nMaxProbeIterations - (nCursor - nBegin));
+			const long long nStart = GetRealTicks();
+			rangeFunc(0, nCursor, nBatchEnd);
+			nElapsedTicks += GetRealTicks() - nStart;
+			nCursor = nBatchEnd;
+			nBatchSize *= 2;
+		}
+
+		const size_t nProbedIterations = nCursor - nBegin;
+		const long long nTicksPerIteration = nProbedIterations ? std::max(nElapsedTicks / (long long)nProbedIterations, 1LL) : nTargetChunkTicks;
+		nChunkSize = (size_t)std::max(nTargetChunkTicks / nTicksPerIteration, 1LL);
+
+		// leave enough chunks to balance the load between all participants
+		const size_t nMaxChunkSize = (nEnd - nCursor + nNumSlots * nMinChunksPerSlot - 1) / (nNumSlots * nMinChunksPerSlot);
+		nChunkSize = std::max<size_t>(std::min(nChunkSize, nMaxChunkSize), 1);
+	}
+
+	const size_t nNumChunks = (nEnd - nCursor + nChunkSize - 1) / nChunkSize;
+	if (nNumChunks <= 1)
+	{
+		if (nCursor < nEnd)
+			rangeFunc(0, nCursor, nEnd);
+		return;
+	}
+
+	SParallelForContext context;
+	context.pRangeFunc = &rangeFunc;
+	context.nCursor = nCursor;
+	context.nEnd = nEnd;
+	context.nChunkSize = nChunkSize;
+
+	// all helpers share one job state, the calling thread takes part in the loop before waiting on it
+	SJobState jobState;
+	SParallelForContext* pContext = &context;
+	const unsigned int nNumHelpers = (unsigned int)std::min<size_t>(nNumWorkers, nNumChunks - 1);
+	for (unsigned int nSlot = 1; nSlot <= nNumHelpers; ++nSlot)
+		GetJobManagerInterface()->AddLambdaJob("ParallelFor", [pContext, nSlot]() { RunParallelForChunks(pContext, nSlot); }, eRegularPriority, &jobState);
+
+	RunParallelForChunks(pContext, 0);
+	GetJobManagerInterface()->WaitForJob(jobState);
+}
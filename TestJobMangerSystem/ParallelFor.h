@@ -0,0 +1,73 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   ParallelFor.h
+//  Version:     v1.00
+//  Description: ParallelFor / ParallelReduce loops on top of the job manager
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "IJobManager.h"
+#include <vector>
+
+namespace JobManager
+{
+namespace detail
+{
+//! Loop body for the range [nBegin, nEnd), nSlot identifies the participating thread (0 is the calling thread).
+typedef std::function<void (unsigned int nSlot, size_t nBegin, size_t nEnd)> TParallelRangeFunc;
+
+//! Splits [nBegin, nEnd) into chunks which are pulled from one shared cursor by the calling thread and the helper jobs.
+//! If nGrainSize is 0, the chunk size is derived from the measured cost of the first iterations and the worker count.
+void ParallelForRange(size_t nBegin, size_t nEnd, const TParallelRangeFunc& rangeFunc, size_t nGrainSize);
+
+//! Upper bound for the nSlot values passed to a TParallelRangeFunc.
+unsigned int GetParallelForMaxSlots();
+} // namespace detail
+
+//! Call body(i) for every i in [nBegin, nEnd), distributed over the worker threads and the calling thread.
+//! Returns once all iterations are done. Called from a worker thread, the loop runs inline.
+template<typename TBody>
+inline void ParallelFor(size_t nBegin, size_t nEnd, const TBody& body, size_t nGrainSize = 0)
+{
+	detail::ParallelForRange(nBegin, nEnd, [&body](unsigned int, size_t nRangeBegin, size_t nRangeEnd)
+	{
+		for (size_t i = nRangeBegin; i < nRangeEnd; ++i)
+			body(i);
+	}, nGrainSize);
+}
+
+//! Call body(acc, i) for every i in [nBegin, nEnd) with one accumulator per participating thread,
+//! the accumulators start as identity and are merged with combine(a, b) at the end.
+//! The chunks of a thread are not contiguous, combine has to be associative and commutative.
+template<typename T, typename TBody, typename TCombine>
+inline T ParallelReduce(size_t nBegin, size_t nEnd, const T& identity, const TBody& body, const TCombine& combine, size_t nGrainSize = 0)
+{
+	// keep the accumulators on separate cache lines
+	struct SPartial
+	{
+		T    value;
+		char padding[64];
+	};
+
+	const unsigned int nNumSlots = detail::GetParallelForMaxSlots();
+	std::vector<SPartial> arrPartials(nNumSlots);
+	for (unsigned int i = 0; i < nNumSlots; ++i)
+		arrPartials[i].value = identity;
+
+	detail::ParallelForRange(nBegin, nEnd, [&arrPartials, &body](unsigned int nSlot, size_t nRangeBegin, size_t nRangeEnd)
+	{
+		T& acc = arrPartials[nSlot].value;
+		for (size_t i = nRangeBegin; i < nRangeEnd; ++i)
+			body(acc, i);
+	}, nGrainSize);
+
+	T result = identity;
+	for (unsigned int i = 0; i < nNumSlots; ++i)
+		result = combine(result, arrPartials[i].value);
+	return result;
+}
+} // namespace JobManager
@@ -1,24 +1,36 @@
 // Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved. 
 
-#include "StdAfx.h"
+#include "stdafx.h"
 //#include "System.h"
 #include "AngelicaPlatformDefines.h"
 #include "ThreadConfigManager.h"
 #include "AngelicaAtomics.h"
-#include "Win32specific.h"
-#include <atlstr.h>
+#if ANGELICA_PLATFORM_WINDOWS
+	#include "Win32specific.h"
+	#include <atlstr.h>
+#else
+	#include "Linuxspecific.h"
+#endif
 #include "IThreadManager.h"
 #include "IThreadConfigManager.h"
-#include "MSVCspecific.h"
+#if ANGELICA_PLATFORM_WINDOWS
+	#include "MSVCspecific.h"
+#else
+	#include "GCCspecific.h"
+#endif
 #include "AngelicaThread.h"
-#include "AngelicaThread_win32.h"
 #include <map>
+#include <string>
 #include "smartptr.h"
 #include "AngelicaThreadImpl.h"
 
 #define INCLUDED_FROM_SYSTEM_THREADING_CPP
 
-#include "AngelicaThreadUtil_win32.h"
+#if ANGELICA_PLATFORM_WINDOWS
+	#include "AngelicaThreadUtil_win32.h"
+#else
+	#include "AngelicaThreadUtil_posix.h"
+#endif
 #include "FairMonitor.h"
 #undef INCLUDED_FROM_SYSTEM_THREADING_CPP
 
@@ -72,7 +84,7 @@ struct SThreadMetaData : public CMultiThreadRefCount
 	//AngelicaMutex                                m_threadExitMutex;     // Mutex used to safeguard thread exit condition signaling
 	//AngelicaConditionVariable                    m_threadExitCondition; // Signaled when the thread is about to exit
 
-	CStringA m_threadName; // Thread name
+	std::string m_threadName; // Thread name
 	volatile bool                           m_isRunning;  // Indicates the thread is not ready to exit yet
 };
 
@@ -131,10 +143,10 @@ private:
 	typedef std::map<IThread*, _smart_ptr<SThreadMetaData>>::const_iterator                                SpawnedThreadMapConstIter;
 	typedef std::pair<IThread*, _smart_ptr<SThreadMetaData>>                                               ThreadMapPair;
 
-	typedef std::map<CString, _smart_ptr<SThreadMetaData>>                 SpawnedThirdPartyThreadMap;
-	typedef std::map<CString, _smart_ptr<SThreadMetaData>>::iterator       SpawnedThirdPartyThreadMapIter;
-	typedef std::map<CString, _smart_ptr<SThreadMetaData>>::const_iterator SpawnedThirdPartyThreadMapConstIter;
-	typedef std::pair<CString, _smart_ptr<SThreadMetaData>>                ThirdPartyThreadMapPair;
+	typedef std::map<std::string, _smart_ptr<SThreadMetaData>>                 SpawnedThirdPartyThreadMap;
+	typedef std::map<std::string, _smart_ptr<SThreadMetaData>>::iterator       SpawnedThirdPartyThreadMapIter;
+	typedef std::map<std::string, _smart_ptr<SThreadMetaData>>::const_iterator SpawnedThirdPartyThreadMapConstIter;
+	typedef std::pair<std::string, _smart_ptr<SThreadMetaData>>                ThirdPartyThreadMapPair;
 
 	AngelicaCriticalSection         m_spawnedThreadsLock; // Use lock for the rare occasion a thread is created/destroyed
 	SpawnedThreadMap           m_spawnedThreads;     // Holds information of all spawned threads (through this system)
@@ -165,22 +177,27 @@ unsigned __stdcall CThreadManager::RunThread(void* thisPtr)
 	pThreadData->m_threadId = AngelicaThreadUtil::AngelicaGetCurrentThreadId();
 
 	// Apply config
-	const SThreadConfig* pThreadConfig = g_ThreadManager.GetThreadConfigManager()->GetDefaultThreadConfig();
-	ApplyThreadConfig(pThreadData->m_threadId , pThreadData->m_threadHandle, *pThreadConfig);
+	// Note: use the handle of the calling thread, the spawning thread might not have stored m_threadHandle yet
+	const SThreadConfig* pThreadConfig = g_ThreadManager.GetThreadConfigManager()->GetThreadConfig(pThreadData->m_threadName.c_str());
+	ApplyThreadConfig(pThreadData->m_threadId, AngelicaThreadUtil::AngelicaGetCurrentThreadHandle(), *pThreadConfig);
 
-	//ANGELICA_PROFILE_THREADNAME(pThreadData->m_threadName.GetBuffer(0));
+	//ANGELICA_PROFILE_THREADNAME(pThreadData->m_threadName.c_str());
 
 	// Config not found, append thread name with no config tag
-	
-	CStringA  tmpString(pThreadData->m_threadName);
-	const char* cNoConfigAppendix = "(NoCfgFound)";
-	int nNumCharsToReplace = (int)strlen(cNoConfigAppendix);
-	tmpString+=(cNoConfigAppendix);
-
+	if (pThreadConfig == g_ThreadManager.GetThreadConfigManager()->GetDefaultThreadConfig())
+	{
+		std::string tmpString(pThreadData->m_threadName);
+		const char* cNoConfigAppendix = "(NoCfgFound)";
+		tmpString += cNoConfigAppendix;
 
-	// Rename Thread
-	AngelicaThreadUtil::AngelicaSetThreadName(pThreadData->m_threadId, tmpString.GetBuffer(0));
-	//ANGELICA_PROFILE_THREADNAME(tmpString.GetBuffer(0));
+		// Rename Thread
+		AngelicaThreadUtil::AngelicaSetThreadName(pThreadData->m_threadId, tmpString.c_str());
+		//ANGELICA_PROFILE_THREADNAME(tmpString.c_str());
+	}
+	else
+	{
+		AngelicaThreadUtil::AngelicaSetThreadName(pThreadData->m_threadId, pThreadData->m_threadName.c_str());
+	}
 	
 
 	// Enable FPEs
@@ -192,16 +209,18 @@ unsigned __stdcall CThreadManager::RunThread(void* thisPtr)
 	// Disable FPEs
 	g_ThreadManager.EnableFloatExceptions(eFPE_None);
 
+	// Unregister thread
+	// Note: Unregister before the exit is signaled, a joined thread must not touch the thread manager anymore,
+	// it might be destroyed right after the join (e.g. on process exit). The local reference keeps pThreadData valid.
+	_smart_ptr<SThreadMetaData> pKeepAlive = pThreadData;
+	pThreadData->m_pThreadMngr->UnregisterThread(pThreadData->m_pThreadTask);
+
 	// Signal imminent thread end
 	pThreadData->m_threadExitMonitor.BeginSynchronized();
 	pThreadData->m_isRunning = false;
 	pThreadData->m_threadExitMonitor.NotifyAll();
 	pThreadData->m_threadExitMonitor.EndSynchronized();
 
-	// Unregister thread
-	// Note: Unregister after m_threadExitCondition.Notify() to ensure pThreadData is still valid
-	pThreadData->m_pThreadMngr->UnregisterThread(pThreadData->m_pThreadTask);
-
 //	PLATFORM_PROFILER_MARKER("Thread_Stop");
 	AngelicaThreadUtil::AngelicaThreadExitCall();
 
@@ -276,7 +295,7 @@ const char* CThreadManager::GetThreadName(unsigned long nThreadId)
 		{
 			if (iter->second->m_threadId == nThreadId)
 			{
-				return iter->second->m_threadName.GetBuffer(0);
+				return iter->second->m_threadName.c_str();
 			}
 		}
 	}
@@ -292,7 +311,7 @@ const char* CThreadManager::GetThreadName(unsigned long nThreadId)
 		{
 			if (iter->second->m_threadId == nThreadId)
 			{
-				return iter->second->m_threadName.GetBuffer(0);
+				return iter->second->m_threadName.c_str();
 			}
 		}
 	}
@@ -346,7 +365,7 @@ bool CThreadManager::SpawnThread(IThread* pThreadTask, const char* sThreadName,
 
 	// Format thread name
 	char strThreadName[THREAD_NAME_LENGTH_MAX];
-	if (!sprintf_s(strThreadName, sThreadName, args))
+	if (vsnprintf(strThreadName, sizeof(strThreadName), sThreadName, args) >= (int)sizeof(strThreadName))
 	{
 		//AngelicaWarning(VALIDATOR_MODULE_SYSTEM, VALIDATOR_WARNING, "<ThreadInfo>: ThreadName \"%s\" has been truncated to \"%s\". Max characters allowed: %i.", sThreadName, strThreadName, (int)sizeof(strThreadName) - 1);
 	}
@@ -502,7 +521,7 @@ bool CThreadManager::UnRegisterThirdPartyThread(const char* sThreadName, ...)
 
 	// Format thread name
 	char strThreadName[THREAD_NAME_LENGTH_MAX];
-	if (!sprintf_s(strThreadName, sThreadName, args))
+	if (vsnprintf(strThreadName, sizeof(strThreadName), sThreadName, args) >= (int)sizeof(strThreadName))
 	{
 		//AngelicaWarning(VALIDATOR_MODULE_SYSTEM, VALIDATOR_WARNING, "<ThreadInfo>: ThreadName \"%s\" has been truncated to \"%s\". Max characters allowed: %i.", sThreadName, strThreadName, (int)sizeof(strThreadName) - 1);
 	}
@@ -543,7 +562,7 @@ unsigned long CThreadManager::GetThreadId(const char* sThreadName, ...)
 
 	// Format thread name
 	char strThreadName[THREAD_NAME_LENGTH_MAX];
-	if (!sprintf_s(strThreadName, sThreadName, args))
+	if (vsnprintf(strThreadName, sizeof(strThreadName), sThreadName, args) >= (int)sizeof(strThreadName))
 	{
 		//AngelicaWarning(VALIDATOR_MODULE_SYSTEM, VALIDATOR_WARNING, "<ThreadInfo>: ThreadName \"%s\" has been truncated to \"%s\". Max characters allowed: %i. ", sThreadName, strThreadName, (int)sizeof(strThreadName) - 1);
 	}
@@ -0,0 +1,181 @@
+// Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved.
+
+// -------------------------------------------------------------------------
+//  File name:   ContinuationRearmTest.cpp
+//  Version:     v1.00
+//  Description: Continuations parked on a job state which was started again
+//               must not be resumed by a late ResumeContinuations of the last stop
+// -------------------------------------------------------------------------
+//  History:
+////////////////////////////////////////////////////////////////////////////
+
+#include "../stdafx.h"
+#include "../IJobManager.h"
+#include "../JobCoroutine.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <stdio.h>
+
+namespace
+{
+unsigned int g_nNumFailed = 0;
+
+void Check(bool bCondition, const char* szWhat)
+{
+	if (bCondition)
+		return;
+	printf("failed: %s\n", szWhat);
+	++g_nNumFailed;
+}
+
+// counts its resumes, the parked address is the key a late ResumeContinuations of the same job state uses
+struct SCountingContinuation : JobManager::SJobStateContinuation
+{
+	SCountingContinuation() : nNumResumed(0)
+	{
+		pResume = &SCountingContinuation::Resume;
+		pNext = NULL;
+		pWaitAddress = NULL;
+	}
+
+	static void Resume(JobManager::SJobStateContinuation* pContinuation)
+	{
+		++static_cast<SCountingContinuation*>(pContinuation)->nNumResumed;
+	}
+
+	std::atomic<unsigned int> nNumResumed;
+};
+
+// time for a waiting thread or a resumed coroutine to get that far, failing checks only become flaky if it is too short
+void WaitABit()
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+}
+
+// the job state stopped and was started again before the stopping thread resumed the continuations
+void TestRestartedJobState()
+{
+	JobManager::SJobState jobState;
+	SCountingContinuation first;
+	jobState.SetRunning();
+	Check(jobState.AddContinuation(&first), "parking on a running job state");
+	jobState.SetStopped();
+	Check(first.nNumResumed == 1, "resume once the job state stopped");
+
+	SCountingContinuation second;
+	jobState.SetRunning();
+	Check(jobState.AddContinuation(&second), "parking on the restarted job state");
+	JobManager::detail::ResumeContinuations(first.pWaitAddress);
+	Check(second.nNumResumed == 0, "late resume of the first stop leaves the restarted job state's continuation parked");
+
+	jobState.SetStopped();
+	Check(second.nNumResumed == 1, "resume once the restarted job state stopped");
+}
+
+// only some of the jobs stopped since the continuation was parked
+void TestChangedRunningCounter()
+{
+	JobManager::SJobState jobState;
+	SCountingContinuation continuation;
+	jobState.SetRunning();
+	jobState.SetRunning();
+	Check(jobState.AddContinuation(&continuation), "parking on a job state with two jobs");
+	jobState.SetStopped();
+	JobManager::detail::ResumeContinuations(continuation.pWaitAddress);
+	Check(continuation.nNumResumed == 0, "late resume while one job still runs");
+
+	jobState.SetStopped();
+	Check(continuation.nNumResumed == 1, "resume once the last job stopped");
+}
+
+// WaitForAll and WaitForAny park continuations for the waiting thread
+void TestWaitForAllAndAny()
+{
+	JobManager::SJobState arrJobStates[2];
+	JobManager::SJobState* arrJobStatePtrs[2] = { &arrJobStates[0], &arrJobStates[1] };
+	SCountingContinuation probes[2];
+	for (unsigned int i = 0; i < 2; ++i)
+	{
+		arrJobStates[i].SetRunning();
+		arrJobStates[i].AddContinuation(&probes[i]);
+	}
+
+	std::atomic<bool> bWaitForAllReturned(false);
+	std::atomic<bool> bWaitForAnyReturned(false);
+	std::atomic<unsigned int> nStoppedIndex(~0U);
+	std::thread waitForAll([&]()
+	{
+		GetJobManagerInterface()->WaitForAll(arrJobStatePtrs, 2);
+		bWaitForAllReturned = true;
+	});
+	std::thread waitForAny([&]()
+	{
+		nStoppedIndex = GetJobManagerInterface()->WaitForAny(arrJobStatePtrs, 2);
+		bWaitForAnyReturned = true;
+	});
+	WaitABit();
+
+	JobManager::detail::ResumeContinuations(probes[0].pWaitAddress);
+	JobManager::detail::ResumeContinuations(probes[1].pWaitAddress);
+	WaitABit();
+	Check(!bWaitForAllReturned, "WaitForAll stays asleep on a late resume");
+	Check(!bWaitForAnyReturned, "WaitForAny stays asleep on a late resume");
+
+	arrJobStates[1].SetStopped();
+	waitForAny.join();
+	Check(nStoppedIndex == 1, "WaitForAny returns the stopped job state");
+	Check(!bWaitForAllReturned, "WaitForAll waits for every job state");
+
+	arrJobStates[0].SetStopped();
+	waitForAll.join();
+	Check(probes[0].nNumResumed == 1 && probes[1].nNumResumed == 1, "probes resumed once");
+}
+
+#if defined(JOBMANAGER_SUPPORT_COROUTINES)
+std::atomic<bool> g_bCoroutineContinued(false);
+
+JobManager::CJobCoroutine AwaitJobState(JobManager::SJobState& rJobState)
+{
+	co_await rJobState;
+	g_bCoroutineContinued = true;
+}
+
+// co_await parks the coroutine itself, a premature resume would continue it while the job state runs
+void TestCoroutine()
+{
+	JobManager::SJobState jobState;
+	SCountingContinuation probe;
+	jobState.SetRunning();
+	jobState.AddContinuation(&probe);
+
+	JobManager::SJobState coroutineState;
+	AwaitJobState(jobState).Run(&coroutineState);
+	WaitABit();
+
+	JobManager::detail::ResumeContinuations(probe.pWaitAddress);
+	WaitABit();
+	Check(!g_bCoroutineContinued, "co_await stays suspended on a late resume");
+
+	jobState.SetStopped();
+	coroutineState.Wait();
+	Check(g_bCoroutineContinued, "co_await continues once the job state stopped");
+}
+#endif
+}
+
+int main()
+{
+	GetJobManagerInterface()->SetWorkerPoolPolicy(JobManager::eWPP_AllLogicalCores, 0);
+	GetJobManagerInterface()->Init(0);
+
+	TestRestartedJobState();
+	TestChangedRunningCounter();
+	TestWaitForAllAndAny();
+#if defined(JOBMANAGER_SUPPORT_COROUTINES)
+	TestCoroutine();
+#endif
+
+	printf("%s\n", g_nNumFailed == 0 ? "passed" : "FAILED");
+	return g_nNumFailed == 0 ? 0 : 1;
+}
@@ -1,13 +1,38 @@
 // Copyright 2001-2017 Angelicatek GmbH / Angelicatek Group. All rights reserved. 
 
-#include "StdAfx.h"
+#include "stdafx.h"
 #include "AngelicaPlatformDefines.h"
 #include "ThreadConfigManager.h"
+#include "AngelicaThread.h"
+#include <stdarg.h>
 
 namespace
 {
 const char* sCurThreadConfigFilename = "";
 const unsigned int sPlausibleStackSizeLimitKB = (1024 * 100); // 100mb
+
+// Matches szName against szPattern, '*' matches any (possibly empty) sequence of characters
+bool MatchWildcard(const char* szPattern, const char* szName)
+{
+	while (*szPattern)
+	{
+		if (*szPattern == '*')
+		{
+			for (const char* szRest = szName;; ++szRest)
+			{
+				if (MatchWildcard(szPattern + 1, szRest))
+					return true;
+				if (*szRest == '\0')
+					return false;
+			}
+		}
+		if (*szPattern != *szName)
+			return false;
+		++szPattern;
+		++szName;
+	}
+	return *szName == '\0';
+}
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -24,15 +49,61 @@ CThreadConfigManager::CThreadConfigManager()
 //////////////////////////////////////////////////////////////////////////
 const SThreadConfig* CThreadConfigManager::GetThreadConfig(const char* szThreadName, ...)
 {
-	return &m_defaultConfig;
+	va_list args;
+	va_start(args, szThreadName);
+
+	// Format thread name
+	char strThreadName[THREAD_NAME_LENGTH_MAX];
+	vsnprintf(strThreadName, sizeof(strThreadName), szThreadName, args);
+
+	// Get thread config
+	const SThreadConfig* retThreadConfig = GetThreadConfigImpl(strThreadName);
+
+	va_end(args);
+	return retThreadConfig;
 }
 
 //////////////////////////////////////////////////////////////////////////
-//const SThreadConfig* CThreadConfigManager::GetThreadConfigImpl(const char* szThreadName)
-//{
-//	// Get thread config for platform
-//	return &m_defaultConfig;
-//}
+const SThreadConfig* CThreadConfigManager::GetThreadConfigImpl(const char* szThreadName)
+{
+	// Get thread config for platform
+	ThreadConfigMapConstIter threadConfigIter = m_threadConfig.find(szThreadName);
+	if (threadConfigIter != m_threadConfig.end())
+	{
+		return &threadConfigIter->second;
+	}
+
+	// Search wildcard configurations, the longest matching pattern wins
+	const SThreadConfig* pBestMatch = NULL;
+	size_t nBestMatchLength = 0;
+	ThreadConfigMapConstIter wildcardIter = m_wildcardThreadConfig.begin();
+	ThreadConfigMapConstIter wildcardIterEnd = m_wildcardThreadConfig.end();
+	for (; wildcardIter != wildcardIterEnd; ++wildcardIter)
+	{
+		if (wildcardIter->first.length() > nBestMatchLength && MatchWildcard(wildcardIter->first.c_str(), szThreadName))
+		{
+			pBestMatch = &wildcardIter->second;
+			nBestMatchLength = wildcardIter->first.length();
+		}
+	}
+
+	// Failure return default config
+	return pBestMatch ? pBestMatch : &m_defaultConfig;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void CThreadConfigManager::SetThreadConfig(const SThreadConfig& rThreadConfig)
+{
+	const bool bWildCard = strchr(rThreadConfig.szThreadName, '*') ? true : false;
+	ThreadConfigMap& threadConfig = bWildCard ? m_wildcardThreadConfig : m_threadConfig;
+
+	// Store new thread config or override the existing one
+	SThreadConfig& rMapThreadConfig = threadConfig[rThreadConfig.szThreadName];
+	rMapThreadConfig = rThreadConfig;
+
+	// Store name (ref to key)
+	rMapThreadConfig.szThreadName = threadConfig.find(rThreadConfig.szThreadName)->first.c_str();
+}
 
 //////////////////////////////////////////////////////////////////////////
 const SThreadConfig* CThreadConfigManager::GetDefaultThreadConfig() const
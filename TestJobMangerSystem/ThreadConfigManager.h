@@ -3,6 +3,7 @@
 #pragma once
 
 #include <map>
+#include <string>
 #include "IThreadConfigManager.h"
 
 /*
@@ -73,14 +74,13 @@
    "true"   : Disable priority boosting - (default) -
    "false"	: Enable priority boosting
  */
-#include<atlstr.h>
 class CThreadConfigManager : public IThreadConfigManager
 {
 public:
-	typedef std::map<CStringA, SThreadConfig>                 ThreadConfigMap;
-	typedef std::pair<CStringA, SThreadConfig>                ThreadConfigMapPair;
-	typedef std::map<CStringA, SThreadConfig>::iterator       ThreadConfigMapIter;
-	typedef std::map<CStringA, SThreadConfig>::const_iterator ThreadConfigMapConstIter;
+	typedef std::map<std::string, SThreadConfig>                 ThreadConfigMap;
+	typedef std::pair<std::string, SThreadConfig>                ThreadConfigMapPair;
+	typedef std::map<std::string, SThreadConfig>::iterator       ThreadConfigMapIter;
+	typedef std::map<std::string, SThreadConfig>::const_iterator ThreadConfigMapConstIter;
 
 public:
 	CThreadConfigManager();
@@ -101,13 +101,16 @@ public:
 	virtual const SThreadConfig* GetThreadConfig(const char* sThreadName, ...) override;
 	virtual const SThreadConfig* GetDefaultThreadConfig() const override;
 
+	// Adds or overrides the configuration for threads named rThreadConfig.szThreadName ('*' wildcards allowed).
+	virtual void                 SetThreadConfig(const SThreadConfig& rThreadConfig) override;
+
 	virtual void                 DumpThreadConfigurationsToLog() override {}
 
 private:
-	/*const char*          IdentifyPlatform();
-
 	const SThreadConfig* GetThreadConfigImpl(const char* cThreadName);
 
+	/*const char*          IdentifyPlatform();
+
 	bool                 LoadPlatformConfig(const XmlNodeRef& rXmlRoot, const char* sPlatformId);
 
 	void                 LoadPlatformThreadConfigs(const XmlNodeRef& rXmlPlatformRef);
@@ -120,7 +123,7 @@ private:
 	void                 LoadStackSize(const XmlNodeRef& rXmlThreadRef, unsigned int& rStackSize, SThreadConfig::TThreadParamFlag& rParamActivityFlag);*/
 
 private:
-	//ThreadConfigMap m_threadConfig; // Note: The map key is referenced by as const char* by the value's storage class. Other containers may not support this behaviour as they will re-allocate memory as they grow/shrink.
-	//ThreadConfigMap m_wildcardThreadConfig;
+	ThreadConfigMap m_threadConfig; // Note: The map key is referenced by as const char* by the value's storage class. Other containers may not support this behaviour as they will re-allocate memory as they grow/shrink.
+	ThreadConfigMap m_wildcardThreadConfig;
 	SThreadConfig   m_defaultConfig;
 };
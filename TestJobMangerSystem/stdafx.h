@@ -5,6 +5,7 @@
 
 #pragma once
 
+#if defined(_WIN32)
 #include "targetver.h"
 
 #define WIN32_LEAN_AND_MEAN             //  Windows ͷųʹõ
@@ -16,6 +17,12 @@
 #include <malloc.h>
 #include <memory.h>
 #include <tchar.h>
+#else
+// Linux: platform and compiler defines plus the Win32 subset used by the job system
+#include "AngelicaPlatformDefines.h"
+#include "GCCspecific.h"
+#include "Linuxspecific.h"
+#endif
 
 
 // TODO:  ڴ˴óҪͷļ